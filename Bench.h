@@ -0,0 +1,2506 @@
+// =============================================================================
+// Bench.h - Built-in microbenchmarks for GamePauser
+//
+// Run with:  GamePauser.exe --bench  (exit code 1 if any correctness check failed)
+// Everything here is portable and exercises the same code the tool runs,
+// so regressions show up as numbers instead of "it feels slower".
+// =============================================================================
+#pragma once
+#include <algorithm>
+#include <cstdarg>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+#include "RetroLog.h"
+#include "ProcessFreezer.h"
+#include "KeyRing.h"
+#include "ReplayScheduler.h"
+#include "KeyboardState.h"
+#include "ProcessTree.h"
+#include "Simulation.h"
+#include "MemoryTrim.h"
+#include "ResumeStrategy.h"
+#include "PauseController.h"
+#include "Throttle.h"
+#include "MacroLibrary.h"
+#include "TextCompiler.h"
+#include "CaptureOptimizer.h"
+#include "ReplayProfiles.h"
+#include "ReplayCalibrator.h"
+#include "ControlChannel.h"
+#include "LinuxInput.h"
+#include "FocusMode.h"
+#include "FreezeJournal.h"
+#include "Tracing.h"
+#include <map>
+#include <set>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static inline int64_t BenchNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Percentile of an already-sorted sample set
+static inline int64_t BenchPercentile(const std::vector<int64_t>& sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    size_t idx = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+static inline void BenchReport(const char* name, std::vector<int64_t>& samples)
+{
+    std::sort(samples.begin(), samples.end());
+    std::printf("  %-40s p50 %8lld ns  p99 %8lld ns  max %8lld ns  (n=%zu)\n", name,
+        static_cast<long long>(BenchPercentile(samples, 0.50)),
+        static_cast<long long>(BenchPercentile(samples, 0.99)),
+        static_cast<long long>(samples.empty() ? 0 : samples.back()), samples.size());
+}
+
+// Every correctness check reports through here; RunBenchmarks exits nonzero if any failed
+static inline int& BenchFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+static inline const char* BenchVerdict(bool ok, const char* pass = "ok", const char* fail = "MISMATCH")
+{
+    if (!ok) ++BenchFailures();
+    return ok ? pass : fail;
+}
+
+// -----------------------------------------------------------------------------
+// Logger: producer-side cost per call (what the hook pays)
+// -----------------------------------------------------------------------------
+static void BenchPushF(AsyncLogger& log, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    log.PushV(fmt, args);
+    va_end(args);
+}
+
+static void BenchLogger()
+{
+    std::printf("[logger]\n");
+    const int ROUNDS = 200;
+    const int BATCH = 512; // Under ring capacity so nothing is dropped
+    for (int retro = 0; retro <= 1; ++retro) {
+        AsyncLogger log;
+        log.SetSilent(true);
+        log.SetRetro(retro != 0);
+        log.Start();
+        std::vector<int64_t> perCall;
+        perCall.reserve(ROUNDS);
+        for (int r = 0; r < ROUNDS; ++r) {
+            int64_t t0 = BenchNowNs();
+            for (int i = 0; i < BATCH; ++i)
+                log.Push("*** PROCESS PAUSED *** PID: 1234 (5 threads affected)", 53);
+            perCall.push_back((BenchNowNs() - t0) / BATCH);
+            log.Flush();
+        }
+        BenchReport(retro ? "Push (retro style), per call" : "Push (plain style), per call", perCall);
+        log.Stop();
+    }
+    AsyncLogger log;
+    log.SetSilent(true);
+    log.Start();
+    std::vector<int64_t> perCall;
+    for (int r = 0; r < ROUNDS; ++r) {
+        int64_t t0 = BenchNowNs();
+        for (int i = 0; i < BATCH; ++i)
+            BenchPushF(log, "%s PID: %lu (%d threads affected)", "*** PROCESS PAUSED ***", 1234ul, i);
+        perCall.push_back((BenchNowNs() - t0) / BATCH);
+        log.Flush();
+    }
+    BenchReport("PushV (formatted), per call", perCall);
+    log.Stop();
+    // Flush racing Stop (and Flush before Start) must not add a second consumer:
+    // every record is written exactly once
+    const int STOPS = 200;
+    uint64_t pushed = 0, written = 0;
+    for (int r = 0; r < STOPS; ++r) {
+        AsyncLogger racy;
+        racy.SetSilent(true);
+        for (int i = 0; i < 8; ++i) pushed += racy.Push("before start", 12);
+        racy.Flush();
+        racy.Start();
+        for (int i = 0; i < 64; ++i) pushed += racy.Push("racing the stop", 15);
+        std::thread flusher([&racy] { for (int i = 0; i < 4; ++i) racy.Flush(); });
+        racy.Stop();
+        flusher.join();
+        written += racy.Written();
+    }
+    std::printf("  Flush racing Stop, %d rounds: %llu pushed, %llu written: %s\n", STOPS,
+        static_cast<unsigned long long>(pushed), static_cast<unsigned long long>(written), BenchVerdict(pushed == written));
+}
+
+// -----------------------------------------------------------------------------
+// Synthetic target process: N threads that wake every millisecond, like a game
+// -----------------------------------------------------------------------------
+static int RunBenchChild(int threads)
+{
+    for (int i = 0; i < threads; ++i) {
+        std::thread([] {
+            for (;;) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }).detach();
+    }
+    for (;;) std::this_thread::sleep_for(std::chrono::seconds(1));
+}
+
+struct BenchChild
+{
+    uint32_t pid = 0;
+#ifdef _WIN32
+    HANDLE process = nullptr;
+#endif
+};
+
+static BenchChild SpawnBenchChild(int threads)
+{
+    BenchChild child;
+#ifdef _WIN32
+    char exePath[MAX_PATH] = {};
+    GetModuleFileNameA(nullptr, exePath, MAX_PATH);
+    std::string cmd = std::string("\"") + exePath + "\" --bench-child " + std::to_string(threads);
+    STARTUPINFOA si = { sizeof(si) };
+    PROCESS_INFORMATION pi = {};
+    if (!CreateProcessA(nullptr, &cmd[0], nullptr, nullptr, FALSE, CREATE_NO_WINDOW, nullptr, nullptr, &si, &pi))
+        return child;
+    CloseHandle(pi.hThread);
+    child.pid = pi.dwProcessId;
+    child.process = pi.hProcess;
+    std::this_thread::sleep_for(std::chrono::milliseconds(300 + threads)); // Let the threads spin up
+#else
+    pid_t pid = fork();
+    if (pid == 0) _exit(RunBenchChild(threads));
+    if (pid < 0) return child;
+    child.pid = static_cast<uint32_t>(pid);
+    for (int i = 0; i < 500 && ListProcTasks(child.pid).size() < static_cast<size_t>(threads) + 1; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+#endif
+    return child;
+}
+
+static void KillBenchChild(BenchChild& child)
+{
+    if (!child.pid) return;
+#ifdef _WIN32
+    TerminateProcess(child.process, 0);
+    WaitForSingleObject(child.process, 2000);
+    CloseHandle(child.process);
+#else
+    kill(static_cast<pid_t>(child.pid), SIGKILL);
+    waitpid(static_cast<pid_t>(child.pid), nullptr, 0);
+#endif
+    child.pid = 0;
+}
+
+// -----------------------------------------------------------------------------
+// Freezer: freeze / thaw latency against target thread count
+// -----------------------------------------------------------------------------
+static void BenchFreezer()
+{
+    std::printf("[freezer]\n");
+    const int ITERATIONS = 100;
+    const int counts[] = { 1, 16, 64, 256 };
+    for (int threads : counts) {
+        BenchChild child = SpawnBenchChild(threads);
+        if (!child.pid) {
+            std::printf("  could not spawn %d-thread target\n", threads);
+            ++BenchFailures();
+            continue;
+        }
+        auto freezer = CreateProcessFreezer();
+        std::vector<int64_t> freeze, thaw;
+        size_t seen = 0, incomplete = 0;
+        for (int i = 0; i < ITERATIONS; ++i) {
+            FreezeResult f = freezer->Freeze(child.pid);
+            seen = f.threads;
+            if (!f.ok || f.partial) ++incomplete;
+            freeze.push_back(f.elapsedNs);
+            thaw.push_back(freezer->Thaw().elapsedNs);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        char label[64];
+        std::snprintf(label, sizeof(label), "Freeze, %zu threads", seen);
+        BenchReport(label, freeze);
+        std::snprintf(label, sizeof(label), "Thaw, %zu threads", seen);
+        BenchReport(label, thaw);
+        if (incomplete) std::printf("  %zu of %d freezes failed or gave up before every thread stopped: %s\n", incomplete, ITERATIONS, BenchVerdict(false));
+        KillBenchChild(child);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Key capture ring: producer cost per event with a live consumer thread
+// -----------------------------------------------------------------------------
+static void BenchKeyRing()
+{
+    std::printf("[capture ring]\n");
+    const size_t EVENTS = 4000000;
+    const struct { OverflowPolicy policy; const char* name; size_t burst; } cases[] = {
+        { OverflowPolicy::Spill, "typing bursts", 1024 }, // Realistic: consumer keeps up
+        { OverflowPolicy::DropOldest, "flood/drop", 0 }, // Producer outruns consumer
+        { OverflowPolicy::Block, "flood/block", 0 },
+        { OverflowPolicy::Spill, "flood/spill", 0 },
+    };
+    for (const auto& c : cases) {
+        KeyRing ring(4096, c.policy);
+        std::atomic<bool> done{ false };
+        size_t consumed = 0;
+        std::thread consumer([&] {
+            std::vector<KeyEvent> batch;
+            batch.reserve(1 << 20);
+            for (;;) {
+                bool last = done.load(std::memory_order_acquire);
+                batch.clear();
+                consumed += ring.Drain(batch);
+                if (last && ring.Empty()) break;
+                if (batch.empty()) std::this_thread::yield();
+            }
+        });
+        int64_t busy = 0;
+        for (size_t i = 0; i < EVENTS;) {
+            size_t end = c.burst ? std::min(EVENTS, i + c.burst) : EVENTS;
+            int64_t t0 = BenchNowNs();
+            for (; i < end; ++i) {
+                KeyEvent ev = { MonotonicNs(), static_cast<uint16_t>('A' + i % 26), 0x1E,
+                    static_cast<uint16_t>(i & 1 ? KEY_UP : 0), 0 };
+                ring.Push(ev);
+            }
+            busy += BenchNowNs() - t0;
+            while (c.burst && !ring.Empty()) std::this_thread::yield(); // Pause between bursts
+        }
+        done.store(true, std::memory_order_release);
+        consumer.join();
+        std::printf("  %-14s %6.1f ns/event  consumed %zu  dropped %llu  spilled %llu  allocations %llu (%.6f/event)\n",
+            c.name, static_cast<double>(busy) / EVENTS, consumed,
+            static_cast<unsigned long long>(ring.Dropped()), static_cast<unsigned long long>(ring.Spilled()),
+            static_cast<unsigned long long>(ring.ArenaGrowths()), static_cast<double>(ring.ArenaGrowths()) / EVENTS);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Replay scheduler: achieved pacing against a recording sink
+// -----------------------------------------------------------------------------
+static std::vector<KeyEvent> BenchTrace(size_t presses, uint64_t gapNs)
+{
+    std::vector<KeyEvent> trace;
+    uint64_t t = 0;
+    for (size_t i = 0; i < presses; ++i) {
+        uint16_t vk = static_cast<uint16_t>('A' + i % 26);
+        trace.push_back({ t, vk, 0, 0, 0 });
+        t += gapNs / 2;
+        trace.push_back({ t, vk, 0, KEY_UP, 0 });
+        t += gapNs / 2;
+    }
+    return trace;
+}
+
+static void BenchReplay()
+{
+    std::printf("[replay]\n");
+    std::vector<KeyEvent> trace = BenchTrace(100, 4000000); // 200 events, 2 ms apart
+    struct Case { const char* name; ReplayPolicy policy; double speed; size_t events; };
+    const Case cases[] = {
+        { "faithful (2 ms gaps)", ReplayPolicy::Faithful, 1.0, trace.size() },
+        { "speed x4", ReplayPolicy::Speed, 4.0, trace.size() },
+        { "batched x32", ReplayPolicy::Batched, 1.0, trace.size() },
+        { "jitter 18-45 ms", ReplayPolicy::Jitter, 1.0, 20 }, // Classic mode; 200 events would take ~6 s
+    };
+    for (const Case& c : cases) {
+        ReplayOptions opt;
+        opt.policy = c.policy;
+        opt.speed = c.speed;
+        opt.leadDelayMs = 0;
+        ReplayScheduler scheduler(opt);
+        RecordingSink sink;
+        ReplayStats st = scheduler.Run(trace.data(), c.events, sink);
+        std::printf("  %-22s %4zu events %3zu sink calls  %8.2f ms total  late p50 %6llu us  p99 %6llu us  max %6llu us\n",
+            c.name, st.events, st.sinkCalls, st.durationNs / 1e6,
+            static_cast<unsigned long long>(st.lateP50Ns / 1000), static_cast<unsigned long long>(st.lateP99Ns / 1000),
+            static_cast<unsigned long long>(st.lateMaxNs / 1000));
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Keyboard state: bitset model vs. the old std::set + capture-log scan
+// -----------------------------------------------------------------------------
+static void BenchKeyboardState()
+{
+    std::printf("[keyboard state]\n");
+    // What a release at resume is built from: the held set, and the flags and scan code
+    // each key was last pressed with
+    {
+        KeyboardState state;
+        auto held = [&state] {
+            std::vector<uint16_t> vks;
+            state.Snapshot().ForEachHeld([&vks](uint16_t vk) { vks.push_back(vk); });
+            return vks;
+        };
+        state.Press('A');
+        state.Press(0xA3, true);
+        state.Press(0x70);
+        state.Press('A'); // Auto-repeat: still one key
+        state.Apply('B', 0x30, 0);
+        state.Release('A');
+        state.Apply('B', 0x30, KEY_UP);
+        state.Release('Z'); // Never pressed
+        bool sequence = held() == std::vector<uint16_t>{ 0x70, 0xA3 } && state.IsDown(0xA3) && !state.IsDown('A') && !state.IsDown('B')
+            && state.Snapshot().Count() == 2;
+        state.Clear();
+        bool cleared = !state.AnyDown() && held().empty();
+        std::printf("  press/release sequence leaves exactly the keys still down: %s, Clear: %s\n", BenchVerdict(sequence), BenchVerdict(cleared));
+
+        state.Apply(0, 0x1E, 0);
+        state.Apply(255, 0x2A, 0); // A driver's fake shift
+        state.Apply(256, 0, 0);
+        state.Apply('C', 0, KEY_UNICODE); // Text, not a key
+        bool ignored = !state.AnyDown();
+        state.Press('D');
+        state.Apply(255, 0, KEY_UP);
+        state.Apply(0, 0, KEY_UP);
+        ignored = ignored && held() == std::vector<uint16_t>{ 'D' };
+        std::printf("  vk 0, 255, 256 and Unicode events ignored: %s\n", BenchVerdict(ignored));
+
+        // Extended flag and scan code as last pressed; a press without a scan code keeps the old one
+        state.Clear();
+        state.Apply(0x2E, 0x53, KEY_EXTENDED); // Delete on the navigation block
+        state.Apply(0xA5, 0x38, KEY_EXTENDED);
+        state.Apply(0xA5, 0x38, KEY_UP);
+        state.Apply(0xA4, 0x38, 0);
+        state.Apply(0x2E, 0, 0); // Numpad Del: same vk, not extended
+        state.Apply(0x2E, 0, KEY_EXTENDED);
+        std::vector<KeyEvent> releases;
+        size_t n = state.Snapshot().HeldEvents(releases, true, 77);
+        bool flags = n == 2 && releases[0].vk == 0x2E && releases[0].scan == 0x53 && releases[0].flags == (KEY_UP | KEY_EXTENDED)
+            && releases[1].vk == 0xA4 && releases[1].scan == 0x38 && releases[1].flags == KEY_UP && releases[0].timeNs == 77;
+        std::vector<KeyEvent> presses;
+        state.Snapshot().HeldEvents(presses, false);
+        flags = flags && presses.size() == 2 && presses[0].flags == KEY_EXTENDED && presses[1].flags == 0;
+        std::printf("  held events carry the last extended flag and scan code: %s\n", BenchVerdict(flags));
+
+        // ForEachHeld goes lowest vk first across all four words; a snapshot is a copy
+        state.Clear();
+        const uint16_t spread[] = { 0xFE, 0x90, 0x41, 0x08, 0x7F, 0x40 };
+        for (uint16_t vk : spread) state.Press(vk);
+        KeySnapshot snap = state.Snapshot();
+        state.Release(0x41);
+        state.Press(0x42);
+        std::vector<uint16_t> order;
+        snap.ForEachHeld([&order](uint16_t vk) { order.push_back(vk); });
+        bool snapshot = order == std::vector<uint16_t>{ 0x08, 0x40, 0x41, 0x7F, 0x90, 0xFE } && snap.Count() == 6 && snap.IsDown(0x41)
+            && !snap.IsDown(0x42) && !snap.IsDown(256);
+        std::printf("  snapshot holds its instant, ForEachHeld in vk order: %s\n", BenchVerdict(snapshot));
+
+        // Raw Input's generic modifiers land on the sided codes the hook uses; only keys whose
+        // release Raw Input reports are seeded at startup
+        bool sided = SidedVk(0x10, 0x2A, false) == 0xA0 && SidedVk(0x10, 0x36, false) == 0xA1 && SidedVk(0x11, 0x1D, false) == 0xA2
+            && SidedVk(0x11, 0x1D, true) == 0xA3 && SidedVk(0x12, 0x38, false) == 0xA4 && SidedVk(0x12, 0x38, true) == 0xA5
+            && SidedVk('A', 0x1E, false) == 'A' && SidedVk(0xA1, 0x36, false) == 0xA1;
+        state.Clear();
+        state.Apply(SidedVk(0x10, 0x36, false), 0x36, 0);
+        state.Apply(SidedVk(0x11, 0x1D, true), 0x1D, KEY_EXTENDED);
+        bool bothDown = held() == std::vector<uint16_t>{ 0xA1, 0xA3 };
+        state.Apply(SidedVk(0x10, 0x36, false), 0x36, KEY_UP);
+        state.Apply(SidedVk(0x11, 0x1D, true), 0x1D, KEY_UP | KEY_EXTENDED);
+        sided = sided && bothDown && !state.AnyDown();
+        bool seeded = true;
+        for (uint16_t vk = 0; vk < 256; ++vk) {
+            bool expect = vk > 0x06 && vk < 0xFF && vk != 0x10 && vk != 0x11 && vk != 0x12;
+            seeded = seeded && RawKeyboardVk(vk) == expect;
+        }
+        std::printf("  generic Shift/Ctrl/Alt map to their sides and release again: %s, seeded keys skip mouse and generic modifiers: %s\n",
+            BenchVerdict(sided), BenchVerdict(seeded));
+    }
+
+    const int ROUNDS = 2000;
+    std::vector<KeyEvent> trace = BenchTrace(500, 1000000); // 1000 captured events
+    for (size_t i = 0; i < 6; ++i) // Leave a chord of 6 keys held at resume
+        trace.push_back({ 0, static_cast<uint16_t>(0xA0 + i), 0, static_cast<uint16_t>(i & 1 ? KEY_EXTENDED : 0), 0 });
+    std::vector<int64_t> applyNs, snapNs, setNs;
+    volatile size_t sink = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        KeyboardState state;
+        int64_t t0 = BenchNowNs();
+        for (const KeyEvent& ev : trace) state.Apply(ev);
+        applyNs.push_back((BenchNowNs() - t0) / static_cast<int64_t>(trace.size()));
+
+        std::vector<KeyEvent> out;
+        out.reserve(256);
+        t0 = BenchNowNs();
+        state.Snapshot().HeldEvents(out, false);
+        snapNs.push_back(BenchNowNs() - t0);
+        sink = sink + out.size();
+
+        // Previous approach: std::set of held keys, then scan the whole log per key for its flags
+        t0 = BenchNowNs();
+        std::set<uint16_t> held;
+        for (const KeyEvent& ev : trace) {
+            if (ev.flags & KEY_UP) held.erase(ev.vk);
+            else held.insert(ev.vk);
+        }
+        size_t extended = 0;
+        for (uint16_t vk : held) {
+            for (const KeyEvent& ev : trace) {
+                if (ev.vk == vk && !(ev.flags & KEY_UP)) {
+                    extended += (ev.flags & KEY_EXTENDED) != 0;
+                    break;
+                }
+            }
+        }
+        setNs.push_back(BenchNowNs() - t0);
+        sink = sink + extended;
+    }
+    BenchReport("Apply, per event", applyNs);
+    BenchReport("Snapshot + held events (6 held)", snapNs);
+    BenchReport("Old: std::set + log scan (1006 events)", setNs);
+}
+
+// -----------------------------------------------------------------------------
+// Process groups: tree discovery and parallel freeze of several processes
+// -----------------------------------------------------------------------------
+static uint32_t BenchSelfPid()
+{
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<uint32_t>(getpid());
+#endif
+}
+
+static void BenchProcessGroup()
+{
+    std::printf("[process groups]\n");
+    const int CHILDREN = 4;
+    std::vector<BenchChild> kids;
+    for (int i = 0; i < CHILDREN; ++i) kids.push_back(SpawnBenchChild(32));
+    std::vector<int64_t> discover, freeze, thaw;
+    PauseTargetOptions opt;
+    opt.includeChildren = true;
+    size_t members = 0, threads = 0, missed = 0;
+    ProcessGroupFreezer group;
+    for (int i = 0; i < 50; ++i) {
+        int64_t t0 = BenchNowNs();
+        // Our own children stand in for a launcher's game/renderer/crash-handler processes
+        std::vector<PauseMember> targets = ResolvePauseTargets(BenchSelfPid(), opt, BenchSelfPid());
+        discover.push_back(BenchNowNs() - t0);
+        members = targets.size();
+        t0 = BenchNowNs();
+        std::vector<MemberResult> res = group.Freeze(targets, GroupOrder::ChildrenFirst);
+        freeze.push_back(BenchNowNs() - t0);
+        size_t frozen = 0;
+        for (const MemberResult& r : res) frozen += r.result.threads;
+        // Freezers (and on Windows their thread handles) are kept from one pause to the next:
+        // every pause must still catch every thread, and a member dropped for one pause is
+        // picked up again with a fresh freezer the next
+        if (i > 0 && (frozen != threads || group.Pids().size() != members)) ++missed;
+        threads = frozen;
+        t0 = BenchNowNs();
+        group.Thaw();
+        thaw.push_back(BenchNowNs() - t0);
+        if (i == 25 && targets.size() > 1) {
+            std::vector<PauseMember> fewer(targets.begin() + 1, targets.end());
+            group.Freeze(fewer, GroupOrder::ChildrenFirst);
+            group.Thaw();
+        }
+    }
+    std::printf("  %zu processes, %zu threads in the group, every pause caught them all: %s\n", members, threads,
+        BenchVerdict(missed == 0));
+    BenchReport("Discover tree (full process scan)", discover);
+    BenchReport("Freeze group (parallel per level)", freeze);
+    BenchReport("Thaw group", thaw);
+    for (BenchChild& k : kids) KillBenchChild(k);
+}
+
+// -----------------------------------------------------------------------------
+// Headless pipeline: synthetic sessions through the real PauseController
+// -----------------------------------------------------------------------------
+static void BenchSimulation()
+{
+    std::printf("[pipeline simulation]\n");
+    ReplayOptions faithful;
+    faithful.policy = ReplayPolicy::Faithful;
+    ReplayOptions batched;
+    batched.policy = ReplayPolicy::Batched;
+    struct Session { const char* name; std::vector<KeyEvent> trace; ReplayOptions replay; };
+    const Session sessions[] = {
+        { "typing bursts, 400 events", SimTypingBursts(400), faithful },
+        { "autorepeat storm, 2k events", SimAutorepeatStorm(2000), faithful },
+        { "long session, 10k events", SimTypingBursts(10000, 7), batched },
+        { "long session, 10k, jitter", SimTypingBursts(10000, 7), ReplayOptions() },
+    };
+    for (const Session& s : sessions) {
+        SimulationResult r = RunSimulation(s.name, s.trace, s.replay);
+        std::printf("  %s - %s\n", r.name.c_str(), BenchVerdict(r.ok, "replayed intact"));
+        BenchReport("hook callback, not paused", r.idleNs);
+        BenchReport("hook callback, capturing", r.captureNs);
+        std::printf("  %-40s %10.0f events/s  (%zu events in %.2f ms, %llu spilled)\n", "capture throughput",
+            r.events / (r.captureWallNs / 1e9), r.events, r.captureWallNs / 1e6, static_cast<unsigned long long>(r.spilled));
+        std::printf("  %-40s %10.1f ms simulated (%s, %zu sink calls), %.2f ms real\n", "replay duration",
+            r.replay.durationNs / 1e6, ReplayPolicyName(s.replay.policy), r.replay.sinkCalls, r.acceptNs / 1e6);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Metrics: recording cost on the hook path, export cost, one real scrape
+// -----------------------------------------------------------------------------
+static std::string BenchScrape(uint16_t port)
+{
+    std::string body;
+#ifndef _WIN32
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+        const char req[] = "GET /metrics HTTP/1.0\r\n\r\n";
+        send(s, req, sizeof(req) - 1, 0);
+        char buf[4096];
+        for (ssize_t n; (n = recv(s, buf, sizeof(buf), 0)) > 0;) body.append(buf, static_cast<size_t>(n));
+    }
+    close(s);
+#else
+    (void)port;
+#endif
+    return body;
+}
+
+// Connects and never sends a byte; -1 if it couldn't connect
+static int BenchSilentClient(uint16_t port)
+{
+#ifndef _WIN32
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) return s;
+    close(s);
+#else
+    (void)port;
+#endif
+    return -1;
+}
+
+static void BenchMetrics()
+{
+    std::printf("[metrics]\n");
+    LatencyHistogram h;
+    std::vector<int64_t> record;
+    for (int r = 0; r < 2000; ++r) {
+        int64_t t0 = BenchNowNs();
+        for (int i = 0; i < 256; ++i) h.Record(static_cast<uint64_t>(40 + (i * 37) % 500));
+        record.push_back((BenchNowNs() - t0) / 256);
+    }
+    BenchReport("Histogram Record, per call", record);
+
+    PauseMetrics metrics;
+    ReplayOptions batched;
+    batched.policy = ReplayPolicy::Batched;
+    SimulationResult plain = RunSimulation("10k, no metrics", SimTypingBursts(10000, 7), batched);
+    SimulationResult metered = RunSimulation("10k, metrics", SimTypingBursts(10000, 7), batched, 4096, &metrics);
+    BenchReport("hook callback, capturing, no metrics", plain.captureNs);
+    BenchReport("hook callback, capturing, with metrics", metered.captureNs);
+    std::vector<int64_t> render;
+    size_t bytes = 0;
+    for (int r = 0; r < 200; ++r) {
+        int64_t t0 = BenchNowNs();
+        bytes = metrics.RenderPrometheus().size();
+        render.push_back(BenchNowNs() - t0);
+    }
+    BenchReport("RenderPrometheus", render);
+    std::printf("  exposition %zu bytes; hook p50 %llu ns / p99 %llu ns as exported\n", bytes,
+        static_cast<unsigned long long>(metrics.hookNs.Percentile(0.50)),
+        static_cast<unsigned long long>(metrics.hookNs.Percentile(0.99)));
+    MetricsServer server;
+    const uint16_t port = 19464;
+    if (server.Start(port, [&] { return metrics.RenderPrometheus(); })) {
+        std::string reply = BenchScrape(port);
+        std::printf("  scrape of 127.0.0.1:%u -> %zu bytes, %s\n", port, reply.size(),
+            BenchVerdict(reply.find("gamepauser_pause_seconds_count{title=\"sim-target\"} 1") != std::string::npos, "ok", "UNEXPECTED"));
+#ifndef _WIN32
+        // A client that connects and says nothing is dropped after the timeout: the next
+        // scrape waits for it at most that long, and so does Stop()
+        int silent = BenchSilentClient(port);
+        int64_t t0 = BenchNowNs();
+        reply = BenchScrape(port);
+        int64_t scrapeNs = BenchNowNs() - t0;
+        close(silent);
+        silent = BenchSilentClient(port);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20)); // Let the server take it
+        t0 = BenchNowNs();
+        server.Stop();
+        int64_t stopNs = BenchNowNs() - t0;
+        close(silent);
+        const int64_t bound = 2LL * MetricsServer::IO_TIMEOUT_MS * 1000000LL;
+        std::printf("  behind a silent client: scrape in %.0f ms, Stop() in %.0f ms (timeout %d ms): %s\n", scrapeNs / 1e6, stopNs / 1e6,
+            MetricsServer::IO_TIMEOUT_MS, BenchVerdict(!reply.empty() && scrapeNs < bound && stopNs < bound));
+#endif
+        server.Stop();
+    }
+    else {
+        std::printf("  could not listen on 127.0.0.1:%u\n", port);
+        ++BenchFailures();
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Memory trim: RSS while paused and faults in the first frame after resume.
+// The target is a forked child that walks a large heap plus a file mapping
+// every frame; anonymous pages can only leave RAM if the machine has swap.
+// -----------------------------------------------------------------------------
+#ifndef _WIN32
+static void RunBenchHeapChild(size_t mb, std::atomic<uint64_t>* frames)
+{
+    size_t bytes = mb << 20;
+    std::vector<char> heap(bytes, 1);
+    char path[] = "/tmp/gamepauser-bench-XXXXXX";
+    int fd = mkstemp(path);
+    std::vector<char> chunk(1 << 20, 2);
+    for (size_t i = 0; fd >= 0 && i < mb; ++i) {
+        if (write(fd, chunk.data(), chunk.size()) < 0) break;
+    }
+    if (fd >= 0) fsync(fd); // Clean pages, so a page-out really drops them
+    const char* file = fd >= 0 ? static_cast<const char*>(mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0)) : nullptr;
+    unlink(path);
+    if (file == MAP_FAILED) file = nullptr;
+    volatile uint64_t sum = 0;
+    for (;;) {
+        uint64_t s = 0;
+        for (size_t i = 0; i < bytes; i += 4096) s += heap[i]; // One touch per page, like a frame's working set
+        for (size_t i = 0; file && i < bytes; i += 4096) s += file[i];
+        sum = sum + s;
+        frames->fetch_add(1, std::memory_order_release);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+}
+
+static void BenchMemoryTrim()
+{
+    std::printf("[memory trim]\n");
+    const size_t MB = 256; // Heap, plus a file mapping of the same size
+    struct Mode { const char* name; bool trim; bool prefetch; uint64_t budgetMB; };
+    const Mode modes[] = { { "no trim", false, false, 0 }, { "trim, no prefetch", true, false, 0 }, { "trim + prefetch", true, true, 0 },
+        { "trim + prefetch 64M", true, true, 64 } };
+    for (const Mode& mode : modes) {
+        auto* frames = static_cast<std::atomic<uint64_t>*>(mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+        new (frames) std::atomic<uint64_t>(0);
+        pid_t pid = fork();
+        if (pid == 0) {
+            RunBenchHeapChild(MB, frames);
+            _exit(0);
+        }
+        for (int i = 0; i < 2000 && frames->load() < 3; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        uint32_t target = static_cast<uint32_t>(pid);
+        auto freezer = CreateProcessFreezer(1);
+        freezer->Freeze(target);
+        uint64_t rssPaused = ProcessResidentBytes(target);
+        WorkingSetTrimmer trimmer(mode.budgetMB << 20);
+        TrimResult t;
+        PrefetchResult p;
+        if (mode.trim) {
+            t = trimmer.Trim(target);
+            rssPaused = t.rssAfter;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        PageFaults faults0 = ProcessPageFaults(target);
+        int64_t t0 = BenchNowNs();
+        std::thread prefetch;
+        if (mode.prefetch) prefetch = std::thread([&] { p = trimmer.Prefetch(); }); // As GroupPauseFreezer does it
+        uint64_t before = frames->load(std::memory_order_acquire);
+        freezer->Thaw();
+        // +2: the frame interrupted by the freeze, then one whole frame after resume
+        while (frames->load(std::memory_order_acquire) < before + 2 && BenchNowNs() - t0 < 10000000000LL)
+            std::this_thread::yield();
+        int64_t frameNs = BenchNowNs() - t0;
+        PageFaults faults1 = ProcessPageFaults(target);
+        if (prefetch.joinable()) prefetch.join();
+        std::printf("  %-19s RSS %6.1f MB -> %6.1f MB paused  first frame %7.2f ms, %6llu faults (%llu major)%s\n", mode.name,
+            (mode.trim ? t.rssBefore : rssPaused) / 1048576.0, rssPaused / 1048576.0, frameNs / 1e6,
+            static_cast<unsigned long long>(faults1.total - faults0.total),
+            static_cast<unsigned long long>(faults1.major - faults0.major), mode.trim && !t.ok ? "  (trim refused - needs CAP_SYS_NICE)" : "");
+        if (mode.trim)
+            std::printf("  %-19s hot set %.1f MB in %zu runs recorded in %.2f ms\n", "", t.hotBytes / 1048576.0, t.regions, t.elapsedNs / 1e6);
+        if (mode.prefetch) {
+            uint64_t budget = mode.budgetMB << 20, want = budget ? std::min(budget, t.hotBytes) : t.hotBytes;
+            std::printf("  %-19s prefetched %.1f MB in %.2f ms, %zu calls, within the budget: %s\n", "", p.bytes / 1048576.0, p.elapsedNs / 1e6, p.calls,
+                BenchVerdict(p.bytes <= want && p.bytes + 4096 > want));
+        }
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        munmap(frames, 4096);
+    }
+}
+#else
+static void BenchMemoryTrim()
+{
+    std::printf("[memory trim]\n  (heap-walking target is Linux only)\n");
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// Resume strategies: how soon the main thread gets going again. The target is
+// a forked "game": a main thread rendering 2 ms frames, plus worker threads
+// whose catch-up work grows with the time they were frozen (like audio and
+// streaming do), all competing for the same CPUs.
+// -----------------------------------------------------------------------------
+#ifndef _WIN32
+struct BenchGameState
+{
+    std::atomic<uint64_t> frames;
+    std::atomic<int64_t> frameNs[4096]; // Completion time of frame n at [n % 4096]
+};
+
+static void BenchBurnCpu(int64_t ns)
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    int64_t end = ts.tv_sec * 1000000000LL + ts.tv_nsec + ns;
+    do clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    while (ts.tv_sec * 1000000000LL + ts.tv_nsec < end);
+}
+
+static void RunBenchGameChild(BenchGameState* state, int workers)
+{
+    for (int i = 0; i < workers; ++i) {
+        std::thread([] {
+            int64_t last = BenchNowNs();
+            for (;;) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                int64_t now = BenchNowNs();
+                BenchBurnCpu(std::min<int64_t>(now - last, 1000000000LL) / 20); // 5% of the time since we last ran
+                last = now;
+            }
+        }).detach();
+    }
+    for (;;) {
+        BenchBurnCpu(2000000);
+        uint64_t n = state->frames.load(std::memory_order_relaxed);
+        state->frameNs[n % 4096].store(BenchNowNs(), std::memory_order_relaxed);
+        state->frames.store(n + 1, std::memory_order_release);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+}
+
+static void BenchResume()
+{
+    std::printf("[resume strategy]\n");
+    const int WORKERS = 6, REPEATS = 3;
+    const int64_t PAUSE_NS = 500000000, WINDOW_NS = 150000000;
+    auto* state = static_cast<BenchGameState*>(mmap(nullptr, sizeof(BenchGameState), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    new (state) BenchGameState();
+    pid_t pid = fork();
+    if (pid == 0) {
+        RunBenchGameChild(state, WORKERS);
+        _exit(0);
+    }
+    uint32_t target = static_cast<uint32_t>(pid);
+    for (int i = 0; i < 2000 && (state->frames.load() < 10 || ListProcTasks(target).size() < WORKERS + 1); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    std::printf("  %d worker threads, %u CPUs, paused %.0f ms, first %.0f ms after resume:\n", WORKERS,
+        std::thread::hardware_concurrency(), PAUSE_NS / 1e6, WINDOW_NS / 1e6);
+
+    struct Mode { const char* name; ResumeOrder order; int staggerMs; int warmupMs; bool running; };
+    const Mode modes[] = {
+        { "reverse (all at once)", ResumeOrder::Reverse, 0, 0, false },
+        { "main-first, 30 ms head start", ResumeOrder::MainFirst, 30, 0, false },
+        { "busiest, 30 ms head start", ResumeOrder::Busiest, 30, 0, false },
+        { "main-first + 150 ms warm-up", ResumeOrder::MainFirst, 30, 150, false },
+        { "reverse, replay on running", ResumeOrder::Reverse, 0, 0, true },
+    };
+    PauseTargetOptions targets;
+    targets.includeChildren = false;
+    for (const Mode& mode : modes) {
+        ResumeOptions opt;
+        opt.order = mode.order;
+        opt.staggerMs = mode.staggerMs;
+        opt.warmupMs = mode.warmupMs;
+        opt.leadOnRunning = mode.running;
+        GroupPauseFreezer freezer(targets, GroupOrder::ChildrenFirst, BenchSelfPid(), MemoryOptions(), opt);
+        double firstFrame = 0, frames = 0, mainCpu = 0, workerCpu = 0, running = 0;
+        for (int rep = 0; rep < REPEATS; ++rep) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(300)); // Back to steady state
+            freezer.Freeze(target);
+            std::this_thread::sleep_for(std::chrono::nanoseconds(PAUSE_NS));
+            std::vector<ThreadCpu> cpu0 = SampleThreadCpu(target, ListProcTasks(target));
+            uint64_t before = state->frames.load(std::memory_order_acquire);
+            int64_t t0 = BenchNowNs();
+            freezer.Thaw();
+            if (mode.running) running += freezer.AwaitRunning(380000000LL) / 1e6;
+            std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(t0 + WINDOW_NS)));
+            std::vector<ThreadCpu> cpu1 = SampleThreadCpu(target, ListProcTasks(target));
+            uint64_t after = state->frames.load(std::memory_order_acquire);
+            // +1: skip the frame the freeze interrupted
+            int64_t firstNs = after > before + 1 ? state->frameNs[(before + 1) % 4096].load() - t0 : WINDOW_NS;
+            firstFrame += firstNs / 1e6;
+            for (uint64_t n = before + 1; n < after; ++n) frames += state->frameNs[n % 4096].load() - t0 <= WINDOW_NS;
+            for (const ThreadCpu& c1 : cpu1) {
+                for (const ThreadCpu& c0 : cpu0) {
+                    if (c0.tid != c1.tid) continue;
+                    (c1.main ? mainCpu : workerCpu) += (c1.cpuNs - c0.cpuNs) / 1e6;
+                }
+            }
+        }
+        std::printf("  %-30s first frame %6.1f ms, %5.1f frames, CPU main %5.1f ms / workers %5.1f ms", mode.name,
+            firstFrame / REPEATS, frames / REPEATS, mainCpu / REPEATS, workerCpu / REPEATS);
+        if (mode.running) std::printf(", running after %.1f ms", running / REPEATS);
+        std::printf("\n");
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    munmap(state, sizeof(BenchGameState));
+}
+#else
+static void BenchResume()
+{
+    std::printf("[resume strategy]\n  (synthetic game target is Linux only)\n");
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// Duty-cycle throttle against a CPU-burning child: achieved vs target share,
+// how long the target is ever left frozen, and what the slicing costs us
+// -----------------------------------------------------------------------------
+#ifndef _WIN32
+static void BenchThrottle()
+{
+    std::printf("[throttle]\n");
+    pid_t pid = fork();
+    if (pid == 0) {
+        std::thread([] { for (volatile uint64_t n = 0;; n = n + 1) {} }).detach();
+        for (volatile uint64_t n = 0;; n = n + 1) {}
+    }
+    uint32_t target = static_cast<uint32_t>(pid);
+    for (int i = 0; i < 500 && ListProcTasks(target).size() < 2; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    struct Mode { const char* name; double share; bool adaptive; };
+    const Mode modes[] = { { "fixed 2 ms / 20 ms", 0.10, false }, { "adaptive 10%", 0.10, true }, { "adaptive 20%", 0.20, true } };
+    PauseTargetOptions targets;
+    targets.includeChildren = false;
+    const int64_t RUN_NS = 3000000000LL;
+    for (const Mode& mode : modes) {
+        ThrottleOptions opt;
+        opt.share = mode.share;
+        opt.adaptive = mode.adaptive;
+        DutyCycleThrottler throttle(targets, GroupOrder::ChildrenFirst, BenchSelfPid(), opt);
+        rusage ru0, ru1;
+        getrusage(RUSAGE_SELF, &ru0); // Unlike /proc task sums, this keeps exited threads' time
+        throttle.Start(target);
+        std::this_thread::sleep_for(std::chrono::nanoseconds(RUN_NS / 2)); // Let the slice settle
+        uint64_t cpu0 = ProcessCpuNs(target);
+        int64_t t0 = BenchNowNs();
+        std::this_thread::sleep_for(std::chrono::nanoseconds(RUN_NS / 2));
+        double share = static_cast<double>(ProcessCpuNs(target) - cpu0) / static_cast<double>(BenchNowNs() - t0);
+        ThrottleStats st = throttle.Stats();
+        throttle.Stop();
+        getrusage(RUSAGE_SELF, &ru1);
+        double self = ((ru1.ru_utime.tv_sec - ru0.ru_utime.tv_sec + ru1.ru_stime.tv_sec - ru0.ru_stime.tv_sec) * 1e9
+            + (ru1.ru_utime.tv_usec - ru0.ru_utime.tv_usec + ru1.ru_stime.tv_usec - ru0.ru_stime.tv_usec) * 1e3) / RUN_NS;
+        std::printf("  %-20s target %4.1f%%  achieved %5.1f%%  slice %5.2f ms  longest freeze %5.1f ms  late max %5.2f ms  freeze %4.0f us  our CPU %4.1f%%\n",
+            mode.name, mode.share * 100, share * 100, st.sliceNs / 1e6, st.maxFrozenNs / 1e6, st.maxLateNs / 1e6,
+            st.freezeCostNs / 1e3, self * 100);
+        if (mode.adaptive) { // Converges on the whole run; single windows swing with the freeze cost
+            bool close = std::fabs(st.achievedShare - mode.share) <= 0.02 + 0.1 * mode.share;
+            std::printf("  %-20s since the start %.1f%%, within %.1f points of the target: %s\n", "", st.achievedShare * 100,
+                (0.02 + 0.1 * mode.share) * 100, BenchVerdict(close, "ok", "MISSED"));
+        }
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+}
+#else
+static void BenchThrottle()
+{
+    std::printf("[throttle]\n  (CPU-burning target is Linux only)\n");
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// Focus mode: pattern matching, then real sessions against forked background
+// processes that wake up and burn CPU like an updater or a browser tab would
+// -----------------------------------------------------------------------------
+#ifndef _WIN32
+static void BenchFocusBurner()
+{
+    for (;;) {
+        int64_t t0 = BenchNowNs();
+        while (BenchNowNs() - t0 < 2000000) {} // 2 ms busy of every 20: ~10% of a core
+        std::this_thread::sleep_for(std::chrono::milliseconds(18));
+    }
+}
+
+static void BenchFocusMode()
+{
+    std::printf("[focus mode]\n");
+    struct Case { const char* pattern; const char* name; bool match; };
+    const Case cases[] = {
+        { "chrome.exe", "chrome.exe", true }, { "chrome.exe", "chrome.exe2", false }, { "discord*.exe", "discordptb.exe", true },
+        { "*updater*", "googleupdater.exe", true }, { "*updater*", "update.exe", false }, { "game?.exe", "game2.exe", true },
+        { "game?.exe", "game.exe", false }, { "*", "", true }, { "a*b*c", "aXbYbZc", true }, { "a*b*c", "aXbYbZ", false },
+    };
+    size_t good = 0;
+    for (const Case& c : cases) good += MatchImagePattern(c.pattern, c.name) == c.match;
+    std::vector<ProcessInfo> procs = ListProcesses();
+    std::vector<std::string> patterns = ParseImageList("Chrome.exe, Discord*.exe, *updater*, *indexer*, steamwebhelper*");
+    const int LOOPS = 200;
+    int64_t t0 = BenchNowNs();
+    size_t hits = 0;
+    for (int i = 0; i < LOOPS; ++i) {
+        for (const ProcessInfo& p : procs) hits += MatchAnyImage(patterns, p.name);
+    }
+    double matchNs = static_cast<double>(BenchNowNs() - t0) / (LOOPS * std::max<size_t>(1, procs.size()));
+    std::printf("  pattern matching: %zu/%zu cases right, %.0f ns per process against 5 patterns (%zu processes, %zu hits)\n", good,
+        sizeof(cases) / sizeof(cases[0]), matchNs, procs.size(), hits / LOOPS);
+
+    // The game (with a helper child of its own), two background apps to freeze, one to leave alone
+    pid_t game = fork();
+    if (game == 0) {
+        if (fork() == 0) BenchFocusBurner();
+        BenchFocusBurner();
+    }
+    pid_t chrome = fork();
+    if (chrome == 0) BenchFocusBurner();
+    pid_t indexer = fork();
+    if (indexer == 0) BenchFocusBurner();
+    pid_t editor = fork();
+    if (editor == 0) BenchFocusBurner();
+    uint32_t helper = 0;
+    for (int i = 0; i < 500 && !helper; ++i) {
+        for (const auto& d : FindDescendants(ListProcesses(), static_cast<uint32_t>(game))) helper = d.first;
+        if (!helper) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    std::map<uint32_t, std::string> names = { { static_cast<uint32_t>(game), "game.exe" }, { helper, "chrome.exe" },
+        { static_cast<uint32_t>(chrome), "chrome.exe" }, { static_cast<uint32_t>(indexer), "searchindexer.exe" },
+        { static_cast<uint32_t>(editor), "notepad.exe" } };
+    auto lister = [&] {
+        std::vector<ProcessInfo> list = ListProcesses();
+        for (ProcessInfo& p : list) {
+            auto it = names.find(p.pid);
+            if (it != names.end()) p.name = it->second;
+        }
+        return list;
+    };
+    FocusOptions options;
+    options.games = ParseImageList("game*.exe");
+    options.background = ParseImageList("chrome.exe, *indexer*");
+    FocusMode focus(options, BenchSelfPid(), nullptr, lister);
+    const std::vector<uint32_t> expected = { static_cast<uint32_t>(chrome), static_cast<uint32_t>(indexer) };
+    auto cpu = [](const std::vector<uint32_t>& pids) {
+        uint64_t ns = 0;
+        for (uint32_t pid : pids) ns += ProcessCpuNs(pid);
+        return ns;
+    };
+    bool ok = true;
+    for (int round = 0; round < 2; ++round) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1200)); // Baseline: what they burn unfrozen
+        int64_t t1 = BenchNowNs();
+        bool started = focus.OnForeground(static_cast<uint32_t>(game));
+        int64_t onNs = BenchNowNs() - t1;
+        std::vector<uint32_t> frozen = focus.FrozenPids();
+        std::sort(frozen.begin(), frozen.end());
+        uint64_t before = cpu(expected), editorBefore = ProcessCpuNs(static_cast<uint32_t>(editor));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        uint64_t used = cpu(expected) - before, editorUsed = ProcessCpuNs(static_cast<uint32_t>(editor)) - editorBefore;
+        t1 = BenchNowNs();
+        // Round 1 ends on a focus change, round 2 on the game exiting
+        if (round == 0) focus.OnForeground(static_cast<uint32_t>(editor));
+        else focus.OnExit(static_cast<uint32_t>(game));
+        int64_t offNs = BenchNowNs() - t1;
+        FocusSession s = focus.LastSession();
+        bool right = started && frozen == expected && !focus.Active() && s.frozen == 2 && used < 20000000 && editorUsed > 20000000;
+        ok = ok && right;
+        std::printf("  session %d (%s): %zu frozen, helper + notepad left running, %.2f s, ~%.3f s CPU reclaimed, %.3f s leaked; on %.2f ms, off %.2f ms - %s\n",
+            round + 1, round == 0 ? "focus moved" : "game exited", s.frozen, s.durationNs / 1e9, s.reclaimedNs / 1e9, s.leakedNs / 1e9,
+            onNs / 1e6, offNs / 1e6, BenchVerdict(right, "ok", "FAILED"));
+    }
+    // Thawed: the background apps run again
+    uint64_t before = cpu(expected);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    bool running = cpu(expected) > before;
+    std::printf("  background processes running again after both sessions: %s\n", BenchVerdict(running && ok, "ok", "FAILED"));
+    for (uint32_t pid : { helper, static_cast<uint32_t>(game), static_cast<uint32_t>(chrome), static_cast<uint32_t>(indexer), static_cast<uint32_t>(editor) }) {
+        kill(static_cast<pid_t>(pid), SIGKILL);
+        waitpid(static_cast<pid_t>(pid), nullptr, 0);
+    }
+}
+#else
+static void BenchFocusMode()
+{
+    std::printf("[focus mode]\n  (forked background processes are Linux only)\n");
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// Macro library: mapped open vs. reading every macro into memory, lookup cost,
+// and how much of the file actually becomes resident as the library grows
+// -----------------------------------------------------------------------------
+static std::string BenchTempPath(const char* name)
+{
+#ifdef _WIN32
+    char dir[MAX_PATH] = {};
+    GetTempPathA(MAX_PATH, dir);
+    return std::string(dir) + name;
+#else
+    const char* dir = std::getenv("TMPDIR");
+    return std::string(dir && *dir ? dir : "/tmp") + "/" + name;
+#endif
+}
+
+static void BenchMacros()
+{
+    std::printf("[macros]\n");
+    std::string path = BenchTempPath("gamepauser-bench.macros");
+    std::vector<KeyEvent> session = BenchTrace(32, 80000000); // 64 events, a short chat line
+    const size_t sizes[] = { 10, 1000, 10000 };
+    for (size_t n : sizes) {
+        MacroLibraryWriter writer;
+        char name[32];
+        for (size_t i = 0; i < n; ++i) {
+            std::snprintf(name, sizeof(name), "macro-%06zu", (i * 7919) % n); // Not in name order
+            writer.Add(name, session.data(), session.size());
+        }
+        int64_t t0 = BenchNowNs();
+        if (!writer.Write(path)) {
+            std::printf("  cannot write %s\n", path.c_str());
+            return;
+        }
+        int64_t writeNs = BenchNowNs() - t0;
+        std::vector<int64_t> openNs, copyNs, findNs;
+        findNs.reserve(20000); // Before the residency baseline
+        for (int r = 0; r < 50; ++r) {
+            MacroLibrary lib;
+            t0 = BenchNowNs();
+            lib.Open(path);
+            openNs.push_back(BenchNowNs() - t0);
+        }
+        for (int r = 0; r < 5; ++r) {
+            MacroLibrary lib;
+            t0 = BenchNowNs();
+            lib.Open(path);
+            MacroLibraryWriter copy; // What a parse-everything loader does
+            copy.AddLibrary(lib);
+            copyNs.push_back(BenchNowNs() - t0);
+        }
+        // Residency: fresh mapping, then one replay's worth of pages, then everything
+        uint64_t rss0 = ProcessResidentBytes(BenchSelfPid());
+        MacroLibrary lib;
+        lib.Open(path);
+        uint64_t rssOpen = ProcessResidentBytes(BenchSelfPid());
+        std::snprintf(name, sizeof(name), "macro-%06zu", n / 2);
+        MacroView m = lib.Find(name);
+        RecordingSink sink;
+        ReplayOptions opt;
+        opt.policy = ReplayPolicy::Batched;
+        opt.batchGapMs = 0;
+        ReplayScheduler(opt).Run(m.events, m.count, sink); // Straight from the mapping
+        uint64_t rssOne = ProcessResidentBytes(BenchSelfPid());
+        std::mt19937 gen(7);
+        uint64_t sum = 0;
+        for (int r = 0; r < 20000; ++r) {
+            std::snprintf(name, sizeof(name), "macro-%06zu", static_cast<size_t>(gen() % n));
+            std::string key = name;
+            t0 = BenchNowNs();
+            MacroView v = lib.Find(key);
+            findNs.push_back(BenchNowNs() - t0);
+            sum += v.count;
+        }
+        for (size_t i = 0; i < lib.Count(); ++i) {
+            MacroView v = lib.At(i);
+            for (size_t e = 0; e < v.count; ++e) sum += v.events[e].vk;
+        }
+        uint64_t rssAll = ProcessResidentBytes(BenchSelfPid());
+        std::sort(openNs.begin(), openNs.end());
+        std::sort(copyNs.begin(), copyNs.end());
+        std::sort(findNs.begin(), findNs.end());
+        auto kb = [rss0](uint64_t rss) { return rss > rss0 ? static_cast<double>(rss - rss0) / 1024 : 0.0; };
+        std::printf("  %5zu macros %8.1f KB  write %7.2f ms  open p50 %6.1f us  read-all p50 %8.2f ms  find p50 %4lld ns"
+                    "  resident +%.0f KB open / +%.0f KB one replay / +%.0f KB all (%s)\n",
+            n, lib.FileBytes() / 1024.0, writeNs / 1e6, BenchPercentile(openNs, 0.5) / 1e3, BenchPercentile(copyNs, 0.5) / 1e6,
+            static_cast<long long>(BenchPercentile(findNs, 0.5)), kb(rssOpen), kb(rssOne), kb(rssAll),
+            BenchVerdict(m.Valid() && sink.Arrivals().size() == session.size() && sum));
+    }
+    // `--macros <library> import` may start a library where there is none, but must
+    // refuse to write over one it cannot read: that would drop every macro in it
+    std::string text = path + ".txt";
+    {
+        MacroLibrary lib;
+        lib.Open(path);
+        std::ofstream out(text);
+        ExportMacro(out, lib.At(0));
+    }
+    auto slurp = [](const std::string& file) {
+        std::ifstream in(file, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+    std::string bytes = slurp(path);
+    bytes.resize(bytes.size() - 16); // Truncated, as after a crash mid-copy
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+    std::string pathArg = path, cmdArg = "import", textArg = text;
+    char* args[] = { &pathArg[0], &cmdArg[0], &textArg[0] };
+    int rc = RunMacroTool(3, args);
+    bool kept = rc == 1 && slurp(path) == bytes;
+    MacroLibrary none;
+    bool missing = !none.Open(path + ".none") && none.Missing();
+    std::printf("  import over a truncated library refused, file untouched: %s; a missing file reads as missing: %s\n",
+        BenchVerdict(kept), BenchVerdict(missing));
+    std::remove(text.c_str());
+    std::remove(path.c_str());
+}
+
+// -----------------------------------------------------------------------------
+// Text compiler: compile speed on large pastes, modifier coalescing, a decode
+// round trip, and the rate the compiled program actually replays at
+// -----------------------------------------------------------------------------
+static std::string BenchPasteText(size_t bytes)
+{
+    static const char* fragments[] = {
+        "The quick brown fox jumps over the lazy dog. ", "HELLO WORLD, THIS IS LOUD! ",
+        "if (a[i] != b->c) { return -1; } ", "Caf\xC3\xA9 cr\xC3\xA8me \xE2\x82\xAC""5 \xE2\x80\x94 na\xC3\xAFve ",
+        "\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E ", "gg \xF0\x9F\x98\x80 ", "Line two:\r\n", "\tIndented ~/path/to/*.txt\n",
+    };
+    std::string text;
+    for (size_t i = 0; text.size() < bytes; ++i) text += fragments[(i * 5) % 8];
+    return text;
+}
+
+// What a US-layout target would receive, for checking the compiler's output
+static std::u32string BenchTypeProgram(const std::vector<KeyEvent>& events, const KeyLayout& layout)
+{
+    std::map<uint32_t, char32_t> typed; // vk | shift << 16
+    for (char32_t c = 0x20; c < 0x7F; ++c)
+        if (const LayoutKey* k = layout.Find(c)) typed[k->vk | (static_cast<uint32_t>(k->mods) << 16)] = c;
+    std::u16string units;
+    bool shift = false;
+    for (const KeyEvent& ev : events) {
+        bool down = !(ev.flags & KEY_UP);
+        if (ev.flags & KEY_UNICODE) {
+            if (down) units.push_back(static_cast<char16_t>(ev.scan));
+            continue;
+        }
+        if (ev.vk == 0xA0) shift = down;
+        if (!down || ev.vk == 0xA0) continue;
+        if (ev.vk == 0x0D) units.push_back(u'\n');
+        else if (ev.vk == 0x09) units.push_back(u'\t');
+        else if (typed.count(ev.vk | (shift ? 1u << 16 : 0))) units.push_back(static_cast<char16_t>(typed[ev.vk | (shift ? 1u << 16 : 0)]));
+    }
+    return DecodeUtf16(units.data(), units.size());
+}
+
+static void BenchTextCompiler()
+{
+    std::printf("[text compiler]\n");
+    KeyLayout us = UsKeyLayout();
+    const size_t sizes[] = { 100 * 1024, 1024 * 1024 };
+    for (size_t bytes : sizes) {
+        std::string utf8 = BenchPasteText(bytes);
+        std::vector<int64_t> samples;
+        TextProgram program;
+        for (int r = 0; r < 5; ++r) {
+            int64_t t0 = BenchNowNs();
+            std::u32string text = DecodeUtf8(utf8);
+            program = TextCompiler(us, TextCompileOptions()).Compile(text);
+            samples.push_back(BenchNowNs() - t0);
+        }
+        std::sort(samples.begin(), samples.end());
+        // Expected: CRLF folded to LF, which is what Enter produces
+        std::u32string expected = DecodeUtf8(utf8);
+        expected.erase(std::remove(expected.begin(), expected.end(), U'\r'), expected.end());
+        bool ok = BenchTypeProgram(program.events, us) == expected;
+        std::printf("  %4zu KB  %7zu chars  compile %6.2f ms (%5.0f MB/s)  %.2f events/char  modifiers %6zu vs %6zu naive  %5zu unicode  round trip %s\n",
+            bytes / 1024, program.chars, BenchPercentile(samples, 0.5) / 1e6, bytes / (BenchPercentile(samples, 0.5) / 1e3),
+            static_cast<double>(program.events.size()) / program.chars, program.modifierEvents, program.naiveModifierEvents,
+            program.unicode, BenchVerdict(ok));
+    }
+    // Replay rate: the compiled program on the real clock vs. the same keys typed and replayed with jitter
+    std::u32string text = DecodeUtf8(BenchPasteText(2000));
+    const double rates[] = { 300, 1000 };
+    for (double rate : rates) {
+        TextCompileOptions opt;
+        opt.charsPerSecond = rate;
+        opt.maxChars = static_cast<size_t>(rate * 1.5); // 1.5 s of typing
+        TextProgram program = TextCompiler(us, opt).Compile(text);
+        ReplayOptions faithful;
+        faithful.policy = ReplayPolicy::Faithful;
+        faithful.leadDelayMs = 0;
+        faithful.maxGapMs = 0;
+        RecordingSink sink;
+        ReplayStats st = ReplayScheduler(faithful).Run(program.events.data(), program.events.size(), sink);
+        VirtualClock clock;
+        ReplayOptions jitter;
+        jitter.leadDelayMs = 0;
+        ReplayStats typed = ReplayScheduler(jitter, &clock).Run(program.events.data(), program.events.size(), sink);
+        std::printf("  target %5.0f chars/s  %4zu chars  achieved %6.1f chars/s  late p99 %4llu us  (typed + jitter replay: %4.1f chars/s)\n",
+            rate, program.chars, program.chars / (st.durationNs / 1e9), static_cast<unsigned long long>(st.lateP99Ns / 1000),
+            program.chars / (typed.durationNs / 1e9));
+    }
+}
+
+// Reference target for the capture optimizer: a text field in insert mode holding
+// "0123456789" with the cursor after the 4, an apostrophe dead key, and a log of
+// everything that isn't typing (shortcuts, navigation, Alt and layout-switch taps)
+struct BenchTextTarget
+{
+    std::string text = "0123456789";
+    size_t cursor = 5;
+    bool held[256] = {};
+    bool dead = false;
+    uint16_t lastDown = 0;
+    std::vector<std::string> actions;
+
+    bool Any(uint16_t a, uint16_t b, uint16_t c) const { return held[a] || held[b] || held[c]; }
+    void Insert(char c)
+    {
+        if (dead) {
+            dead = false;
+            if (c == ' ') c = '\'';
+            else text.insert(cursor++, 1, '\'');
+        }
+        text.insert(cursor++, 1, c);
+    }
+    void Key(const KeyEvent& ev)
+    {
+        uint16_t vk = ev.vk & 0xFF;
+        if (ev.flags & KEY_UP) {
+            bool tap = lastDown == vk;
+            held[vk] = false;
+            bool shift = Any(0x10, 0xA0, 0xA1), ctrl = Any(0x11, 0xA2, 0xA3), alt = Any(0x12, 0xA4, 0xA5);
+            if (tap && IsModifierVk(vk) && (shift || ctrl || alt)) actions.push_back("switch");
+            if (tap && (vk == 0xA4 || vk == 0x12) && !shift && !ctrl) actions.push_back("menu");
+            return;
+        }
+        held[vk] = true;
+        lastDown = vk;
+        bool shift = Any(0x10, 0xA0, 0xA1), ctrl = Any(0x11, 0xA2, 0xA3), alt = Any(0x12, 0xA4, 0xA5);
+        if (IsModifierVk(vk)) return;
+        if (ctrl || alt) {
+            if (vk == 0x08 && ctrl && !alt) {
+                while (cursor > 0 && text[cursor - 1] == ' ') text.erase(--cursor, 1);
+                while (cursor > 0 && text[cursor - 1] != ' ') text.erase(--cursor, 1);
+            }
+            else {
+                actions.push_back(std::string(ctrl ? "C+" : "A+") + std::to_string(vk));
+            }
+            return;
+        }
+        if (vk >= 'A' && vk <= 'Z') Insert(static_cast<char>(shift ? vk : vk + 32));
+        else if (vk >= '0' && vk <= '9') Insert(shift ? ")!@#$%^&*("[vk - '0'] : static_cast<char>(vk));
+        else if (vk == 0x20) Insert(' ');
+        else if (vk == 0x0D) Insert('\n');
+        else if (vk == 0xDE) {
+            if (dead) Insert('\'');
+            dead = !dead;
+        }
+        else if (vk == 0x08) {
+            if (dead) dead = false;
+            else if (cursor > 0) text.erase(--cursor, 1);
+        }
+        else if (vk == 0x2E) {
+            if (shift) actions.push_back("cut");
+            else if (cursor < text.size()) text.erase(cursor, 1);
+        }
+        else if (vk == 0x25 || vk == 0x27 || vk == 0x24 || vk == 0x23) {
+            if (shift) actions.push_back("select");
+            if (vk == 0x25 && cursor > 0) --cursor;
+            if (vk == 0x27 && cursor < text.size()) ++cursor;
+            if (vk == 0x24) cursor = 0;
+            if (vk == 0x23) cursor = text.size();
+        }
+    }
+    bool operator==(const BenchTextTarget& o) const
+    {
+        return text == o.text && cursor == o.cursor && dead == o.dead && actions == o.actions
+            && std::equal(held, held + 256, o.held);
+    }
+};
+
+// A pause session of typing, fixing typos, holding keys and stray modifier taps
+static std::vector<KeyEvent> BenchEditingSession(std::mt19937& gen, size_t segments)
+{
+    std::vector<KeyEvent> trace;
+    uint64_t t = 0;
+    std::uniform_int_distribution<> kind(0, 15), small(1, 6), repeats(3, 40), letter(0, 25), gap(15, 220);
+    auto key = [&](uint16_t vk, bool up) {
+        uint16_t ext = (vk == 0x2E || (vk >= 0x23 && vk <= 0x28)) ? KEY_EXTENDED : 0;
+        trace.push_back({ t, vk, 0, static_cast<uint16_t>(ext | (up ? KEY_UP : 0)), 0 });
+        t += static_cast<uint64_t>(gap(gen)) * 1000000ULL;
+    };
+    auto tap = [&](uint16_t vk) { key(vk, false); key(vk, true); };
+    auto hold = [&](uint16_t vk) {
+        key(vk, false);
+        for (int r = repeats(gen); r > 0; --r) key(vk, false);
+        key(vk, true);
+    };
+    auto randomChar = [&]() { return static_cast<uint16_t>(gen() % 8 == 0 ? (gen() % 3 ? ' ' : '0' + gen() % 10) : 'A' + letter(gen)); };
+    for (size_t s = 0; s < segments; ++s) {
+        switch (kind(gen)) {
+        case 0: case 1: case 2: { // A word, sometimes with Shift, sometimes rolled over
+            bool shifted = gen() % 4 == 0;
+            if (shifted) key(0xA0, false);
+            for (int n = small(gen); n > 0; --n) {
+                uint16_t a = randomChar();
+                if (gen() % 5 == 0) {
+                    uint16_t b = randomChar();
+                    if (b == a) b = a == 'Q' ? 'W' : 'Q';
+                    key(a, false); key(b, false); key(a, true); key(b, true);
+                }
+                else {
+                    tap(a);
+                }
+            }
+            if (shifted) key(0xA0, true);
+            break;
+        }
+        case 3: case 4: for (int n = small(gen); n > 0; --n) tap(0x08); break;
+        case 5: hold(0x08); break;
+        case 6: hold(randomChar()); break;
+        case 7: tap(static_cast<uint16_t>(gen() % 2 ? 0x25 + (gen() % 2) * 2 : 0x23 + gen() % 2)); break;
+        case 8: tap(0x2E); break;
+        case 9: key(0xA2, false); tap(gen() % 2 ? 0x08 : 'A' + letter(gen)); key(0xA2, true); break;
+        case 10: tap(static_cast<uint16_t>(gen() % 2 ? 0xA0 : 0xA2)); break;
+        case 11: { // Alt tap, Alt+Shift, or Shift+Ctrl
+            uint16_t a = gen() % 2 ? 0xA4 : 0xA2, b = gen() % 2 ? 0xA0 : 0xA4;
+            key(a, false);
+            if (b != a) tap(b);
+            key(a, true);
+            break;
+        }
+        case 12: key(static_cast<uint16_t>('A' + letter(gen)), true); break; // Released, pressed before the pause
+        case 13: key(0xA0, false); tap(gen() % 2 ? 0x08 : 0x2E); key(0xA0, true); break;
+        case 14: tap(0xDE); if (gen() % 2) tap(randomChar()); break;
+        default: tap(0x0D); break;
+        }
+    }
+    if (gen() % 4 == 0) key(gen() % 2 ? 0xA2 : static_cast<uint16_t>('A' + letter(gen)), false); // Still held at Enter
+    return trace;
+}
+
+// Replays events the way PauseController::Replay() does - held chord first - into a target
+static BenchTextTarget BenchReplayInto(const std::vector<KeyEvent>& presses, const std::vector<KeyEvent>& events)
+{
+    VirtualClock clock;
+    RecordingSink sink(&clock);
+    ReplayOptions opt;
+    opt.leadDelayMs = 0;
+    ReplayScheduler(opt, &clock).Run(events.data(), events.size(), sink);
+    BenchTextTarget target;
+    for (const KeyEvent& ev : presses) target.Key(ev);
+    for (const RecordingSink::Arrival& a : sink.Arrivals()) target.Key(a.event);
+    return target;
+}
+
+static void BenchCaptureOptimizer()
+{
+    std::printf("[capture optimizer]\n");
+    // Property: for random sessions, the target ends up in the same state either way
+    const char* modes[] = { "all", "repeats", "edits", "taps" };
+    ReplayOptions jitter, faithful;
+    jitter.leadDelayMs = faithful.leadDelayMs = 0;
+    faithful.policy = ReplayPolicy::Faithful;
+    for (const char* mode : modes) {
+        std::mt19937 gen(7);
+        CaptureOptimizer optimizer(CaptureOptimizeFromString(mode));
+        size_t sessions = 2000, violations = 0, in = 0, out = 0;
+        uint64_t jitterBefore = 0, jitterAfter = 0, faithfulBefore = 0, faithfulAfter = 0;
+        int64_t optimizeNs = 0;
+        for (size_t n = 0; n < sessions; ++n) {
+            std::vector<KeyEvent> trace = BenchEditingSession(gen, 4 + gen() % 30);
+            KeyboardState held;
+            for (const KeyEvent& ev : trace) held.Apply(ev);
+            std::vector<KeyEvent> presses;
+            held.Snapshot().HeldEvents(presses, false);
+            std::vector<KeyEvent> optimized = trace;
+            int64_t t0 = BenchNowNs();
+            CaptureOptimizeStats st = optimizer.Run(optimized, &presses);
+            optimizeNs += BenchNowNs() - t0;
+            if (!(BenchReplayInto(presses, trace) == BenchReplayInto(presses, optimized))) {
+                if (violations++ == 0) std::printf("  VIOLATION (%s, session %zu, %zu -> %zu events)\n", mode, n, st.eventsIn, st.eventsOut);
+            }
+            in += st.eventsIn;
+            out += st.eventsOut;
+            jitterBefore += EstimateReplayNs(trace, jitter);
+            jitterAfter += EstimateReplayNs(optimized, jitter);
+            faithfulBefore += EstimateReplayNs(trace, faithful);
+            faithfulAfter += EstimateReplayNs(optimized, faithful);
+        }
+        std::printf("  %-8s %zu sessions  %zu violations  events %6zu -> %6zu (-%4.1f%%)  replay jitter -%4.1f%%  faithful -%4.1f%%  %.2f us/session\n",
+            mode, sessions, violations, in, out, 100.0 * (in - out) / in, 100.0 * (jitterBefore - jitterAfter) / jitterBefore,
+            100.0 * (faithfulBefore - faithfulAfter) / faithfulBefore, optimizeNs / 1e3 / sessions);
+        if (violations) ++BenchFailures();
+    }
+    // A typical chat line: a typo fixed with Backspace, then W held for two seconds
+    std::vector<KeyEvent> line;
+    uint64_t t = 0;
+    auto tap = [&](uint16_t vk) {
+        line.push_back({ t, vk, 0, 0, 0 });
+        line.push_back({ t + 40000000, vk, 0, KEY_UP, 0 });
+        t += 120000000;
+    };
+    for (const char* c = "HELO"; *c; ++c) tap(static_cast<uint16_t>(*c));
+    for (int i = 0; i < 3; ++i) tap(0x08);
+    for (const char* c = "ELLO WORLD"; *c; ++c) tap(static_cast<uint16_t>(*c));
+    tap(0x0D);
+    line.push_back({ t, 'W', 0, 0, 0 });
+    for (int r = 0; r < 45; ++r) line.push_back({ t += r ? 33000000 : 500000000, 'W', 0, 0, 0 });
+    line.push_back({ t += 33000000, 'W', 0, KEY_UP, 0 });
+    std::vector<KeyEvent> optimized = line;
+    CaptureOptimizeStats st = CaptureOptimizer(CaptureOptimizeFromString("all")).Run(optimized);
+    std::vector<KeyEvent> none;
+    BenchTextTarget target = BenchReplayInto(none, optimized);
+    std::printf("  chat line + W hold: %zu -> %zu events (%zu repeats folded, %zu keystrokes erased)  jitter %.0f -> %.0f ms  faithful %.0f -> %.0f ms  text %s\n",
+        st.eventsIn, st.eventsOut, st.repeatsFolded, st.keystrokesErased, EstimateReplayNs(line, jitter) / 1e6,
+        EstimateReplayNs(optimized, jitter) / 1e6, EstimateReplayNs(line, faithful) / 1e6, EstimateReplayNs(optimized, faithful) / 1e6,
+        BenchVerdict(target == BenchReplayInto(none, line), "same", "DIFFERENT"));
+}
+
+// Feeds what a replay sent into a fresh frame-polling game; returns letters it missed
+static size_t BenchLostKeys(const std::vector<RecordingSink::Arrival>& arrivals, double frameMs, double jitterMs)
+{
+    VirtualClock clock;
+    SlowPoller game(&clock, frameMs, jitterMs, 3);
+    size_t expected = 0;
+    for (const RecordingSink::Arrival& a : arrivals) {
+        clock.SleepUntil(a.timeNs);
+        game.Send(&a.event, 1);
+        if (!(a.event.flags & KEY_UP) && a.event.vk >= 'A' && a.event.vk <= 'Z') ++expected;
+    }
+    clock.Advance(1000000000);
+    size_t seen = game.Received().size();
+    return expected > seen ? expected - seen : 0;
+}
+
+static void BenchProfiles()
+{
+    std::printf("[profiles + calibration]\n");
+    // Hashed lookup, as done when the hotkey fires
+    ReplayProfiles profiles;
+    for (int i = 0; i < 1000; ++i) {
+        ReplayProfile p;
+        ParseReplayProfile("Game" + std::to_string(i) + ".exe, Policy=faithful, LeadDelayMs=" + std::to_string(i % 400), ReplayOptions(), p);
+        profiles.Set(p);
+    }
+    std::vector<int64_t> findNs;
+    size_t hits = 0;
+    for (int i = 0; i < 20000; ++i) {
+        std::string image = i % 4 ? "game" + std::to_string(i % 1000) + ".exe" : "notepad.exe";
+        int64_t t0 = BenchNowNs();
+        hits += profiles.Find(image) != nullptr;
+        findNs.push_back(BenchNowNs() - t0);
+    }
+    std::sort(findNs.begin(), findNs.end());
+    std::printf("  lookup among %zu profiles: p50 %lld ns  p99 %lld ns  (%zu/20000 hits)\n", profiles.Count(),
+        static_cast<long long>(BenchPercentile(findNs, 0.5)), static_cast<long long>(BenchPercentile(findNs, 0.99)), hits);
+
+    // Calibration against frame-polling stand-ins (virtual time)
+    struct Game { const char* name; double frameMs, jitterMs; };
+    const Game games[] = { { "30 fps", 33.3, 3 }, { "60 fps", 16.7, 2 }, { "144 fps", 6.9, 1 } };
+    int calibrated60 = 0;
+    for (const Game& g : games) {
+        VirtualClock clock;
+        SlowPoller game(&clock, g.frameMs, g.jitterMs);
+        int64_t t0 = BenchNowNs();
+        CalibrationResult res = ReplayCalibrator(CalibrationOptions(), &clock).Run(game);
+        int64_t cpuNs = BenchNowNs() - t0;
+        if (g.frameMs == 16.7) calibrated60 = res.recommendedGapMs;
+        std::printf("  %-7s frame %5.1f ms  fastest reliable %3d ms  MinGapMs %3d  %2zu gaps tried  %5.1f s of typing (%.1f ms here)%s\n", g.name,
+            g.frameMs, res.fastestGapMs, res.recommendedGapMs, res.steps.size(), res.elapsedNs / 1e9, cpuNs / 1e6,
+            BenchVerdict(res.ok && res.recommendedGapMs >= g.frameMs + g.jitterMs, "", "  UNEXPECTED")); // Longest gap between two polls
+    }
+
+    // End to end through the PauseController: fast replay into the 60 fps game, without and with its profile
+    ReplayOptions fast;
+    fast.policy = ReplayPolicy::Speed;
+    fast.speed = 4;
+    fast.leadDelayMs = 0;
+    ReplayProfiles sim;
+    ReplayProfile p;
+    ParseReplayProfile("sim-target, Policy=speed, Speed=4, LeadDelayMs=0, MinGapMs=" + std::to_string(calibrated60), fast, p);
+    sim.Set(p);
+    std::vector<KeyEvent> trace = SimTypingBursts(600, 5);
+    SimulationResult before = RunSimulation("no profile", trace, fast);
+    SimulationResult after = RunSimulation("profile", trace, fast, 4096, nullptr, &sim);
+    std::printf("  300 keys at 4x speed into 60 fps: lost %3zu without profile (%.2f s)  %3zu with MinGapMs=%d (%.2f s)\n",
+        BenchLostKeys(before.arrivals, 16.7, 2), before.replay.durationNs / 1e9, BenchLostKeys(after.arrivals, 16.7, 2), calibrated60,
+        after.replay.durationNs / 1e9);
+
+    // Saving a learned value back: only the game's line changes, CRLF kept
+    std::string ini = "[Replay]\r\nPolicy = jitter\r\n\r\n[Profiles]\r\nCalibrateKey = F9\r\nProfile1 =\r\nProfile2 = Other.exe, Policy=batched\r\n\r\n[Paste]\r\n";
+    ReplayProfile learned;
+    ParseReplayProfile("Game.exe, Policy=faithful, LeadDelayMs=90, MinGapMs=21", ReplayOptions(), learned);
+    std::string once = UpdateProfileIni(ini, learned);
+    learned.replay.minGapMs = 25;
+    std::string twice = UpdateProfileIni(once, learned);
+    ReplayProfile other;
+    ParseReplayProfile("new.exe", ReplayOptions(), other);
+    std::string added = UpdateProfileIni(twice, other);
+    bool ok = once.find("Profile1 = Game.exe, Policy=faithful, LeadDelayMs=90, MinGapMs=21\r\n") != std::string::npos
+        && twice.find("Profile1 = Game.exe, Policy=faithful, LeadDelayMs=90, MinGapMs=25\r\n") != std::string::npos
+        && twice.size() == once.size() && added.find("Profile2 = Other.exe, Policy=batched\r\nProfile3 = new.exe,") != std::string::npos
+        && UpdateProfileIni("[Hotkey]\nPauseKey = P\n", other).find("\n[Profiles]\nProfile1 = new.exe") != std::string::npos;
+    std::printf("  INI write-back (placeholder, rewrite, append, new section): %s\n", BenchVerdict(ok));
+}
+
+// --calibrate <fps> [ini]: calibrate against a frame-polling stand-in in real time,
+// then save the result as the "slow-poller" profile in ini if one is given
+static int RunCalibrateStandIn(int argc, char** args)
+{
+    double fps = argc > 0 ? std::atof(args[0]) : 60;
+    if (fps <= 0 || fps > 1000) {
+        std::fprintf(stderr, "usage: --calibrate <fps> [GamePauser.ini]\n");
+        return 2;
+    }
+    PreciseWaiter clock;
+    SlowPoller game(&clock, 1000.0 / fps, 1000.0 / fps / 10);
+    std::printf("Calibrating against a game polling the keyboard at %.0f fps (real time)\n", fps);
+    CalibrationResult res = ReplayCalibrator(CalibrationOptions(), &clock).Run(game, [](const CalibrationStep& step) {
+        std::printf("  %3d ms apart: %d/%d sequences intact%s\n", step.gapMs, step.passed, step.trials,
+            step.passed == step.trials ? "" : (" - got '" + step.received + "' for '" + step.expected + "'").c_str());
+        std::fflush(stdout);
+    });
+    if (!res.ok) {
+        std::printf("Calibration failed: %s\n", res.error.c_str());
+        return 1;
+    }
+    std::printf("Fastest reliable gap %d ms, MinGapMs = %d (%.1f s)\n", res.fastestGapMs, res.recommendedGapMs, res.elapsedNs / 1e9);
+    if (argc < 2) return 0;
+    std::string text;
+    {
+        std::ifstream in(args[1], std::ios::binary);
+        if (in) text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    ReplayProfile profile;
+    ParseReplayProfile("slow-poller", ReplayOptions(), profile);
+    profile.replay.minGapMs = res.recommendedGapMs;
+    std::string tmp = std::string(args[1]) + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out << UpdateProfileIni(text, profile);
+    }
+    if (std::rename(tmp.c_str(), args[1]) != 0) {
+        std::printf("Could not update %s\n", args[1]);
+        return 1;
+    }
+    std::printf("Saved to %s: %s\n", args[1], FormatReplayProfile(profile).c_str());
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Control channel: request round trips over the local pipe/socket, alone and
+// with concurrent clients, then pause/text/resume/throttle end to end against
+// a real child process
+// -----------------------------------------------------------------------------
+static void BenchControl()
+{
+    std::printf("[control channel]\n");
+#ifdef _WIN32
+    std::string path = "\\\\.\\pipe\\GamePauser-bench-" + std::to_string(BenchSelfPid());
+#else
+    std::string path = BenchTempPath("gamepauser-bench.sock");
+#endif
+    SimKeyboardHook hook;
+    GroupPauseFreezer freezer(PauseTargetOptions(), GroupOrder::ChildrenFirst, BenchSelfPid());
+    RecordingSink sink;
+    PauseBackends backends;
+    backends.hook = &hook;
+    backends.freezer = &freezer;
+    backends.sink = &sink;
+    backends.selfPid = BenchSelfPid();
+    PauseConfig config;
+    config.replay.leadDelayMs = 0;
+    PauseController controller(backends, config);
+    controller.Start();
+    PauseTargetOptions throttleTargets;
+    ThrottleManager throttle(throttleTargets, GroupOrder::ChildrenFirst, BenchSelfPid(), ThrottleOptions());
+    ControlHost host;
+    host.controller = &controller;
+    host.throttle = &throttle;
+    host.selfPid = BenchSelfPid();
+    host.reload = [&](std::string& reply) {
+        PauseConfig fresh = config;
+        fresh.replay.policy = ReplayPolicy::Faithful;
+        reply = "reloaded";
+        return controller.Reconfigure(fresh) ? ControlStatus::Ok : ControlStatus::Refused;
+    };
+    ControlDispatcher dispatcher(host);
+    ControlServer server;
+    std::string error;
+    if (!server.Start(path, [&](ControlOp op, const std::string& payload, std::string& reply) {
+            return dispatcher.Handle(op, payload, reply);
+        }, &error)) {
+        std::printf("  could not listen: %s\n", error.c_str());
+        ++BenchFailures();
+        return;
+    }
+    ControlClient client;
+    ControlStatus status;
+    std::string reply;
+    std::vector<std::string> failures;
+    if (!client.Connect(path, &error)) {
+        std::printf("  could not connect: %s\n", error.c_str());
+        ++BenchFailures();
+        return;
+    }
+    std::vector<int64_t> ping;
+    for (int i = 0; i < 5000; ++i) {
+        int64_t t0 = BenchNowNs();
+        client.Call(ControlOp::Ping, std::string(), status, reply);
+        ping.push_back(BenchNowNs() - t0);
+    }
+    BenchReport("Ping round trip, 1 client", ping);
+
+    // Concurrent clients hammering status (each on its own connection and server thread)
+    const int CLIENTS = 8, CALLS = 2000;
+    std::vector<std::vector<int64_t>> perClient(CLIENTS);
+    std::atomic<int> broken{ 0 };
+    std::vector<std::thread> threads;
+    int64_t wall0 = BenchNowNs();
+    for (int c = 0; c < CLIENTS; ++c) {
+        threads.emplace_back([&, c] {
+            ControlClient mine;
+            ControlStatus st;
+            std::string out;
+            if (!mine.Connect(path)) {
+                ++broken;
+                return;
+            }
+            for (int i = 0; i < CALLS; ++i) {
+                int64_t t0 = BenchNowNs();
+                if (!mine.Call(ControlOp::Status, std::string(), st, out) || out.find("paused=") == std::string::npos) ++broken;
+                perClient[c].push_back(BenchNowNs() - t0);
+            }
+        });
+    }
+    for (std::thread& t : threads) t.join();
+    int64_t wallNs = BenchNowNs() - wall0;
+    std::vector<int64_t> statusNs;
+    for (const auto& v : perClient) statusNs.insert(statusNs.end(), v.begin(), v.end());
+    BenchReport("Status round trip, 8 concurrent clients", statusNs);
+    std::printf("  %d requests in %.1f ms (%.0f requests/s), %d failed\n", CLIENTS * CALLS, wallNs / 1e6,
+        CLIENTS * CALLS / (wallNs / 1e9), broken.load());
+    if (broken.load()) ++BenchFailures();
+
+    // End to end against a real process: pause (freeze), queue text, resume (thaw + replay)
+    BenchChild child = SpawnBenchChild(4);
+    if (!child.pid) {
+        std::printf("  could not spawn a target\n");
+        ++BenchFailures();
+        return;
+    }
+    std::string target = EncodeControlTarget(child.pid, "");
+    std::vector<int64_t> pauseNs, resumeNs;
+    TextProgram hello = TextCompiler(UsKeyLayout(), TextCompileOptions()).Compile(DecodeUtf8("Hello!"));
+    size_t replayed = 0;
+    for (int i = 0; i < 50; ++i) {
+        int64_t t0 = BenchNowNs();
+        client.Call(ControlOp::Pause, target, status, reply);
+        pauseNs.push_back(BenchNowNs() - t0);
+        if (status != ControlStatus::Ok || controller.TargetPid() != child.pid) failures.push_back("pause: " + reply);
+        if (i == 0) {
+            client.Call(ControlOp::Text, "Hello!", status, reply);
+            if (status != ControlStatus::Ok || controller.CapturedCount() != hello.events.size()) failures.push_back("text: " + reply);
+            sink.Clear();
+        }
+        t0 = BenchNowNs();
+        client.Call(ControlOp::Resume, std::string(), status, reply);
+        resumeNs.push_back(BenchNowNs() - t0);
+        if (status != ControlStatus::Ok || controller.Paused()) failures.push_back("resume: " + reply);
+        if (i == 0) replayed = sink.Arrivals().size();
+    }
+    BenchReport("Pause by PID (freeze 5 threads)", pauseNs);
+    BenchReport("Resume (thaw, nothing to replay)", resumeNs);
+    if (replayed != hello.events.size()) failures.push_back("text replayed " + std::to_string(replayed) + " of " + std::to_string(hello.events.size()) + " events");
+
+    // The protocol's edges
+    std::string selfName;
+    for (const ProcessInfo& p : ListProcesses()) {
+        if (p.pid == child.pid) selfName = p.name;
+    }
+    client.Call(ControlOp::Pause, EncodeControlTarget(0, selfName), status, reply);
+    if (status == ControlStatus::Ok) client.Call(ControlOp::Resume, EncodeControlTarget(0, selfName), status, reply);
+    if (status != ControlStatus::Ok && status != ControlStatus::Ambiguous) failures.push_back("pause by name: " + reply);
+    client.Call(ControlOp::Throttle, target, status, reply);
+    bool throttled = status == ControlStatus::Ok && throttle.Throttled(child.pid);
+    client.Call(ControlOp::Unthrottle, target, status, reply);
+    if (!throttled || status != ControlStatus::Ok || throttle.Throttled(child.pid)) failures.push_back("throttle: " + reply);
+    client.Call(ControlOp::Text, "too late", status, reply);
+    if (status != ControlStatus::Refused) failures.push_back("text outside a pause accepted");
+    client.Call(ControlOp::Pause, EncodeControlTarget(BenchSelfPid(), ""), status, reply);
+    if (status != ControlStatus::Refused) failures.push_back("pausing ourselves accepted");
+    client.Call(ControlOp::Pause, EncodeControlTarget(0, "no-such-process.exe"), status, reply);
+    if (status != ControlStatus::NotFound) failures.push_back("unknown name: " + reply);
+    client.Call(static_cast<ControlOp>(99), std::string(), status, reply);
+    if (status != ControlStatus::BadRequest) failures.push_back("unknown op accepted");
+    client.Call(ControlOp::Pause, target, status, reply);
+    client.Call(ControlOp::Reload, std::string(), status, reply);
+    if (status != ControlStatus::Refused) failures.push_back("reload while paused accepted");
+    client.Call(ControlOp::Resume, target, status, reply);
+    client.Call(ControlOp::Reload, std::string(), status, reply);
+    if (status != ControlStatus::Ok || controller.CurrentReplay().policy != ReplayPolicy::Faithful) failures.push_back("reload: " + reply);
+    KillBenchChild(child);
+#ifndef _WIN32
+    // Another user gets hung up on even if the socket's mode lets them connect, and a
+    // socket directory owned by someone else is refused (needs root to play the other user)
+    if (geteuid() == 0) {
+        chmod(path.c_str(), 0666);
+        pid_t other = fork();
+        if (other == 0) {
+            ControlClient stranger;
+            ControlStatus st;
+            std::string out;
+            _exit(setuid(65534) == 0 && stranger.Connect(path) && !stranger.Call(ControlOp::Ping, std::string(), st, out) ? 0 : 1);
+        }
+        int code = -1;
+        waitpid(other, &code, 0);
+        bool hungUp = WIFEXITED(code) && WEXITSTATUS(code) == 0 && server.Rejected() == 1;
+        std::string foreign = BenchTempPath("gamepauser-bench-foreign");
+        mkdir(foreign.c_str(), 0700);
+        bool refused = chown(foreign.c_str(), 65534, 65534) == 0;
+        ControlServer squatted;
+        refused = refused && !squatted.Start(foreign + "/gamepauser.sock", [](ControlOp, const std::string&, std::string&) { return ControlStatus::Ok; });
+        rmdir(foreign.c_str());
+        std::printf("  client running as another user hung up on: %s, socket directory owned by another user refused: %s\n",
+            BenchVerdict(hungUp), BenchVerdict(refused));
+    }
+#endif
+    server.Stop();
+    std::printf("  %zu server requests, end-to-end checks (text, name, throttle, refusals, reload): %s\n", static_cast<size_t>(server.Requests()),
+        BenchVerdict(failures.empty(), "ok", "FAILED"));
+    for (const std::string& f : failures) std::printf("    %s\n", f.c_str());
+}
+
+// -----------------------------------------------------------------------------
+// Hook thread: OnKey() cost on every path once Esc/Enter are handed to a
+// worker, against Enter handled inside the hook; then what happens to keys
+// typed between the Esc/Enter and the worker taking the hook down
+// -----------------------------------------------------------------------------
+static void BenchHookThread()
+{
+    std::printf("[hook thread]\n");
+    SimKeyboardHook hook;
+    SimFreezer freezer;
+    VirtualClock clock;
+    RecordingSink sink(&clock);
+    CommandQueue worker;
+#ifndef _WIN32
+    worker.RunSync([] { setpriority(PRIO_PROCESS, 0, 19); }); // Below the hook side, as in the tool
+#endif
+    std::vector<int64_t> wakeNs;
+    std::function<void()> onWake;
+    PauseBackends backends;
+    backends.hook = &hook;
+    backends.freezer = &freezer;
+    backends.sink = &sink;
+    backends.clock = &clock;
+    backends.selfPid = BenchSelfPid();
+    backends.wakeWorker = [&] { onWake(); };
+    PauseController deferred(backends, PauseConfig());
+    deferred.Start();
+    onWake = [&] {
+        int64_t posted = BenchNowNs();
+        worker.Post([&, posted] {
+            wakeNs.push_back(BenchNowNs() - posted);
+            deferred.RunPendingAction();
+        });
+    };
+    const uint32_t chord = HOTKEY_CONTROL | HOTKEY_ALT;
+    auto key = [](uint16_t vk, bool up) { KeyEvent ev = { MonotonicNs(), vk, 0, static_cast<uint16_t>(up ? KEY_UP : 0), 0 }; return ev; };
+    auto timed = [&](std::vector<int64_t>& out, const KeyEvent& ev, uint32_t mods) {
+        int64_t t0 = BenchNowNs();
+        deferred.OnKey(ev, mods);
+        out.push_back(BenchNowNs() - t0);
+    };
+    std::vector<int64_t> idle, hotkeyPass, capture, esc, enter, keyup;
+    const int ROUNDS = 2000;
+    for (int i = 0; i < ROUNDS; ++i) {
+        timed(idle, key('A', false), 0);
+        deferred.OnHotkey(4242);
+        timed(hotkeyPass, key('P', false), chord);
+        for (uint16_t vk = 'Q'; vk < 'U'; ++vk) {
+            timed(capture, key(vk, false), 0);
+            timed(capture, key(vk, true), 0);
+        }
+        uint16_t special = i % 2 ? KEYCODE_ESCAPE : KEYCODE_RETURN;
+        timed(special == KEYCODE_ESCAPE ? esc : enter, key(special, false), 0);
+        timed(keyup, key(special, true), 0);
+        worker.RunSync([] {}); // The worker thaws and replays; idle again before the next key
+    }
+    BenchReport("hook callback, not paused", idle);
+    BenchReport("hook callback, pause hotkey passed", hotkeyPass);
+    BenchReport("hook callback, capturing", capture);
+    BenchReport("hook callback, Esc handed to worker", esc);
+    BenchReport("hook callback, Enter handed to worker", enter);
+    BenchReport("hook callback, Esc/Enter keyup", keyup);
+    BenchReport("worker wake, post -> running", wakeNs);
+
+    // Before: Enter ran unhook + thaw + LeadDelayMs + replay inside the callback
+    {
+        SimKeyboardHook inlineHook;
+        SimFreezer inlineFreezer;
+        RecordingSink inlineSink;
+        PauseBackends b;
+        b.hook = &inlineHook;
+        b.freezer = &inlineFreezer;
+        b.sink = &inlineSink;
+        b.selfPid = BenchSelfPid();
+        PauseController inlined(b, PauseConfig());
+        inlined.Start();
+        inlined.OnHotkey(4242);
+        for (uint16_t vk = 'Q'; vk < 'U'; ++vk) {
+            inlined.OnKey(key(vk, false), 0);
+            inlined.OnKey(key(vk, true), 0);
+        }
+        int64_t t0 = BenchNowNs();
+        inlined.OnKey(key(KEYCODE_RETURN, false), 0);
+        int64_t ns = BenchNowNs() - t0;
+        std::printf("  %-40s %10.1f ms  (real clock, LeadDelayMs %d, %zu events replayed)\n", "hook callback, Enter handled inline",
+            ns / 1e6, PauseConfig().replay.leadDelayMs, inlined.LastReplay().events);
+        inlined.Stop();
+    }
+
+    // Ordering: keys typed after the Esc/Enter but before the hook is down. The worker is
+    // run by hand here so the keys land in that window every time.
+    onWake = [] {};
+    auto sent = [&]() {
+        std::string vks;
+        for (const RecordingSink::Arrival& a : sink.Arrivals()) vks += static_cast<char>(a.event.vk);
+        return vks;
+    };
+    auto tap = [&](uint16_t vk) {
+        deferred.OnKey(key(vk, false), 0);
+        deferred.OnKey(key(vk, true), 0);
+    };
+    deferred.OnHotkey(4242);
+    sink.Clear();
+    tap('A');
+    tap('B');
+    deferred.OnKey(key(KEYCODE_RETURN, false), 0);
+    tap('C');
+    deferred.OnKey(key(KEYCODE_RETURN, true), 0);
+    deferred.RunPendingAction();
+    bool enterOk = !deferred.Paused() && sent() == "AABBCC";
+    deferred.OnHotkey(4242);
+    sink.Clear();
+    tap('A');
+    deferred.OnKey(key(KEYCODE_ESCAPE, false), 0);
+    tap('C');
+    deferred.OnKey(key(KEYCODE_ESCAPE, true), 0);
+    deferred.RunPendingAction();
+    bool escOk = !deferred.Paused() && sent() == "CC";
+    deferred.OnHotkey(4242);
+    sink.Clear();
+    tap('A');
+    deferred.OnKey(key(KEYCODE_RETURN, false), 0);
+    int thaws = freezer.thaws;
+    deferred.OnHotkey(4242); // The hotkey wins the race: it resumes, the queued Enter finds nothing to do
+    deferred.RunPendingAction();
+    bool raceOk = !deferred.Paused() && freezer.thaws == thaws + 1 && sent() == "AA";
+    deferred.Stop();
+    std::printf("  keys typed while the hook comes down: after Enter %s, after Esc %s, hotkey first %s\n",
+        BenchVerdict(enterOk, "replayed after the session", "FAILED"), BenchVerdict(escOk, "replayed alone", "FAILED"), BenchVerdict(raceOk, "ok", "FAILED"));
+}
+
+// -----------------------------------------------------------------------------
+// Linux input: uinput injection throughput (one write per batch vs. one per
+// event) against the rate the replay policies actually pace at, and evdev
+// capture latency from the kernel timestamp to the key sitting in the ring.
+// Both run on pipes - /dev/uinput would type into whatever has focus.
+// -----------------------------------------------------------------------------
+#ifndef _WIN32
+static void BenchWriteInputEvent(int fd, uint16_t type, uint16_t code, int32_t value, uint64_t timeNs)
+{
+    input_event ev = UinputSink::MakeEvent(type, code, value);
+    ev.input_event_sec = static_cast<decltype(ev.input_event_sec)>(timeNs / 1000000000ULL);
+    ev.input_event_usec = static_cast<decltype(ev.input_event_usec)>(timeNs % 1000000000ULL / 1000);
+    if (write(fd, &ev, sizeof(ev)) < 0) {}
+}
+
+static void BenchWriteKey(int fd, uint16_t code, bool down)
+{
+    uint64_t now = MonotonicNs();
+    BenchWriteInputEvent(fd, EV_KEY, code, down ? 1 : 0, now);
+    BenchWriteInputEvent(fd, EV_SYN, SYN_REPORT, 0, now);
+}
+
+static void BenchLinuxInput()
+{
+    std::printf("[linux input]\n");
+    const EvdevKeyMap& map = EvdevKeyMap::Get();
+    size_t keys = 0, mismatched = 0;
+    map.ForEachCode([&](uint16_t code) {
+        uint16_t flags = 0;
+        uint16_t vk = map.ToVK(code, flags);
+        ++keys;
+        if (map.ToCode(vk, flags) != code) ++mismatched;
+    });
+    std::printf("  key map: %zu evdev keys, %zu don't round-trip through virtual keys\n", keys, mismatched);
+
+    // Injection: the same 20000 events through the scheduler's batches, into a drained pipe
+    std::vector<KeyEvent> trace = BenchTrace(10000, 0);
+    int pipefd[2];
+    if (pipe2(pipefd, O_CLOEXEC) != 0) return;
+    std::thread drain([&] {
+        char buf[65536];
+        while (read(pipefd[0], buf, sizeof(buf)) > 0) {} // Until the write end closes
+    });
+    UinputSink sink;
+    sink.Attach(pipefd[1]);
+    const size_t batches[] = { 1, 32, trace.size() };
+    for (size_t batch : batches) {
+        ReplayOptions opt;
+        opt.policy = ReplayPolicy::Batched;
+        opt.batchSize = batch;
+        opt.batchGapMs = 0;
+        opt.leadDelayMs = 0;
+        VirtualClock clock; // Pacing is measured separately below; this is the sink's ceiling
+        ReplayScheduler scheduler(opt, &clock);
+        uint64_t writes0 = sink.Writes();
+        int64_t t0 = BenchNowNs();
+        scheduler.Run(trace.data(), trace.size(), sink);
+        int64_t ns = BenchNowNs() - t0;
+        std::printf("  uinput sink, %5zu events per write  %8.0f events/s  %6.1f ns/event  %6zu writes\n", batch,
+            trace.size() * 1e9 / ns, static_cast<double>(ns) / trace.size(), static_cast<size_t>(sink.Writes() - writes0));
+    }
+    {
+        // What a straight port of the Win32 loop does: every input_event its own write()
+        int64_t t0 = BenchNowNs();
+        for (const KeyEvent& ev : trace) {
+            input_event key = UinputSink::MakeEvent(EV_KEY, map.ToCode(ev.vk, ev.flags), (ev.flags & KEY_UP) ? 0 : 1);
+            input_event syn = UinputSink::MakeEvent(EV_SYN, SYN_REPORT, 0);
+            if (write(pipefd[1], &key, sizeof(key)) < 0 || write(pipefd[1], &syn, sizeof(syn)) < 0) break;
+        }
+        int64_t ns = BenchNowNs() - t0;
+        std::printf("  one write per input_event              %8.0f events/s  %6.1f ns/event  %6zu writes\n",
+            trace.size() * 1e9 / ns, static_cast<double>(ns) / trace.size(), trace.size() * 2);
+    }
+    close(pipefd[1]);
+    drain.join();
+    close(pipefd[0]);
+    // The pace replay runs at on either platform - the Win32 SendInput path included - is the policy's
+    struct Pace { const char* name; ReplayPolicy policy; };
+    const Pace paces[] = { { "jitter (default)", ReplayPolicy::Jitter }, { "batched x32", ReplayPolicy::Batched } };
+    for (const Pace& pace : paces) {
+        ReplayOptions opt;
+        opt.policy = pace.policy;
+        opt.leadDelayMs = 0;
+        VirtualClock clock;
+        ReplayScheduler scheduler(opt, &clock);
+        RecordingSink recorded;
+        ReplayStats st = scheduler.Run(trace.data(), 2000, recorded);
+        std::printf("  policy pace, %-26s %8.0f events/s\n", pace.name, st.events * 1e9 / std::max<uint64_t>(1, st.durationNs));
+    }
+
+    // Capture: hotkey chord, 2000 taps and Enter written into a pipe as a keyboard would deliver them
+    if (pipe2(pipefd, O_CLOEXEC | O_NONBLOCK) != 0) return;
+    EvdevInput input;
+    input.AddDevice(pipefd[0], "bench pipe", true);
+    SimFreezer freezer;
+    RecordingSink replayed;
+    VirtualClock clock;
+    PauseBackends backends;
+    backends.hook = &input;
+    backends.freezer = &freezer;
+    backends.sink = &replayed;
+    backends.clock = &clock;
+    backends.hotkeys = &input;
+    backends.selfPid = BenchSelfPid();
+    CommandQueue worker;
+    PauseController* pending = nullptr;
+    backends.wakeWorker = [&] { worker.Post([&] { pending->RunPendingAction(); }); };
+    PauseController controller(backends, PauseConfig());
+    pending = &controller;
+    controller.Start();
+    std::atomic<int> hotkeys{ 0 };
+    input.Start(&controller, [&] {
+        ++hotkeys;
+        worker.Post([&] { controller.OnHotkey(4242); });
+    });
+    const uint16_t chord[] = { KEY_LEFTCTRL, KEY_LEFTALT, KEY_P };
+    for (uint16_t code : chord) BenchWriteKey(pipefd[1], code, true);
+    for (int i = 2; i >= 0; --i) BenchWriteKey(pipefd[1], chord[i], false);
+    for (int i = 0; i < 1000 && !(controller.Paused() && input.Grabbed()); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    const uint16_t letters[] = { KEY_Q, KEY_W, KEY_E, KEY_R, KEY_T, KEY_Y };
+    const size_t TAPS = 2000;
+    for (size_t i = 0; i < TAPS; ++i) {
+        BenchWriteKey(pipefd[1], letters[i % 6], true);
+        BenchWriteKey(pipefd[1], letters[i % 6], false);
+        if (i % 8 == 7) std::this_thread::sleep_for(std::chrono::microseconds(200)); // Typing, not one burst
+    }
+    BenchWriteKey(pipefd[1], KEY_ENTER, true);
+    BenchWriteKey(pipefd[1], KEY_ENTER, false);
+    for (int i = 0; i < 2000 && controller.Paused(); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    bool grabbed = input.Grabbed();
+    input.Stop();
+    worker.RunSync([] {});
+    close(pipefd[1]);
+    close(pipefd[0]);
+    std::printf("  evdev capture, kernel time -> ring     p50 %8llu ns  p99 %8llu ns  max %8llu ns  (n=%llu)\n",
+        static_cast<unsigned long long>(input.captureNs.Percentile(0.50)), static_cast<unsigned long long>(input.captureNs.Percentile(0.99)),
+        static_cast<unsigned long long>(input.captureNs.Max()), static_cast<unsigned long long>(input.captureNs.Count()));
+    // Replayed: every tap, plus the chord's Ctrl/Alt releases if they came after the worker
+    // started the pause; the Enter is eaten
+    size_t letterEvents = 0;
+    for (const RecordingSink::Arrival& a : replayed.Arrivals()) {
+        if (a.event.vk >= 'A' && a.event.vk <= 'Z' && a.event.vk != 'P') ++letterEvents;
+    }
+    bool ok = hotkeys == 1 && !controller.Paused() && !grabbed && controller.LastReplay().events >= TAPS * 2
+        && controller.LastReplay().events <= TAPS * 2 + 2 && letterEvents == TAPS * 2;
+    std::printf("  evdev hotkey, grab, %zu taps, Enter to replay, ungrab: %s (replayed %zu)\n", TAPS, BenchVerdict(ok, "ok", "FAILED"),
+        controller.LastReplay().events);
+}
+#else
+static void BenchLinuxInput()
+{
+    std::printf("[linux input]\n  (evdev/uinput are Linux only)\n");
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// Freeze journal: kill -9 a process in the middle of a pause, then time how
+// long the next start, and separately the watchdog, take to get the game
+// running again. Also what journaling adds to a freeze, and the PID reuse guard.
+// -----------------------------------------------------------------------------
+#ifndef _WIN32
+static size_t BenchStoppedTasks(uint32_t pid)
+{
+    size_t n = 0;
+    for (uint32_t tid : ListProcTasks(pid)) {
+        char st = ReadTaskState(pid, tid);
+        n += st == 'T' || st == 't';
+    }
+    return n;
+}
+
+// A forked GamePauser stand-in: journals and freezes pids, reports in, then waits to be killed
+static pid_t BenchCrashingInstance(const std::string& path, const std::vector<uint32_t>& pids)
+{
+    int ready[2];
+    if (pipe(ready) != 0) return -1;
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(ready[0]);
+        FreezeJournal journal;
+        if (!journal.Open(path, 1000)) _exit(1);
+        ActiveFreezeRecorder().store(&journal);
+        std::vector<PauseMember> members(pids.size());
+        for (size_t i = 0; i < pids.size(); ++i) members[i].pid = pids[i];
+        ProcessGroupFreezer group(1);
+        group.Freeze(members, GroupOrder::ChildrenFirst);
+        char c = 1;
+        if (write(ready[1], &c, 1) != 1) _exit(1);
+        for (;;) pause();
+    }
+    close(ready[1]);
+    char c = 0;
+    bool ok = pid > 0 && read(ready[0], &c, 1) == 1;
+    close(ready[0]);
+    if (!ok && pid > 0) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+    return ok ? pid : -1;
+}
+
+// Waits for every main thread of pids to leave the stopped state (cheap enough to poll
+// tightly; sets mainNs), then for every other task. Returns false after a second.
+static bool BenchWaitRunning(const std::vector<uint32_t>& pids, int64_t& mainNs)
+{
+    int64_t t0 = BenchNowNs(), deadline = t0 + 1000000000LL;
+    for (uint32_t pid : pids) {
+        for (char st = ReadTaskState(pid, pid); st == 'T' || st == 't'; st = ReadTaskState(pid, pid)) {
+            if (BenchNowNs() > deadline) return false;
+            std::this_thread::yield();
+        }
+    }
+    mainNs = BenchNowNs() - t0;
+    for (;;) {
+        size_t stopped = 0;
+        for (uint32_t pid : pids) stopped += BenchStoppedTasks(pid);
+        if (!stopped) return true;
+        if (BenchNowNs() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+static int64_t BenchThreadCpuNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+static void BenchFreezeJournal()
+{
+    std::printf("[freeze journal]\n");
+    const int THREADS = 300, SMALL = 8, ROUNDS = 5;
+    std::string path = BenchTempPath("gamepauser-bench.journal");
+    unlink(path.c_str());
+    BenchChild game = SpawnBenchChild(THREADS);
+    std::vector<BenchChild> small;
+    for (int i = 0; i < SMALL; ++i) small.push_back(SpawnBenchChild(1));
+    std::vector<uint32_t> pids = { game.pid };
+    size_t tasks = ListProcTasks(game.pid).size();
+    for (const BenchChild& c : small) {
+        pids.push_back(c.pid);
+        tasks += ListProcTasks(c.pid).size();
+    }
+
+    // What the journal adds to a freeze of the big target: its calls on their own, then a whole freeze/thaw
+    {
+        FreezeJournal journal;
+        journal.Open(path, 1000);
+        std::vector<uint32_t> tids = ListProcTasks(game.pid);
+        std::vector<int64_t> calls;
+        for (int i = 0; i < 200; ++i) {
+            int64_t t0 = BenchNowNs();
+            int slot = journal.Begin(game.pid);
+            journal.Threads(slot, tids);
+            journal.End(slot);
+            calls.push_back(BenchNowNs() - t0);
+        }
+        char label[64];
+        std::snprintf(label, sizeof(label), "Journal calls, %zu threads", tids.size()); // Begin, Threads and End: the write-ahead part
+        BenchReport(label, calls);
+        // A process with more threads than a slot holds continues in further slots;
+        // indices run on across them and End frees them all
+        std::vector<uint32_t> many(FREEZE_JOURNAL_THREADS * 2 + 100), more(50);
+        for (size_t i = 0; i < many.size(); ++i) many[i] = static_cast<uint32_t>(100000 + i);
+        for (size_t i = 0; i < more.size(); ++i) more[i] = static_cast<uint32_t>(200000 + i);
+        int slot = journal.Begin(game.pid);
+        int first = journal.Threads(slot, many), next = journal.Threads(slot, more);
+        size_t chained = journal.LiveSlots();
+        int last = static_cast<int>(many.size() + more.size()) - 1;
+        journal.Resumed(slot, last);
+        journal.Frozen(slot);
+        FreezeJournalSlot& tail = journal.Slot(static_cast<int>(journal.Slot(static_cast<int>(journal.Slot(slot).next) - 1).next) - 1);
+        bool resumedLast = tail.count.load() == 100 + more.size() && tail.threads[tail.count.load() - 1].tid == more.back()
+            && tail.threads[tail.count.load() - 1].suspends == 0 && tail.threads[0].suspends == 1 && tail.continues == 1
+            && tail.startTime == journal.Slot(slot).startTime && tail.startTime != 0;
+        journal.End(slot);
+        std::printf("  %zu threads in one process: %zu slots chained, indices %d and %d, resume of the last recorded: %s, all freed: %s\n",
+            many.size() + more.size(), chained, first, next, BenchVerdict(chained == 3 && first == 0 && next == static_cast<int>(many.size()) && resumedLast),
+            BenchVerdict(journal.LiveSlots() == 0));
+        auto freezer = CreateProcessFreezer(1);
+        std::vector<int64_t> plain, journaled;
+        for (int i = 0; i < 40; ++i) {
+            ActiveFreezeRecorder().store(i % 2 ? &journal : nullptr);
+            int64_t t0 = BenchNowNs();
+            freezer->Freeze(game.pid);
+            freezer->Thaw();
+            (i % 2 ? journaled : plain).push_back(BenchNowNs() - t0);
+        }
+        ActiveFreezeRecorder().store(nullptr);
+        std::sort(plain.begin(), plain.end());
+        std::sort(journaled.begin(), journaled.end());
+        std::printf("  freeze+thaw: %.0f us plain, %.0f us journaled (medians), %zu slots left in use\n",
+            plain[plain.size() / 2] / 1e3, journaled[journaled.size() / 2] / 1e3, journal.LiveSlots());
+    }
+
+    // kill -9 mid-pause, the next start recovers
+    std::vector<int64_t> recover, recoverCpu, startup, running;
+    bool orphaned = true, resumed = true, exact = true;
+    for (int round = 0; round < ROUNDS; ++round) {
+        pid_t instance = BenchCrashingInstance(path, pids);
+        if (instance < 0) {
+            std::printf("  could not start the crashing instance\n");
+            ++BenchFailures();
+            break;
+        }
+        kill(instance, SIGKILL);
+        waitpid(instance, nullptr, 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        size_t stopped = 0;
+        for (uint32_t pid : pids) stopped += BenchStoppedTasks(pid);
+        orphaned = orphaned && stopped == tasks; // What used to need Task Manager or a reboot
+        int64_t t0 = BenchNowNs();
+        FreezeJournal journal;
+        journal.Open(path, 1000);
+        int64_t cpu0 = BenchThreadCpuNs();
+        FreezeRecovery r = journal.Recover();
+        recoverCpu.push_back(BenchThreadCpuNs() - cpu0);
+        startup.push_back(BenchNowNs() - t0);
+        recover.push_back(r.elapsedNs);
+        int64_t mainNs = 0;
+        resumed = BenchWaitRunning(pids, mainNs) && resumed;
+        running.push_back(startup.back() + mainNs);
+        exact = exact && r.processes == pids.size() && r.threads == tasks && !r.skipped && !journal.LiveSlots();
+    }
+    std::printf("  kill -9 while %zu threads in %zu processes were frozen: %s after the crash\n", tasks, pids.size(),
+        BenchVerdict(orphaned, "all still frozen", "NOT all frozen (MISMATCH)"));
+    BenchReport("Next start: Recover(), wall", recover); // Includes the woken game preempting us on a busy CPU
+    BenchReport("Next start: Recover(), our CPU", recoverCpu);
+    BenchReport("Next start: Open() + Recover()", startup);
+    BenchReport("Next start: until main threads run", running);
+    std::printf("  recovered exactly what was journaled: %s, everything running again: %s\n", BenchVerdict(exact), BenchVerdict(resumed, "ok", "FAILED"));
+
+    // kill -9 with a watchdog waiting on the journal lock
+    pid_t instance = BenchCrashingInstance(path, pids);
+    pid_t watchdog = instance > 0 ? fork() : -1;
+    if (watchdog == 0) {
+        DetachStdStreams(); // As SpawnFreezeWatchdog does; the note below is its report
+        _exit(RunFreezeWatchdog(path));
+    }
+    if (watchdog > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50)); // Let it block on the lock
+        int64_t t0 = BenchNowNs();
+        kill(instance, SIGKILL);
+        waitpid(instance, nullptr, 0);
+        int64_t mainNs = 0, waitAt = BenchNowNs();
+        bool ok = BenchWaitRunning(pids, mainNs);
+        int64_t elapsed = waitAt - t0 + mainNs;
+        int status = 0;
+        waitpid(watchdog, &status, 0);
+        FreezeJournal journal;
+        journal.Open(path, 1000);
+        FreezeRecovery note;
+        int64_t atNs = 0;
+        uint32_t by = 0;
+        bool reported = journal.TakeReport(note, atNs, by) && by == static_cast<uint32_t>(watchdog) && note.processes == pids.size();
+        std::printf("  watchdog: main threads running %.2f ms after the kill, every task running (%s), exit %d, note for the next start %s\n", elapsed / 1e6,
+            BenchVerdict(ok, "ok", "FAILED"), WIFEXITED(status) ? WEXITSTATUS(status) : -1, BenchVerdict(reported));
+    }
+    else if (instance > 0) {
+        kill(instance, SIGKILL);
+        waitpid(instance, nullptr, 0);
+    }
+
+    // A journaled PID that now belongs to some other process is left alone
+    {
+        FreezeJournal journal;
+        journal.Open(path, 1000);
+        int slot = journal.Begin(small[0].pid);
+        journal.Frozen(slot);
+        journal.Slot(slot).startTime += 1; // As if small[0] had exited and its PID been reused
+        kill(static_cast<pid_t>(small[0].pid), SIGSTOP);
+        for (int i = 0; i < 500 && !BenchStoppedTasks(small[0].pid); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        journal.Close(); // "Crash" with the slot live
+        journal.Open(path, 1000);
+        FreezeRecovery r = journal.Recover();
+        bool untouched = BenchStoppedTasks(small[0].pid) > 0;
+        kill(static_cast<pid_t>(small[0].pid), SIGCONT);
+        std::printf("  reused PID: %zu skipped, %zu resumed, process left alone: %s\n", r.skipped, r.processes,
+            BenchVerdict(r.skipped == 1 && !r.processes && untouched));
+    }
+    KillBenchChild(game);
+    for (BenchChild& c : small) KillBenchChild(c);
+    unlink(path.c_str());
+}
+#else
+static void BenchFreezeJournal()
+{
+    std::printf("[freeze journal]\n  (the kill -9 harness is Linux only)\n");
+}
+#endif
+
+// Events named `name` in a dump, and whether each thread's `i` args count up by one
+static size_t BenchTraceCount(const std::string& json, const char* name, bool* consecutive = nullptr)
+{
+    std::string key = std::string("\"name\":\"") + name + "\"";
+    std::map<unsigned long, unsigned long long> last;
+    size_t count = 0;
+    if (consecutive) *consecutive = true;
+    for (size_t at = json.find(key); at != std::string::npos; at = json.find(key, at + 1)) {
+        ++count;
+        if (!consecutive) continue;
+        size_t start = json.rfind('\n', at), end = json.find('\n', at);
+        std::string line = json.substr(start + 1, end == std::string::npos ? std::string::npos : end - start - 1);
+        size_t tid = line.find("\"tid\":"), arg = line.find("\"i\":");
+        if (tid == std::string::npos || arg == std::string::npos) {
+            *consecutive = false;
+            continue;
+        }
+        unsigned long t = std::strtoul(line.c_str() + tid + 6, nullptr, 10);
+        unsigned long long i = std::strtoull(line.c_str() + arg + 4, nullptr, 10);
+        auto it = last.find(t);
+        if (it != last.end() && i != it->second + 1) *consecutive = false;
+        last[t] = i;
+    }
+    return count;
+}
+
+static void BenchTracing()
+{
+    std::printf("[tracing]\n");
+    Tracer& tracer = Tracer::Instance();
+    const int SPANS = 1000000;
+    std::string path = BenchTempPath("gamepauser-bench.trace.json");
+    auto readDump = [&path] {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+
+    // Cost per span, off and on; each measurement runs on a fresh thread so it has its own ring
+    auto perSpan = [SPANS](bool enabled, bool instant) {
+        double ns = 0;
+        std::thread t([&] {
+            if (enabled) Tracer::Instance().Enable(TRACE_DEFAULT_EVENTS);
+            int64_t t0 = BenchNowNs();
+            for (int i = 0; i < SPANS; ++i) {
+                if (instant) {
+                    TraceInstant("bench instant", "i", static_cast<uint64_t>(i));
+                }
+                else {
+                    TraceSpan span("bench span", "i", static_cast<uint64_t>(i));
+                }
+            }
+            ns = static_cast<double>(BenchNowNs() - t0) / SPANS;
+            Tracer::Instance().Disable();
+        });
+        t.join();
+        return ns;
+    };
+    double off = perSpan(false, false), on = perSpan(true, false), instant = perSpan(true, true);
+    int64_t c0 = BenchNowNs();
+    for (int i = 0; i < SPANS; ++i) TraceNowNs();
+    double clock = static_cast<double>(BenchNowNs() - c0) / SPANS;
+    std::printf("  span: %.2f ns off, %.1f ns on (two clock reads of %.1f ns each), instant on: %.1f ns\n", off, on, clock, instant);
+
+    // Threads recording at once never share a ring: every event of every thread is in the dump
+    const int THREADS = 4, EACH = 10000;
+    tracer.Enable(65536);
+    {
+        std::vector<std::thread> threads;
+        for (int n = 0; n < THREADS; ++n) {
+            threads.emplace_back([] {
+                TraceThreadName("bench recorder");
+                for (int i = 0; i < EACH; ++i) TraceSpan span("bench thread span", "i", static_cast<uint64_t>(i));
+            });
+        }
+        for (std::thread& t : threads) t.join();
+    }
+    // A ring that wraps keeps the newest events and counts the rest as overwritten
+    tracer.Enable(1024);
+    std::thread([] {
+        for (int i = 0; i < 5000; ++i) TraceInstant("bench wrap", "i", static_cast<uint64_t>(i));
+    }).join();
+    TraceDumpStats stats;
+    int64_t d0 = BenchNowNs();
+    bool written = tracer.Dump(path, &stats);
+    int64_t dumpNs = BenchNowNs() - d0;
+    std::string json = readDump();
+    bool consecutive = false;
+    size_t parallel = BenchTraceCount(json, "bench thread span", &consecutive);
+    size_t wrapped = BenchTraceCount(json, "bench wrap");
+    bool framed = json.rfind("{\"displayTimeUnit\"", 0) == 0 && json.size() > 4 && json.compare(json.size() - 4, 4, "\n]}\n") == 0;
+    std::printf("  %d threads x %d spans: %zu in the dump, in order per thread: %s\n", THREADS, EACH, parallel,
+        BenchVerdict(written && framed && parallel == static_cast<size_t>(THREADS * EACH) && consecutive));
+    std::printf("  ring of 1024 after 5000 events: newest %zu kept: %s\n", wrapped, BenchVerdict(wrapped == 1024 && stats.lost >= 5000 - 1024));
+    std::printf("  dump: %zu events from %zu threads (%llu overwritten), %.1f MB in %.1f ms\n", stats.events, stats.threads,
+        static_cast<unsigned long long>(stats.lost), stats.bytes / 1048576.0, dumpNs / 1e6);
+
+    // Dumping while a thread records flat out: a slot it laps mid-copy is dropped, never torn
+    {
+        std::atomic<bool> stop{ false };
+        tracer.Enable(4096);
+        std::thread writer([&stop] {
+            for (uint64_t i = 0; !stop.load(std::memory_order_relaxed); ++i) TraceSpan span("bench live span", "i", i);
+        });
+        bool intact = true;
+        size_t seen = 0;
+        for (int round = 0; round < 10; ++round) {
+            tracer.Dump(path);
+            bool inOrder = false;
+            seen += BenchTraceCount(readDump(), "bench live span", &inOrder);
+            intact = intact && inOrder;
+        }
+        stop = true;
+        writer.join();
+        std::printf("  10 dumps during recording: %zu events read, none torn: %s\n", seen, BenchVerdict(intact && seen));
+    }
+
+    // A ring whose thread exited goes to the next new thread once a dump has written it
+    // out: far more short-lived threads than TRACE_MAX_THREADS, all traced
+    {
+        const int ROUNDS = 5, BATCH = 40;
+        tracer.Enable(1024);
+        size_t traced = 0, most = 0;
+        TraceDumpStats st;
+        for (int round = 0; round < ROUNDS; ++round) {
+            for (int n = 0; n < BATCH; ++n) std::thread([] { TraceInstant("bench reuse"); }).join();
+            tracer.Dump(path, &st);
+            traced += BenchTraceCount(readDump(), "bench reuse");
+            most = std::max(most, st.threads);
+        }
+        tracer.Disable();
+        std::printf("  %d short-lived threads, dump every %d: %zu traced, at most %zu rings, %llu untraced: %s\n", ROUNDS * BATCH, BATCH, traced, most,
+            static_cast<unsigned long long>(st.untraced), BenchVerdict(traced == static_cast<size_t>(ROUNDS * BATCH) && most <= TRACE_MAX_THREADS && !st.untraced));
+    }
+
+    // A traced freeze/thaw: what the spans add, and that the freezer's steps are on the timeline
+    {
+        BenchChild child = SpawnBenchChild(64);
+        auto freezer = CreateProcessFreezer(1);
+        std::vector<int64_t> plain, traced;
+        size_t threads = 0;
+        for (int i = 0; i < 40; ++i) {
+            if (i % 2) tracer.Enable(TRACE_DEFAULT_EVENTS);
+            else tracer.Disable();
+            int64_t t0 = BenchNowNs();
+            threads = freezer->Freeze(child.pid).threads;
+            freezer->Thaw();
+            (i % 2 ? traced : plain).push_back(BenchNowNs() - t0);
+        }
+        tracer.Disable();
+        tracer.Dump(path);
+        json = readDump();
+#ifdef _WIN32
+        const char* step = "SuspendThread";
+#else
+        const char* step = "SIGSTOP";
+#endif
+        size_t freezes = BenchTraceCount(json, "freeze process"), steps = BenchTraceCount(json, step);
+        std::sort(plain.begin(), plain.end());
+        std::sort(traced.begin(), traced.end());
+        std::printf("  freeze+thaw of %zu threads: %.0f us plain, %.0f us traced (medians); %zu freezes and %zu %s spans on the timeline: %s\n",
+            threads, plain[plain.size() / 2] / 1e3, traced[traced.size() / 2] / 1e3,
+            freezes, steps, step, BenchVerdict(freezes >= 20 && steps >= 20));
+        KillBenchChild(child);
+    }
+    std::remove(path.c_str());
+}
+
+static int RunBenchmarks()
+{
+    std::printf("GamePauser microbenchmarks\n");
+    BenchLogger();
+    BenchFreezer();
+    BenchKeyRing();
+    BenchReplay();
+    BenchKeyboardState();
+    BenchProcessGroup();
+    BenchSimulation();
+    BenchMetrics();
+    BenchMemoryTrim();
+    BenchResume();
+    BenchThrottle();
+    BenchFocusMode();
+    BenchFreezeJournal();
+    BenchMacros();
+    BenchTextCompiler();
+    BenchCaptureOptimizer();
+    BenchProfiles();
+    BenchControl();
+    BenchHookThread();
+    BenchTracing();
+    BenchLinuxInput();
+    if (BenchFailures()) std::printf("%d checks FAILED\n", BenchFailures());
+    return BenchFailures() ? 1 : 0;
+}
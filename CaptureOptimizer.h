@@ -0,0 +1,339 @@
+// =============================================================================
+// CaptureOptimizer.h - Shrink a captured session before it is replayed
+//
+// Everything typed during a pause is replayed literally, each event paced by
+// the replay policy. This optional pass removes what the target can't tell
+// apart, under a plain text-field model (insert mode, typing at the cursor):
+//   repeats - an autorepeat run becomes one key-down standing for the whole
+//             run (KEY_EXTRA_REPEAT, sent as one burst by the scheduler);
+//             repeats of a held modifier are dropped outright
+//   edits   - a letter, digit or space and the Backspace that deletes it are
+//             both removed, when only Shift, Delete and key-ups came in
+//             between and no modifier was held for the Backspace
+//   taps    - Shift or Ctrl pressed and released on its own, and key-ups of
+//             keys that were never down (the pre-pause cleanup already
+//             released them), are dropped
+// Anything the model can't vouch for - navigation, shortcuts, Enter,
+// punctuation, pasted text - is a barrier edits never cross, and the first
+// character after a barrier is never erased (it may complete a dead key).
+// Autocomplete and IME composition are outside the model: leave it off for
+// fields that do either. The time spent typing what was erased is cut from
+// the event times, so Faithful replays get shorter too.
+// =============================================================================
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "KeyRing.h"
+#include "ReplayScheduler.h"
+#include "TextCompiler.h"
+
+struct CaptureOptimizeOptions
+{
+    bool repeats = false;
+    bool edits = false;
+    bool taps = false;
+
+    bool Any() const { return repeats || edits || taps; }
+};
+
+// "off", "all", or a comma list of repeats, edits, taps
+static inline CaptureOptimizeOptions CaptureOptimizeFromString(const std::string& s)
+{
+    CaptureOptimizeOptions opt;
+    std::stringstream list(s);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        item.erase(0, item.find_first_not_of(" \t"));
+        item.erase(item.find_last_not_of(" \t") + 1);
+        if (item == "all") opt.repeats = opt.edits = opt.taps = true;
+        else if (item == "repeats") opt.repeats = true;
+        else if (item == "edits") opt.edits = true;
+        else if (item == "taps") opt.taps = true;
+    }
+    return opt;
+}
+
+struct CaptureOptimizeStats
+{
+    size_t eventsIn = 0;
+    size_t eventsOut = 0;
+    size_t repeatsFolded = 0; // Autorepeat key-downs merged into a burst or dropped
+    size_t keystrokesErased = 0; // Typed characters removed together with their Backspace
+    size_t tapsDropped = 0; // Events of no-op taps and orphan key-ups
+    uint64_t erasedNs = 0; // Cut from the event times
+};
+
+static inline bool IsShiftVk(uint16_t vk) { return vk == 0x10 || vk == 0xA0 || vk == 0xA1; }
+static inline bool IsCtrlVk(uint16_t vk) { return vk == 0x11 || vk == 0xA2 || vk == 0xA3; }
+static inline bool IsModifierVk(uint16_t vk)
+{
+    return IsShiftVk(vk) || IsCtrlVk(vk) || vk == 0x12 || vk == 0xA4 || vk == 0xA5 || vk == 0x5B || vk == 0x5C;
+}
+// Keys that type the same one character on every layout's base and Shift levels
+static inline bool IsPlainCharVk(uint16_t vk) { return (vk >= 'A' && vk <= 'Z') || (vk >= '0' && vk <= '9') || vk == 0x20; }
+
+// What a replay of events would take under options, without waiting it out
+static inline uint64_t EstimateReplayNs(const std::vector<KeyEvent>& events, const ReplayOptions& options)
+{
+    class DiscardSink : public InputSink
+    {
+    public:
+        void Send(const KeyEvent*, size_t) override {}
+    };
+    VirtualClock clock;
+    DiscardSink sink;
+    return ReplayScheduler(options, &clock).Run(events.data(), events.size(), sink).durationNs;
+}
+
+class CaptureOptimizer
+{
+public:
+    explicit CaptureOptimizer(const CaptureOptimizeOptions& options) : m_options(options) {}
+
+    // Rewrites events in place. pressedFirst: key-downs the target gets before events
+    // (the held chord Replay() presses up front), so they count as already down.
+    CaptureOptimizeStats Run(std::vector<KeyEvent>& events, const std::vector<KeyEvent>* pressedFirst = nullptr)
+    {
+        m_stats = CaptureOptimizeStats();
+        m_stats.eventsIn = events.size();
+        m_drop.assign(events.size(), KEEP);
+        std::fill(m_downFirst, m_downFirst + 256, false);
+        if (pressedFirst)
+            for (const KeyEvent& ev : *pressedFirst)
+                if (ev.vk < 256 && !(ev.flags & KEY_UP)) m_downFirst[ev.vk] = true;
+        if (m_options.repeats) FoldRepeats(events);
+        if (m_options.edits) EraseEdits(events);
+        if (m_options.taps) DropTaps(events);
+        Compact(events);
+        m_stats.eventsOut = events.size();
+        return m_stats;
+    }
+
+private:
+    enum : uint8_t { KEEP, MERGED, ERASED }; // MERGED keeps its time in the schedule, ERASED doesn't
+
+    static const size_t NONE = static_cast<size_t>(-1);
+
+    // Hook events only: pasted text and unicode units are left exactly as they are
+    static bool Plain(const KeyEvent& ev)
+    {
+        return ev.extra != KEY_EXTRA_PASTE && !(ev.flags & KEY_UNICODE) && ev.vk < 256;
+    }
+
+    void FoldRepeats(std::vector<KeyEvent>& events)
+    {
+        bool down[256];
+        std::copy(m_downFirst, m_downFirst + 256, down);
+        size_t last = NONE; // Last event still in the stream
+        for (size_t i = 0; i < events.size(); ++i) {
+            KeyEvent& ev = events[i];
+            if (!Plain(ev) || ev.extra) {
+                last = i;
+                continue;
+            }
+            if ((ev.flags & KEY_UP) || !down[ev.vk]) {
+                down[ev.vk] = !(ev.flags & KEY_UP);
+                last = i;
+                continue;
+            }
+            // Key-down of a key that is already down: autorepeat
+            if (IsModifierVk(ev.vk)) {
+                m_drop[i] = MERGED;
+                ++m_stats.repeatsFolded;
+                continue;
+            }
+            KeyEvent* run = last != NONE ? &events[last] : nullptr;
+            if (run && run->vk == ev.vk && run->flags == ev.flags && (run->extra & KEY_EXTRA_KIND) == KEY_EXTRA_REPEAT
+                && KeyDownCount(*run) < KEY_REPEAT_MAX) {
+                SetKeyRepeat(*run, KeyDownCount(*run) + 1);
+                m_drop[i] = MERGED;
+                ++m_stats.repeatsFolded;
+                continue;
+            }
+            SetKeyRepeat(ev, 1); // Starts a run; the press before it stays on its own
+            last = i;
+        }
+    }
+
+    // A held or released typed key: the key-downs that each inserted a character
+    struct Unit
+    {
+        std::vector<size_t> inserts;
+        size_t up = NONE;
+    };
+
+    void EraseEdits(std::vector<KeyEvent>& events)
+    {
+        const uint16_t BACKSPACE = 0x08, DELETE_KEY = 0x2E;
+        std::vector<Unit> units;
+        std::vector<size_t> typed; // Units in insertion order: what Backspace deletes, last first
+        size_t open[256];
+        std::fill(open, open + 256, NONE);
+        bool down[256];
+        std::copy(m_downFirst, m_downFirst + 256, down);
+        bool backspaceOpen = false, backspaceErased = false; // Every press of the current Backspace hold was erased
+        bool afterBarrier = true; // A dead key may be pending, from before the pause too
+        for (size_t i = 0; i < events.size(); ++i) {
+            if (m_drop[i]) continue;
+            KeyEvent& ev = events[i];
+            if (!Plain(ev)) {
+                typed.clear();
+                afterBarrier = true;
+                continue;
+            }
+            uint16_t vk = ev.vk;
+            if (ev.flags & KEY_UP) {
+                down[vk] = false;
+                if (vk == BACKSPACE) {
+                    if (backspaceOpen && backspaceErased) m_drop[i] = ERASED;
+                    backspaceOpen = false;
+                }
+                else if (open[vk] != NONE) {
+                    units[open[vk]].up = i;
+                    open[vk] = NONE;
+                }
+                continue; // Key-ups never change the text
+            }
+            bool repeat = down[vk];
+            down[vk] = true;
+            bool shift = down[0x10] || down[0xA0] || down[0xA1];
+            bool other = down[0x11] || down[0xA2] || down[0xA3] || down[0x12] || down[0xA4] || down[0xA5] || down[0x5B] || down[0x5C];
+            if (IsShiftVk(vk)) continue; // Shift alone types nothing
+            if (vk == DELETE_KEY && !shift && !other) continue; // Deletes after the cursor; what was typed is before it
+            if (IsPlainCharVk(vk) && !other) {
+                if (afterBarrier) {
+                    afterBarrier = false;
+                    typed.clear();
+                }
+                else if (!repeat) {
+                    open[vk] = units.size();
+                    units.push_back(Unit());
+                    units.back().inserts.push_back(i);
+                    typed.push_back(open[vk]);
+                }
+                else if (open[vk] != NONE && !typed.empty() && typed.back() == open[vk]) {
+                    units[open[vk]].inserts.push_back(i);
+                }
+                else {
+                    typed.clear(); // Repeats of a key held since before the pause, or out of order
+                }
+                continue;
+            }
+            if (vk == BACKSPACE && !shift && !other) {
+                if (!repeat) {
+                    backspaceOpen = true;
+                    backspaceErased = true;
+                }
+                else if (!backspaceOpen) {
+                    typed.clear(); // Held since before the pause
+                    continue;
+                }
+                size_t presses = KeyDownCount(ev), erased = 0;
+                while (erased < presses && !typed.empty() && units[typed.back()].up != NONE) {
+                    EraseLastInsert(events, units, typed);
+                    ++erased;
+                }
+                m_stats.keystrokesErased += erased;
+                if (erased == presses) {
+                    m_drop[i] = ERASED;
+                    continue;
+                }
+                if (erased) SetKeyRepeat(ev, presses - erased);
+                backspaceErased = false;
+                typed.clear(); // The rest deletes text from before the pause, or a key still held
+                continue;
+            }
+            typed.clear(); // Navigation, shortcuts, Enter, punctuation...: a barrier
+            afterBarrier = true;
+        }
+    }
+
+    void EraseLastInsert(std::vector<KeyEvent>& events, std::vector<Unit>& units, std::vector<size_t>& typed)
+    {
+        Unit& u = units[typed.back()];
+        size_t e = u.inserts.back();
+        size_t count = KeyDownCount(events[e]);
+        if (count > 1) {
+            SetKeyRepeat(events[e], count - 1);
+        }
+        else {
+            m_drop[e] = ERASED;
+            u.inserts.pop_back();
+        }
+        if (u.inserts.empty()) {
+            m_drop[u.up] = ERASED;
+            typed.pop_back();
+        }
+    }
+
+    void DropTaps(const std::vector<KeyEvent>& events)
+    {
+        bool down[256];
+        std::copy(m_downFirst, m_downFirst + 256, down);
+        size_t held = std::count(down, down + 256, true);
+        size_t pressed[256]; // The key-down that pressed each key, NONE if it was down already
+        std::fill(pressed, pressed + 256, NONE);
+        std::vector<size_t> kept;
+        for (size_t i = 0; i < events.size(); ++i) {
+            if (m_drop[i]) continue;
+            const KeyEvent& ev = events[i];
+            if (!Plain(ev)) {
+                kept.push_back(i);
+                continue;
+            }
+            if (!(ev.flags & KEY_UP)) {
+                if (!down[ev.vk]) {
+                    ++held;
+                    pressed[ev.vk] = i;
+                }
+                down[ev.vk] = true;
+                kept.push_back(i);
+                continue;
+            }
+            if (!down[ev.vk]) {
+                m_drop[i] = ERASED; // Released, never pressed: the target already has it up
+                ++m_stats.tapsDropped;
+                continue;
+            }
+            down[ev.vk] = false;
+            --held;
+            size_t press = pressed[ev.vk];
+            pressed[ev.vk] = NONE;
+            // Alone only: Alt+Shift and Ctrl+Shift switch the keyboard layout
+            if ((IsShiftVk(ev.vk) || IsCtrlVk(ev.vk)) && held == 0 && !kept.empty() && kept.back() == press) {
+                m_drop[press] = ERASED;
+                m_drop[i] = ERASED;
+                kept.pop_back();
+                m_stats.tapsDropped += 2;
+                continue;
+            }
+            kept.push_back(i);
+        }
+    }
+
+    void Compact(std::vector<KeyEvent>& events)
+    {
+        uint64_t cut = 0, prev = events.empty() ? 0 : events[0].timeNs;
+        size_t out = 0;
+        for (size_t i = 0; i < events.size(); ++i) {
+            uint64_t t = events[i].timeNs;
+            uint64_t gap = t > prev ? t - prev : 0;
+            prev = t;
+            if (m_drop[i] == ERASED) cut += gap;
+            if (m_drop[i]) continue;
+            KeyEvent ev = events[i];
+            ev.timeNs = t >= cut ? t - cut : 0;
+            events[out++] = ev;
+        }
+        events.resize(out);
+        m_stats.erasedNs = cut;
+    }
+
+    CaptureOptimizeOptions m_options;
+    CaptureOptimizeStats m_stats;
+    std::vector<uint8_t> m_drop;
+    bool m_downFirst[256] = {};
+};
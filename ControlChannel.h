@@ -0,0 +1,998 @@
+// =============================================================================
+// ControlChannel.h - Local control channel: pause, resume and query by script
+//
+// A running GamePauser listens on a named pipe (\\.\pipe\GamePauser) on
+// Windows or a Unix domain socket on Linux. Both are local only: the pipe
+// rejects remote clients and its DACL admits only our own account (and
+// SYSTEM), the socket is created mode 0600 in the user's
+// runtime directory (or a 0700 directory of ours under /tmp), and a peer
+// running as another user is hung up on. Requests and replies share one frame layout,
+// little-endian:
+//
+//   uint32 magic "GPC1" | uint16 op | uint16 status | uint32 id | uint32 length | payload
+//
+// A reply echoes the request's op and id. A connection carries any number of
+// requests and every client gets its own thread, so a script connects once and
+// then pays a couple of context switches per request (tens of microseconds).
+//
+// ControlDispatcher maps the ops onto a PauseController and ThrottleManager.
+// Status and metrics are answered straight from atomics on the client's
+// thread; commands that change state go through the host's executor (the
+// message thread on Windows), so they never interleave with a hotkey.
+// RunControlClient() is the `--ctl` command-line client. `trace` writes the
+// Tracing.h timeline; the other threads keep recording while it does.
+// =============================================================================
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "PauseController.h"
+#include "Throttle.h"
+#include "TextCompiler.h"
+#include "Tracing.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <sddl.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "advapi32.lib")
+#endif
+#else
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// -----------------------------------------------------------------------------
+// Wire format
+// -----------------------------------------------------------------------------
+const uint32_t CONTROL_MAGIC = 0x31435047; // "GPC1" in byte order
+const size_t CONTROL_HEADER_BYTES = 16;
+const uint32_t CONTROL_MAX_PAYLOAD = 1u << 20; // Replay text is the only large payload
+
+enum class ControlOp : uint16_t
+{
+    Ping = 1,
+    Status = 2, // -> key=value lines
+    Metrics = 3, // -> Prometheus text
+    Pause = 4, // Target
+    Resume = 5, // Target, or empty for whatever is paused
+    Throttle = 6, // Target
+    Unthrottle = 7, // Target
+    Text = 8, // UTF-8, queued into the current pause like a paste
+    Reload = 9, // Re-read the INI
+    Trace = 10, // Write the trace timeline to the file named, or empty for [Trace] TraceFile
+};
+
+enum class ControlStatus : uint16_t
+{
+    Ok = 0,
+    BadRequest = 1, // Unknown op or malformed payload
+    NotFound = 2, // No such process, or nothing paused
+    Ambiguous = 3, // A name matched several processes; the reply lists their PIDs
+    Refused = 4, // Not in the current state (e.g. reload while paused)
+    Failed = 5,
+    Unavailable = 6, // Feature off, shutting down, or the connection broke
+};
+
+static inline const char* ControlStatusName(ControlStatus status)
+{
+    switch (status) {
+    case ControlStatus::Ok: return "ok";
+    case ControlStatus::BadRequest: return "bad request";
+    case ControlStatus::NotFound: return "not found";
+    case ControlStatus::Ambiguous: return "ambiguous";
+    case ControlStatus::Refused: return "refused";
+    case ControlStatus::Failed: return "failed";
+    case ControlStatus::Unavailable: return "unavailable";
+    }
+    return "unknown";
+}
+
+struct ControlMessage
+{
+    uint16_t op = 0; // ControlOp, kept raw so an unknown op can still be answered
+    uint16_t status = 0; // ControlStatus, replies only
+    uint32_t id = 0;
+    std::string payload;
+};
+
+static inline void PutLe(unsigned char* p, uint32_t v, int bytes)
+{
+    for (int i = 0; i < bytes; ++i) p[i] = static_cast<unsigned char>(v >> (8 * i));
+}
+
+static inline uint32_t GetLe(const unsigned char* p, int bytes)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < bytes; ++i) v |= static_cast<uint32_t>(p[i]) << (8 * i);
+    return v;
+}
+
+static inline std::string EncodeControlMessage(const ControlMessage& m)
+{
+    std::string out(CONTROL_HEADER_BYTES + m.payload.size(), '\0');
+    unsigned char* p = reinterpret_cast<unsigned char*>(&out[0]);
+    PutLe(p, CONTROL_MAGIC, 4);
+    PutLe(p + 4, m.op, 2);
+    PutLe(p + 6, m.status, 2);
+    PutLe(p + 8, m.id, 4);
+    PutLe(p + 12, static_cast<uint32_t>(m.payload.size()), 4);
+    if (!m.payload.empty()) std::memcpy(p + CONTROL_HEADER_BYTES, m.payload.data(), m.payload.size());
+    return out;
+}
+
+// Target of pause/resume/throttle: uint32 PID, or 0 followed by an image name
+static inline std::string EncodeControlTarget(uint32_t pid, const std::string& name)
+{
+    std::string out(4, '\0');
+    PutLe(reinterpret_cast<unsigned char*>(&out[0]), pid, 4);
+    return pid ? out : out + name;
+}
+
+static inline bool DecodeControlTarget(const std::string& payload, uint32_t& pid, std::string& name)
+{
+    if (payload.size() < 4) return false;
+    pid = GetLe(reinterpret_cast<const unsigned char*>(payload.data()), 4);
+    name = payload.substr(4);
+    return pid != 0 || !name.empty();
+}
+
+// \\.\pipe\GamePauser, or gamepauser.sock in $XDG_RUNTIME_DIR (/tmp/gamepauser-<uid>/ without one)
+static inline std::string DefaultControlPath()
+{
+#ifdef _WIN32
+    return "\\\\.\\pipe\\GamePauser";
+#else
+    const char* dir = std::getenv("XDG_RUNTIME_DIR");
+    if (dir && *dir) return std::string(dir) + "/gamepauser.sock";
+    return "/tmp/gamepauser-" + std::to_string(getuid()) + "/gamepauser.sock";
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// One end of a connection: a pipe instance or a connected socket
+// -----------------------------------------------------------------------------
+class ControlStream
+{
+public:
+#ifdef _WIN32
+    typedef HANDLE Handle;
+    static Handle Invalid() { return INVALID_HANDLE_VALUE; }
+#else
+    typedef int Handle;
+    static Handle Invalid() { return -1; }
+#endif
+
+    explicit ControlStream(Handle h = Invalid()) : m_h(h) {}
+    ~ControlStream() { Close(); }
+    ControlStream(const ControlStream&) = delete;
+    ControlStream& operator=(const ControlStream&) = delete;
+
+    bool IsOpen() const { return m_h != Invalid(); }
+    void Reset(Handle h)
+    {
+        Close();
+        m_h = h;
+    }
+
+    // False on a closed connection or a frame that isn't ours (bad magic, oversized)
+    bool Read(ControlMessage& m)
+    {
+        unsigned char h[CONTROL_HEADER_BYTES];
+        if (!ReadAll(h, sizeof(h)) || GetLe(h, 4) != CONTROL_MAGIC) return false;
+        uint32_t length = GetLe(h + 12, 4);
+        if (length > CONTROL_MAX_PAYLOAD) return false;
+        m.op = static_cast<uint16_t>(GetLe(h + 4, 2));
+        m.status = static_cast<uint16_t>(GetLe(h + 6, 2));
+        m.id = GetLe(h + 8, 4);
+        m.payload.resize(length);
+        return length == 0 || ReadAll(&m.payload[0], length);
+    }
+
+    // Header and payload in one write
+    bool Write(const ControlMessage& m)
+    {
+        std::string frame = EncodeControlMessage(m);
+        return WriteAll(frame.data(), frame.size());
+    }
+
+    // Wakes a thread blocked in Read() on this stream; the stream is unusable afterwards
+    void Interrupt()
+    {
+        if (!IsOpen()) return;
+#ifdef _WIN32
+        CancelIoEx(m_h, nullptr);
+#else
+        shutdown(m_h, SHUT_RDWR);
+#endif
+    }
+
+    void Close()
+    {
+        if (!IsOpen()) return;
+#ifdef _WIN32
+        CloseHandle(m_h);
+#else
+        close(m_h);
+#endif
+        m_h = Invalid();
+    }
+
+private:
+    bool ReadAll(void* buf, size_t n)
+    {
+        char* p = static_cast<char*>(buf);
+        while (n) {
+#ifdef _WIN32
+            DWORD got = 0;
+            if (!ReadFile(m_h, p, static_cast<DWORD>(n), &got, nullptr) || got == 0) return false;
+#else
+            ssize_t got = recv(m_h, p, n, 0);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return false;
+#endif
+            p += got;
+            n -= static_cast<size_t>(got);
+        }
+        return true;
+    }
+
+    bool WriteAll(const void* buf, size_t n)
+    {
+        const char* p = static_cast<const char*>(buf);
+        while (n) {
+#ifdef _WIN32
+            DWORD put = 0;
+            if (!WriteFile(m_h, p, static_cast<DWORD>(n), &put, nullptr) || put == 0) return false;
+#else
+            ssize_t put = send(m_h, p, n, MSG_NOSIGNAL); // A vanished client is an error, not SIGPIPE
+            if (put < 0 && errno == EINTR) continue;
+            if (put <= 0) return false;
+#endif
+            p += put;
+            n -= static_cast<size_t>(put);
+        }
+        return true;
+    }
+
+    Handle m_h;
+};
+
+// -----------------------------------------------------------------------------
+// Server: an accept thread plus one thread per connected client
+// -----------------------------------------------------------------------------
+class ControlServer
+{
+public:
+    typedef std::function<ControlStatus(ControlOp op, const std::string& payload, std::string& reply)> Handler;
+    static const size_t MAX_CLIENTS = 32; // Further connections are closed straight away
+
+    ~ControlServer() { Stop(); }
+
+    // Fails if another instance already answers on path; a stale socket file is replaced
+    bool Start(const std::string& path, Handler handler, std::string* error = nullptr)
+    {
+        if (m_running) return true;
+        m_path = path;
+        m_handler = handler;
+        std::string why;
+        if (!Listen(why)) {
+            if (error) *error = why;
+            return false;
+        }
+        m_running = true;
+        m_acceptor = std::thread([this] { AcceptLoop(); });
+        return true;
+    }
+
+    void Stop()
+    {
+        if (!m_running.exchange(false)) return;
+        WakeAcceptor();
+        if (m_acceptor.joinable()) m_acceptor.join();
+#ifndef _WIN32
+        close(m_listen);
+        m_listen = -1;
+#endif
+        std::vector<std::unique_ptr<Client>> clients;
+        {
+            std::lock_guard<std::mutex> lock(m_clientsMutex);
+            clients.swap(m_clients);
+        }
+        for (auto& c : clients) {
+            // A client thread may not have reached its blocking read yet: keep poking until it leaves
+            for (int i = 0; i < 2000 && !c->done; ++i) {
+                c->stream.Interrupt();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            if (c->thread.joinable()) c->thread.join();
+        }
+#ifdef _WIN32
+        FreeSecurity();
+#else
+        unlink(m_path.c_str());
+#endif
+    }
+
+    bool Running() const { return m_running; }
+    const std::string& Path() const { return m_path; }
+    uint64_t Requests() const { return m_requests.load(std::memory_order_relaxed); }
+    // Connections hung up on because the peer runs as another user (Linux)
+    uint64_t Rejected() const { return m_rejected.load(std::memory_order_relaxed); }
+
+private:
+    struct Client
+    {
+        explicit Client(ControlStream::Handle h) : stream(h) {}
+        ControlStream stream;
+        std::thread thread;
+        std::atomic<bool> done{ false };
+    };
+
+#ifdef _WIN32
+    HANDLE CreateInstance(bool first)
+    {
+        SECURITY_ATTRIBUTES sa = { sizeof(sa), m_security, FALSE };
+        return CreateNamedPipeA(m_path.c_str(), PIPE_ACCESS_DUPLEX | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+            PIPE_UNLIMITED_INSTANCES, 65536, 65536, 0, &sa);
+    }
+
+    // Full access for the account we run as and SYSTEM, nobody else. The default
+    // DACL would also let Everyone and anonymous logons read the pipe.
+    bool BuildSecurity(std::string& error)
+    {
+        std::string sid;
+        HANDLE token = nullptr;
+        if (OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &token)) {
+            DWORD size = 0;
+            GetTokenInformation(token, TokenUser, nullptr, 0, &size);
+            std::vector<unsigned char> buf(size);
+            char* text = nullptr;
+            if (size && GetTokenInformation(token, TokenUser, buf.data(), size, &size)
+                && ConvertSidToStringSidA(reinterpret_cast<TOKEN_USER*>(buf.data())->User.Sid, &text)) {
+                sid = text;
+                LocalFree(text);
+            }
+            CloseHandle(token);
+        }
+        if (sid.empty()) {
+            error = "cannot read the current user's SID";
+            return false;
+        }
+        std::string sddl = "D:P(A;;GA;;;" + sid + ")(A;;GA;;;SY)";
+        if (!ConvertStringSecurityDescriptorToSecurityDescriptorA(sddl.c_str(), SDDL_REVISION_1, &m_security, nullptr)) {
+            error = "cannot build the pipe's security descriptor";
+            return false;
+        }
+        return true;
+    }
+
+    void FreeSecurity()
+    {
+        if (m_security) LocalFree(m_security);
+        m_security = nullptr;
+    }
+
+    bool Listen(std::string& error)
+    {
+        FreeSecurity();
+        if (!BuildSecurity(error)) return false;
+        // The first instance claims the name: if someone else holds it, it isn't us they'd talk to
+        m_pending = CreateInstance(true);
+        if (m_pending == INVALID_HANDLE_VALUE) {
+            error = GetLastError() == ERROR_ACCESS_DENIED ? m_path + " is already in use" : "could not create " + m_path;
+            FreeSecurity();
+            return false;
+        }
+        return true;
+    }
+
+    void WakeAcceptor()
+    {
+        HANDLE h = CreateFileA(m_path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (h != INVALID_HANDLE_VALUE) CloseHandle(h);
+    }
+
+    void AcceptLoop()
+    {
+        while (m_running) {
+            HANDLE h = m_pending != INVALID_HANDLE_VALUE ? m_pending : CreateInstance(false);
+            m_pending = INVALID_HANDLE_VALUE;
+            if (h == INVALID_HANDLE_VALUE) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            bool connected = ConnectNamedPipe(h, nullptr) || GetLastError() == ERROR_PIPE_CONNECTED;
+            if (!m_running || !connected) {
+                CloseHandle(h);
+                continue;
+            }
+            Adopt(h);
+        }
+    }
+#else
+    bool Listen(std::string& error)
+    {
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if (m_path.empty() || m_path.size() >= sizeof(addr.sun_path)) {
+            error = "socket path too long: " + m_path;
+            return false;
+        }
+        std::memcpy(addr.sun_path, m_path.c_str(), m_path.size() + 1);
+        if (!SecureDirectory(error)) return false;
+        // A socket file nobody answers on is left over from a crash; one that answers is another instance
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool live = probe >= 0 && connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+        if (probe >= 0) close(probe);
+        if (live) {
+            error = m_path + " is already in use";
+            return false;
+        }
+        unlink(m_path.c_str());
+        m_listen = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (m_listen < 0) {
+            error = std::strerror(errno);
+            return false;
+        }
+        mode_t mask = umask(0177); // Owner read/write only, from the moment the file exists
+        int rc = bind(m_listen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        umask(mask);
+        if (rc != 0 || listen(m_listen, 16) != 0) {
+            error = m_path + ": " + std::strerror(errno);
+            close(m_listen);
+            m_listen = -1;
+            return false;
+        }
+        return true;
+    }
+
+    // The socket's directory is created 0700 if missing. One that exists must be
+    // ours or root's, and writable by others only if sticky (like /tmp), so
+    // nobody else can swap the socket file out from under us.
+    bool SecureDirectory(std::string& error)
+    {
+        size_t slash = m_path.find_last_of('/');
+        std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : m_path.substr(0, slash);
+        if (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+            error = dir + ": " + std::strerror(errno);
+            return false;
+        }
+        struct stat st;
+        if (lstat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+            error = dir + " is not a directory";
+            return false;
+        }
+        if (st.st_uid != getuid() && st.st_uid != 0) {
+            error = dir + " belongs to another user";
+            return false;
+        }
+        if ((st.st_mode & 0022) && !(st.st_mode & S_ISVTX)) {
+            error = dir + " is writable by other users";
+            return false;
+        }
+        return true;
+    }
+
+    // The 0600 mode should keep other users out; this holds even if it doesn't
+    static bool SameUser(int fd)
+    {
+        ucred cred = {};
+        socklen_t len = sizeof(cred);
+        return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && cred.uid == getuid();
+    }
+
+    void WakeAcceptor()
+    {
+        shutdown(m_listen, SHUT_RDWR); // Unblocks accept()
+    }
+
+    void AcceptLoop()
+    {
+        while (m_running) {
+            int fd = accept4(m_listen, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (m_running && errno != EINTR) std::this_thread::sleep_for(std::chrono::milliseconds(10)); // EMFILE and friends
+                continue;
+            }
+            if (!SameUser(fd)) {
+                m_rejected.fetch_add(1, std::memory_order_relaxed);
+                close(fd);
+                continue;
+            }
+            Adopt(fd);
+        }
+    }
+#endif
+
+    void Adopt(ControlStream::Handle h)
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        for (auto it = m_clients.begin(); it != m_clients.end();) {
+            if (!(*it)->done) {
+                ++it;
+                continue;
+            }
+            (*it)->thread.join();
+            it = m_clients.erase(it);
+        }
+        std::unique_ptr<Client> c(new Client(h));
+        if (m_clients.size() >= MAX_CLIENTS) return; // Closed by c's destructor
+        Client* raw = c.get();
+        c->thread = std::thread([this, raw] { Serve(*raw); });
+        m_clients.push_back(std::move(c));
+    }
+
+    void Serve(Client& c)
+    {
+        ControlMessage request, reply;
+        while (m_running && c.stream.Read(request)) {
+            reply.op = request.op;
+            reply.id = request.id;
+            reply.payload.clear();
+            reply.status = static_cast<uint16_t>(m_handler(static_cast<ControlOp>(request.op), request.payload, reply.payload));
+            m_requests.fetch_add(1, std::memory_order_relaxed);
+            if (!c.stream.Write(reply)) break;
+        }
+        c.done = true;
+    }
+
+    std::string m_path;
+    Handler m_handler;
+    std::atomic<bool> m_running{ false };
+    std::atomic<uint64_t> m_requests{ 0 };
+    std::atomic<uint64_t> m_rejected{ 0 };
+    std::thread m_acceptor;
+    std::mutex m_clientsMutex;
+    std::vector<std::unique_ptr<Client>> m_clients;
+#ifdef _WIN32
+    HANDLE m_pending = INVALID_HANDLE_VALUE;
+    PSECURITY_DESCRIPTOR m_security = nullptr; // LocalAlloc'd by BuildSecurity()
+#else
+    int m_listen = -1;
+#endif
+};
+
+// -----------------------------------------------------------------------------
+// Client: one connection, one request in flight
+// -----------------------------------------------------------------------------
+class ControlClient
+{
+public:
+    bool Connect(const std::string& path, std::string* error = nullptr)
+    {
+        m_stream.Close();
+#ifdef _WIN32
+        for (int attempt = 0; attempt < 5; ++attempt) {
+            HANDLE h = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+            if (h != INVALID_HANDLE_VALUE) {
+                m_stream.Reset(h);
+                return true;
+            }
+            if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeA(path.c_str(), 1000)) break; // All instances busy: wait for one
+        }
+        if (error) *error = "nothing is listening on " + path;
+        return false;
+#else
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            if (error) *error = "socket path too long: " + path;
+            return false;
+        }
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            if (error) *error = "nothing is listening on " + path + " (" + std::strerror(errno) + ")";
+            if (fd >= 0) close(fd);
+            return false;
+        }
+        m_stream.Reset(fd);
+        return true;
+#endif
+    }
+
+    // False if the connection broke; status and reply then say so
+    bool Call(ControlOp op, const std::string& payload, ControlStatus& status, std::string& reply)
+    {
+        ControlMessage request, response;
+        request.op = static_cast<uint16_t>(op);
+        request.id = ++m_id;
+        request.payload = payload;
+        if (!m_stream.Write(request) || !m_stream.Read(response) || response.id != request.id) {
+            m_stream.Close();
+            status = ControlStatus::Unavailable;
+            reply = "connection to GamePauser lost";
+            return false;
+        }
+        status = static_cast<ControlStatus>(response.status);
+        reply.swap(response.payload);
+        return true;
+    }
+
+    void Close() { m_stream.Close(); }
+
+private:
+    ControlStream m_stream;
+    uint32_t m_id = 0;
+};
+
+// -----------------------------------------------------------------------------
+// Dispatcher: control ops -> PauseController / ThrottleManager
+// -----------------------------------------------------------------------------
+typedef std::function<ControlStatus(std::string& reply)> ControlCommand;
+
+struct ControlHost
+{
+    PauseController* controller = nullptr;
+    ThrottleManager* throttle = nullptr; // Optional
+    PauseMetrics* metrics = nullptr; // Optional: null = metrics are off
+    AsyncLogger* log = nullptr; // Optional
+    uint32_t selfPid = 0;
+    // Runs a state-changing command where the hotkeys are handled and waits for it.
+    // Null = run it on the calling thread, one command at a time.
+    std::function<ControlStatus(const ControlCommand& command, std::string& reply)> run;
+    // Replay text -> key events for the paused target. Null = US layout, default paste options.
+    std::function<TextProgram(const std::u32string& text)> compile;
+    ControlCommand reload; // Optional; runs through run like any other command
+    std::function<std::string()> traceFile; // Optional: [Trace] TraceFile, for a trace request that names no file
+};
+
+class ControlDispatcher
+{
+public:
+    explicit ControlDispatcher(const ControlHost& host) : m_host(host) {}
+
+    // ControlServer::Handler
+    ControlStatus Handle(ControlOp op, const std::string& payload, std::string& reply)
+    {
+        switch (op) {
+        case ControlOp::Ping:
+            return ControlStatus::Ok;
+        case ControlOp::Status:
+            reply = Status();
+            return ControlStatus::Ok;
+        case ControlOp::Metrics:
+            if (!m_host.metrics) {
+                reply = "metrics are off - set Metrics = 1 under [Metrics]";
+                return ControlStatus::Unavailable;
+            }
+            reply = m_host.metrics->RenderPrometheus();
+            return ControlStatus::Ok;
+        case ControlOp::Pause:
+        case ControlOp::Throttle:
+        case ControlOp::Unthrottle: {
+            uint32_t pid = 0;
+            std::string name;
+            ControlStatus found = ResolveTarget(payload, pid, name, reply);
+            if (found != ControlStatus::Ok) return found;
+            return Run([this, op, pid, name](std::string& out) { return Target(op, pid, name, out); }, reply);
+        }
+        case ControlOp::Resume: {
+            uint32_t pid = 0;
+            std::string name;
+            if (!payload.empty()) {
+                ControlStatus found = ResolveTarget(payload, pid, name, reply);
+                if (found != ControlStatus::Ok) return found;
+            }
+            return Run([this, pid](std::string& out) { return Resume(pid, out); }, reply);
+        }
+        case ControlOp::Text: {
+            std::u32string text = DecodeUtf8(payload);
+            if (text.empty()) {
+                reply = "no text";
+                return ControlStatus::BadRequest;
+            }
+            return Run([this, text](std::string& out) { return QueueText(text, out); }, reply);
+        }
+        case ControlOp::Reload:
+            if (!m_host.reload) {
+                reply = "this build has no config to reload";
+                return ControlStatus::Unavailable;
+            }
+            return Run(m_host.reload, reply);
+        case ControlOp::Trace:
+            if (!TraceEnabled()) {
+                reply = "tracing is off - set Trace = 1 under [Trace]";
+                return ControlStatus::Unavailable;
+            }
+            return Run([this, payload](std::string& out) { return Trace(payload, out); }, reply);
+        }
+        reply = "unknown op " + std::to_string(static_cast<unsigned>(op));
+        return ControlStatus::BadRequest;
+    }
+
+    // key=value lines from atomics and short locks only, so it never waits behind a replay
+    std::string Status()
+    {
+        PauseController& c = *m_host.controller;
+        std::string out = "pid=" + std::to_string(m_host.selfPid) + "\npaused=" + std::to_string(c.TargetPid())
+            + "\nreplaying=" + (c.Replaying() ? "1" : "0") + "\ncaptured=" + std::to_string(c.CapturedCount()) + "\nthrottled=";
+        if (m_host.throttle) {
+            std::vector<ThrottleStats> throttled = m_host.throttle->Stats();
+            for (size_t i = 0; i < throttled.size(); ++i) out += (i ? "," : "") + std::to_string(throttled[i].pid);
+        }
+        return out + "\n";
+    }
+
+    // A PID that exists, or the one running process with that image name
+    ControlStatus ResolveTarget(const std::string& payload, uint32_t& pid, std::string& name, std::string& reply)
+    {
+        if (!DecodeControlTarget(payload, pid, name)) {
+            reply = "expected a PID or a process name";
+            return ControlStatus::BadRequest;
+        }
+        if (pid) {
+            if (pid == m_host.selfPid) {
+                reply = "that is GamePauser itself";
+                return ControlStatus::Refused;
+            }
+            if (!ProcessStartTime(pid)) {
+                reply = "no process with PID " + std::to_string(pid);
+                return ControlStatus::NotFound;
+            }
+            return ControlStatus::Ok;
+        }
+        std::string key = ProfileKey(name);
+        std::vector<uint32_t> matches;
+        for (const ProcessInfo& p : ListProcesses()) {
+            if (p.pid != m_host.selfPid && p.name == key) matches.push_back(p.pid);
+        }
+        if (matches.empty()) {
+            reply = "no process named " + name;
+            return ControlStatus::NotFound;
+        }
+        if (matches.size() > 1) {
+            reply = std::to_string(matches.size()) + " processes named " + name + ", pick a PID:";
+            for (uint32_t m : matches) reply += " " + std::to_string(m);
+            return ControlStatus::Ambiguous;
+        }
+        pid = matches[0];
+        return ControlStatus::Ok;
+    }
+
+private:
+    ControlStatus Run(const ControlCommand& command, std::string& reply)
+    {
+        if (m_host.run) return m_host.run(command, reply);
+        std::lock_guard<std::mutex> lock(m_runMutex);
+        return command(reply);
+    }
+
+    static std::string Describe(uint32_t pid, const std::string& name)
+    {
+        return "PID " + std::to_string(pid) + (name.empty() ? "" : " (" + name + ")");
+    }
+
+    ControlStatus Target(ControlOp op, uint32_t pid, const std::string& name, std::string& out)
+    {
+        PauseController& c = *m_host.controller;
+        std::string who = Describe(pid, name);
+        if (op == ControlOp::Pause) {
+            if (c.TargetPid() == pid) {
+                out = who + " is already paused";
+                return ControlStatus::Ok;
+            }
+            if (c.Paused()) {
+                out = "PID " + std::to_string(c.TargetPid()) + " is paused - resume it first";
+                return ControlStatus::Refused;
+            }
+            Log("*** CONTROL: PAUSE *** - %s", who.c_str());
+            if (m_host.throttle) m_host.throttle->Release(pid); // A hard pause takes over from throttling
+            c.OnHotkey(pid);
+            out = "paused " + who;
+            return ControlStatus::Ok;
+        }
+        if (!m_host.throttle) {
+            out = "throttling is not available here";
+            return ControlStatus::Unavailable;
+        }
+        if (op == ControlOp::Unthrottle) {
+            if (!m_host.throttle->Release(pid)) {
+                out = who + " is not throttled";
+                return ControlStatus::NotFound;
+            }
+            out = "released " + who;
+            return ControlStatus::Ok;
+        }
+        if (c.TargetPid() == pid) {
+            out = who + " is paused - resume it before throttling";
+            return ControlStatus::Refused;
+        }
+        if (m_host.throttle->Throttled(pid)) {
+            out = who + " is already throttled";
+            return ControlStatus::Ok;
+        }
+        Log("*** CONTROL: THROTTLE *** - %s", who.c_str());
+        if (!m_host.throttle->Toggle(pid)) {
+            out = "could not throttle " + who;
+            return ControlStatus::Failed;
+        }
+        out = "throttled " + who;
+        return ControlStatus::Ok;
+    }
+
+    ControlStatus Resume(uint32_t pid, std::string& out)
+    {
+        PauseController& c = *m_host.controller;
+        uint32_t target = c.TargetPid();
+        if (!target || (pid && pid != target)) {
+            out = target ? "PID " + std::to_string(pid) + " is not paused (PID " + std::to_string(target) + " is)" : "nothing is paused";
+            return ControlStatus::NotFound;
+        }
+        Log("*** CONTROL: RESUME *** - PID %u", target);
+        c.OnHotkey(target);
+        const ReplayStats& r = c.LastReplay();
+        char buf[128];
+        std::snprintf(buf, sizeof(buf), "resumed PID %u, replayed %zu events in %.1f ms", target, r.events, r.durationNs / 1e6);
+        out = buf;
+        return ControlStatus::Ok;
+    }
+
+    ControlStatus QueueText(const std::u32string& text, std::string& out)
+    {
+        PauseController& c = *m_host.controller;
+        if (!c.Paused()) {
+            out = "nothing is paused - text is queued into a pause";
+            return ControlStatus::Refused;
+        }
+        TextProgram program = m_host.compile ? m_host.compile(text) : TextCompiler(UsKeyLayout(), TextCompileOptions()).Compile(text);
+        size_t queued = c.QueuePaste(program);
+        Log("*** CONTROL: TEXT QUEUED *** - %zu characters (%zu key events)", program.chars, queued);
+        out = "queued " + std::to_string(program.chars) + " characters (" + std::to_string(queued) + " key events)";
+        return queued ? ControlStatus::Ok : ControlStatus::Failed;
+    }
+
+    // Through Run, so the configured file is read on the thread that reloads it
+    ControlStatus Trace(const std::string& file, std::string& out)
+    {
+        std::string path = !file.empty() ? file : m_host.traceFile ? m_host.traceFile() : "";
+        if (path.empty()) {
+            out = "no trace file - name one or set TraceFile under [Trace]";
+            return ControlStatus::BadRequest;
+        }
+        TraceDumpStats stats;
+        std::string error;
+        if (!Tracer::Instance().Dump(path, &stats, &error)) {
+            out = error;
+            return ControlStatus::Failed;
+        }
+        out = FormatTraceDump(path, stats);
+        Log("*** CONTROL: TRACE WRITTEN *** - %s", out.c_str());
+        return ControlStatus::Ok;
+    }
+
+    template <typename... Args>
+    void Log(const char* fmt, Args... args)
+    {
+        if (m_host.log) m_host.log->PushF(fmt, args...);
+    }
+
+    ControlHost m_host;
+    std::mutex m_runMutex;
+};
+
+// -----------------------------------------------------------------------------
+// Client mode: GamePauser --ctl [--path <pipe or socket>] <command>
+// -----------------------------------------------------------------------------
+static inline int ControlUsage()
+{
+    std::printf("Usage: --ctl [--path <pipe or socket>] <command>\n"
+                "  ping [count]            round-trip time\n"
+                "  status                  paused PID, replay in progress, queued keys, throttled PIDs\n"
+                "  metrics                 Prometheus text\n"
+                "  pause <pid|name>\n"
+                "  resume [pid|name]       resume and replay\n"
+                "  throttle <pid|name>\n"
+                "  unthrottle <pid|name>\n"
+                "  text <text...>          queue text into the current pause (- reads stdin)\n"
+                "  reload                  re-read the INI\n"
+                "  trace [file]            write the trace timeline (Chrome/Perfetto JSON)\n");
+    return 2;
+}
+
+static inline std::string ControlTargetArg(const char* arg)
+{
+    std::string s = arg;
+    bool digits = !s.empty() && s.find_first_not_of("0123456789") == std::string::npos;
+    return digits ? EncodeControlTarget(static_cast<uint32_t>(std::strtoul(arg, nullptr, 10)), "") : EncodeControlTarget(0, s);
+}
+
+// A relative file is meant from the client's working directory, not the server's
+static inline std::string ControlAbsolutePath(const std::string& path)
+{
+#ifdef _WIN32
+    char full[MAX_PATH];
+    DWORD n = GetFullPathNameA(path.c_str(), MAX_PATH, full, nullptr);
+    return n && n < MAX_PATH ? std::string(full) : path;
+#else
+    char cwd[4096];
+    if (path.empty() || path[0] == '/' || !getcwd(cwd, sizeof(cwd))) return path;
+    return std::string(cwd) + "/" + path;
+#endif
+}
+
+static inline int RunControlClient(int argc, char** args)
+{
+    std::string path = DefaultControlPath();
+    if (argc >= 2 && std::string(args[0]) == "--path") {
+        path = args[1];
+        args += 2;
+        argc -= 2;
+    }
+    if (argc < 1) return ControlUsage();
+    std::string cmd = args[0], payload;
+    ControlOp op;
+    if (cmd == "ping") op = ControlOp::Ping;
+    else if (cmd == "status") op = ControlOp::Status;
+    else if (cmd == "metrics") op = ControlOp::Metrics;
+    else if (cmd == "reload") op = ControlOp::Reload;
+    else if (cmd == "trace") op = ControlOp::Trace;
+    else if (cmd == "resume") op = ControlOp::Resume;
+    else if (cmd == "pause" && argc > 1) op = ControlOp::Pause;
+    else if (cmd == "throttle" && argc > 1) op = ControlOp::Throttle;
+    else if (cmd == "unthrottle" && argc > 1) op = ControlOp::Unthrottle;
+    else if (cmd == "text" && argc > 1) op = ControlOp::Text;
+    else return ControlUsage();
+    if (op == ControlOp::Text) {
+        if (std::string(args[1]) == "-") {
+            payload.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+        }
+        else {
+            for (int i = 1; i < argc; ++i) payload += (i > 1 ? " " : "") + std::string(args[i]);
+        }
+    }
+    else if (op == ControlOp::Trace) {
+        if (argc > 1) payload = ControlAbsolutePath(args[1]);
+    }
+    else if (argc > 1 && op != ControlOp::Ping) {
+        payload = ControlTargetArg(args[1]);
+    }
+    ControlClient client;
+    std::string error;
+    if (!client.Connect(path, &error)) {
+        std::fprintf(stderr, "%s - is GamePauser running with Control = 1?\n", error.c_str());
+        return 1;
+    }
+    ControlStatus status;
+    std::string reply;
+    if (op == ControlOp::Ping) {
+        int count = argc > 1 ? std::max(1, std::atoi(args[1])) : 1;
+        std::vector<uint64_t> rtt;
+        for (int i = 0; i < count; ++i) {
+            uint64_t t0 = MonotonicNs();
+            if (!client.Call(op, payload, status, reply)) break;
+            rtt.push_back(MonotonicNs() - t0);
+        }
+        if (rtt.empty()) {
+            std::fprintf(stderr, "%s\n", reply.c_str());
+            return 1;
+        }
+        std::sort(rtt.begin(), rtt.end());
+        std::printf("%zu round trips: p50 %.1f us, p99 %.1f us, max %.1f us\n", rtt.size(), rtt[rtt.size() / 2] / 1e3,
+            rtt[std::min(rtt.size() - 1, rtt.size() * 99 / 100)] / 1e3, rtt.back() / 1e3);
+        return 0;
+    }
+    client.Call(op, payload, status, reply);
+    if (status != ControlStatus::Ok) {
+        std::fprintf(stderr, "%s: %s\n", ControlStatusName(status), reply.c_str());
+        return 1;
+    }
+    if (!reply.empty()) std::printf("%s%s", reply.c_str(), reply.back() == '\n' ? "" : "\n");
+    return 0;
+}
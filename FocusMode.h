@@ -0,0 +1,296 @@
+// =============================================================================
+// FocusMode.h - Freeze background processes while a listed game has focus
+//
+// Frame-time spikes often come from a browser tab, an updater or an indexer
+// waking up, not from the game. While a window of one of the [Focus] games is
+// foreground, every running process matching the background list is frozen
+// with the same group freezer a pause uses; when the game loses focus or
+// exits they are thawed. Names and patterns are lowercase image names with
+// `*` and `?` wildcards ("discord*.exe", "*updater*").
+//
+// The caller delivers the events (a foreground-change hook on Windows, a
+// harness on Linux); this class only matches and freezes. CPU reclaimed is an
+// estimate: each process's CPU rate since it was last seen running, times
+// how long it stayed frozen, minus what it still managed to use.
+// =============================================================================
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "RetroLog.h"
+#include "ProcessTree.h"
+#include "ResumeStrategy.h"
+
+// Glob match, `*` = any run, `?` = any one character. Both sides lowercase.
+static inline bool MatchImagePattern(const std::string& pattern, const std::string& name)
+{
+    size_t p = 0, n = 0, star = std::string::npos, mark = 0;
+    while (n < name.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+            ++p;
+            ++n;
+        }
+        else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            mark = n;
+        }
+        else if (star != std::string::npos) {
+            p = star + 1;
+            n = ++mark;
+        }
+        else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') ++p;
+    return p == pattern.size();
+}
+
+static inline bool MatchAnyImage(const std::vector<std::string>& patterns, const std::string& name)
+{
+    for (const std::string& p : patterns) {
+        if (MatchImagePattern(p, name)) return true;
+    }
+    return false;
+}
+
+// "Chrome.exe, Discord*.exe" -> { "chrome.exe", "discord*.exe" }
+static inline std::vector<std::string> ParseImageList(const std::string& csv)
+{
+    std::vector<std::string> out;
+    std::stringstream list(csv);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        item.erase(0, item.find_first_not_of(" \t"));
+        item.erase(item.find_last_not_of(" \t\r") + 1);
+        if (!item.empty()) out.push_back(ToLowerAscii(item));
+    }
+    return out;
+}
+
+struct FocusOptions
+{
+    std::vector<std::string> games; // Image names/patterns that turn focus mode on while foreground
+    std::vector<std::string> background; // Image names/patterns frozen meanwhile
+    bool Enabled() const { return !games.empty() && !background.empty(); }
+};
+
+struct FocusSession
+{
+    std::string game;
+    uint32_t gamePid = 0;
+    size_t frozen = 0; // Processes frozen
+    size_t failed = 0; // Matched but could not be frozen
+    size_t estimated = 0; // Frozen processes with a CPU baseline (the rest count as 0 reclaimed)
+    int64_t durationNs = 0;
+    int64_t reclaimedNs = 0; // Estimated background CPU time the game didn't have to share
+    int64_t leakedNs = 0; // CPU the frozen processes still used (threads born mid-freeze)
+};
+
+class FocusMode
+{
+public:
+    typedef std::function<std::vector<ProcessInfo>()> ProcessLister;
+    typedef std::function<bool(uint32_t pid)> SkipFilter;
+    static const int64_t MIN_BASELINE_NS = 1000000000; // Shorter baselines say too little about a rate
+
+    // lister: the process list to match against (ListProcesses when unset)
+    FocusMode(const FocusOptions& options, uint32_t selfPid, AsyncLogger* log = nullptr, const ProcessLister& lister = ProcessLister())
+        : m_options(options), m_selfPid(selfPid), m_log(log), m_lister(lister ? lister : ProcessLister(ListProcesses))
+    {
+        if (m_options.Enabled()) Sample(m_lister());
+    }
+    ~FocusMode() { Stop(); }
+    FocusMode(const FocusMode&) = delete;
+    FocusMode& operator=(const FocusMode&) = delete;
+
+    // Processes to leave alone even if they match (paused or throttled elsewhere)
+    void SetSkip(const SkipFilter& skip)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_skip = skip;
+    }
+
+    // Ends any session, then applies the new lists
+    void SetOptions(const FocusOptions& options)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        End("settings changed");
+        m_options = options;
+        m_baseline.clear();
+        if (m_options.Enabled()) Sample(m_lister());
+    }
+
+    // A window of pid came to the foreground. Starts a session for a listed game,
+    // ends one for anything else. Returns true if this started a session.
+    bool OnForeground(uint32_t pid)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_options.Enabled() || (m_session.gamePid && pid == m_session.gamePid)) return false;
+        std::vector<ProcessInfo> procs = m_lister();
+        std::string name;
+        for (const ProcessInfo& p : procs) {
+            if (p.pid == pid) name = p.name;
+        }
+        bool game = pid && pid != m_selfPid && !name.empty() && MatchAnyImage(m_options.games, name);
+        End(game ? "another game took focus" : "game lost focus");
+        if (!game) return false;
+        Begin(pid, name, procs);
+        return true;
+    }
+
+    // The game exited
+    void OnExit(uint32_t pid)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (pid && pid == m_session.gamePid) End("game exited");
+    }
+
+    // Thaws whatever is frozen; safe to call more than once (exit and crash paths)
+    void Stop()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        End("shutting down");
+    }
+
+    bool Active()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_session.gamePid != 0;
+    }
+    uint32_t GamePid()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_session.gamePid;
+    }
+    std::vector<uint32_t> FrozenPids()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_group.Pids();
+    }
+    FocusSession LastSession()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_last;
+    }
+
+private:
+    struct Baseline
+    {
+        uint64_t startTime = 0; // ProcessStartTime - guards against PID reuse
+        uint64_t cpuNs = 0;
+        int64_t atNs = 0;
+    };
+    struct Frozen
+    {
+        uint32_t pid = 0;
+        uint64_t cpuNs = 0; // At the freeze
+        double rate = -1; // CPU ns per ns before the freeze, -1 = no baseline
+    };
+
+    template <typename... Args>
+    void Log(const char* fmt, Args... args)
+    {
+        if (m_log) m_log->PushF(fmt, args...);
+    }
+
+    // CPU baseline of every background match, for the next session's estimate
+    void Sample(const std::vector<ProcessInfo>& procs)
+    {
+        int64_t now = FreezerNowNs();
+        for (const ProcessInfo& p : procs) {
+            if (!MatchAnyImage(m_options.background, p.name)) continue;
+            Baseline b;
+            b.startTime = ProcessStartTime(p.pid);
+            b.cpuNs = ProcessCpuNs(p.pid);
+            b.atNs = now;
+            m_baseline[p.pid] = b;
+        }
+    }
+
+    void Begin(uint32_t pid, const std::string& name, const std::vector<ProcessInfo>& procs)
+    {
+        // Never the game, its own helpers, ourselves, or anything another game pattern names
+        std::vector<uint32_t> exclude = { pid, m_selfPid };
+        for (const auto& d : FindDescendants(procs, pid)) exclude.push_back(d.first);
+        std::vector<PauseMember> members;
+        for (const ProcessInfo& p : procs) {
+            if (!MatchAnyImage(m_options.background, p.name) || MatchAnyImage(m_options.games, p.name)) continue;
+            if (std::find(exclude.begin(), exclude.end(), p.pid) != exclude.end() || (m_skip && m_skip(p.pid))) continue;
+            PauseMember m;
+            m.pid = p.pid;
+            m.name = p.name;
+            members.push_back(m);
+        }
+        m_session = FocusSession();
+        m_session.game = name;
+        m_session.gamePid = pid;
+        m_frozen.clear();
+        int64_t now = FreezerNowNs();
+        for (const PauseMember& m : members) {
+            Frozen f;
+            f.pid = m.pid;
+            f.cpuNs = ProcessCpuNs(m.pid);
+            auto b = m_baseline.find(m.pid);
+            if (b != m_baseline.end() && b->second.startTime == ProcessStartTime(m.pid) && now - b->second.atNs >= MIN_BASELINE_NS && f.cpuNs >= b->second.cpuNs)
+                f.rate = static_cast<double>(f.cpuNs - b->second.cpuNs) / static_cast<double>(now - b->second.atNs);
+            m_frozen.push_back(f);
+        }
+        std::vector<MemberResult> results = m_group.Freeze(members, GroupOrder::ChildrenFirst);
+        std::string names;
+        for (const MemberResult& r : results) {
+            if (!r.result.ok) {
+                ++m_session.failed;
+                Log("WARNING: Focus mode could not freeze %s PID %u", r.name.c_str(), r.pid);
+                continue;
+            }
+            ++m_session.frozen;
+            if (names.size() < 200) names += (names.empty() ? "" : ", ") + r.name;
+        }
+        m_startNs = FreezerNowNs();
+        Log("*** FOCUS MODE ON *** %s PID %u - %zu background processes frozen%s%s", name.c_str(), pid, m_session.frozen,
+            names.empty() ? "" : ": ", names.c_str());
+    }
+
+    void End(const char* why)
+    {
+        if (!m_session.gamePid) return;
+        std::vector<uint32_t> frozen = m_group.Pids();
+        m_group.Thaw();
+        int64_t now = FreezerNowNs();
+        m_session.durationNs = now - m_startNs;
+        for (const Frozen& f : m_frozen) {
+            if (std::find(frozen.begin(), frozen.end(), f.pid) == frozen.end()) continue;
+            uint64_t cpu = ProcessCpuNs(f.pid);
+            int64_t used = cpu > f.cpuNs ? static_cast<int64_t>(cpu - f.cpuNs) : 0;
+            m_session.leakedNs += used;
+            if (f.rate < 0) continue;
+            ++m_session.estimated;
+            m_session.reclaimedNs += std::max<int64_t>(0, static_cast<int64_t>(f.rate * m_session.durationNs) - used);
+        }
+        Log("*** FOCUS MODE OFF *** %s (%s) - %zu processes thawed after %.1f s, ~%.2f s CPU reclaimed (%zu with a baseline)",
+            m_session.game.c_str(), why, m_session.frozen, m_session.durationNs / 1e9, m_session.reclaimedNs / 1e9, m_session.estimated);
+        m_last = m_session;
+        m_session = FocusSession();
+        m_frozen.clear();
+        Sample(m_lister()); // Fresh baselines: the next estimate starts from now
+    }
+
+    FocusOptions m_options;
+    uint32_t m_selfPid;
+    AsyncLogger* m_log;
+    ProcessLister m_lister;
+    SkipFilter m_skip;
+    std::mutex m_mutex;
+    ProcessGroupFreezer m_group;
+    FocusSession m_session; // gamePid 0 = no session
+    FocusSession m_last;
+    std::vector<Frozen> m_frozen;
+    std::map<uint32_t, Baseline> m_baseline;
+    int64_t m_startNs = 0;
+};
@@ -0,0 +1,617 @@
+// =============================================================================
+// FreezeJournal.h - Write-ahead record of every freeze, for crash recovery
+//
+// GamePauser's exit paths all resume what they froze, but kill -9, End Task
+// or a crash past the exception filter skip them and the game stays frozen
+// until reboot. So before any freezer suspends anything it writes what it is
+// about to do into a small memory-mapped file:
+//   FreezeJournalHeader    64 bytes: magic, version, geometry, owner, and the
+//                          last watchdog recovery for the next instance to log
+//   FreezeJournalSlot[n]   one per frozen process: pid, process start time,
+//                          thread ids with the suspends we added to each
+// Stores to a shared mapping outlive the process that made them, so the file
+// is as current as the freezes themselves without a single flush. A slot is
+// freed once everything in it has been resumed.
+//
+// The owner holds an exclusive lock on the file while it runs, and the OS drops
+// that lock when the process dies, however it dies. Whoever gets the lock next -
+// the next instance at startup, or the watchdog process the owner started,
+// which sits blocked on it - resumes every live slot: ResumeThread as many
+// times as journaled on Windows, SIGCONT on Linux. A slot whose process start
+// time no longer matches belongs to a reused PID and is left alone. Only what
+// was journaled is resumed: a thread suspended after every slot was full may as
+// well have been suspended by the game, a debugger or anti-cheat, so it is
+// counted and reported instead.
+//
+// Beginning a slot is plain stores into the mapping. The start time - a read of
+// /proc/<pid>/stat that can stall behind a busy target's threads - is taken
+// once the target is frozen; a slot that crashed before then has none and is
+// resumed if its process is still alive.
+//
+// The same records let a crash handler in the owner undo its own freezes with
+// ThawOwn(), which takes no lock and allocates nothing. With the journal off,
+// OpenPrivate() keeps them in plain memory for that alone.
+// =============================================================================
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include "RetroLog.h"
+#include "ProcessFreezer.h"
+#include "ProcessTree.h"
+
+const uint32_t FREEZE_JOURNAL_VERSION = 1;
+const uint32_t FREEZE_JOURNAL_SLOTS = 128; // Processes frozen at once (focus mode can freeze dozens)
+const uint32_t FREEZE_JOURNAL_THREADS = 512; // Threads per slot; a process with more continues in another slot
+static const char FREEZE_JOURNAL_MAGIC[8] = { 'G', 'P', 'J', 'O', 'U', 'R', 'N', 'L' };
+
+struct FreezeJournalHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t slots;
+    uint32_t threadsPerSlot;
+    uint32_t ownerPid;
+    uint64_t ownerStart; // ProcessStartTime of the owner
+    // Left by a watchdog for the next instance to report; recoveredBy 0 = nothing to report
+    int64_t recoveredAtNs; // system_clock, nanoseconds since epoch
+    uint32_t recoveredBy;
+    uint32_t recoveredProcesses;
+    uint32_t recoveredThreads;
+    uint32_t recoveredSkipped;
+    uint32_t recoveredUnjournaled;
+    uint32_t reserved;
+};
+static_assert(sizeof(FreezeJournalHeader) == 64, "FreezeJournalHeader is part of the file format");
+
+struct FreezeJournalThread
+{
+    uint32_t tid;
+    uint32_t suspends; // Added by us and not yet taken back
+};
+
+struct FreezeJournalSlot
+{
+    std::atomic<uint32_t> state; // FREE / CLAIMED (being filled in, nothing suspended yet) / LIVE
+    uint32_t pid;
+    uint64_t startTime; // ProcessStartTime once frozen - the PID reuse guard; 0 = not taken yet
+    std::atomic<uint32_t> count; // Valid entries in threads[]
+    uint32_t dropped; // Threads suspended with threads[] full and no slot to continue in
+    uint32_t next; // Slot + 1 holding the threads after these, 0 = none
+    uint32_t continues; // 1 = continues another slot's threads (same process)
+    uint64_t reserved[4];
+    FreezeJournalThread threads[FREEZE_JOURNAL_THREADS];
+};
+static_assert(sizeof(std::atomic<uint32_t>) == 4, "Journal slots are shared between processes");
+static_assert(sizeof(FreezeJournalSlot) == 64 + 8 * FREEZE_JOURNAL_THREADS, "FreezeJournalSlot is part of the file format");
+
+struct FreezeRecovery
+{
+    size_t processes = 0; // Resumed
+    size_t threads = 0; // Resumed (Linux: journaled threads of the processes sent SIGCONT)
+    size_t skipped = 0; // PID now belongs to a different process
+    size_t gone = 0; // Process exited while frozen
+    size_t unjournaled = 0; // Windows: suspended without a journal entry, so left suspended
+    int64_t elapsedNs = 0;
+};
+
+class FreezeJournal : public FreezeRecorder
+{
+public:
+    static const uint32_t SLOT_FREE = 0, SLOT_CLAIMED = 1, SLOT_LIVE = 2;
+
+    FreezeJournal() {}
+    ~FreezeJournal() override { Close(); }
+    FreezeJournal(const FreezeJournal&) = delete;
+    FreezeJournal& operator=(const FreezeJournal&) = delete;
+
+    static size_t FileSize() { return sizeof(FreezeJournalHeader) + FREEZE_JOURNAL_SLOTS * sizeof(FreezeJournalSlot); }
+
+    // Creates or maps path and takes the owner lock. waitMs: how long to wait for the
+    // lock, -1 = until whoever holds it exits (the watchdog). A file that isn't a
+    // journal of this version is reset.
+    bool Open(const std::string& path, int waitMs, std::string* error = nullptr)
+    {
+        Close();
+        const size_t size = FileSize();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return Fail(error, "could not open " + path);
+        m_file = file;
+        if (!Lock(waitMs)) {
+            Close();
+            return Fail(error, "another GamePauser holds " + path);
+        }
+        LARGE_INTEGER current = {};
+        if (!GetFileSizeEx(m_file, &current) || current.QuadPart < static_cast<LONGLONG>(size)) {
+            LARGE_INTEGER end;
+            end.QuadPart = static_cast<LONGLONG>(size);
+            if (!SetFilePointerEx(m_file, end, nullptr, FILE_BEGIN) || !SetEndOfFile(m_file)) {
+                Close();
+                return Fail(error, "could not size " + path);
+            }
+        }
+        HANDLE mapping = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(size), nullptr);
+        if (mapping) {
+            m_base = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size));
+            CloseHandle(mapping); // The view keeps the mapping alive
+        }
+#else
+        m_fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | O_NOFOLLOW, 0600);
+        if (m_fd < 0) return Fail(error, "could not open " + path + ": " + std::strerror(errno));
+        if (!Lock(waitMs)) {
+            Close();
+            return Fail(error, "another GamePauser holds " + path);
+        }
+        struct stat st;
+        if (fstat(m_fd, &st) != 0 || (static_cast<size_t>(st.st_size) < size && ftruncate(m_fd, static_cast<off_t>(size)) != 0)) {
+            Close();
+            return Fail(error, "could not size " + path);
+        }
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (p != MAP_FAILED) m_base = static_cast<uint8_t*>(p);
+#endif
+        if (!m_base) {
+            Close();
+            return Fail(error, "could not map " + path);
+        }
+        FreezeJournalHeader* h = Header();
+        if (std::memcmp(h->magic, FREEZE_JOURNAL_MAGIC, sizeof(h->magic)) != 0 || h->version != FREEZE_JOURNAL_VERSION
+            || h->slots != FREEZE_JOURNAL_SLOTS || h->threadsPerSlot != FREEZE_JOURNAL_THREADS) {
+            std::memset(m_base, 0, size);
+            h->version = FREEZE_JOURNAL_VERSION;
+            h->slots = FREEZE_JOURNAL_SLOTS;
+            h->threadsPerSlot = FREEZE_JOURNAL_THREADS;
+            std::memcpy(h->magic, FREEZE_JOURNAL_MAGIC, sizeof(h->magic)); // Last: a torn reset reads as "not a journal"
+        }
+#ifdef _WIN32
+        h->ownerPid = GetCurrentProcessId();
+#else
+        h->ownerPid = static_cast<uint32_t>(getpid());
+#endif
+        h->ownerStart = ProcessStartTime(h->ownerPid);
+        m_path = path;
+        return true;
+    }
+
+    // Journal = 0: the same records in private memory, for ThawOwn() only - a
+    // killed process takes them with it
+    bool OpenPrivate()
+    {
+        Close();
+#ifdef _WIN32
+        m_base = static_cast<uint8_t*>(VirtualAlloc(nullptr, FileSize(), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+#else
+        void* p = mmap(nullptr, FileSize(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p != MAP_FAILED) m_base = static_cast<uint8_t*>(p);
+#endif
+        m_private = m_base != nullptr;
+        return m_private; // Zero-filled: every slot starts free
+    }
+
+    void Close()
+    {
+        if (ActiveFreezeRecorder().load() == this) ActiveFreezeRecorder().store(nullptr);
+#ifdef _WIN32
+        if (m_base && m_private) VirtualFree(m_base, 0, MEM_RELEASE);
+        else if (m_base) UnmapViewOfFile(m_base);
+        if (m_file) CloseHandle(m_file); // Drops the lock
+        m_file = nullptr;
+#else
+        if (m_base) munmap(m_base, FileSize());
+        if (m_fd >= 0) close(m_fd); // Drops the lock
+        m_fd = -1;
+#endif
+        m_base = nullptr;
+        m_private = false;
+    }
+
+    bool IsOpen() const { return m_base != nullptr; }
+    const std::string& Path() const { return m_path; }
+
+    // Resumes everything a dead owner left frozen and frees every slot. Call right
+    // after Open(), before this process freezes anything itself.
+    FreezeRecovery Recover()
+    {
+        FreezeRecovery r;
+        int64_t t0 = FreezerNowNs();
+        for (uint32_t i = 0; m_base && i < FREEZE_JOURNAL_SLOTS; ++i) {
+            FreezeJournalSlot& s = Slot(static_cast<int>(i));
+            uint32_t state = s.state.load(std::memory_order_acquire);
+            if (state == SLOT_LIVE) RecoverSlot(s, r);
+            if (state != SLOT_FREE) s.state.store(SLOT_FREE, std::memory_order_release);
+        }
+        r.elapsedNs = FreezerNowNs() - t0;
+        return r;
+    }
+
+    // For a crash handler in the owner: resumes what this process journaled and
+    // frees the slots. No lock, allocation or wait, so it is safe while other
+    // threads are stopped holding anything. Freezers still running meanwhile are
+    // not stopped. Returns the threads resumed.
+    size_t ThawOwn()
+    {
+        size_t n = 0;
+        for (uint32_t i = 0; m_base && i < FREEZE_JOURNAL_SLOTS; ++i) {
+            FreezeJournalSlot& s = Slot(static_cast<int>(i));
+            if (s.state.load(std::memory_order_acquire) != SLOT_LIVE) continue; // CLAIMED: nothing suspended yet
+#ifdef _WIN32
+            n += ResumeJournaled(s); // The freezer's process handle keeps the PID from being reused
+#else
+            uint32_t count = std::min(s.count.load(std::memory_order_acquire), FREEZE_JOURNAL_THREADS);
+            if (kill(static_cast<pid_t>(s.pid), SIGCONT) == 0) n += count;
+#endif
+            s.state.store(SLOT_FREE, std::memory_order_release);
+        }
+        return n;
+    }
+
+    // Slots in use right now
+    size_t LiveSlots()
+    {
+        size_t n = 0;
+        for (uint32_t i = 0; m_base && i < FREEZE_JOURNAL_SLOTS; ++i) {
+            if (Slot(static_cast<int>(i)).state.load(std::memory_order_acquire) != SLOT_FREE) ++n;
+        }
+        return n;
+    }
+
+    // For tests and diagnostics; slot as returned by Begin()
+    FreezeJournalSlot& Slot(int slot) { return reinterpret_cast<FreezeJournalSlot*>(m_base + sizeof(FreezeJournalHeader))[slot]; }
+
+    // The watchdog's note for the next instance
+    void LeaveReport(const FreezeRecovery& r)
+    {
+        FreezeJournalHeader* h = Header();
+        h->recoveredAtNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        h->recoveredProcesses = static_cast<uint32_t>(r.processes);
+        h->recoveredThreads = static_cast<uint32_t>(r.threads);
+        h->recoveredSkipped = static_cast<uint32_t>(r.skipped);
+        h->recoveredUnjournaled = static_cast<uint32_t>(r.unjournaled);
+        h->recoveredBy = h->ownerPid;
+    }
+    // Returns false if there is no note; clears it either way. atNs: system_clock.
+    bool TakeReport(FreezeRecovery& r, int64_t& atNs, uint32_t& by)
+    {
+        FreezeJournalHeader* h = Header();
+        if (!m_base || !h->recoveredBy) return false;
+        r = FreezeRecovery();
+        r.processes = h->recoveredProcesses;
+        r.threads = h->recoveredThreads;
+        r.skipped = h->recoveredSkipped;
+        r.unjournaled = h->recoveredUnjournaled;
+        atNs = h->recoveredAtNs;
+        by = h->recoveredBy;
+        h->recoveredBy = 0;
+        return true;
+    }
+
+    // FreezeRecorder: called by the freezers while this journal is installed
+    int Begin(uint32_t pid) override { return Claim(pid, false); }
+
+    int Threads(int slot, const std::vector<uint32_t>& tids) override
+    {
+        if (slot < 0) return -1;
+        FreezeJournalSlot* s = &Slot(slot);
+        int hops = 0;
+        for (; s->next; ++hops) s = &Slot(static_cast<int>(s->next) - 1);
+        int first = -1;
+        for (size_t i = 0; i < tids.size();) {
+            uint32_t at = s->count.load(std::memory_order_relaxed);
+            if (at == FREEZE_JOURNAL_THREADS) {
+                int more = Claim(s->pid, true);
+                if (more < 0) { // Journal full: these go unjournaled
+                    s->dropped += static_cast<uint32_t>(tids.size() - i);
+                    break;
+                }
+                Slot(more).startTime = s->startTime;
+                s->next = static_cast<uint32_t>(more) + 1;
+                s = &Slot(more);
+                ++hops;
+                continue;
+            }
+            size_t fit = std::min<size_t>(tids.size() - i, FREEZE_JOURNAL_THREADS - at);
+            for (size_t k = 0; k < fit; ++k) {
+                s->threads[at + k].tid = tids[i + k];
+                s->threads[at + k].suspends = 1;
+            }
+            s->count.store(at + static_cast<uint32_t>(fit), std::memory_order_release); // Published before the suspends
+            if (first < 0) first = hops * static_cast<int>(FREEZE_JOURNAL_THREADS) + static_cast<int>(at);
+            i += fit;
+        }
+        return first; // Slots fill up before the next is used, so the indices run on across them
+    }
+
+    void Resumed(int slot, int index) override
+    {
+        if (slot < 0 || index < 0) return;
+        FreezeJournalSlot* s = &Slot(slot);
+        for (int hop = index / static_cast<int>(FREEZE_JOURNAL_THREADS); hop > 0; --hop) {
+            if (!s->next) return;
+            s = &Slot(static_cast<int>(s->next) - 1);
+        }
+        uint32_t at = static_cast<uint32_t>(index) % FREEZE_JOURNAL_THREADS;
+        if (at < s->count.load(std::memory_order_relaxed)) s->threads[at].suspends = 0;
+    }
+
+    // The target is stopped now, so reading its start time can't stall behind its threads
+    void Frozen(int slot) override
+    {
+        if (slot < 0) return;
+        uint64_t start = ProcessStartTime(Slot(slot).pid);
+        for (FreezeJournalSlot* s = &Slot(slot);; s = &Slot(static_cast<int>(s->next) - 1)) {
+            s->startTime = start;
+            if (!s->next) break;
+        }
+    }
+
+    void End(int slot) override
+    {
+        while (slot >= 0) {
+            FreezeJournalSlot& s = Slot(slot);
+            slot = static_cast<int>(s.next) - 1;
+            s.next = 0;
+            s.state.store(SLOT_FREE, std::memory_order_release);
+        }
+    }
+
+private:
+    FreezeJournalHeader* Header() { return reinterpret_cast<FreezeJournalHeader*>(m_base); }
+
+    // A free slot for pid, LIVE with no threads; -1 if all are taken
+    int Claim(uint32_t pid, bool continuation)
+    {
+        if (!m_base) return -1;
+        uint32_t first = m_hint.fetch_add(1, std::memory_order_relaxed); // Spreads concurrent freezers over the slots
+        for (uint32_t n = 0; n < FREEZE_JOURNAL_SLOTS; ++n) {
+            int i = static_cast<int>((first + n) % FREEZE_JOURNAL_SLOTS);
+            FreezeJournalSlot& s = Slot(i);
+            uint32_t expected = SLOT_FREE;
+            if (!s.state.compare_exchange_strong(expected, SLOT_CLAIMED, std::memory_order_acq_rel)) continue;
+            s.pid = pid;
+            s.startTime = 0;
+            s.dropped = 0;
+            s.next = 0;
+            s.continues = continuation ? 1 : 0;
+            s.count.store(0, std::memory_order_relaxed);
+            s.state.store(SLOT_LIVE, std::memory_order_release);
+            return i;
+        }
+        return -1; // Full: this freeze goes unjournaled
+    }
+
+    static bool Fail(std::string* error, const std::string& why)
+    {
+        if (error) *error = why;
+        return false;
+    }
+
+    // The lock lives one byte past the data, so it never overlaps the mapped view
+    bool Lock(int waitMs)
+    {
+        int64_t deadline = FreezerNowNs() + static_cast<int64_t>(std::max(0, waitMs)) * 1000000LL;
+        for (;;) {
+#ifdef _WIN32
+            OVERLAPPED at = {};
+            at.Offset = static_cast<DWORD>(FileSize());
+            if (LockFileEx(m_file, LOCKFILE_EXCLUSIVE_LOCK | (waitMs < 0 ? 0 : LOCKFILE_FAIL_IMMEDIATELY), 0, 1, 0, &at)) return true;
+#else
+            if (flock(m_fd, LOCK_EX | (waitMs < 0 ? 0 : LOCK_NB)) == 0) return true;
+            if (errno == EINTR) continue;
+#endif
+            if (waitMs < 0 || FreezerNowNs() >= deadline) return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5)); // A watchdog mid-recovery lets go within milliseconds
+        }
+    }
+
+    // A continuation slot adds its threads to the process its first slot counts
+    void RecoverSlot(FreezeJournalSlot& s, FreezeRecovery& r)
+    {
+        bool first = !s.continues;
+        uint64_t start = ProcessStartTime(s.pid);
+        if (!start) {
+            r.gone += first;
+            return;
+        }
+        if (s.startTime && start != s.startTime) { // No start time: it died mid-freeze, when the process was still ours
+            r.skipped += first;
+            return;
+        }
+#ifdef _WIN32
+        r.threads += ResumeJournaled(s);
+        r.unjournaled += s.dropped;
+#else
+        if (kill(static_cast<pid_t>(s.pid), SIGCONT) != 0) {
+            r.gone += first;
+            return;
+        }
+        r.threads += std::min(s.count.load(std::memory_order_acquire), FREEZE_JOURNAL_THREADS);
+#endif
+        r.processes += first;
+    }
+
+#ifdef _WIN32
+    // Takes back every suspend journaled in s and zeroes them. Returns the threads resumed.
+    static size_t ResumeJournaled(FreezeJournalSlot& s)
+    {
+        size_t n = 0;
+        uint32_t count = std::min(s.count.load(std::memory_order_acquire), FREEZE_JOURNAL_THREADS);
+        for (uint32_t t = 0; t < count; ++t) {
+            FreezeJournalThread& e = s.threads[t];
+            if (!e.suspends) continue;
+            HANDLE h = OpenThread(THREAD_SUSPEND_RESUME | THREAD_QUERY_LIMITED_INFORMATION, FALSE, e.tid);
+            if (!h) continue; // Exited
+            if (GetProcessIdOfThread(h) == s.pid) { // A reused thread id belongs to someone else
+                for (uint32_t k = 0; k < e.suspends; ++k) {
+                    if (ResumeThread(h) == static_cast<DWORD>(-1)) break;
+                }
+                e.suspends = 0;
+                ++n;
+            }
+            CloseHandle(h);
+        }
+        return n;
+    }
+
+    HANDLE m_file = nullptr;
+#else
+    int m_fd = -1;
+#endif
+    uint8_t* m_base = nullptr;
+    bool m_private = false; // OpenPrivate(): no file behind m_base
+    std::string m_path;
+    std::atomic<uint32_t> m_hint{ 0 };
+};
+
+// GamePauser.journal next to the exe on Windows (the caller knows where that is);
+// gamepauser.journal in $XDG_RUNTIME_DIR, or /tmp/gamepauser-<uid>.journal without one
+static inline std::string DefaultJournalPath(const std::string& exeDir = std::string())
+{
+#ifdef _WIN32
+    return exeDir + "GamePauser.journal";
+#else
+    (void)exeDir;
+    const char* dir = std::getenv("XDG_RUNTIME_DIR");
+    if (dir && *dir) return std::string(dir) + "/gamepauser.journal";
+    return "/tmp/gamepauser-" + std::to_string(getuid()) + ".journal";
+#endif
+}
+
+// --watchdog <journal>: waits for the owner to let go of the journal (it exited or
+// died), resumes whatever it left frozen and leaves a note for the next instance.
+// After a clean exit there is nothing to do. The note is the report; the stderr
+// lines are only seen when it is run by hand (a spawned one writes to /dev/null).
+static inline int RunFreezeWatchdog(const std::string& path)
+{
+    FreezeJournal journal;
+    std::string error;
+    if (!journal.Open(path, -1, &error)) {
+#ifndef _WIN32
+        std::fprintf(stderr, "watchdog: %s\n", error.c_str());
+#endif
+        return 1;
+    }
+    FreezeRecovery r = journal.Recover();
+    if (r.processes || r.skipped || r.unjournaled) journal.LeaveReport(r);
+#ifndef _WIN32
+    if (r.processes || r.skipped)
+        std::fprintf(stderr, "watchdog: resumed %zu threads in %zu processes left frozen in %.2f ms (%zu skipped: PID reused)\n",
+            r.threads, r.processes, r.elapsedNs / 1e6, r.skipped);
+#endif
+    return 0;
+}
+
+#ifndef _WIN32
+// Points stdin/out/err at /dev/null so a detached watchdog stays off our terminal:
+// anything it has to say goes in the journal. Safe between fork and exec.
+static inline void DetachStdStreams()
+{
+    int null = open("/dev/null", O_RDWR);
+    if (null < 0) return;
+    dup2(null, 0);
+    dup2(null, 1);
+    dup2(null, 2);
+    if (null > 2) close(null);
+}
+#endif
+
+// Starts `<this exe> --watchdog <journal>` detached from us, so it outlives a kill
+// of this process (and of our console or session on Linux)
+static inline bool SpawnFreezeWatchdog(const std::string& path)
+{
+#ifdef _WIN32
+    char exePath[MAX_PATH] = {};
+    GetModuleFileNameA(nullptr, exePath, MAX_PATH);
+    std::string cmd = std::string("\"") + exePath + "\" --watchdog \"" + path + "\"";
+    STARTUPINFOA si = { sizeof(si) };
+    PROCESS_INFORMATION pi = {};
+    if (!CreateProcessA(nullptr, &cmd[0], nullptr, nullptr, FALSE, CREATE_NO_WINDOW | CREATE_NEW_PROCESS_GROUP, nullptr, nullptr, &si, &pi))
+        return false;
+    CloseHandle(pi.hThread);
+    CloseHandle(pi.hProcess);
+    return true;
+#else
+    const char* journal = path.c_str(); // Nothing that allocates between fork and exec
+    pid_t child = fork();
+    if (child < 0) return false;
+    if (child == 0) {
+        // Double fork: init reaps the watchdog, not us. It must not inherit a
+        // daemon's blocked SIGINT/SIGTERM either.
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, nullptr);
+        setsid();
+        if (fork() == 0) {
+            DetachStdStreams();
+            execl("/proc/self/exe", "gamepauser-watchdog", "--watchdog", journal, static_cast<char*>(nullptr));
+            _exit(127);
+        }
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+}
+
+// At startup, before anything is frozen: takes the journal, resumes what a dead
+// instance left frozen, installs the journal for every freezer from here on and
+// starts the watchdog. Returns false (after logging why) without a journal.
+static inline bool StartFreezeJournal(FreezeJournal& journal, const std::string& path, bool watchdog, AsyncLogger* log)
+{
+    char line[256];
+    std::string error;
+    if (!journal.Open(path, 250, &error)) {
+        if (log) log->Push("WARNING: Freeze journal unavailable (" + error + ") - a crash while paused would leave the game frozen");
+        return false;
+    }
+    FreezeRecovery note, r;
+    int64_t atNs = 0;
+    uint32_t by = 0;
+    if (journal.TakeReport(note, atNs, by) && log) {
+        int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        std::snprintf(line, sizeof(line), "*** WATCHDOG RECOVERY *** - %.0f s ago the last run died; watchdog PID %u resumed %zu threads in %zu processes",
+            std::max<int64_t>(0, nowNs - atNs) / 1e9, by, note.threads, note.processes);
+        log->Push(line);
+    }
+    r = journal.Recover();
+    if (r.processes && log) {
+        std::snprintf(line, sizeof(line), "*** CRASH RECOVERY *** - resumed %zu threads in %zu processes the last run left frozen (%.2f ms)",
+            r.threads, r.processes, r.elapsedNs / 1e6);
+        log->Push(line);
+    }
+    if (r.unjournaled + note.unjournaled && log) {
+        std::snprintf(line, sizeof(line), "WARNING: %zu threads the last run suspended after its journal was full were left suspended - restart the game if it hangs",
+            r.unjournaled + note.unjournaled);
+        log->Push(line);
+    }
+    if (r.skipped + note.skipped && log) {
+        std::snprintf(line, sizeof(line), "WARNING: %zu journaled processes were left frozen by a dead run but their PIDs now belong to other programs - not touched",
+            r.skipped + note.skipped);
+        log->Push(line);
+    }
+    ActiveFreezeRecorder().store(&journal);
+    if (watchdog && !SpawnFreezeWatchdog(path) && log)
+        log->Push("WARNING: Could not start the recovery watchdog - a crash is undone at the next start instead");
+    return true;
+}
@@ -17,46 +17,126 @@
 // • Special behavior: Escape = cancel + discard, Enter = accept without sending Enter
 // • Retro logging: Old-terminal style with amber tint (toggle in ini)
 // =============================================================================
+#include <winsock2.h> // Before windows.h, which would otherwise pull in the old winsock.h
 #include <windows.h>
-#include <tlhelp32.h>
+#include <shellapi.h> // DragQueryFileW - a file copied in Explorer can be pasted as text
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <vector>
 #include <map>
 #include <algorithm>
-#include <random>
 #include <chrono>
+#include <future> // Control commands wait for the message thread to run them
 #include <thread>
-#include <set>
-#include <iomanip> // For timestamp formatting
+#include <memory>
+#include <mutex>
 #include <sstream> // For std::ostringstream
-#include <ctime> // For std::tm and localtime_s
+#include <cstdarg> // For LogRetroF
+#include <ctime> // Saved macro names
+#include <iterator> // std::istreambuf_iterator - the INI is read whole to update a profile
+#include "RetroLog.h" // Asynchronous logger - keeps console I/O off the hook path
+#include "ProcessFreezer.h" // Convergent suspend with cached thread handles
+#include "KeyRing.h" // Hook -> consumer SPSC ring of packed key events
+#include "ReplayScheduler.h" // Replay pacing policies, separate from SendInput
+#include "KeyboardState.h" // Bitset model of held keys + extended flags
+#include "ProcessTree.h" // Process trees / named groups as one pause target
+#include "ResumeStrategy.h" // Staged resume, warm-up boost, running detection
+#include "PauseController.h" // Pause/capture/replay state machine behind injectable backends
+#include "Throttle.h" // Duty-cycle throttling: timed freeze/thaw slices
+#include "MacroLibrary.h" // Saved sessions in a memory-mapped macro file
+#include "TextCompiler.h" // Clipboard text -> key-event program for paste-while-paused
+#include "CaptureOptimizer.h" // Optional pass that shortens a captured session before replay
+#include "ReplayProfiles.h" // Per-game replay settings, hashed by image name
+#include "ReplayCalibrator.h" // Learns the fastest key rate a game accepts
+#include "Metrics.h" // Latency histograms + Prometheus endpoint
+#include "ControlChannel.h" // Named-pipe control channel + --ctl client
+#include "FocusMode.h" // Background processes frozen while a listed game has focus
+#include "FreezeJournal.h" // Write-ahead freeze record: a crash never leaves a game frozen
+#include "Tracing.h" // Opt-in span timeline, dumped as Chrome/Perfetto JSON
+#include "Bench.h" // --bench microbenchmarks
 // -----------------------------------------------------------------------------
 // Global state
 // -----------------------------------------------------------------------------
 const int HOTKEY_ID = 9001;
-DWORD g_targetPid = 0; // PID of the currently paused process
+const int THROTTLE_HOTKEY_ID = 9002;
+const int SAVE_MACRO_HOTKEY_ID = 9003;
+const int PASTE_HOTKEY_ID = 9004;
+const int CALIBRATE_HOTKEY_ID = 9005;
+const int MACRO_HOTKEY_BASE = 9100; // + index into g_macroBindings
+const UINT WM_CONTROL_COMMAND = WM_APP + 1; // lParam: a ControlJob posted by a control client thread
+const UINT WM_PENDING_ACTION = WM_APP + 2; // Esc/Enter seen by the hook - run it on the main thread
+const UINT WM_HOOK_INSTALL = WM_APP + 3; // To the hook thread
+const UINT WM_HOOK_REMOVE = WM_APP + 4; // To the hook thread
+const UINT WM_FOCUS_EXITED = WM_APP + 5; // wParam: PID of the focus-mode game that exited
+DWORD g_mainThreadId = 0; // Runs the message loop: hotkeys, control commands, freeze/thaw/replay
 std::string g_iniPath = "GamePauser.ini"; // Config file placed next to the exe
-std::vector<INPUT> g_capturedWhilePaused; // Keystrokes queued for replay
 HHOOK g_kbHook = nullptr; // Low-level keyboard hook handle
 WORD g_pauseVK = 'P'; // Virtual-key code for the pause hotkey
-UINT g_pauseMods = MOD_CONTROL | MOD_ALT | MOD_NOREPEAT;
-std::set<WORD> g_heldKeys; // Keys physically held when resuming (during-pause only, post-clear)
-bool g_unpauseOnNextEsc = false; // True only while paused - Esc cancels
-bool g_unpauseOnNextEnter = false; // True only while paused - Enter accepts without sending Enter
+UINT g_pauseMods = MOD_CONTROL | MOD_ALT; // MOD_NOREPEAT is added at registration
+std::string g_hotkeyLabel = "Ctrl+Alt + P"; // As written in the INI, for the log
+HWND g_inputWindow = nullptr; // Message-only window receiving WM_INPUT
 bool g_retroLogs = true; // Toggle for amber/retro styling
 HANDLE g_console = nullptr; // For color control
-const WORD AMBER_COLOR = 14; // Bright yellow/orange for that phosphor glow
 const WORD NORMAL_COLOR = 7; // Default white
+AsyncLogger g_log; // Lock-free log ring drained by a background thread
+FreezeJournal g_journal; // Declared before anything that freezes, so it is torn down after them
+PauseTargetOptions g_targetOptions; // [Targets] IncludeChildren / Processes
+GroupOrder g_groupOrder = GroupOrder::ChildrenFirst; // [Targets] Order
+size_t g_ringCapacity = 4096; // [Capture] RingSize
+OverflowPolicy g_overflowPolicy = OverflowPolicy::Spill; // [Capture] Overflow
+CaptureOptimizeOptions g_optimizeOptions; // [Capture] Optimize
+ReplayOptions g_replayOptions; // [Replay] section
+ReplayProfiles g_profiles; // [Profiles] Profile1, Profile2, ... - per-game [Replay] overrides
+WORD g_calibrateVK = 0; // [Profiles] CalibrateKey, 0 = no calibration hotkey
+UINT g_calibrateMods = MOD_CONTROL | MOD_ALT; // [Profiles] CalibrateModifiers
+CalibrationOptions g_calibrationOptions; // [Profiles] CalibrateStartMs
+std::unique_ptr<PauseController> g_controller; // The pause / capture / replay state machine
+bool g_metricsEnabled = false; // [Metrics] Metrics
+uint16_t g_metricsPort = 9464; // [Metrics] MetricsPort (localhost only)
+PauseMetrics g_metrics; // Counters + histograms, lock-free to record
+MetricsServer g_metricsServer; // Serves g_metrics in Prometheus text format
+MemoryOptions g_memoryOptions; // [Memory] trim while paused / prefetch on resume
+ResumeOptions g_resumeOptions; // [Resume] thread order, warm-up, replay-on-running
+WORD g_throttleVK = 0; // [Throttle] ThrottleKey, 0 = no throttle hotkey
+UINT g_throttleMods = MOD_CONTROL | MOD_ALT; // [Throttle] ThrottleModifiers
+ThrottleOptions g_throttleOptions; // [Throttle] share, period, adaptive
+std::vector<std::string> g_throttleRules; // [Throttle] ThrottleProcesses - always throttled
+std::unique_ptr<ThrottleManager> g_throttle;
+struct MacroBinding
+{
+    WORD vk;
+    UINT mods;
+    std::string name;
+};
+std::string g_macroPath = "GamePauser.macros"; // [Macros] MacroFile, relative to the exe
+MacroLibrary g_macros; // Mapped at startup, remapped after every save
+WORD g_saveMacroVK = 0; // [Macros] SaveMacroKey, 0 = no save hotkey
+UINT g_saveMacroMods = MOD_CONTROL | MOD_ALT; // [Macros] SaveMacroModifiers
+std::vector<MacroBinding> g_macroBindings; // [Macros] Macro1, Macro2, ...
+WORD g_pasteVK = 0; // [Paste] PasteKey, 0 = no paste hotkey
+UINT g_pasteMods = MOD_CONTROL | MOD_ALT; // [Paste] PasteModifiers
+TextCompileOptions g_pasteOptions; // [Paste] rate, newlines, size limit
+bool g_controlEnabled = true; // [Control] Control
+std::string g_controlPath; // [Control] ControlPath, empty = \\.\pipe\GamePauser
+ControlServer g_controlServer; // Local pipe for --ctl and scripts
+std::unique_ptr<ControlDispatcher> g_control; // Control ops -> g_controller / g_throttle
+FocusOptions g_focusOptions; // [Focus] FocusGames / FocusFreeze
+std::unique_ptr<FocusMode> g_focus; // Freezes FocusFreeze while a FocusGames window is foreground
+HWINEVENTHOOK g_foregroundHook = nullptr; // EVENT_SYSTEM_FOREGROUND, delivered to the message loop
+HANDLE g_focusProcess = nullptr; // The focus-mode game, waited on for its exit
+HANDLE g_focusWait = nullptr;
+bool g_journalEnabled = true; // [Recovery] Journal
+bool g_watchdogEnabled = true; // [Recovery] Watchdog
+bool g_traceEnabled = false; // [Trace] Trace
+std::string g_tracePath = "GamePauser.trace.json"; // [Trace] TraceFile, relative to the exe
+size_t g_traceEvents = TRACE_DEFAULT_EVENTS; // [Trace] TraceEvents, per thread
 // -----------------------------------------------------------------------------
 // Forward declarations (required due to function ordering and hook callback)
 // -----------------------------------------------------------------------------
 static void CleanupAndExit();
-static void SetCaptureHook(bool enable);
-static void SuspendOrResumeProcess(bool suspend);
-static void SendCapturedInputs();
 static void LogRetro(const std::string& msg); // Enhanced: Styled logging with more events
+static void LogRetroF(const char* fmt, ...); // printf-style, formats straight into the log ring
 LRESULT CALLBACK LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam);
 // -----------------------------------------------------------------------------
 // Utility functions
@@ -115,7 +195,8 @@ static void CreateDefaultIni()
         << ";\n"
         << "; This is a simple text file for customizing GamePauser. Open it in Notepad or any text editor.\n"
         << "; Lines starting with ';' are comments and ignored. Edit the values after '=' signs.\n"
-        << "; Save the file and restart GamePauser for changes to take effect.\n"
+        << "; Save the file and restart GamePauser for changes to take effect\n"
+        << "; (or run: GamePauser.exe --ctl reload).\n"
         << ";\n"
         << "; --- HOTKEY SETTINGS ---\n"
         << "; The hotkey pauses/resumes the foreground process (e.g., your game).\n"
@@ -138,6 +219,145 @@ static void CreateDefaultIni()
         << "; RetroLogs: Enables old-school terminal-style logging with timestamps and borders.\n"
         << ";            Set to 0 for plain text logs (easier on modern displays).\n"
         << ";\n"
+        << "; --- CAPTURE SETTINGS ---\n"
+        << "; RingSize: Keystrokes buffered between the keyboard hook and the replay queue\n"
+        << ";           (rounded up to a power of two). 4096 is plenty for normal typing.\n"
+        << "; Overflow: What happens if the buffer ever fills up:\n"
+        << ";             spill = grow an overflow area, nothing lost (default)\n"
+        << ";             drop  = forget the oldest keystrokes\n"
+        << ";             block = wait for room (never loses keys, may delay the hook)\n"
+        << "; Optimize: Shorten the replay without changing what the game ends up with:\n"
+        << ";             repeats = send a held key's autorepeat as one burst\n"
+        << ";             edits   = drop letters together with the Backspace that erased them\n"
+        << ";             taps    = drop lone Shift/Ctrl taps and releases of unpressed keys\n"
+        << ";           Comma separated, or all / off (default). Leave edits off for chat\n"
+        << ";           boxes with autocomplete.\n"
+        << ";\n"
+        << "; --- TARGET SETTINGS ---\n"
+        << "; IncludeChildren: 1 = also pause every process the foreground app started\n"
+        << ";                  (launchers, renderers, crash handlers, emulator cores).\n"
+        << "; Processes: Extra image names to pause with it, comma separated\n"
+        << ";            (e.g. Processes = launcher.exe, crashpad_handler.exe).\n"
+        << "; Order: children-first (default) or parent-first. Resume is the reverse.\n"
+        << ";\n"
+        << "; --- REPLAY SETTINGS ---\n"
+        << "; Policy: How captured keys are played back on resume:\n"
+        << ";           jitter   = 18-45 ms random gap between keys (default, natural feel)\n"
+        << ";           faithful = same rhythm you typed it in\n"
+        << ";           speed    = your rhythm, Speed times faster\n"
+        << ";           batched  = BatchSize keys at once, 1 ms apart (fastest)\n"
+        << "; LeadDelayMs: Wait after resuming before the first key (default 380).\n"
+        << "; MaxGapMs: faithful/speed only - long pauses are shortened to this.\n"
+        << "; MinGapMs: Never send keys closer together than this (default 0 = no floor).\n"
+        << ";\n"
+        << "; --- PROFILE SETTINGS ---\n"
+        << "; Profile1, Profile2, ...: Replay settings for one game, used instead of\n"
+        << ";           [Replay] when that game is paused. Image name first, e.g.\n"
+        << ";           Profile1 = eldenring.exe, Policy=faithful, LeadDelayMs=120, MinGapMs=17\n"
+        << ";           Fields left out come from [Replay].\n"
+        << "; CalibrateKey / CalibrateModifiers: Hotkey that measures how fast the\n"
+        << ";           foreground game takes keys. Open a text box in the game (chat,\n"
+        << ";           console) that supports Ctrl+A / Ctrl+C first, then press it and\n"
+        << ";           keep your hands off the keyboard. Letters are typed faster and\n"
+        << ";           faster and read back through the clipboard; the fastest rate\n"
+        << ";           that never lost a key (plus a margin) is saved as that game's\n"
+        << ";           MinGapMs here. Empty key = no hotkey.\n"
+        << "; CalibrateStartMs: Slowest gap tried first (default 50).\n"
+        << ";\n"
+        << "; --- METRICS SETTINGS ---\n"
+        << "; Metrics: 1 = serve pause/resume latency histograms and event counters in\n"
+        << ";          Prometheus text format at http://127.0.0.1:MetricsPort/metrics.\n"
+        << ";          Only reachable from this machine. Default 0 (off).\n"
+        << "; MetricsPort: TCP port for the endpoint (default 9464).\n"
+        << ";\n"
+        << "; --- MEMORY SETTINGS ---\n"
+        << "; TrimWhilePaused: 1 = page the frozen game out so the rest of the system\n"
+        << ";                  gets its RAM back while you're away. Default 0 (off).\n"
+        << "; PrefetchOnResume: 1 = read the game's hot memory back in the background\n"
+        << ";                   as it resumes, so it stutters less. Default 1.\n"
+        << "; PrefetchLimitMB: Cap on how much is read back per process (0 = all).\n"
+        << ";\n"
+        << "; --- RESUME SETTINGS ---\n"
+        << "; ResumeOrder: Which threads wake first on resume:\n"
+        << ";           reverse    = all at once (default)\n"
+        << ";           main-first = the game's main thread, then the busiest\n"
+        << ";           busiest    = threads that used the most CPU before the pause\n"
+        << "; LeadThreads: How many threads go first (default 1).\n"
+        << "; StaggerMs: How long they run alone before the rest wake (default 0).\n"
+        << "; WarmupMs: Raise the game's priority for this long after resume, then put it\n"
+        << ";           back (0 = off). Linux needs CAP_SYS_NICE to put it back.\n"
+        << "; WarmupPin: 1 = also pin the lead threads to the core they last ran on.\n"
+        << "; LeadOnRunning: 1 = start replay as soon as the game is running again,\n"
+        << ";                LeadDelayMs at most. Default 0 (always wait LeadDelayMs).\n"
+        << ";\n"
+        << "; --- THROTTLE SETTINGS ---\n"
+        << "; Instead of a hard pause, a throttled process keeps running in short slices\n"
+        << "; (frozen and thawed many times a second), e.g. an idle MMO client that must\n"
+        << "; not lose its connection.\n"
+        << "; ThrottleKey / ThrottleModifiers: Hotkey that throttles the foreground process,\n"
+        << ";           or releases it (empty key = no hotkey).\n"
+        << "; ThrottleShare: CPU to allow, in percent of one core (default 15).\n"
+        << "; ThrottlePeriodMs: One run slice per period (default 20). Longest the process\n"
+        << ";           is ever frozen is about this long.\n"
+        << "; ThrottleAdaptive: 1 = correct the slice from measured CPU time (default).\n"
+        << "; ThrottleProcesses: Image names that are always throttled while running,\n"
+        << ";           comma separated (e.g. ThrottleProcesses = mmoclient.exe).\n"
+        << ";\n"
+        << "; --- FOCUS MODE ---\n"
+        << "; While a window of one of FocusGames is in front, every process named in\n"
+        << "; FocusFreeze is frozen; they thaw when the game loses focus or exits.\n"
+        << "; Both lists are comma separated image names, * and ? as wildcards, e.g.\n"
+        << ";           FocusFreeze = chrome.exe, discord*.exe, *updater*.exe\n"
+        << "; Either list empty = off. Frozen apps miss their notifications until you\n"
+        << "; switch away; the log reports the CPU time each session kept for the game.\n"
+        << ";\n"
+        << "; --- CRASH RECOVERY ---\n"
+        << "; Journal: 1 = record every freeze in GamePauser.journal next to the exe before\n"
+        << ";           anything is suspended (default). If GamePauser is killed or crashes\n"
+        << ";           while something is frozen, the next start resumes it.\n"
+        << "; Watchdog: 1 = also start a small watchdog process that resumes it the moment\n"
+        << ";           GamePauser dies, without waiting for a restart (default).\n"
+        << "; Both are read at startup only.\n"
+        << ";\n"
+        << "; --- TRACING ---\n"
+        << "; Trace: 1 = record a timeline of every pause - hotkey, each thread suspended\n"
+        << ";           and resumed, hook install/remove, every replayed key and wait - in\n"
+        << ";           nanoseconds (default 0). Costs nothing measurable while off.\n"
+        << "; TraceFile: Where the timeline is written when GamePauser exits or on\n"
+        << ";           GamePauser.exe --ctl trace [file]; next to the exe unless a full path\n"
+        << ";           is given. Open it in ui.perfetto.dev or chrome://tracing.\n"
+        << "; TraceEvents: Newest events kept per thread (default 32768).\n"
+        << ";\n"
+        << "; --- PASTE SETTINGS ---\n"
+        << "; PasteKey / PasteModifiers: Hotkey that, during a pause, queues the clipboard\n"
+        << ";           text (or the text file copied in Explorer) as keystrokes, replayed\n"
+        << ";           with everything else on resume. Empty key = no hotkey.\n"
+        << "; PasteRate: Characters per second the pasted text is typed at (default 300).\n"
+        << ";           Lower it if the game drops letters.\n"
+        << "; PasteNewlines: 1 = press Enter for each line break (default), 0 = skip them.\n"
+        << "; PasteMaxChars: Longest text that is pasted; the rest is left out (default 20000).\n"
+        << ";\n"
+        << "; --- MACRO SETTINGS ---\n"
+        << "; What you type during a pause can be kept and played back later by hotkey.\n"
+        << "; MacroFile: Library file, next to the exe unless a full path is given.\n"
+        << "; SaveMacroKey / SaveMacroModifiers: Hotkey that saves the last pause session\n"
+        << ";           (replayed or cancelled) as a macro named session-<date>-<time>.\n"
+        << ";           Empty key = no hotkey.\n"
+        << "; Macro1, Macro2, ...: Hotkey, then the macro it plays, e.g.\n"
+        << ";           Macro1 = Ctrl+Alt+F1, session-20251104-213015\n"
+        << ";           Macros play with the [Replay] Policy. Rename, list, import and\n"
+        << ";           export them with: GamePauser.exe --macros GamePauser.macros list\n"
+        << ";\n"
+        << "; --- CONTROL CHANNEL ---\n"
+        << "; Scripts and stream decks can drive a running GamePauser from the command line:\n"
+        << ";           GamePauser.exe --ctl status | pause <pid|name> | resume | text <string>\n"
+        << ";           | throttle <pid|name> | unthrottle <pid|name> | metrics | reload | ping\n"
+        << "; Control: 1 = listen for these commands (default), 0 = off. Only programs\n"
+        << ";           running as you on this PC can connect.\n"
+        << "; ControlPath: Pipe name, empty = \\\\.\\pipe\\GamePauser.\n"
+        << "; reload re-reads this file between pauses; RingSize, Overflow, [Metrics] and\n"
+        << ";           [Control] still need a restart.\n"
+        << ";\n"
         << "; Default values below - edit as needed.\n"
         << ";\n"
         << "[Hotkey]\n"
@@ -146,6 +366,85 @@ static void CreateDefaultIni()
         << "\n"
         << "[Logging]\n"
         << "RetroLogs = 1  ; 0 = plain logs, 1 = retro amber style with timestamps and borders\n"
+        << "\n"
+        << "[Capture]\n"
+        << "RingSize = 4096\n"
+        << "Overflow = spill\n"
+        << "Optimize = off\n"
+        << "\n"
+        << "[Targets]\n"
+        << "IncludeChildren = 1\n"
+        << "Processes =\n"
+        << "Order = children-first\n"
+        << "\n"
+        << "[Replay]\n"
+        << "Policy = jitter\n"
+        << "LeadDelayMs = 380\n"
+        << "Speed = 2.0\n"
+        << "BatchSize = 32\n"
+        << "MaxGapMs = 1000\n"
+        << "MinGapMs = 0\n"
+        << "\n"
+        << "[Profiles]\n"
+        << "CalibrateKey =\n"
+        << "CalibrateModifiers = Ctrl+Alt\n"
+        << "CalibrateStartMs = 50\n"
+        << "Profile1 =\n"
+        << "\n"
+        << "[Metrics]\n"
+        << "Metrics = 0\n"
+        << "MetricsPort = 9464\n"
+        << "\n"
+        << "[Memory]\n"
+        << "TrimWhilePaused = 0\n"
+        << "PrefetchOnResume = 1\n"
+        << "PrefetchLimitMB = 0\n"
+        << "\n"
+        << "[Resume]\n"
+        << "ResumeOrder = reverse\n"
+        << "LeadThreads = 1\n"
+        << "StaggerMs = 0\n"
+        << "WarmupMs = 0\n"
+        << "WarmupPin = 0\n"
+        << "LeadOnRunning = 0\n"
+        << "\n"
+        << "[Throttle]\n"
+        << "ThrottleKey =\n"
+        << "ThrottleModifiers = Ctrl+Alt\n"
+        << "ThrottleShare = 15\n"
+        << "ThrottlePeriodMs = 20\n"
+        << "ThrottleAdaptive = 1\n"
+        << "ThrottleProcesses =\n"
+        << "\n"
+        << "[Focus]\n"
+        << "FocusGames =\n"
+        << "FocusFreeze =\n"
+        << "\n"
+        << "[Recovery]\n"
+        << "Journal = 1\n"
+        << "Watchdog = 1\n"
+        << "\n"
+        << "[Trace]\n"
+        << "Trace = 0\n"
+        << "TraceFile = GamePauser.trace.json\n"
+        << "TraceEvents = 32768\n"
+        << "\n"
+        << "[Paste]\n"
+        << "PasteKey =\n"
+        << "PasteModifiers = Ctrl+Alt\n"
+        << "PasteRate = 300\n"
+        << "PasteNewlines = 1\n"
+        << "PasteMaxChars = 20000\n"
+        << "\n"
+        << "[Macros]\n"
+        << "MacroFile = GamePauser.macros\n"
+        << "SaveMacroKey =\n"
+        << "SaveMacroModifiers = Ctrl+Alt\n"
+        << "Macro1 =\n"
+        << "\n"
+        << "[Control]\n"
+        << "Control = 1\n"
+        << "ControlPath =\n"
         << ";\n"
         << "; =============================================================================\n"
         << "; End of file. For support, check the console output or contact the author.\n"
@@ -156,220 +455,532 @@ static void CreateDefaultIni()
 // -----------------------------------------------------------------------------
 // Enhanced: Retro-styled logging with broader usage
 // -----------------------------------------------------------------------------
+// Never blocks: the record is copied into the ring and the drain thread does
+// the timestamp, amber colour, borders and flicker. Safe to call from the hook.
 static void LogRetro(const std::string& msg)
 {
-    if (!g_retroLogs) {
-        std::cout << msg << "\n";
-        return;
-    }
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
-    std::tm timeinfo;
-    std::string timestamp;
-    if (localtime_s(&timeinfo, &time_t) == 0) {
-        std::ostringstream oss;
-        oss << "[" << std::put_time(&timeinfo, "%H:%M:%S") << "."
-            << std::setfill('0') << std::setw(3) << ms.count() << "] ";
-        timestamp = oss.str();
-    }
-    else {
-        // Fallback: basic time without local formatting (rare, but safe)
-        std::ostringstream oss_fallback;
-        oss_fallback << "[" << time_t << "." << ms.count() << "] ";
-        timestamp = oss_fallback.str();
-    }
-    std::string border = std::string(timestamp.length() + msg.length() + 4, '-'); // Simple underline for that teletype feel
-    SetConsoleTextAttribute(g_console, AMBER_COLOR);
-    std::cout << border << "\n";
-    std::cout << "| " << timestamp << msg << " |\n";
-    std::cout << border << "\n";
-    SetConsoleTextAttribute(g_console, NORMAL_COLOR);
-    std::cout << std::flush; // Ensure it draws immediately, like a slow terminal
-    // Subtle "flicker" pause—old CRTs weren't instant
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    g_log.Push(msg);
+}
+static void LogRetroF(const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    g_log.PushV(fmt, args);
+    va_end(args);
 }
 // -----------------------------------------------------------------------------
-// Low-level keyboard hook
+// Win32 backends for the PauseController
 // -----------------------------------------------------------------------------
-static void SetCaptureHook(bool enable)
-{
-    if (enable && !g_kbHook) {
-        g_kbHook = SetWindowsHookExW(WH_KEYBOARD_LL, LowLevelKeyboardProc,
-            GetModuleHandle(nullptr), 0);
-        if (g_kbHook) {
-            LogRetro("*** KEYBOARD CAPTURE ACTIVATED *** - Inputs queued for replay on resume");
-            LogRetro("Note: Global keyboard input blocked during pause - this is by design");
-        }
-        else {
+// Low-level keyboard hook: only present while paused. It lives on its own
+// time-critical thread whose message pump does nothing else, so the system
+// never waits on a freeze, thaw or replay to deliver a key. Install/Remove
+// are posted to that thread and return once it has acted: after Remove(),
+// every key the hook blocked is already in the ring.
+class Win32KeyboardHook : public KeyboardHook
+{
+public:
+    bool Install() override
+    {
+        if (!Ask(WM_HOOK_INSTALL)) {
             LogRetro("WARNING: Failed to install keyboard hook - inputs may not capture properly");
+            return false;
         }
+        LogRetro("*** KEYBOARD CAPTURE ACTIVATED *** - Inputs queued for replay on resume");
+        LogRetro("Note: Global keyboard input blocked during pause - this is by design");
+        return true;
     }
-    else if (!enable && g_kbHook) {
-        UnhookWindowsHookEx(g_kbHook);
-        g_kbHook = nullptr;
+    void Remove() override
+    {
+        if (!m_thread || !m_installed) return;
+        Ask(WM_HOOK_REMOVE);
         LogRetro("*** KEYBOARD CAPTURE DEACTIVATED *** - Normal input restored");
     }
+    void Stop()
+    {
+        if (!m_thread) return;
+        Remove();
+        PostThreadMessage(m_threadId, WM_QUIT, 0, 0);
+        WaitForSingleObject(m_thread, INFINITE);
+        CloseHandle(m_thread);
+        CloseHandle(m_done);
+        m_thread = m_done = nullptr;
+    }
+
+private:
+    // Posts a request to the hook thread (starting it the first time) and waits for it
+    bool Ask(UINT request)
+    {
+        if (!m_thread) {
+            m_done = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+            m_thread = CreateThread(nullptr, 0, ThreadMain, this, 0, &m_threadId);
+            if (!m_thread) return false;
+            WaitForSingleObject(m_done, INFINITE); // Its message queue exists from here
+        }
+        if (!PostThreadMessage(m_threadId, request, 0, 0)) return false;
+        WaitForSingleObject(m_done, INFINITE);
+        return m_installed;
+    }
+    static DWORD WINAPI ThreadMain(LPVOID param)
+    {
+        Win32KeyboardHook* self = static_cast<Win32KeyboardHook*>(param);
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+        TraceThreadName("keyboard hook");
+        MSG msg;
+        PeekMessage(&msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE); // Create the queue before anyone posts
+        SetEvent(self->m_done);
+        while (GetMessage(&msg, nullptr, 0, 0)) {
+            if (msg.message == WM_HOOK_INSTALL) {
+                TraceSpan span("SetWindowsHookEx");
+                if (!g_kbHook) g_kbHook = SetWindowsHookExW(WH_KEYBOARD_LL, LowLevelKeyboardProc, GetModuleHandle(nullptr), 0);
+                self->m_installed = g_kbHook != nullptr;
+                SetEvent(self->m_done);
+            }
+            else if (msg.message == WM_HOOK_REMOVE) {
+                // Callbacks run inside this pump, so none is in flight while we're here
+                TraceSpan span("UnhookWindowsHookEx");
+                if (g_kbHook) UnhookWindowsHookEx(g_kbHook);
+                g_kbHook = nullptr;
+                self->m_installed = false;
+                SetEvent(self->m_done);
+            }
+        }
+        return 0;
+    }
+
+    HANDLE m_thread = nullptr;
+    DWORD m_threadId = 0;
+    HANDLE m_done = nullptr; // Auto-reset: the thread has handled the last request
+    std::atomic<bool> m_installed{ false };
+};
+class Win32HotkeyRegistrar : public HotkeyRegistrar
+{
+public:
+    bool Register(uint16_t vk, uint32_t mods) override
+    {
+        return RegisterHotKey(nullptr, HOTKEY_ID, mods | MOD_NOREPEAT, vk) != FALSE;
+    }
+    void Unregister() override { UnregisterHotKey(nullptr, HOTKEY_ID); }
+};
+static INPUT ToInput(const KeyEvent& ev)
+{
+    INPUT inp = {};
+    inp.type = INPUT_KEYBOARD;
+    if (ev.flags & KEY_UNICODE) {
+        inp.ki.wScan = ev.scan;
+        inp.ki.dwFlags = KEYEVENTF_UNICODE;
+    }
+    else {
+        inp.ki.wVk = ev.vk;
+        if (ev.flags & KEY_EXTENDED) inp.ki.dwFlags |= KEYEVENTF_EXTENDEDKEY;
+    }
+    if (ev.flags & KEY_UP) inp.ki.dwFlags |= KEYEVENTF_KEYUP;
+    return inp;
+}
+// Injection sink: each scheduler batch becomes one SendInput array call. A
+// session is attached to the foreground thread so the keys land in its queue.
+class SendInputSink : public InputSink
+{
+public:
+    void Begin() override
+    {
+        m_fgThreadId = GetWindowThreadProcessId(GetForegroundWindow(), nullptr);
+        m_attached = false;
+        if (m_fgThreadId && m_fgThreadId != GetCurrentThreadId()) {
+            {
+                TraceSpan span("AttachThreadInput", "tid", m_fgThreadId);
+                m_attached = AttachThreadInput(GetCurrentThreadId(), m_fgThreadId, TRUE) != FALSE;
+            }
+            if (m_attached) {
+                TraceSpan span("attach settle");
+                Sleep(15);
+            }
+        }
+    }
+    void Send(const KeyEvent* events, size_t count) override
+    {
+        INPUT batch[64];
+        while (count) {
+            UINT n = static_cast<UINT>(std::min<size_t>(count, 64));
+            for (UINT i = 0; i < n; ++i) batch[i] = ToInput(events[i]);
+            TraceSpan span("SendInput", "events", n);
+            SendInput(n, batch, sizeof(INPUT));
+            events += n;
+            count -= n;
+        }
+    }
+    void End() override
+    {
+        if (m_attached) {
+            TraceSpan span("detach thread input");
+            AttachThreadInput(GetCurrentThreadId(), m_fgThreadId, FALSE);
+        }
+        m_attached = false;
+    }
+
+private:
+    DWORD m_fgThreadId = 0;
+    bool m_attached = false;
+};
+Win32KeyboardHook g_hookBackend;
+Win32HotkeyRegistrar g_hotkeyBackend;
+SendInputSink g_sendInput;
+std::unique_ptr<GroupPauseFreezer> g_freezer; // Built after LoadConfig ([Targets])
+// -----------------------------------------------------------------------------
+// Low-level keyboard hook
+// -----------------------------------------------------------------------------
+// Translates the Win32 event and lets the controller decide. The modifier
+// state is only polled for the pause key itself.
+static uint32_t HeldModifiers()
+{
+    uint32_t current = 0;
+    if (GetAsyncKeyState(VK_CONTROL) & 0x8000) current |= MOD_CONTROL;
+    if (GetAsyncKeyState(VK_MENU) & 0x8000) current |= MOD_ALT;
+    if (GetAsyncKeyState(VK_SHIFT) & 0x8000) current |= MOD_SHIFT;
+    if (GetAsyncKeyState(VK_LWIN) & 0x8000) current |= MOD_WIN;
+    return current;
 }
 LRESULT CALLBACK LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam)
 {
-    if (nCode < 0 || g_targetPid == 0)
+    if (nCode < 0 || !g_controller || !g_controller->Paused())
         return CallNextHookEx(g_kbHook, nCode, wParam, lParam);
     auto* kbd = reinterpret_cast<KBDLLHOOKSTRUCT*>(lParam);
-    if (kbd->flags & LLKHF_INJECTED)
+    KeyEvent ev;
+    ev.timeNs = MonotonicNs();
+    ev.vk = static_cast<uint16_t>(kbd->vkCode);
+    ev.scan = static_cast<uint16_t>(kbd->scanCode);
+    ev.flags = static_cast<uint16_t>(((wParam == WM_KEYUP || wParam == WM_SYSKEYUP) ? KEY_UP : 0)
+        | ((kbd->flags & LLKHF_EXTENDED) ? KEY_EXTENDED : 0) | ((kbd->flags & LLKHF_INJECTED) ? KEY_INJECTED : 0));
+    ev.extra = 0;
+    uint32_t mods = (kbd->vkCode == g_pauseVK || kbd->vkCode == g_pasteVK) ? HeldModifiers() : 0;
+    bool plainKey = wParam == WM_KEYDOWN || wParam == WM_KEYUP;
+    if (g_controller->OnKey(ev, mods, plainKey) == HookVerdict::Pass)
         return CallNextHookEx(g_kbHook, nCode, wParam, lParam);
-    // Let the configured pause hotkey pass through untouched
-    if (kbd->vkCode == g_pauseVK) {
-        UINT current = 0;
-        if (GetAsyncKeyState(VK_CONTROL) & 0x8000) current |= MOD_CONTROL;
-        if (GetAsyncKeyState(VK_MENU) & 0x8000) current |= MOD_ALT;
-        if (GetAsyncKeyState(VK_SHIFT) & 0x8000) current |= MOD_SHIFT;
-        if (GetAsyncKeyState(VK_LWIN) & 0x8000) current |= MOD_WIN;
-        UINT required = g_pauseMods & (MOD_CONTROL | MOD_ALT | MOD_SHIFT | MOD_WIN);
-        if ((current & required) == required)
-            return CallNextHookEx(g_kbHook, nCode, wParam, lParam);
-    }
-    // === SPECIAL: Escape – cancel pause (only while actually paused) ===
-    if (g_targetPid != 0 && g_unpauseOnNextEsc && kbd->vkCode == VK_ESCAPE && wParam == WM_KEYDOWN) {
-        g_unpauseOnNextEsc = false;
-        // Order is CRITICAL: unhook FIRST, then resume the process
-        SetCaptureHook(false); // ← hook is now gone — no more events will be captured
-        SuspendOrResumeProcess(false); // ← game threads resume
-        g_targetPid = 0;
-        g_capturedWhilePaused.clear();
-        g_heldKeys.clear();
-        LogRetro("*** ESCAPE DETECTED: PAUSE CANCELLED *** - Discarding all captured input");
-        return -1; // eat this Esc down (keyup will never reach us)
-    }
-    // === SPECIAL: Escape – cancel on first Esc down, suppress Esc + any modifier keyups ===
-    if (g_unpauseOnNextEsc && kbd->vkCode == VK_ESCAPE && wParam == WM_KEYDOWN) {
-        g_unpauseOnNextEsc = false;
-        SetCaptureHook(false);
-        SuspendOrResumeProcess(false);
-        g_targetPid = 0;
-        g_capturedWhilePaused.clear();
-        g_heldKeys.clear();
-        LogRetro("*** ESCAPE DETECTED: PAUSE CANCELLED *** - Discarding all captured input");
-        return -1; // eat Esc down
-    }
-    if (g_unpauseOnNextEsc && kbd->vkCode == VK_ESCAPE && wParam == WM_KEYUP) {
-        g_unpauseOnNextEsc = false; // disarm on keyup too (safety)
-        return -1; // eat Esc up
-    }
-    // === SPECIAL: Enter – accept on first Enter down, suppress Enter + any modifier keyups ===
-    if (g_unpauseOnNextEnter && kbd->vkCode == VK_RETURN && wParam == WM_KEYDOWN) {
-        g_unpauseOnNextEnter = false;
-        SetCaptureHook(false);
-        SuspendOrResumeProcess(false);
-        SendCapturedInputs(); // only sends keys typed BEFORE this Enter
-        g_targetPid = 0;
-        LogRetro("*** ENTER DETECTED: PAUSE ACCEPTED *** - Replaying input (Enter suppressed)");
-        return -1; // eat Enter down
-    }
-    if (g_unpauseOnNextEnter && kbd->vkCode == VK_RETURN && wParam == WM_KEYUP) {
-        g_unpauseOnNextEnter = false; // disarm on keyup too
-        return -1; // eat Enter up
-    }
-    // Normal capture
-    if (wParam == WM_KEYDOWN) {
-        g_heldKeys.insert(static_cast<WORD>(kbd->vkCode));
-        INPUT inp = {};
-        inp.type = INPUT_KEYBOARD;
-        inp.ki.wVk = static_cast<WORD>(kbd->vkCode);
-        if (kbd->flags & LLKHF_EXTENDED) inp.ki.dwFlags |= KEYEVENTF_EXTENDEDKEY;
-        g_capturedWhilePaused.push_back(inp);
-    }
-    else if (wParam == WM_KEYUP) {
-        g_heldKeys.erase(static_cast<WORD>(kbd->vkCode));
-        INPUT inp = {};
-        inp.type = INPUT_KEYBOARD;
-        inp.ki.wVk = static_cast<WORD>(kbd->vkCode);
-        inp.ki.dwFlags = KEYEVENTF_KEYUP;
-        if (kbd->flags & LLKHF_EXTENDED) inp.ki.dwFlags |= KEYEVENTF_EXTENDEDKEY;
-        g_capturedWhilePaused.push_back(inp);
-    }
-    return -1; // Block all other keys while paused
+    return -1; // Blocked while paused (captured, or consumed as Esc/Enter)
 }
 // -----------------------------------------------------------------------------
-// Process suspend / resume
+// Keyboard state tracking (Raw Input - no hook, nothing blocks the input pipeline)
 // -----------------------------------------------------------------------------
-static void SuspendOrResumeProcess(bool suspend)
+static void ApplyRawKeyboard(const RAWKEYBOARD& kb)
+{
+    bool e0 = (kb.Flags & RI_KEY_E0) != 0;
+    // Raw Input reports generic modifiers; the hook reports sided ones - store sided
+    uint16_t vk = SidedVk(kb.VKey, kb.MakeCode, e0);
+    uint16_t flags = static_cast<uint16_t>(((kb.Flags & RI_KEY_BREAK) ? KEY_UP : 0) | (e0 ? KEY_EXTENDED : 0));
+    g_controller->PhysicalKeys().Apply(vk, kb.MakeCode, flags); // Ignores vk 0 and 255 (a driver's fake shift)
+}
+static LRESULT CALLBACK InputWindowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    if (msg == WM_INPUT) {
+        RAWINPUT raw;
+        UINT size = sizeof(raw);
+        if (GetRawInputData(reinterpret_cast<HRAWINPUT>(lParam), RID_INPUT, &raw, &size, sizeof(RAWINPUTHEADER)) != static_cast<UINT>(-1)
+            && raw.header.dwType == RIM_TYPEKEYBOARD)
+            ApplyRawKeyboard(raw.data.keyboard);
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+static void StartKeyTracking()
 {
-    if (!g_targetPid) return;
-    HANDLE snap = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
-    if (snap == INVALID_HANDLE_VALUE) {
-        LogRetro("ERROR: Could not snapshot threads for PID " + std::to_string(g_targetPid));
+    WNDCLASSEXW wc = { sizeof(wc) };
+    wc.lpfnWndProc = InputWindowProc;
+    wc.hInstance = GetModuleHandle(nullptr);
+    wc.lpszClassName = L"GamePauserInput";
+    RegisterClassExW(&wc);
+    g_inputWindow = CreateWindowExW(0, wc.lpszClassName, L"", 0, 0, 0, 0, 0, HWND_MESSAGE, nullptr, wc.hInstance, nullptr);
+    RAWINPUTDEVICE rid = { 0x01, 0x06, RIDEV_INPUTSINK, g_inputWindow }; // Generic desktop / keyboard
+    if (!g_inputWindow || !RegisterRawInputDevices(&rid, 1, sizeof(rid))) {
+        LogRetro("WARNING: Raw keyboard tracking unavailable - held keys may not be released before pausing");
         return;
     }
-    THREADENTRY32 te = { sizeof(te) };
-    int count = 0;
-    if (Thread32First(snap, &te)) {
-        do {
-            if (te.th32OwnerProcessID == g_targetPid) {
-                HANDLE hThread = OpenThread(THREAD_SUSPEND_RESUME, FALSE, te.th32ThreadID);
-                if (hThread) {
-                    suspend ? SuspendThread(hThread) : ResumeThread(hThread);
-                    CloseHandle(hThread);
-                    ++count;
-                }
-            }
-        } while (Thread32Next(snap, &te));
+    // One poll at startup seeds keys that were already down; from here on it's event-driven.
+    // Only keys whose release Raw Input will report: a mouse button or generic modifier
+    // seeded here would stay down and get a spurious key-up injected at every pause.
+    // Generic modifiers are covered by their VK_L*/VK_R* codes, polled in the same loop.
+    for (uint16_t vk = 1; vk < 255; ++vk) {
+        if (RawKeyboardVk(vk) && (GetAsyncKeyState(vk) & 0x8000))
+            g_controller->PhysicalKeys().Press(vk, vk == VK_RCONTROL || vk == VK_RMENU); // Right Ctrl/Alt are E0 keys
     }
-    CloseHandle(snap);
-    std::ostringstream oss;
-    oss << (suspend ? "*** PROCESS PAUSED ***" : "*** PROCESS RESUMED ***") << " PID: " << g_targetPid << " (" << count << " threads affected)";
-    LogRetro(oss.str());
+}
+// Apply any WM_INPUT still queued so the snapshot includes the hotkey chord itself
+static void FlushPendingRawInput()
+{
+    MSG msg;
+    while (g_inputWindow && PeekMessage(&msg, g_inputWindow, WM_INPUT, WM_INPUT, PM_REMOVE))
+        DispatchMessage(&msg);
 }
 // -----------------------------------------------------------------------------
-// Replay captured keystrokes
+// Paste while paused: clipboard text compiled into keystrokes
 // -----------------------------------------------------------------------------
-static void SendCapturedInputs()
+// A text file's contents: UTF-16 if it has the BOM, UTF-8 otherwise
+static std::u32string ReadTextFile(const std::wstring& path)
 {
-    if (g_capturedWhilePaused.empty() && g_heldKeys.empty()) {
-        LogRetro("*** INPUT REPLAY: Nothing queued - proceeding empty-handed ***");
+    std::string bytes;
+    HANDLE f = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (f == INVALID_HANDLE_VALUE) return std::u32string();
+    LARGE_INTEGER size = {};
+    if (GetFileSizeEx(f, &size) && size.QuadPart > 0 && size.QuadPart < (64LL << 20)) { // Far beyond PasteMaxChars anyway
+        bytes.resize(static_cast<size_t>(size.QuadPart));
+        DWORD read = 0;
+        if (!ReadFile(f, &bytes[0], static_cast<DWORD>(bytes.size()), &read, nullptr)) read = 0;
+        bytes.resize(read);
+    }
+    CloseHandle(f);
+    if (bytes.size() >= 2 && static_cast<unsigned char>(bytes[0]) == 0xFF && static_cast<unsigned char>(bytes[1]) == 0xFE)
+        return DecodeUtf16(reinterpret_cast<const char16_t*>(bytes.data()), bytes.size() / 2);
+    return DecodeUtf8(bytes);
+}
+// Unicode text, or the first file of a file list copied in Explorer
+static std::u32string ReadClipboardText(const char*& source)
+{
+    std::u32string text;
+    source = "clipboard";
+    for (int attempt = 0; attempt < 10 && !OpenClipboard(nullptr); ++attempt) Sleep(5); // Another app may hold it briefly
+    if (HANDLE h = GetClipboardData(CF_UNICODETEXT)) {
+        if (const wchar_t* w = static_cast<const wchar_t*>(GlobalLock(h))) {
+            text = DecodeUtf16(reinterpret_cast<const char16_t*>(w), wcslen(w));
+            GlobalUnlock(h);
+        }
+    }
+    else if (HANDLE drop = GetClipboardData(CF_HDROP)) {
+        wchar_t path[MAX_PATH] = {};
+        if (DragQueryFileW(static_cast<HDROP>(drop), 0, path, MAX_PATH)) {
+            text = ReadTextFile(path);
+            source = "copied file";
+        }
+    }
+    CloseClipboard();
+    return text;
+}
+// The foreground (normally the paused) window's own layout and Caps Lock, not ours
+static TextProgram CompileForPause(const std::u32string& text)
+{
+    HKL hkl = GetKeyboardLayout(GetWindowThreadProcessId(GetForegroundWindow(), nullptr));
+    KeyLayout layout = KeyLayoutFromSystem(hkl, text);
+    TextCompileOptions opt = g_pasteOptions;
+    opt.capsLock = (GetKeyState(VK_CAPITAL) & 1) != 0;
+    return TextCompiler(layout, opt).Compile(text);
+}
+static void PasteIntoPause()
+{
+    uint32_t target = g_controller->TargetPid();
+    if (!target) {
+        LogRetro("WARNING: Paste works during a pause - pause the game first");
         return;
     }
-    std::ostringstream oss;
-    oss << "*** INPUT REPLAY INITIATED ***";
-    if (!g_heldKeys.empty()) oss << " (Releasing chord of " << g_heldKeys.size() << " held keys)";
-    if (!g_capturedWhilePaused.empty()) oss << " (" << g_capturedWhilePaused.size() / 2 << " key events)";
-    LogRetro(oss.str());
-    Sleep(380);
-    HWND fg = GetForegroundWindow();
-    DWORD fgThreadId = GetWindowThreadProcessId(fg, nullptr);
-    bool attached = false;
-    if (fgThreadId && fgThreadId != GetCurrentThreadId()) {
-        attached = AttachThreadInput(GetCurrentThreadId(), fgThreadId, TRUE);
-        if (attached) Sleep(15);
-    }
-    // Press all currently held keys first
-    for (WORD vk : g_heldKeys) {
-        INPUT inp = {};
-        inp.type = INPUT_KEYBOARD;
-        inp.ki.wVk = vk;
-        for (const auto& saved : g_capturedWhilePaused) {
-            if (saved.ki.wVk == vk && !(saved.ki.dwFlags & KEYEVENTF_KEYUP)) {
-                if (saved.ki.dwFlags & KEYEVENTF_EXTENDEDKEY)
-                    inp.ki.dwFlags |= KEYEVENTF_EXTENDEDKEY;
-                break;
+    const char* source = nullptr;
+    std::u32string text = ReadClipboardText(source);
+    if (text.empty()) {
+        LogRetro("WARNING: Nothing to paste - the clipboard has no text");
+        return;
+    }
+    TextProgram program = CompileForPause(text);
+    g_controller->QueuePaste(program);
+    LogRetroF("*** PASTE QUEUED *** - %zu characters from the %s (%zu typed, %zu as unicode, %zu modifier presses instead of %zu)",
+        program.chars, source, program.keyed, program.unicode, program.modifierEvents, program.naiveModifierEvents);
+    if (program.skipped)
+        LogRetroF("Note: %zu characters left out (control characters or past PasteMaxChars)", program.skipped);
+    LogRetroF("Types in %.1f s at %.0f chars/s once you resume", program.durationNs / 1e9, g_pasteOptions.charsPerSecond);
+}
+// -----------------------------------------------------------------------------
+// Macros: saved pause sessions, played back by hotkey
+// -----------------------------------------------------------------------------
+static void SaveLastSession()
+{
+    std::vector<KeyEvent> session = g_controller->LastSession();
+    if (session.empty()) {
+        LogRetro("Nothing to save yet - pause, type, then resume, Enter or Esc first");
+        return;
+    }
+    char name[64];
+    time_t now = time(nullptr);
+    tm local = {};
+    localtime_s(&local, &now);
+    strftime(name, sizeof(name), "session-%Y%m%d-%H%M%S", &local);
+    if (!g_macros.IsOpen() && !g_macros.Missing()) { // Saving would replace whatever is there with this one macro
+        LogRetroF("ERROR: Not saving - %s could not be loaded (%s)", g_macroPath.c_str(), g_macros.Error().c_str());
+        return;
+    }
+    MacroLibraryWriter writer;
+    writer.AddLibrary(g_macros);
+    writer.Add(name, session.data(), session.size());
+    std::string error;
+    if (!writer.Write(g_macroPath, &g_macros, &error)) {
+        LogRetroF("ERROR: Could not save the macro - %s", error.c_str());
+        return;
+    }
+    LogRetroF("*** MACRO SAVED *** - '%s' (%zu key events, %zu macros in library)", name, session.size(), g_macros.Count());
+}
+static void PlayBoundMacro(size_t index)
+{
+    const MacroBinding& b = g_macroBindings[index];
+    if (g_controller->Paused()) {
+        LogRetro("WARNING: Macros don't play during a pause - resume first");
+        return;
+    }
+    MacroView m = g_macros.Find(b.name);
+    if (!m.Valid()) {
+        LogRetroF("WARNING: No macro named '%s' in %s", b.name.c_str(), g_macroPath.c_str());
+        return;
+    }
+    FlushPendingRawInput(); // So the hotkey's own modifiers are known to be held
+    g_controller->PlayMacro(b.name.c_str(), m.events, m.count); // Straight from the mapped file
+}
+// -----------------------------------------------------------------------------
+// Profiles: calibrate the foreground game's key rate and save it to the INI
+// -----------------------------------------------------------------------------
+// Calibration target: a text box in the foreground game. What arrived is read
+// back by selecting it all and copying it; the box is cleared before each run.
+// The user's clipboard text is put back afterwards.
+class ClipboardEchoTarget : public CalibrationTarget
+{
+public:
+    void Begin() override
+    {
+        m_saved = ReadClipboard();
+        g_sendInput.Begin();
+    }
+    void Send(const KeyEvent* events, size_t count) override { g_sendInput.Send(events, count); }
+    void End() override
+    {
+        Chord('A');
+        Tap(VK_BACK);
+        g_sendInput.End();
+        WriteClipboard(m_saved);
+    }
+    void Reset() override
+    {
+        Chord('A');
+        Tap(VK_BACK);
+    }
+    std::string Received() override
+    {
+        WriteClipboard(std::wstring()); // So a box that ignores Ctrl+C reads as empty, not stale
+        Chord('A');
+        Chord('C');
+        Sleep(100);
+        std::string letters;
+        for (wchar_t c : ReadClipboard())
+            if ((c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z')) letters.push_back(static_cast<char>(c));
+        return letters;
+    }
+
+private:
+    // Slow enough for anything: the calibration's own starting gap
+    void Key(WORD vk, bool up)
+    {
+        KeyEvent ev = { 0, vk, 0, static_cast<uint16_t>(up ? KEY_UP : 0), 0 };
+        g_sendInput.Send(&ev, 1);
+        Sleep(g_calibrationOptions.startGapMs);
+    }
+    void Tap(WORD vk)
+    {
+        Key(vk, false);
+        Key(vk, true);
+    }
+    void Chord(WORD vk)
+    {
+        Key(VK_CONTROL, false);
+        Tap(vk);
+        Key(VK_CONTROL, true);
+    }
+    static std::wstring ReadClipboard()
+    {
+        std::wstring text;
+        for (int attempt = 0; attempt < 10 && !OpenClipboard(nullptr); ++attempt) Sleep(5);
+        if (HANDLE h = GetClipboardData(CF_UNICODETEXT)) {
+            if (const wchar_t* w = static_cast<const wchar_t*>(GlobalLock(h))) {
+                text = w;
+                GlobalUnlock(h);
+            }
+        }
+        CloseClipboard();
+        return text;
+    }
+    static void WriteClipboard(const std::wstring& text)
+    {
+        for (int attempt = 0; attempt < 10 && !OpenClipboard(nullptr); ++attempt) Sleep(5);
+        EmptyClipboard();
+        if (!text.empty()) {
+            if (HGLOBAL mem = GlobalAlloc(GMEM_MOVEABLE, (text.size() + 1) * sizeof(wchar_t))) {
+                if (void* p = GlobalLock(mem)) {
+                    memcpy(p, text.c_str(), (text.size() + 1) * sizeof(wchar_t));
+                    GlobalUnlock(mem);
+                    if (!SetClipboardData(CF_UNICODETEXT, mem)) GlobalFree(mem); // The clipboard owns it on success
+                }
+                else {
+                    GlobalFree(mem);
+                }
             }
         }
-        SendInput(1, &inp, sizeof(INPUT));
-    }
-    Sleep(1);
-    // Replay recorded events
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> jitter(18, 45);
-    for (size_t i = 0; i < g_capturedWhilePaused.size(); ++i) {
-        SendInput(1, &g_capturedWhilePaused[i], sizeof(INPUT));
-        if (i + 1 < g_capturedWhilePaused.size())
-            Sleep(jitter(gen));
-    }
-    if (attached) AttachThreadInput(GetCurrentThreadId(), fgThreadId, FALSE);
-    LogRetro("*** INPUT REPLAY COMPLETE *** - Target process fully updated");
-    g_capturedWhilePaused.clear();
-    g_heldKeys.clear();
+        CloseClipboard();
+    }
+
+    std::wstring m_saved;
+};
+// Rewrites the game's ProfileN line (or adds one) - written aside, then swapped in
+static bool SaveProfile(const ReplayProfile& profile, std::string& error)
+{
+    std::string text;
+    {
+        std::ifstream in(g_iniPath, std::ios::binary);
+        if (in) text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    std::string tmp = g_iniPath + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out << UpdateProfileIni(text, profile);
+        if (!out.flush()) {
+            error = "could not write " + tmp;
+            return false;
+        }
+    }
+    if (!MoveFileExA(tmp.c_str(), g_iniPath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        error = "could not replace " + g_iniPath;
+        return false;
+    }
+    return true;
+}
+static void CalibrateForeground()
+{
+    if (g_controller->Paused()) {
+        LogRetro("WARNING: Calibration needs the game running - resume first");
+        return;
+    }
+    DWORD pid = 0;
+    GetWindowThreadProcessId(GetForegroundWindow(), &pid);
+    if (!pid || pid == GetCurrentProcessId()) return;
+    std::string image;
+    for (const ProcessInfo& p : ListProcesses())
+        if (p.pid == pid) image = p.name;
+    if (image.empty()) {
+        LogRetroF("WARNING: Could not find the image name of PID %u", pid);
+        return;
+    }
+    LogRetroF("*** CALIBRATING *** - %s: typing test letters into the focused text box, hands off the keyboard", image.c_str());
+    // The hotkey chord is still down - release it or every letter is a Ctrl+Alt shortcut
+    FlushPendingRawInput();
+    std::vector<KeyEvent> releases;
+    g_controller->PhysicalKeys().Snapshot().HeldEvents(releases, true);
+    if (!releases.empty()) g_sendInput.Send(releases.data(), releases.size());
+    Sleep(g_calibrationOptions.settleMs);
+    ClipboardEchoTarget target;
+    CalibrationResult result = ReplayCalibrator(g_calibrationOptions).Run(target, [](const CalibrationStep& step) {
+        LogRetroF("    %3d ms apart: %d/%d sequences intact%s", step.gapMs, step.passed, step.trials, step.passed == step.trials ? "" : " - keys lost");
+    });
+    if (!result.ok) {
+        LogRetroF("WARNING: Calibration failed - %s. Is a text box focused, and does it take Ctrl+A / Ctrl+C?", result.error.c_str());
+        return;
+    }
+    const ReplayProfile* existing = g_profiles.Find(image);
+    ReplayProfile profile = existing ? *existing : ReplayProfile{ image, g_replayOptions };
+    profile.replay.minGapMs = result.recommendedGapMs;
+    g_profiles.Set(profile);
+    g_controller->SetProfile(profile);
+    std::string error;
+    if (!SaveProfile(profile, error))
+        LogRetroF("WARNING: Profile not saved to the INI - %s (used until exit)", error.c_str());
+    LogRetroF("*** CALIBRATION COMPLETE *** - %s takes keys %d ms apart; MinGapMs = %d with margin (%.1f s)", image.c_str(),
+        result.fastestGapMs, result.recommendedGapMs, result.elapsedNs / 1e9);
 }
 // -----------------------------------------------------------------------------
 // Configuration and cleanup
@@ -399,33 +1010,436 @@ static void LoadConfig()
     }
     g_pauseVK = StringToVK(settings.count("PauseKey") ? settings["PauseKey"] : "P");
     if (g_pauseVK == 0) g_pauseVK = 'P';
-    g_pauseMods = ModifiersFromString(settings.count("Modifiers") ? settings["Modifiers"] : "Ctrl+Alt")
-        | MOD_NOREPEAT;
+    g_pauseMods = ModifiersFromString(settings.count("Modifiers") ? settings["Modifiers"] : "Ctrl+Alt");
     g_retroLogs = settings.count("RetroLogs") ? (trim(settings["RetroLogs"]) == "1") : true;
-    if (!RegisterHotKey(nullptr, HOTKEY_ID, g_pauseMods, g_pauseVK)) {
-        LogRetro("*** HOTKEY REGISTRATION FAILED *** - Run as administrator or change in INI (Modifiers/PauseKey)");
-        std::cerr << "Failed to register hotkey - try running as administrator or choose a different combination\n";
+    g_log.SetRetro(g_retroLogs);
+    if (settings.count("RingSize")) {
+        try { g_ringCapacity = std::max(64, std::stoi(settings["RingSize"])); }
+        catch (...) {}
     }
-    else {
-        std::ostringstream oss;
-        oss << "*** HOTKEY READY *** " << (settings.count("Modifiers") ? settings["Modifiers"] : "Ctrl+Alt")
-            << " + " << (settings.count("PauseKey") ? settings["PauseKey"] : "P");
-        LogRetro(oss.str());
-        LogRetro("Press the hotkey to pause/resume the foreground process");
+    if (settings.count("Overflow")) g_overflowPolicy = OverflowPolicyFromString(settings["Overflow"]);
+    if (settings.count("Optimize")) g_optimizeOptions = CaptureOptimizeFromString(trim(settings["Optimize"]));
+    if (settings.count("IncludeChildren")) g_targetOptions.includeChildren = trim(settings["IncludeChildren"]) == "1";
+    if (settings.count("Processes")) {
+        std::stringstream list(settings["Processes"]);
+        std::string name;
+        while (std::getline(list, name, ',')) {
+            name = ToLowerAscii(trim(name));
+            if (!name.empty()) g_targetOptions.imageNames.push_back(name);
+        }
+    }
+    if (settings.count("Order")) g_groupOrder = GroupOrderFromString(trim(settings["Order"]));
+    if (settings.count("Policy")) g_replayOptions.policy = ReplayPolicyFromString(settings["Policy"]);
+    try {
+        if (settings.count("LeadDelayMs")) g_replayOptions.leadDelayMs = std::max(0, std::stoi(settings["LeadDelayMs"]));
+        if (settings.count("Speed")) g_replayOptions.speed = std::max(0.1, std::stod(settings["Speed"]));
+        if (settings.count("BatchSize")) g_replayOptions.batchSize = static_cast<size_t>(std::max(1, std::stoi(settings["BatchSize"])));
+        if (settings.count("MaxGapMs")) g_replayOptions.maxGapMs = std::max(0, std::stoi(settings["MaxGapMs"]));
+        if (settings.count("MinGapMs")) g_replayOptions.minGapMs = std::max(0, std::stoi(settings["MinGapMs"]));
+    }
+    catch (...) {
+        LogRetro("WARNING: Invalid number in [Replay] section - keeping defaults for the rest");
+    }
+    if (settings.count("Metrics")) g_metricsEnabled = trim(settings["Metrics"]) == "1";
+    if (settings.count("MetricsPort")) {
+        try { g_metricsPort = static_cast<uint16_t>(std::min(65535, std::max(1, std::stoi(settings["MetricsPort"])))); }
+        catch (...) {}
+    }
+    if (settings.count("TrimWhilePaused")) g_memoryOptions.trimWhilePaused = trim(settings["TrimWhilePaused"]) == "1";
+    if (settings.count("PrefetchOnResume")) g_memoryOptions.prefetchOnResume = trim(settings["PrefetchOnResume"]) == "1";
+    if (settings.count("PrefetchLimitMB")) {
+        try { g_memoryOptions.prefetchLimit = static_cast<uint64_t>(std::max(0, std::stoi(settings["PrefetchLimitMB"]))) << 20; }
+        catch (...) {}
+    }
+    if (settings.count("ResumeOrder")) g_resumeOptions.order = ResumeOrderFromString(trim(settings["ResumeOrder"]));
+    try {
+        if (settings.count("LeadThreads")) g_resumeOptions.leadThreads = static_cast<size_t>(std::max(0, std::stoi(settings["LeadThreads"])));
+        if (settings.count("StaggerMs")) g_resumeOptions.staggerMs = std::max(0, std::stoi(settings["StaggerMs"]));
+        if (settings.count("WarmupMs")) g_resumeOptions.warmupMs = std::max(0, std::stoi(settings["WarmupMs"]));
+    }
+    catch (...) {
+        LogRetro("WARNING: Invalid number in [Resume] section - keeping defaults for the rest");
+    }
+    if (settings.count("WarmupPin")) g_resumeOptions.warmupPin = trim(settings["WarmupPin"]) == "1";
+    if (settings.count("LeadOnRunning")) g_resumeOptions.leadOnRunning = trim(settings["LeadOnRunning"]) == "1";
+    if (settings.count("ThrottleKey")) g_throttleVK = StringToVK(settings["ThrottleKey"]);
+    if (settings.count("ThrottleModifiers")) g_throttleMods = ModifiersFromString(settings["ThrottleModifiers"]);
+    try {
+        if (settings.count("ThrottleShare")) g_throttleOptions.share = std::min(100.0, std::max(1.0, std::stod(settings["ThrottleShare"]))) / 100.0;
+        if (settings.count("ThrottlePeriodMs")) g_throttleOptions.periodMs = std::min(1000, std::max(2, std::stoi(settings["ThrottlePeriodMs"])));
     }
+    catch (...) {
+        LogRetro("WARNING: Invalid number in [Throttle] section - keeping defaults for the rest");
+    }
+    if (settings.count("ThrottleAdaptive")) g_throttleOptions.adaptive = trim(settings["ThrottleAdaptive"]) == "1";
+    if (settings.count("ThrottleProcesses")) {
+        std::stringstream list(settings["ThrottleProcesses"]);
+        std::string name;
+        while (std::getline(list, name, ',')) {
+            name = ToLowerAscii(trim(name));
+            if (!name.empty()) g_throttleRules.push_back(name);
+        }
+    }
+    if (settings.count("FocusGames")) g_focusOptions.games = ParseImageList(settings["FocusGames"]);
+    if (settings.count("FocusFreeze")) g_focusOptions.background = ParseImageList(settings["FocusFreeze"]);
+    if (settings.count("Journal")) g_journalEnabled = trim(settings["Journal"]) != "0";
+    if (settings.count("Watchdog")) g_watchdogEnabled = trim(settings["Watchdog"]) != "0";
+    if (settings.count("Trace")) g_traceEnabled = trim(settings["Trace"]) == "1";
+    if (settings.count("TraceFile")) g_tracePath = trim(settings["TraceFile"]);
+    try {
+        if (settings.count("TraceEvents")) g_traceEvents = static_cast<size_t>(std::max(16, std::stoi(settings["TraceEvents"])));
+    }
+    catch (...) {
+        LogRetro("WARNING: Invalid TraceEvents in [Trace] section - keeping the default");
+    }
+    if (settings.count("PasteKey")) g_pasteVK = StringToVK(settings["PasteKey"]);
+    if (settings.count("PasteModifiers")) g_pasteMods = ModifiersFromString(settings["PasteModifiers"]);
+    try {
+        if (settings.count("PasteRate")) g_pasteOptions.charsPerSecond = std::min(5000.0, std::max(1.0, std::stod(settings["PasteRate"])));
+        if (settings.count("PasteMaxChars")) g_pasteOptions.maxChars = static_cast<size_t>(std::max(0, std::stoi(settings["PasteMaxChars"])));
+    }
+    catch (...) {
+        LogRetro("WARNING: Invalid number in [Paste] section - keeping defaults for the rest");
+    }
+    if (settings.count("PasteNewlines")) g_pasteOptions.enterForNewline = trim(settings["PasteNewlines"]) == "1";
+    if (settings.count("CalibrateKey")) g_calibrateVK = StringToVK(settings["CalibrateKey"]);
+    if (settings.count("CalibrateModifiers")) g_calibrateMods = ModifiersFromString(settings["CalibrateModifiers"]);
+    if (settings.count("CalibrateStartMs")) {
+        try { g_calibrationOptions.startGapMs = std::min(1000, std::max(2, std::stoi(settings["CalibrateStartMs"]))); }
+        catch (...) {}
+    }
+    for (const auto& kv : settings) {
+        // Profile<N> = <image>, Policy=..., LeadDelayMs=..., MinGapMs=...
+        if (kv.first.size() <= 7 || kv.first.compare(0, 7, "Profile") != 0
+            || kv.first.find_first_not_of("0123456789", 7) != std::string::npos) continue;
+        ReplayProfile profile;
+        std::string error;
+        if (!ParseReplayProfile(kv.second, g_replayOptions, profile, &error)) {
+            LogRetroF("WARNING: Ignoring %s - expected e.g. %s = game.exe, Policy=faithful, LeadDelayMs=120", kv.first.c_str(), kv.first.c_str());
+            continue;
+        }
+        if (!error.empty()) LogRetroF("WARNING: %s (%s) - %s", kv.first.c_str(), profile.image.c_str(), error.c_str());
+        if (g_profiles.Find(profile.image)) LogRetroF("WARNING: %s repeats the profile for %s - the later one wins", kv.first.c_str(), profile.image.c_str());
+        g_profiles.Set(profile);
+    }
+    if (settings.count("Control")) g_controlEnabled = trim(settings["Control"]) == "1";
+    if (settings.count("ControlPath")) g_controlPath = trim(settings["ControlPath"]);
+    if (settings.count("MacroFile")) g_macroPath = settings["MacroFile"];
+    if (settings.count("SaveMacroKey")) g_saveMacroVK = StringToVK(settings["SaveMacroKey"]);
+    if (settings.count("SaveMacroModifiers")) g_saveMacroMods = ModifiersFromString(settings["SaveMacroModifiers"]);
+    for (const auto& kv : settings) {
+        // Macro<N> = <Modifiers>+<Key>, <macro name>
+        if (kv.first.size() <= 5 || kv.first.compare(0, 5, "Macro") != 0
+            || kv.first.find_first_not_of("0123456789", 5) != std::string::npos) continue;
+        size_t comma = kv.second.find(',');
+        std::string combo = trim(kv.second.substr(0, comma));
+        std::string name = comma == std::string::npos ? "" : trim(kv.second.substr(comma + 1));
+        size_t plus = combo.find_last_of('+');
+        MacroBinding b;
+        b.vk = StringToVK(trim(plus == std::string::npos ? combo : combo.substr(plus + 1)));
+        b.mods = plus == std::string::npos ? 0 : ModifiersFromString(combo.substr(0, plus));
+        b.name = name;
+        if (b.vk == 0 || name.empty())
+            LogRetroF("WARNING: Ignoring %s - expected e.g. %s = Ctrl+Alt+F1, macro name", kv.first.c_str(), kv.first.c_str());
+        else
+            g_macroBindings.push_back(b);
+    }
+    g_hotkeyLabel = (settings.count("Modifiers") ? settings["Modifiers"] : "Ctrl+Alt") + " + "
+        + (settings.count("PauseKey") ? settings["PauseKey"] : "P");
     LogRetro("*** CONFIG LOAD COMPLETE *** - System armed and waiting...");
 }
+// Everything LoadConfig() sets, back to the built-in defaults (same values as the globals start with)
+static void ResetConfig()
+{
+    g_pauseVK = 'P';
+    g_pauseMods = MOD_CONTROL | MOD_ALT;
+    g_retroLogs = true;
+    g_ringCapacity = 4096;
+    g_overflowPolicy = OverflowPolicy::Spill;
+    g_optimizeOptions = CaptureOptimizeOptions();
+    g_targetOptions = PauseTargetOptions();
+    g_groupOrder = GroupOrder::ChildrenFirst;
+    g_replayOptions = ReplayOptions();
+    g_profiles = ReplayProfiles();
+    g_calibrateVK = 0;
+    g_calibrateMods = MOD_CONTROL | MOD_ALT;
+    g_calibrationOptions = CalibrationOptions();
+    g_metricsEnabled = false;
+    g_metricsPort = 9464;
+    g_memoryOptions = MemoryOptions();
+    g_resumeOptions = ResumeOptions();
+    g_throttleVK = 0;
+    g_throttleMods = MOD_CONTROL | MOD_ALT;
+    g_throttleOptions = ThrottleOptions();
+    g_throttleRules.clear();
+    g_focusOptions = FocusOptions();
+    g_journalEnabled = true;
+    g_watchdogEnabled = true;
+    g_traceEnabled = false;
+    g_tracePath = "GamePauser.trace.json";
+    g_traceEvents = TRACE_DEFAULT_EVENTS;
+    g_macroPath = "GamePauser.macros";
+    g_saveMacroVK = 0;
+    g_saveMacroMods = MOD_CONTROL | MOD_ALT;
+    g_macroBindings.clear();
+    g_pasteVK = 0;
+    g_pasteMods = MOD_CONTROL | MOD_ALT;
+    g_pasteOptions = TextCompileOptions();
+    g_controlEnabled = true;
+    g_controlPath.clear();
+}
+static PauseConfig BuildPauseConfig()
+{
+    PauseConfig config;
+    config.pauseVK = g_pauseVK;
+    config.pauseMods = g_pauseMods;
+    config.pasteVK = g_pasteVK;
+    config.pasteMods = g_pasteMods;
+    config.ringCapacity = g_ringCapacity;
+    config.overflow = g_overflowPolicy;
+    config.replay = g_replayOptions;
+    config.optimize = g_optimizeOptions;
+    config.profiles = g_profiles;
+    return config;
+}
+static void OpenMacroLibrary()
+{
+    if (g_macroPath.find(':') == std::string::npos && g_macroPath[0] != '\\' && g_macroPath[0] != '/')
+        g_macroPath = g_iniPath.substr(0, g_iniPath.find_last_of("\\/") + 1) + g_macroPath; // Next to the exe
+    uint64_t mapStart = MonotonicNs();
+    if (g_macros.Open(g_macroPath))
+        LogRetroF("*** MACRO LIBRARY MAPPED *** - %zu macros from %s (%.2f ms)", g_macros.Count(), g_macroPath.c_str(), (MonotonicNs() - mapStart) / 1e6);
+    else if (GetFileAttributesA(g_macroPath.c_str()) != INVALID_FILE_ATTRIBUTES)
+        LogRetroF("WARNING: Could not load macro library %s - %s", g_macroPath.c_str(), g_macros.Error().c_str());
+}
+// Every hotkey except the pause hotkey, which the PauseController registers itself
+static void RegisterHotkeys()
+{
+    if (g_throttleVK) {
+        if (RegisterHotKey(nullptr, THROTTLE_HOTKEY_ID, g_throttleMods | MOD_NOREPEAT, g_throttleVK))
+            LogRetroF("*** THROTTLE HOTKEY READY *** - runs the foreground process at %.0f%% of a core", g_throttleOptions.share * 100);
+        else
+            LogRetro("WARNING: Could not register the throttle hotkey - change ThrottleKey/ThrottleModifiers in INI");
+    }
+    if (g_saveMacroVK) {
+        if (RegisterHotKey(nullptr, SAVE_MACRO_HOTKEY_ID, g_saveMacroMods | MOD_NOREPEAT, g_saveMacroVK))
+            LogRetro("*** MACRO SAVE HOTKEY READY *** - keeps the last pause session as a macro");
+        else
+            LogRetro("WARNING: Could not register the macro save hotkey - change SaveMacroKey/SaveMacroModifiers in INI");
+    }
+    for (size_t i = 0; i < g_macroBindings.size(); ++i) {
+        const MacroBinding& b = g_macroBindings[i];
+        if (!RegisterHotKey(nullptr, MACRO_HOTKEY_BASE + static_cast<int>(i), b.mods | MOD_NOREPEAT, b.vk))
+            LogRetroF("WARNING: Could not register the hotkey for macro '%s'", b.name.c_str());
+        else if (!g_macros.Find(b.name).Valid())
+            LogRetroF("WARNING: Macro '%s' is bound but not in the library (yet)", b.name.c_str());
+    }
+    if (g_pasteVK) {
+        if (RegisterHotKey(nullptr, PASTE_HOTKEY_ID, g_pasteMods | MOD_NOREPEAT, g_pasteVK))
+            LogRetroF("*** PASTE HOTKEY READY *** - queues clipboard text into a pause at %.0f chars/s", g_pasteOptions.charsPerSecond);
+        else
+            LogRetro("WARNING: Could not register the paste hotkey - change PasteKey/PasteModifiers in INI");
+    }
+    if (!g_macroBindings.empty()) LogRetroF("*** MACRO HOTKEYS READY *** - %zu bound", g_macroBindings.size());
+    if (g_calibrateVK) {
+        if (RegisterHotKey(nullptr, CALIBRATE_HOTKEY_ID, g_calibrateMods | MOD_NOREPEAT, g_calibrateVK))
+            LogRetro("*** CALIBRATE HOTKEY READY *** - focus a text box in the game, then press it");
+        else
+            LogRetro("WARNING: Could not register the calibrate hotkey - change CalibrateKey/CalibrateModifiers in INI");
+    }
+}
+static void UnregisterHotkeys()
+{
+    UnregisterHotKey(nullptr, THROTTLE_HOTKEY_ID);
+    UnregisterHotKey(nullptr, SAVE_MACRO_HOTKEY_ID);
+    UnregisterHotKey(nullptr, PASTE_HOTKEY_ID);
+    UnregisterHotKey(nullptr, CALIBRATE_HOTKEY_ID);
+    for (size_t i = 0; i < g_macroBindings.size(); ++i) UnregisterHotKey(nullptr, MACRO_HOTKEY_BASE + static_cast<int>(i));
+}
+// -----------------------------------------------------------------------------
+// Control channel: remote commands run on the message thread, like hotkeys
+// -----------------------------------------------------------------------------
+struct ControlJob
+{
+    ControlCommand command;
+    std::string reply;
+    ControlStatus status = ControlStatus::Failed;
+    std::promise<void> done;
+};
+// Called on a control client's thread. The job is shared, so a client that gives
+// up at shutdown leaves nothing dangling for the message loop.
+static ControlStatus RunOnMessageThread(const ControlCommand& command, std::string& reply)
+{
+    std::shared_ptr<ControlJob> job = std::make_shared<ControlJob>();
+    job->command = command;
+    std::future<void> done = job->done.get_future();
+    std::shared_ptr<ControlJob>* posted = new std::shared_ptr<ControlJob>(job);
+    if (!PostThreadMessage(g_mainThreadId, WM_CONTROL_COMMAND, 0, reinterpret_cast<LPARAM>(posted))) {
+        delete posted;
+        reply = "the message queue is full";
+        return ControlStatus::Unavailable;
+    }
+    // Waits out a replay in progress rather than timing out and running later anyway
+    while (done.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+        if (!g_controlServer.Running()) {
+            reply = "GamePauser is shutting down";
+            return ControlStatus::Unavailable;
+        }
+    }
+    reply = job->reply;
+    return job->status;
+}
+static void RunControlCommand(LPARAM lParam)
+{
+    std::unique_ptr<std::shared_ptr<ControlJob>> posted(reinterpret_cast<std::shared_ptr<ControlJob>*>(lParam));
+    ControlJob& job = **posted;
+    job.status = job.command(job.reply);
+    job.done.set_value();
+}
+// -----------------------------------------------------------------------------
+// Focus mode: foreground changes arrive as WinEvents on the message loop, the
+// game's exit through a thread-pool wait that posts WM_FOCUS_EXITED
+// -----------------------------------------------------------------------------
+static void UnwatchFocusGame()
+{
+    if (g_focusWait) UnregisterWaitEx(g_focusWait, INVALID_HANDLE_VALUE); // Waits out a callback in flight
+    if (g_focusProcess) CloseHandle(g_focusProcess);
+    g_focusWait = g_focusProcess = nullptr;
+}
+static VOID CALLBACK FocusGameExited(PVOID param, BOOLEAN)
+{
+    PostThreadMessage(g_mainThreadId, WM_FOCUS_EXITED, reinterpret_cast<WPARAM>(param), 0);
+}
+static void WatchFocusGame(DWORD pid)
+{
+    UnwatchFocusGame();
+    g_focusProcess = OpenProcess(SYNCHRONIZE, FALSE, pid);
+    if (g_focusProcess && !RegisterWaitForSingleObject(&g_focusWait, g_focusProcess, FocusGameExited,
+            reinterpret_cast<PVOID>(static_cast<uintptr_t>(pid)), INFINITE, WT_EXECUTEONLYONCE))
+        g_focusWait = nullptr;
+    if (!g_focusWait) LogRetroF("WARNING: Can't watch PID %u for exit - focus mode ends when it loses focus", pid);
+}
+static void CALLBACK ForegroundChanged(HWINEVENTHOOK, DWORD, HWND hwnd, LONG, LONG, DWORD, DWORD)
+{
+    DWORD pid = 0;
+    if (!hwnd || !GetWindowThreadProcessId(hwnd, &pid)) return;
+    if (g_focus->OnForeground(pid)) WatchFocusGame(pid);
+    else if (!g_focus->Active()) UnwatchFocusGame();
+}
+static void StartFocusMode()
+{
+    g_focus.reset(new FocusMode(g_focusOptions, GetCurrentProcessId(), &g_log));
+    g_focus->SetSkip([](uint32_t pid) { return g_controller->TargetPid() == pid || g_throttle->Throttled(pid); });
+    g_foregroundHook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, nullptr, ForegroundChanged, 0, 0,
+        WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+    if (!g_foregroundHook) {
+        LogRetro("WARNING: Foreground notifications unavailable - focus mode disabled");
+        return;
+    }
+    if (g_focusOptions.Enabled())
+        LogRetroF("*** FOCUS MODE ARMED *** - %zu game patterns, %zu background patterns frozen while one is in front",
+            g_focusOptions.games.size(), g_focusOptions.background.size());
+    ForegroundChanged(nullptr, EVENT_SYSTEM_FOREGROUND, GetForegroundWindow(), 0, 0, 0, 0); // A game already in front
+}
+// [Trace]: recording starts and stops with the INI, at startup and on reload. The file
+// is written at exit and on --ctl trace.
+static void ApplyTraceConfig()
+{
+    if (g_tracePath.find(':') == std::string::npos && g_tracePath[0] != '\\' && g_tracePath[0] != '/')
+        g_tracePath = g_iniPath.substr(0, g_iniPath.find_last_of("\\/") + 1) + g_tracePath; // Next to the exe
+    if (!g_traceEnabled) {
+        if (TraceEnabled()) LogRetro("*** TRACING OFF ***");
+        Tracer::Instance().Disable();
+        return;
+    }
+    Tracer::Instance().Enable(g_traceEvents);
+    LogRetroF("*** TRACING ON *** - newest %zu events per thread, written to %s at exit or on --ctl trace", g_traceEvents, g_tracePath.c_str());
+}
+static void WriteTrace()
+{
+    TraceDumpStats stats;
+    std::string error;
+    if (Tracer::Instance().Dump(g_tracePath, &stats, &error))
+        LogRetro("*** TRACE WRITTEN *** - " + FormatTraceDump(g_tracePath, stats));
+    else
+        LogRetro("WARNING: Trace not written - " + error);
+}
+// --ctl reload: re-read the INI without a restart. Control, RingSize/Overflow and [Metrics]
+// keep the values they started with.
+static ControlStatus ReloadConfig(std::string& reply)
+{
+    if (g_controller->Paused()) {
+        reply = "resume first - the INI is reloaded between pauses";
+        return ControlStatus::Refused;
+    }
+    UnregisterHotkeys(); // While g_macroBindings still lists what was registered
+    ResetConfig();
+    LoadConfig();
+    g_freezer->SetOptions(g_targetOptions, g_groupOrder, g_memoryOptions, g_resumeOptions);
+    bool hotkey = g_controller->Reconfigure(BuildPauseConfig());
+    g_throttle->Reconfigure(g_throttleOptions, g_throttleRules);
+    UnwatchFocusGame();
+    g_focus->SetOptions(g_focusOptions);
+    ApplyTraceConfig();
+    if (g_foregroundHook) ForegroundChanged(nullptr, EVENT_SYSTEM_FOREGROUND, GetForegroundWindow(), 0, 0, 0, 0);
+    OpenMacroLibrary();
+    RegisterHotkeys();
+    if (!hotkey) {
+        LogRetro("*** HOTKEY REGISTRATION FAILED *** - Run as administrator or change in INI (Modifiers/PauseKey)");
+        reply = "reloaded " + g_iniPath + ", but the pause hotkey " + g_hotkeyLabel + " could not be registered";
+        return ControlStatus::Failed;
+    }
+    LogRetro("*** CONFIG RELOADED *** - Pause hotkey " + g_hotkeyLabel);
+    reply = "reloaded " + g_iniPath;
+    return ControlStatus::Ok;
+}
+static void StartControlChannel()
+{
+    if (!g_controlEnabled) return;
+    ControlHost host;
+    host.controller = g_controller.get();
+    host.throttle = g_throttle.get();
+    host.metrics = g_metricsEnabled ? &g_metrics : nullptr;
+    host.log = &g_log;
+    host.selfPid = GetCurrentProcessId();
+    host.run = RunOnMessageThread;
+    host.compile = CompileForPause;
+    host.reload = ReloadConfig;
+    host.traceFile = [] { return g_tracePath; };
+    g_control.reset(new ControlDispatcher(host));
+    std::string path = g_controlPath.empty() ? DefaultControlPath() : g_controlPath;
+    std::string error;
+    if (g_controlServer.Start(path, [](ControlOp op, const std::string& payload, std::string& reply) {
+            return g_control->Handle(op, payload, reply);
+        }, &error))
+        LogRetro("*** CONTROL CHANNEL ONLINE *** - " + path + " (GamePauser.exe --ctl status)");
+    else
+        LogRetro("WARNING: Control channel disabled - " + error);
+}
+// Unhandled exception: thaw what we froze before Windows tears the process down.
+// Only that - the crashed thread may hold any lock or be one CleanupAndExit would
+// join, so this resumes straight from the journal's records and returns.
+static LONG WINAPI CrashFilter(EXCEPTION_POINTERS*)
+{
+    g_journal.ThawOwn();
+    return EXCEPTION_CONTINUE_SEARCH;
+}
 static void CleanupAndExit()
 {
     LogRetro("*** SHUTDOWN SEQUENCE INITIATED *** - Final safety checks");
-    SetCaptureHook(false);
-    if (g_targetPid) {
-        LogRetro("Force-resuming lingering process PID " + std::to_string(g_targetPid));
-        SuspendOrResumeProcess(false);
-        g_targetPid = 0;
-    }
-    UnregisterHotKey(nullptr, HOTKEY_ID);
+    g_controlServer.Stop(); // No new remote commands from here on
+    if (g_throttle) g_throttle->StopAll(); // Thaw everything being throttled
+    if (g_foregroundHook) UnhookWinEvent(g_foregroundHook);
+    g_foregroundHook = nullptr;
+    if (g_focus) g_focus->Stop(); // Thaw the background processes focus mode froze
+    UnwatchFocusGame();
+    UnregisterHotkeys();
+    if (g_controller) g_controller->Stop(); // Unhook, force-resume any lingering pause, drop the hotkey
+    g_hookBackend.Stop();
+    if (TraceEnabled()) WriteTrace(); // After the final thaw, so it is on the timeline
+    g_metricsServer.Stop();
     LogRetro("*** GOODBYE *** - GamePauser signing off. Stay accessible.");
+    g_log.Flush(); // Let the drain thread finish the farewell before the process dies
     SetConsoleTextAttribute(g_console, NORMAL_COLOR); // Reset color on exit
 }
 static BOOL WINAPI ConsoleCtrlHandler(DWORD dwCtrlType)
@@ -443,11 +1457,22 @@ static BOOL WINAPI ConsoleCtrlHandler(DWORD dwCtrlType)
 // -----------------------------------------------------------------------------
 // Entry point
 // -----------------------------------------------------------------------------
-int main()
+int main(int argc, char** argv)
 {
+    if (argc > 1 && std::string(argv[1]) == "--bench")
+        return RunBenchmarks();
+    if (argc > 2 && std::string(argv[1]) == "--bench-child")
+        return RunBenchChild(std::atoi(argv[2]));
+    if (argc > 1 && std::string(argv[1]) == "--macros")
+        return RunMacroTool(argc - 2, argv + 2);
+    if (argc > 1 && std::string(argv[1]) == "--ctl")
+        return RunControlClient(argc - 2, argv + 2);
+    if (argc > 2 && std::string(argv[1]) == "--watchdog")
+        return RunFreezeWatchdog(argv[2]);
     // Retro boot sequence
     g_console = GetStdHandle(STD_OUTPUT_HANDLE);
     SetConsoleTextAttribute(g_console, NORMAL_COLOR); // Start neutral
+    g_log.Start();
     LogRetro("==========================================");
     LogRetro("|     GAMEPAUSER v1.2.3 - BOOTING...     |");
     LogRetro("==========================================");
@@ -461,75 +1486,109 @@ int main()
     size_t slash = dir.find_last_of("\\/");
     if (slash != std::string::npos) dir = dir.substr(0, slash + 1);
     g_iniPath = dir + "GamePauser.ini";
+    g_mainThreadId = GetCurrentThreadId();
+    TraceThreadName("main");
     atexit(CleanupAndExit);
     SetConsoleCtrlHandler(ConsoleCtrlHandler, TRUE);
+    SetUnhandledExceptionFilter(CrashFilter);
     LogRetro("*** SPECIAL CONTROLS ACTIVE *** - ESC = cancel pause, ENTER = accept (no Enter sent)");
     LoadConfig();
+    // Before anything can freeze: undo what a killed run left frozen, then journal ours
+    if (!g_journalEnabled)
+        LogRetro("WARNING: [Recovery] Journal = 0 - if GamePauser is killed while paused, the game stays frozen");
+    if (!g_journalEnabled || !StartFreezeJournal(g_journal, DefaultJournalPath(dir), g_watchdogEnabled, &g_log)) {
+        if (g_journal.OpenPrivate()) ActiveFreezeRecorder().store(&g_journal); // Still lets CrashFilter thaw
+    }
+    ApplyTraceConfig();
+    g_freezer.reset(new GroupPauseFreezer(g_targetOptions, g_groupOrder, GetCurrentProcessId(), g_memoryOptions, g_resumeOptions, &g_log));
+    PauseBackends backends;
+    backends.hook = &g_hookBackend;
+    backends.freezer = g_freezer.get();
+    backends.sink = &g_sendInput;
+    backends.hotkeys = &g_hotkeyBackend;
+    backends.log = &g_log;
+    backends.metrics = g_metricsEnabled ? &g_metrics : nullptr;
+    backends.selfPid = GetCurrentProcessId();
+    // Esc/Enter: the hook only marks the ring; the thaw and replay run here, off the hook thread
+    backends.wakeWorker = [] { PostThreadMessage(g_mainThreadId, WM_PENDING_ACTION, 0, 0); };
+    g_controller.reset(new PauseController(backends, BuildPauseConfig()));
+    if (!g_controller->Start()) {
+        LogRetro("*** HOTKEY REGISTRATION FAILED *** - Run as administrator or change in INI (Modifiers/PauseKey)");
+        std::cerr << "Failed to register hotkey - try running as administrator or choose a different combination\n";
+    }
+    else {
+        LogRetro("*** HOTKEY READY *** " + g_hotkeyLabel);
+        LogRetro("Press the hotkey to pause/resume the foreground process");
+    }
+    if (g_metricsEnabled) {
+        if (g_metricsServer.Start(g_metricsPort, [] { return g_metrics.RenderPrometheus(); }))
+            LogRetroF("*** METRICS ONLINE *** - Prometheus endpoint at http://127.0.0.1:%u/metrics", g_metricsPort);
+        else
+            LogRetroF("WARNING: Could not listen on 127.0.0.1:%u - metrics endpoint disabled", g_metricsPort);
+    }
+    // Throttling: children come along, the pause's extra named processes don't
+    PauseTargetOptions throttleTargets;
+    throttleTargets.includeChildren = g_targetOptions.includeChildren;
+    g_throttle.reset(new ThrottleManager(throttleTargets, g_groupOrder, GetCurrentProcessId(), g_throttleOptions, &g_log));
+    if (!g_throttleRules.empty()) {
+        g_throttle->Watch(g_throttleRules);
+        LogRetroF("*** THROTTLE RULES ACTIVE *** - %zu image names throttled whenever they run", g_throttleRules.size());
+    }
+    OpenMacroLibrary();
+    RegisterHotkeys();
+    if (g_profiles.Count()) LogRetroF("*** REPLAY PROFILES LOADED *** - %zu games with their own replay settings", g_profiles.Count());
+    StartControlChannel();
+    StartFocusMode();
+    StartKeyTracking();
     LogRetro("==========================================");
     LogRetro("|          MONITORING FOREGROUND         |");
     LogRetro("|     Hotkey press detected? STANDBY.    |");
     LogRetro("==========================================");
     MSG msg = {};
     while (GetMessage(&msg, nullptr, 0, 0)) {
-        if (msg.message == WM_HOTKEY && msg.wParam == HOTKEY_ID) {
+        if (msg.message == WM_HOTKEY && msg.wParam == SAVE_MACRO_HOTKEY_ID) {
+            SaveLastSession();
+        }
+        else if (msg.message == WM_HOTKEY && msg.wParam == PASTE_HOTKEY_ID) {
+            PasteIntoPause();
+        }
+        else if (msg.message == WM_HOTKEY && msg.wParam == CALIBRATE_HOTKEY_ID) {
+            CalibrateForeground();
+        }
+        else if (msg.message == WM_CONTROL_COMMAND) {
+            RunControlCommand(msg.lParam);
+        }
+        else if (msg.message == WM_PENDING_ACTION) {
+            g_controller->RunPendingAction();
+        }
+        else if (msg.message == WM_FOCUS_EXITED) {
+            UnwatchFocusGame();
+            g_focus->OnExit(static_cast<uint32_t>(msg.wParam));
+        }
+        else if (msg.message == WM_HOTKEY && msg.wParam >= MACRO_HOTKEY_BASE && msg.wParam < MACRO_HOTKEY_BASE + g_macroBindings.size()) {
+            PlayBoundMacro(msg.wParam - MACRO_HOTKEY_BASE);
+        }
+        else if (msg.message == WM_HOTKEY && (msg.wParam == HOTKEY_ID || msg.wParam == THROTTLE_HOTKEY_ID)) {
+            TraceInstant("WM_HOTKEY", "id", msg.wParam);
             HWND fg = GetForegroundWindow();
             if (!fg) continue;
             DWORD pid = 0;
             GetWindowThreadProcessId(fg, &pid);
             if (pid == GetCurrentProcessId()) continue;
-            if (g_targetPid && g_targetPid == pid) {
-                // Resume via normal hotkey
-                g_unpauseOnNextEsc = g_unpauseOnNextEnter = false;
-                SetCaptureHook(false);
-                SuspendOrResumeProcess(false);
-                SendCapturedInputs();
-                g_targetPid = 0;
-            }
-            else {
-                // Pause
-                if (g_targetPid) {
-                    SetCaptureHook(false);
-                    SuspendOrResumeProcess(false);
-                }
-                g_targetPid = pid;
-                g_capturedWhilePaused.clear();
-                g_heldKeys.clear(); // Reset for during-pause tracking only
-                // Clear any held keys before suspending
-                std::set<WORD> initialHeld;
-                for (int vk = 1; vk < 256; ++vk) { // Skip 0, cover common range
-                    if (GetAsyncKeyState(vk) & 0x8000) {
-                        initialHeld.insert(static_cast<WORD>(vk));
-                    }
-                }
-                DWORD fgThreadId = GetWindowThreadProcessId(fg, nullptr);
-                bool attached = false;
-                if (fgThreadId && fgThreadId != GetCurrentThreadId()) {
-                    attached = AttachThreadInput(GetCurrentThreadId(), fgThreadId, TRUE);
-                    if (attached) Sleep(15);
-                }
-                for (WORD vk : initialHeld) {
-                    INPUT inp = {};
-                    inp.type = INPUT_KEYBOARD;
-                    inp.ki.wVk = vk;
-                    inp.ki.dwFlags = KEYEVENTF_KEYUP;
-                    // Basic extended handling: set for numpad/right-side keys
-                    if ((vk >= VK_NUMPAD0 && vk <= VK_DIVIDE) || vk >= VK_F1) {
-                        inp.ki.dwFlags |= KEYEVENTF_EXTENDEDKEY;
-                    }
-                    SendInput(1, &inp, sizeof(INPUT));
-                }
-                if (attached) {
-                    AttachThreadInput(GetCurrentThreadId(), fgThreadId, FALSE);
-                }
-                std::ostringstream oss;
-                oss << "*** PRE-PAUSE CLEANUP *** - Released " << initialHeld.size() << " held keys to prevent stuck input";
-                LogRetro(oss.str());
-                g_unpauseOnNextEsc = true;
-                g_unpauseOnNextEnter = true;
-                SuspendOrResumeProcess(true);
-                SetCaptureHook(true);
-                LogRetro("*** PAUSE MODE ENGAGED *** - Type freely; replay on resume or special keys");
+            if (msg.wParam == THROTTLE_HOTKEY_ID) {
+                bool wasThrottled = g_throttle->Throttled(pid);
+                if (g_controller->TargetPid() == pid)
+                    LogRetro("WARNING: That process is paused - resume it before throttling");
+                else if (!g_throttle->Toggle(pid) && !wasThrottled)
+                    LogRetroF("WARNING: Could not throttle PID %u", pid);
+                continue;
             }
+            g_throttle->Release(pid); // A hard pause takes over from throttling
+            FlushPendingRawInput(); // So the held-key snapshot includes the hotkey chord itself
+            g_controller->OnHotkey(pid);
+        }
+        else {
+            DispatchMessage(&msg); // WM_INPUT for the key-tracking window
         }
     }
     return 0;
@@ -0,0 +1,303 @@
+// =============================================================================
+// Headless.cpp - GamePauser's portable core without the Win32 front end
+//
+// Build (Linux, or any C++17 compiler):
+//   g++ -std=c++17 -O2 -pthread Headless.cpp -o gamepauser-headless
+// Run:
+//   gamepauser-headless             pipeline simulation only
+//   gamepauser-headless --bench     every microbenchmark + the simulation
+//   gamepauser-headless --macros <library> list|export|import|delete|rename
+//   gamepauser-headless --calibrate <fps> [ini]   calibrate against a frame-polling stand-in
+//   gamepauser-headless --daemon [socket] [ini]   pause hotkey (evdev) + control channel until SIGINT/SIGTERM
+//   gamepauser-headless --ctl <command>           talk to a running daemon (or GamePauser.exe)
+//   gamepauser-headless --watchdog <journal>      started by the daemon: thaws what it froze if it dies
+// =============================================================================
+#include <cctype>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <pthread.h>
+#include "Bench.h"
+#include "ControlChannel.h"
+#include "FreezeJournal.h"
+#include "LinuxInput.h"
+
+// Without access to /dev/input and /dev/uinput the daemon is control-channel only:
+// nothing is captured, and replayed events are only counted
+class CountingSink : public InputSink
+{
+public:
+    void Send(const KeyEvent*, size_t count) override { sent += count; }
+    std::atomic<uint64_t> sent{ 0 };
+};
+
+// Same names as GamePauser.exe's StringToVK / ModifiersFromString
+static uint16_t DaemonKeyFromString(std::string s)
+{
+    s = ToLowerAscii(s);
+    if (s == "space") return 0x20;
+    if (s == "enter") return 0x0D;
+    if (s == "esc" || s == "escape") return 0x1B;
+    if (s == "tab") return 0x09;
+    if (s == "pause") return 0x13;
+    if (s == "left") return 0x25;
+    if (s == "right") return 0x27;
+    if (s == "up") return 0x26;
+    if (s == "down") return 0x28;
+    if (s.size() >= 2 && s[0] == 'f' && s.find_first_not_of("0123456789", 1) == std::string::npos) {
+        int n = std::atoi(s.c_str() + 1);
+        if (n >= 1 && n <= 24) return static_cast<uint16_t>(0x70 + n - 1);
+    }
+    if (s.size() == 1 && std::isalnum(static_cast<unsigned char>(s[0]))) return static_cast<uint16_t>(std::toupper(static_cast<unsigned char>(s[0])));
+    return 0;
+}
+
+static uint32_t DaemonModsFromString(std::string s)
+{
+    s = ToLowerAscii(s);
+    uint32_t mods = 0;
+    if (s.find("ctrl") != std::string::npos) mods |= HOTKEY_CONTROL;
+    if (s.find("alt") != std::string::npos) mods |= HOTKEY_ALT;
+    if (s.find("shift") != std::string::npos) mods |= HOTKEY_SHIFT;
+    if (s.find("win") != std::string::npos) mods |= HOTKEY_WIN;
+    return mods;
+}
+
+struct DaemonConfig
+{
+    PauseConfig pause;
+    PauseTargetOptions targets; // Processes is also what the hotkey pauses - Linux has no foreground window to ask
+    GroupOrder order = GroupOrder::ChildrenFirst;
+    bool trace = false; // [Trace] Trace
+    std::string traceFile; // [Trace] TraceFile, empty = the runtime dir
+    size_t traceEvents = TRACE_DEFAULT_EVENTS;
+};
+
+// The portable part of GamePauser.ini: [Hotkey], [Targets], [Replay], [Capture] Optimize, [Profiles] and [Trace]
+static bool LoadDaemonConfig(const std::string& path, DaemonConfig& config, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file) {
+        error = "cannot read " + path;
+        return false;
+    }
+    std::map<std::string, std::string> settings;
+    std::string line;
+    while (std::getline(file, line)) {
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        size_t eq = line.find('=');
+        if (line.empty() || line[0] == ';' || eq == std::string::npos) continue;
+        std::string key = line.substr(0, eq), val = line.substr(eq + 1);
+        key.erase(0, key.find_first_not_of(" \t"));
+        key.erase(key.find_last_not_of(" \t") + 1);
+        val.erase(0, val.find_first_not_of(" \t"));
+        if (!key.empty() && !val.empty()) settings[key] = val;
+    }
+    DaemonConfig fresh;
+    if (settings.count("PauseKey") && DaemonKeyFromString(settings["PauseKey"])) fresh.pause.pauseVK = DaemonKeyFromString(settings["PauseKey"]);
+    if (settings.count("Modifiers")) fresh.pause.pauseMods = DaemonModsFromString(settings["Modifiers"]);
+    if (settings.count("IncludeChildren")) fresh.targets.includeChildren = settings["IncludeChildren"] == "1";
+    if (settings.count("Processes")) {
+        std::stringstream list(settings["Processes"]);
+        std::string name;
+        while (std::getline(list, name, ',')) {
+            name.erase(0, name.find_first_not_of(" \t"));
+            name.erase(name.find_last_not_of(" \t") + 1);
+            if (!name.empty()) fresh.targets.imageNames.push_back(ToLowerAscii(name));
+        }
+    }
+    if (settings.count("Order")) fresh.order = GroupOrderFromString(settings["Order"]);
+    ReplayOptions& replay = fresh.pause.replay;
+    if (settings.count("Policy")) replay.policy = ReplayPolicyFromString(settings["Policy"]);
+    if (settings.count("LeadDelayMs")) replay.leadDelayMs = std::max(0, std::atoi(settings["LeadDelayMs"].c_str()));
+    if (settings.count("Speed")) replay.speed = std::max(0.1, std::atof(settings["Speed"].c_str()));
+    if (settings.count("MaxGapMs")) replay.maxGapMs = std::max(0, std::atoi(settings["MaxGapMs"].c_str()));
+    if (settings.count("MinGapMs")) replay.minGapMs = std::max(0, std::atoi(settings["MinGapMs"].c_str()));
+    if (settings.count("Optimize")) fresh.pause.optimize = CaptureOptimizeFromString(settings["Optimize"]);
+    if (settings.count("Trace")) fresh.trace = settings["Trace"] == "1";
+    // The Windows default (next to the exe) means nothing here; only a full path is taken
+    if (settings.count("TraceFile") && settings["TraceFile"][0] == '/') fresh.traceFile = settings["TraceFile"];
+    if (settings.count("TraceEvents")) fresh.traceEvents = static_cast<size_t>(std::max(16, std::atoi(settings["TraceEvents"].c_str())));
+    for (const auto& kv : settings) {
+        ReplayProfile profile;
+        if (kv.first.size() > 7 && kv.first.compare(0, 7, "Profile") == 0 && kv.first.find_first_not_of("0123456789", 7) == std::string::npos
+            && ParseReplayProfile(kv.second, replay, profile))
+            fresh.pause.profiles.Set(profile);
+    }
+    config = fresh;
+    return true;
+}
+
+// The hotkey's target: the paused process (to resume it), else the first running [Targets] Processes match
+static uint32_t DaemonHotkeyTarget(const PauseController& controller, const PauseTargetOptions& targets, uint32_t self)
+{
+    if (controller.TargetPid()) return controller.TargetPid();
+    for (const ProcessInfo& p : ListProcesses()) {
+        if (p.pid != self && std::find(targets.imageNames.begin(), targets.imageNames.end(), p.name) != targets.imageNames.end())
+            return p.pid;
+    }
+    return 0;
+}
+
+// --daemon [socket] [ini]: the pause hotkey and capture through evdev, replay through uinput,
+// the real freezer (SIGSTOP/SIGCONT), throttle and the control channel, until SIGINT or
+// SIGTERM. `--ctl reload` re-reads ini.
+static int RunDaemon(int argc, char** args)
+{
+    std::string path = argc > 0 && *args[0] ? args[0] : DefaultControlPath();
+    std::string ini = argc > 1 ? args[1] : "";
+    // Every thread started from here on leaves the shutdown signals to sigwait() below
+    sigset_t stop;
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop, nullptr);
+    AsyncLogger log;
+    log.SetRetro(false);
+    log.SetFlicker(std::chrono::milliseconds(0));
+    log.Start();
+    DaemonConfig config;
+    std::string error;
+    if (!ini.empty() && !LoadDaemonConfig(ini, config, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    uint32_t self = static_cast<uint32_t>(getpid());
+    std::string tracePath = config.traceFile.empty() ? DefaultTracePath(std::string()) : config.traceFile;
+    if (config.trace) {
+        Tracer::Instance().Enable(config.traceEvents);
+        log.Push("*** TRACING ON *** - written to " + tracePath + " at shutdown or on --ctl trace");
+    }
+    // Before anything can freeze; outlives every freezer below
+    FreezeJournal journal;
+    StartFreezeJournal(journal, DefaultJournalPath(), true, &log);
+    EvdevInput input;
+    UinputSink uinput;
+    SimKeyboardHook noHook;
+    CountingSink counter;
+    std::string inputError;
+    bool live = input.OpenKeyboards(&inputError) > 0 && uinput.Open(&inputError);
+    GroupPauseFreezer freezer(config.targets, config.order, self, MemoryOptions(), ResumeOptions(), &log);
+    PauseMetrics metrics;
+    // Pause, resume, replay and control commands take turns here, like the Win32 message loop;
+    // the evdev reader only classifies keys and posts
+    CommandQueue worker;
+    PauseBackends backends;
+    backends.hook = live ? static_cast<KeyboardHook*>(&input) : &noHook;
+    backends.freezer = &freezer;
+    backends.sink = live ? static_cast<InputSink*>(&uinput) : &counter;
+    backends.hotkeys = live ? &input : nullptr;
+    backends.log = &log;
+    backends.metrics = &metrics;
+    backends.selfPid = self;
+    PauseController* pending = nullptr;
+    backends.wakeWorker = [&] { worker.Post([&] { pending->RunPendingAction(); }); };
+    PauseController controller(backends, config.pause);
+    pending = &controller;
+    bool hotkey = controller.Start();
+    PauseTargetOptions throttleTargets;
+    ThrottleManager throttle(throttleTargets, GroupOrder::ChildrenFirst, self, ThrottleOptions(), &log);
+    PauseTargetOptions hotkeyTargets = config.targets;
+    if (live) {
+        input.Start(&controller, [&] {
+            worker.Post([&] {
+                uint32_t pid = DaemonHotkeyTarget(controller, hotkeyTargets, self);
+                if (!pid) {
+                    log.Push("WARNING: Pause hotkey pressed, but none of [Targets] Processes is running");
+                    return;
+                }
+                throttle.Release(pid); // A hard pause takes over from throttling
+                controller.OnHotkey(pid);
+            });
+        });
+        log.Push("*** EVDEV INPUT READY *** - " + std::to_string(input.DeviceCount()) + " keyboards, replay through uinput"
+            + (hotkey && !hotkeyTargets.imageNames.empty() ? ", pause hotkey armed" : ", pause hotkey needs [Targets] Processes"));
+    }
+    else {
+        log.Push("WARNING: " + inputError + " - control channel only, keys are neither captured nor replayed");
+    }
+    ControlHost host;
+    host.controller = &controller;
+    host.throttle = &throttle;
+    host.metrics = &metrics;
+    host.log = &log;
+    host.selfPid = self;
+    host.run = [&](const ControlCommand& command, std::string& reply) {
+        ControlStatus status = ControlStatus::Failed;
+        worker.RunSync([&] { status = command(reply); });
+        return status;
+    };
+    if (!ini.empty()) {
+        host.reload = [&](std::string& reply) {
+            DaemonConfig fresh;
+            if (!LoadDaemonConfig(ini, fresh, reply)) return ControlStatus::Failed;
+            if (controller.Paused()) {
+                reply = "resume first - the config is reloaded between pauses";
+                return ControlStatus::Refused;
+            }
+            controller.Reconfigure(fresh.pause); // The evdev hotkey can't fail to register
+            freezer.SetOptions(fresh.targets, fresh.order, MemoryOptions(), ResumeOptions());
+            hotkeyTargets = fresh.targets;
+            tracePath = fresh.traceFile.empty() ? DefaultTracePath(std::string()) : fresh.traceFile;
+            if (fresh.trace) Tracer::Instance().Enable(fresh.traceEvents);
+            else Tracer::Instance().Disable();
+            reply = "reloaded " + ini + " (" + std::to_string(fresh.pause.profiles.Count()) + " profiles, "
+                + ReplayPolicyName(fresh.pause.replay.policy) + " replay)";
+            log.Push("*** CONFIG RELOADED *** - " + ini);
+            return ControlStatus::Ok;
+        };
+    }
+    host.traceFile = [&] { return tracePath; }; // On the worker, like reload
+    ControlDispatcher dispatcher(host);
+    ControlServer server;
+    if (!server.Start(path, [&](ControlOp op, const std::string& payload, std::string& reply) {
+            return dispatcher.Handle(op, payload, reply);
+        }, &error)) {
+        std::fprintf(stderr, "Control channel: %s\n", error.c_str());
+        input.Stop();
+        worker.RunSync([] {}); // Nothing queued may outlive the controller
+        return 1;
+    }
+    log.Push("*** CONTROL CHANNEL ONLINE *** - " + path);
+    int sig = 0;
+    sigwait(&stop, &sig);
+    log.Push("*** SHUTDOWN *** - resuming anything still paused or throttled");
+    server.Stop();
+    input.Stop(); // No hotkey or captured key can start anything from here on
+    worker.RunSync([&] {
+        throttle.StopAll();
+        controller.Stop();
+    });
+    if (live) log.Push("Replayed " + std::to_string(uinput.Events()) + " keys in " + std::to_string(uinput.Writes()) + " writes");
+    if (TraceEnabled()) {
+        TraceDumpStats stats;
+        if (Tracer::Instance().Dump(tracePath, &stats, &error)) log.Push("*** TRACE WRITTEN *** - " + FormatTraceDump(tracePath, stats));
+        else log.Push("WARNING: Trace not written - " + error);
+    }
+    log.Stop();
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && std::string(argv[1]) == "--bench")
+        return RunBenchmarks();
+    if (argc > 2 && std::string(argv[1]) == "--bench-child")
+        return RunBenchChild(std::atoi(argv[2]));
+    if (argc > 1 && std::string(argv[1]) == "--macros")
+        return RunMacroTool(argc - 2, argv + 2);
+    if (argc > 1 && std::string(argv[1]) == "--calibrate")
+        return RunCalibrateStandIn(argc - 2, argv + 2);
+    if (argc > 1 && std::string(argv[1]) == "--daemon")
+        return RunDaemon(argc - 2, argv + 2);
+    if (argc > 1 && std::string(argv[1]) == "--ctl")
+        return RunControlClient(argc - 2, argv + 2);
+    if (argc > 2 && std::string(argv[1]) == "--watchdog")
+        return RunFreezeWatchdog(argv[2]);
+    std::printf("GamePauser headless pipeline simulation\n");
+    BenchSimulation();
+    return 0;
+}
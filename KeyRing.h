@@ -0,0 +1,189 @@
+// =============================================================================
+// KeyRing.h - Preallocated SPSC ring for captured keystrokes
+//
+// The keyboard hook is the only producer: it stamps a 16-byte KeyEvent and
+// writes it into a fixed-capacity ring, with no allocation and no locks on
+// the normal path. A consumer thread drains the ring into replay records.
+//
+// When the ring is full the configured OverflowPolicy decides:
+//   DropOldest - overwrite the oldest unread event (capture never stalls)
+//   Block      - spin until the consumer makes room (nothing is lost)
+//   Spill      - append to a growable arena; ordering is preserved
+// =============================================================================
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// KeyEvent flags
+const uint16_t KEY_UP = 0x0001; // Key release (otherwise press)
+const uint16_t KEY_EXTENDED = 0x0002; // Extended scan code (right Ctrl/Alt, arrows, numpad Enter...)
+const uint16_t KEY_UNICODE = 0x0004; // scan holds a UTF-16 code unit, vk is unused
+const uint16_t KEY_INJECTED = 0x0008; // Synthesized by software (hook input only, never stored)
+
+// One captured key transition. 16 bytes, trivially copyable.
+struct KeyEvent
+{
+    uint64_t timeNs; // Monotonic capture time
+    uint16_t vk;
+    uint16_t scan;
+    uint16_t flags;
+    uint16_t extra; // Reserved for passes that annotate events (0 from the hook)
+};
+static_assert(sizeof(KeyEvent) == 16, "KeyEvent must stay packed into 16 bytes");
+
+static inline uint64_t MonotonicNs()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+enum class OverflowPolicy { DropOldest, Block, Spill };
+
+static inline OverflowPolicy OverflowPolicyFromString(const std::string& s)
+{
+    if (s == "drop" || s == "DropOldest") return OverflowPolicy::DropOldest;
+    if (s == "block" || s == "Block") return OverflowPolicy::Block;
+    return OverflowPolicy::Spill;
+}
+
+class KeyRing
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit KeyRing(size_t capacity = 4096, OverflowPolicy policy = OverflowPolicy::Spill)
+        : m_policy(policy)
+    {
+        size_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        m_mask = cap - 1;
+        m_slots.reset(new Slot[cap]);
+    }
+    KeyRing(const KeyRing&) = delete;
+    KeyRing& operator=(const KeyRing&) = delete;
+
+    void SetPolicy(OverflowPolicy policy) { m_policy.store(policy, std::memory_order_relaxed); }
+    OverflowPolicy Policy() const { return m_policy.load(std::memory_order_relaxed); }
+    size_t Capacity() const { return m_mask + 1; }
+
+    // Producer (hook thread only). Returns false only if the event was discarded.
+    bool Push(const KeyEvent& ev)
+    {
+        if (m_spilling.load(std::memory_order_acquire))
+            return SpillPush(ev); // Keep order: nothing goes back in the ring until the arena drains
+        uint64_t h = m_head.load(std::memory_order_relaxed);
+        uint64_t t = m_tail.load(std::memory_order_acquire);
+        if (h - t > m_mask) {
+            switch (m_policy.load(std::memory_order_relaxed)) {
+            case OverflowPolicy::DropOldest:
+                // Steal the oldest slot; if the consumer beat us to it there is room anyway
+                if (m_tail.compare_exchange_strong(t, t + 1, std::memory_order_acq_rel))
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                break;
+            case OverflowPolicy::Block:
+                m_blocked.fetch_add(1, std::memory_order_relaxed);
+                while (h - m_tail.load(std::memory_order_acquire) > m_mask)
+                    std::this_thread::yield();
+                break;
+            case OverflowPolicy::Spill:
+                return SpillPush(ev);
+            }
+        }
+        Store(m_slots[h & m_mask], ev);
+        m_head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer. Appends everything available, in capture order. Returns count.
+    size_t Drain(std::vector<KeyEvent>& out)
+    {
+        size_t n = DrainRing(out);
+        if (m_spilling.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(m_spillMutex);
+            // The producer stopped using the ring when it started spilling, so
+            // whatever is still in the ring predates the arena.
+            n += DrainRing(out);
+            out.insert(out.end(), m_spill.begin(), m_spill.end());
+            n += m_spill.size();
+            m_spill.clear(); // Keeps capacity: the arena only grows, never churns
+            m_spilling.store(false, std::memory_order_release);
+        }
+        return n;
+    }
+
+    uint64_t Dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+    uint64_t Blocked() const { return m_blocked.load(std::memory_order_relaxed); }
+    uint64_t Spilled() const { return m_spilled.load(std::memory_order_relaxed); }
+    // Number of times the spill arena had to grow - the only allocation site
+    uint64_t ArenaGrowths() const { return m_arenaGrowths.load(std::memory_order_relaxed); }
+    bool Empty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire)
+            && !m_spilling.load(std::memory_order_acquire);
+    }
+
+private:
+    // Two relaxed 64-bit atomics per slot: a DropOldest steal may overwrite a
+    // slot the consumer is reading; the consumer's tail CAS then fails and the
+    // torn copy is discarded, with no data race in the C++ sense.
+    struct Slot { std::atomic<uint64_t> w[2]; };
+
+    static void Store(Slot& s, const KeyEvent& ev)
+    {
+        uint64_t w[2];
+        std::memcpy(w, &ev, sizeof(w));
+        s.w[0].store(w[0], std::memory_order_relaxed);
+        s.w[1].store(w[1], std::memory_order_relaxed);
+    }
+    static KeyEvent Load(const Slot& s)
+    {
+        uint64_t w[2] = { s.w[0].load(std::memory_order_relaxed), s.w[1].load(std::memory_order_relaxed) };
+        KeyEvent ev;
+        std::memcpy(&ev, w, sizeof(ev));
+        return ev;
+    }
+
+    size_t DrainRing(std::vector<KeyEvent>& out)
+    {
+        size_t n = 0;
+        uint64_t t = m_tail.load(std::memory_order_acquire);
+        for (;;) {
+            if (t == m_head.load(std::memory_order_acquire)) break;
+            KeyEvent ev = Load(m_slots[t & m_mask]);
+            // CAS (not a plain store) because DropOldest lets the producer advance tail too
+            if (m_tail.compare_exchange_weak(t, t + 1, std::memory_order_acq_rel)) {
+                out.push_back(ev);
+                ++t;
+                ++n;
+            }
+        }
+        return n;
+    }
+
+    bool SpillPush(const KeyEvent& ev)
+    {
+        std::lock_guard<std::mutex> lock(m_spillMutex); // Overflow path only
+        if (m_spill.size() == m_spill.capacity())
+            m_arenaGrowths.fetch_add(1, std::memory_order_relaxed);
+        m_spill.push_back(ev);
+        m_spilled.fetch_add(1, std::memory_order_relaxed);
+        m_spilling.store(true, std::memory_order_release);
+        return true;
+    }
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_mask = 0;
+    std::atomic<OverflowPolicy> m_policy;
+    alignas(64) std::atomic<uint64_t> m_head{ 0 }; // Written by producer
+    alignas(64) std::atomic<uint64_t> m_tail{ 0 }; // Written by consumer (and DropOldest)
+    alignas(64) std::atomic<bool> m_spilling{ false };
+    std::mutex m_spillMutex;
+    std::vector<KeyEvent> m_spill;
+    std::atomic<uint64_t> m_dropped{ 0 }, m_blocked{ 0 }, m_spilled{ 0 }, m_arenaGrowths{ 0 };
+};
@@ -0,0 +1,148 @@
+// =============================================================================
+// KeyboardState.h - 256-bit key-down model with a per-key flag table
+//
+// Updated incrementally from key events (one atomic bit operation each), so
+// "which keys are held, and are they extended?" is an O(1) snapshot instead
+// of 255 GetAsyncKeyState calls or a scan over the capture log. Writers and
+// readers may live on different threads; every word is an atomic.
+// =============================================================================
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "KeyRing.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static inline int LowestSetBit(uint64_t w)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, w);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(w);
+#endif
+}
+
+// Raw Input says VK_SHIFT / VK_CONTROL / VK_MENU where the hook and this model
+// use the sided codes. Shift's side is in the scan code (0x36 = right), Ctrl's
+// and Alt's in the E0 prefix.
+static inline uint16_t SidedVk(uint16_t vk, uint16_t scan, bool extended)
+{
+    switch (vk) {
+    case 0x10: return scan == 0x36 ? 0xA1 : 0xA0;
+    case 0x11: return extended ? 0xA3 : 0xA2;
+    case 0x12: return extended ? 0xA5 : 0xA4;
+    default: return vk;
+    }
+}
+
+// Keys a Raw Input keyboard reports the release of, so a bit set for one is
+// cleared again: not the mouse buttons (0x01-0x06) nor the generic modifiers
+static inline bool RawKeyboardVk(uint16_t vk)
+{
+    return vk > 0x06 && vk < 255 && (vk < 0x10 || vk > 0x12);
+}
+
+// Copy of the state at one instant - plain data, safe to keep around
+struct KeySnapshot
+{
+    uint64_t bits[4];
+    uint16_t flags[256]; // KEY_EXTENDED as last seen for each vk
+    uint16_t scan[256];
+
+    bool IsDown(uint16_t vk) const { return vk < 256 && ((bits[vk >> 6] >> (vk & 63)) & 1); }
+    size_t Count() const
+    {
+        size_t n = 0;
+        for (uint64_t w : bits) {
+            for (; w; w &= w - 1) ++n; // One iteration per held key
+        }
+        return n;
+    }
+    // Calls fn(vk) for each held key, lowest vk first
+    template <typename Fn> void ForEachHeld(Fn fn) const
+    {
+        for (int word = 0; word < 4; ++word) {
+            for (uint64_t w = bits[word]; w; w &= w - 1)
+                fn(static_cast<uint16_t>(word * 64 + LowestSetBit(w)));
+        }
+    }
+    // Builds one press (release=false) or release event per held key, with the
+    // extended flag each key was last seen with. Appends to out; returns count.
+    size_t HeldEvents(std::vector<KeyEvent>& out, bool release, uint64_t timeNs = 0) const
+    {
+        size_t before = out.size();
+        ForEachHeld([&](uint16_t vk) {
+            KeyEvent ev;
+            ev.timeNs = timeNs;
+            ev.vk = vk;
+            ev.scan = scan[vk];
+            ev.flags = static_cast<uint16_t>((flags[vk] & KEY_EXTENDED) | (release ? KEY_UP : 0));
+            ev.extra = 0;
+            out.push_back(ev);
+        });
+        return out.size() - before;
+    }
+};
+
+class KeyboardState
+{
+public:
+    KeyboardState() { Clear(); }
+    KeyboardState(const KeyboardState&) = delete;
+    KeyboardState& operator=(const KeyboardState&) = delete;
+
+    void Apply(const KeyEvent& ev) { Apply(ev.vk, ev.scan, ev.flags); }
+    void Apply(uint16_t vk, uint16_t scan, uint16_t flags)
+    {
+        if (vk == 0 || vk >= 255 || (flags & KEY_UNICODE)) return; // 255 = fake shift from some keyboard drivers
+        uint64_t mask = 1ULL << (vk & 63);
+        if (flags & KEY_UP) {
+            m_bits[vk >> 6].fetch_and(~mask, std::memory_order_release);
+        }
+        else {
+            m_flags[vk].store(flags & KEY_EXTENDED, std::memory_order_relaxed);
+            if (scan) m_scan[vk].store(scan, std::memory_order_relaxed);
+            m_bits[vk >> 6].fetch_or(mask, std::memory_order_release);
+        }
+    }
+    void Press(uint16_t vk, bool extended = false) { Apply(vk, 0, extended ? KEY_EXTENDED : 0); }
+    void Release(uint16_t vk) { Apply(vk, 0, KEY_UP); }
+
+    bool IsDown(uint16_t vk) const
+    {
+        return vk < 256 && ((m_bits[vk >> 6].load(std::memory_order_acquire) >> (vk & 63)) & 1);
+    }
+    bool AnyDown() const
+    {
+        for (const auto& w : m_bits) {
+            if (w.load(std::memory_order_acquire)) return true;
+        }
+        return false;
+    }
+
+    // Clears the down bits; the flag table is kept (it describes keys, not state)
+    void Clear()
+    {
+        for (auto& w : m_bits) w.store(0, std::memory_order_release);
+    }
+
+    KeySnapshot Snapshot() const
+    {
+        KeySnapshot s;
+        for (int i = 0; i < 4; ++i) s.bits[i] = m_bits[i].load(std::memory_order_acquire);
+        for (int vk = 0; vk < 256; ++vk) {
+            s.flags[vk] = m_flags[vk].load(std::memory_order_relaxed);
+            s.scan[vk] = m_scan[vk].load(std::memory_order_relaxed);
+        }
+        return s;
+    }
+
+private:
+    std::atomic<uint64_t> m_bits[4];
+    std::atomic<uint16_t> m_flags[256] = {};
+    std::atomic<uint16_t> m_scan[256] = {};
+};
@@ -0,0 +1,567 @@
+// =============================================================================
+// LinuxInput.h - Linux input backends: evdev capture + hotkeys, uinput replay
+//
+// Keyboards are read straight from /dev/input/event* (root, or a member of
+// the input group). Outside a pause they are only watched: the reader keeps
+// the held-key model current and spots the pause hotkey. During a pause every
+// keyboard is grabbed (EVIOCGRAB), so nothing reaches other programs, and each
+// event goes through PauseController::OnKey(). A keyboard is grabbed once all
+// of its keys are up - grabbing under a held key would leave the desktop
+// thinking it is still down - so the hotkey chord is released normally first.
+// The reader thread never waits on the pause itself: OnKey() is lock-free and
+// the hotkey handler is expected to post to a worker. Removing the capture is
+// done by the reader too, so keys queued before the ungrab still get captured.
+//
+// Replay goes through a uinput virtual keyboard. A scheduler batch becomes a
+// single write(): each key event followed by its SYN_REPORT, instead of two
+// syscalls per key.
+//
+// Key codes are translated to Windows virtual-key values at the edge (the
+// evdev code rides along in KeyEvent::scan), so the state machine, macros
+// and profiles are the same on both platforms.
+// =============================================================================
+#pragma once
+#ifndef _WIN32
+#include <atomic>
+#include <bitset>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+// <linux/input.h> defines KEY_UP (the arrow) as a macro, which would rewrite KeyRing.h's
+// KEY_UP flag everywhere after this point
+const uint16_t EVDEV_KEY_UP = KEY_UP;
+#undef KEY_UP
+#include "PauseController.h"
+#include "Metrics.h"
+
+const char* const UINPUT_DEVICE_NAME = "GamePauser virtual keyboard";
+
+// -----------------------------------------------------------------------------
+// evdev code <-> Windows virtual key
+// -----------------------------------------------------------------------------
+struct EvdevKey
+{
+    uint16_t code;
+    uint16_t vk;
+    bool extended; // KEY_EXTENDED on Windows (right-hand modifiers, navigation block, numpad Enter/divide)
+};
+
+static const EvdevKey EVDEV_KEYS[] = {
+    { KEY_ESC, 0x1B, false }, { KEY_BACKSPACE, 0x08, false }, { KEY_TAB, 0x09, false }, { KEY_ENTER, 0x0D, false },
+    { KEY_SPACE, 0x20, false }, { KEY_CAPSLOCK, 0x14, false }, { KEY_NUMLOCK, 0x90, true }, { KEY_SCROLLLOCK, 0x91, false },
+    { KEY_PAUSE, 0x13, false }, { KEY_SYSRQ, 0x2C, true }, { KEY_COMPOSE, 0x5D, true },
+    { KEY_1, '1', false }, { KEY_2, '2', false }, { KEY_3, '3', false }, { KEY_4, '4', false }, { KEY_5, '5', false },
+    { KEY_6, '6', false }, { KEY_7, '7', false }, { KEY_8, '8', false }, { KEY_9, '9', false }, { KEY_0, '0', false },
+    { KEY_A, 'A', false }, { KEY_B, 'B', false }, { KEY_C, 'C', false }, { KEY_D, 'D', false }, { KEY_E, 'E', false },
+    { KEY_F, 'F', false }, { KEY_G, 'G', false }, { KEY_H, 'H', false }, { KEY_I, 'I', false }, { KEY_J, 'J', false },
+    { KEY_K, 'K', false }, { KEY_L, 'L', false }, { KEY_M, 'M', false }, { KEY_N, 'N', false }, { KEY_O, 'O', false },
+    { KEY_P, 'P', false }, { KEY_Q, 'Q', false }, { KEY_R, 'R', false }, { KEY_S, 'S', false }, { KEY_T, 'T', false },
+    { KEY_U, 'U', false }, { KEY_V, 'V', false }, { KEY_W, 'W', false }, { KEY_X, 'X', false }, { KEY_Y, 'Y', false },
+    { KEY_Z, 'Z', false },
+    // US positions of the OEM keys - the layout is the desktop's business, as on Windows
+    { KEY_SEMICOLON, 0xBA, false }, { KEY_EQUAL, 0xBB, false }, { KEY_COMMA, 0xBC, false }, { KEY_MINUS, 0xBD, false },
+    { KEY_DOT, 0xBE, false }, { KEY_SLASH, 0xBF, false }, { KEY_GRAVE, 0xC0, false }, { KEY_LEFTBRACE, 0xDB, false },
+    { KEY_BACKSLASH, 0xDC, false }, { KEY_RIGHTBRACE, 0xDD, false }, { KEY_APOSTROPHE, 0xDE, false }, { KEY_102ND, 0xE2, false },
+    { KEY_LEFTSHIFT, 0xA0, false }, { KEY_RIGHTSHIFT, 0xA1, false }, { KEY_LEFTCTRL, 0xA2, false }, { KEY_RIGHTCTRL, 0xA3, true },
+    { KEY_LEFTALT, 0xA4, false }, { KEY_RIGHTALT, 0xA5, true }, { KEY_LEFTMETA, 0x5B, true }, { KEY_RIGHTMETA, 0x5C, true },
+    { KEY_INSERT, 0x2D, true }, { KEY_DELETE, 0x2E, true }, { KEY_HOME, 0x24, true }, { KEY_END, 0x23, true },
+    { KEY_PAGEUP, 0x21, true }, { KEY_PAGEDOWN, 0x22, true },
+    { KEY_LEFT, 0x25, true }, { EVDEV_KEY_UP, 0x26, true }, { KEY_RIGHT, 0x27, true }, { KEY_DOWN, 0x28, true },
+    { KEY_KP0, 0x60, false }, { KEY_KP1, 0x61, false }, { KEY_KP2, 0x62, false }, { KEY_KP3, 0x63, false },
+    { KEY_KP4, 0x64, false }, { KEY_KP5, 0x65, false }, { KEY_KP6, 0x66, false }, { KEY_KP7, 0x67, false },
+    { KEY_KP8, 0x68, false }, { KEY_KP9, 0x69, false }, { KEY_KPASTERISK, 0x6A, false }, { KEY_KPPLUS, 0x6B, false },
+    { KEY_KPMINUS, 0x6D, false }, { KEY_KPDOT, 0x6E, false }, { KEY_KPSLASH, 0x6F, true }, { KEY_KPENTER, 0x0D, true },
+    { KEY_F1, 0x70, false }, { KEY_F2, 0x71, false }, { KEY_F3, 0x72, false }, { KEY_F4, 0x73, false },
+    { KEY_F5, 0x74, false }, { KEY_F6, 0x75, false }, { KEY_F7, 0x76, false }, { KEY_F8, 0x77, false },
+    { KEY_F9, 0x78, false }, { KEY_F10, 0x79, false }, { KEY_F11, 0x7A, false }, { KEY_F12, 0x7B, false },
+    { KEY_F13, 0x7C, false }, { KEY_F14, 0x7D, false }, { KEY_F15, 0x7E, false }, { KEY_F16, 0x7F, false },
+    { KEY_F17, 0x80, false }, { KEY_F18, 0x81, false }, { KEY_F19, 0x82, false }, { KEY_F20, 0x83, false },
+    { KEY_F21, 0x84, false }, { KEY_F22, 0x85, false }, { KEY_F23, 0x86, false }, { KEY_F24, 0x87, false },
+};
+
+class EvdevKeyMap
+{
+public:
+    static const EvdevKeyMap& Get()
+    {
+        static const EvdevKeyMap map;
+        return map;
+    }
+    // 0 if the key has no virtual-key equivalent; flags gets KEY_EXTENDED where Windows would set it
+    uint16_t ToVK(uint16_t code, uint16_t& flags) const
+    {
+        if (code >= KEY_CNT) return 0;
+        if (m_extended[code]) flags |= KEY_EXTENDED;
+        return m_vk[code];
+    }
+    // Extended picks the right-hand / keypad variant where there is one (VK_RETURN -> KEY_KPENTER)
+    uint16_t ToCode(uint16_t vk, uint16_t flags) const
+    {
+        if (vk >= 256) return 0;
+        uint16_t code = m_code[vk][(flags & KEY_EXTENDED) ? 1 : 0];
+        return code ? code : m_code[vk][(flags & KEY_EXTENDED) ? 0 : 1];
+    }
+    template <typename Fn> void ForEachCode(Fn fn) const
+    {
+        for (const EvdevKey& k : EVDEV_KEYS) fn(k.code);
+    }
+
+private:
+    EvdevKeyMap()
+    {
+        std::memset(m_vk, 0, sizeof(m_vk));
+        std::memset(m_extended, 0, sizeof(m_extended));
+        std::memset(m_code, 0, sizeof(m_code));
+        for (const EvdevKey& k : EVDEV_KEYS) {
+            m_vk[k.code] = k.vk;
+            m_extended[k.code] = k.extended;
+            m_code[k.vk][k.extended ? 1 : 0] = k.code;
+        }
+        // Generic modifiers (the text compiler's layouts may use them) type as the left-hand key
+        m_code[0x10][0] = KEY_LEFTSHIFT;
+        m_code[0x11][0] = KEY_LEFTCTRL;
+        m_code[0x12][0] = KEY_LEFTALT;
+    }
+    uint16_t m_vk[KEY_CNT];
+    bool m_extended[KEY_CNT];
+    uint16_t m_code[256][2]; // [vk][extended]
+};
+
+// HOTKEY_* bit for a sided modifier, 0 for anything else
+static inline uint32_t EvdevModifierBit(uint16_t vk)
+{
+    switch (vk) {
+    case 0xA0: case 0xA1: return HOTKEY_SHIFT;
+    case 0xA2: case 0xA3: return HOTKEY_CONTROL;
+    case 0xA4: case 0xA5: return HOTKEY_ALT;
+    case 0x5B: case 0x5C: return HOTKEY_WIN;
+    default: return 0;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Replay: uinput virtual keyboard
+// -----------------------------------------------------------------------------
+class UinputSink : public InputSink
+{
+public:
+    ~UinputSink() { Close(); }
+
+    // Creates the virtual keyboard. Needs write access to /dev/uinput.
+    bool Open(std::string* error = nullptr, const char* path = "/dev/uinput")
+    {
+        Close();
+        int fd = open(path, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) return Fail(error, std::string("cannot open ") + path);
+        bool ok = ioctl(fd, UI_SET_EVBIT, EV_KEY) == 0 && ioctl(fd, UI_SET_EVBIT, EV_SYN) == 0;
+        EvdevKeyMap::Get().ForEachCode([&](uint16_t code) { ok = ok && ioctl(fd, UI_SET_KEYBIT, code) == 0; });
+        uinput_setup setup;
+        std::memset(&setup, 0, sizeof(setup));
+        setup.id.bustype = BUS_VIRTUAL;
+        setup.id.vendor = 0x6770; // "gp"
+        setup.id.product = 0x0001;
+        std::snprintf(setup.name, sizeof(setup.name), "%s", UINPUT_DEVICE_NAME);
+        ok = ok && ioctl(fd, UI_DEV_SETUP, &setup) == 0 && ioctl(fd, UI_DEV_CREATE) == 0;
+        if (!ok) {
+            int err = errno;
+            close(fd);
+            errno = err;
+            return Fail(error, "cannot create the virtual keyboard");
+        }
+        m_fd = fd;
+        m_created = true;
+        m_readyNs = MonotonicNs() + 200000000ULL; // The desktop needs a moment to pick up a new device
+        return true;
+    }
+
+    // Writes to an existing descriptor instead (a pipe or /dev/null - benchmarks). Not owned.
+    void Attach(int fd)
+    {
+        Close();
+        m_fd = fd;
+        m_readyNs = 0;
+    }
+
+    void Close()
+    {
+        if (m_fd < 0) return;
+        if (m_created) {
+            ioctl(m_fd, UI_DEV_DESTROY);
+            close(m_fd);
+        }
+        m_fd = -1;
+        m_created = false;
+    }
+    bool IsOpen() const { return m_fd >= 0; }
+
+    void Begin() override
+    {
+        uint64_t now = MonotonicNs();
+        if (now < m_readyNs) std::this_thread::sleep_for(std::chrono::nanoseconds(m_readyNs - now));
+    }
+
+    // One write() for the whole batch. Unicode events have no key to press and are skipped.
+    void Send(const KeyEvent* events, size_t count) override
+    {
+        const EvdevKeyMap& map = EvdevKeyMap::Get();
+        m_batch.clear();
+        for (size_t i = 0; i < count; ++i) {
+            uint16_t code = (events[i].flags & KEY_UNICODE) ? 0 : map.ToCode(events[i].vk, events[i].flags);
+            if (!code) {
+                m_skipped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            m_batch.push_back(MakeEvent(EV_KEY, code, (events[i].flags & KEY_UP) ? 0 : 1));
+            m_batch.push_back(MakeEvent(EV_SYN, SYN_REPORT, 0));
+        }
+        if (m_batch.empty() || m_fd < 0) return;
+        TraceSpan span("uinput write", "events", m_batch.size() / 2);
+        const char* p = reinterpret_cast<const char*>(m_batch.data());
+        size_t left = m_batch.size() * sizeof(input_event);
+        while (left) {
+            ssize_t n = write(m_fd, p, left);
+            m_writes.fetch_add(1, std::memory_order_relaxed);
+            if (n > 0) {
+                p += n;
+                left -= static_cast<size_t>(n);
+            }
+            else if (n < 0 && errno == EAGAIN) {
+                pollfd pfd = { m_fd, POLLOUT, 0 };
+                poll(&pfd, 1, 10);
+            }
+            else if (n < 0 && errno != EINTR) {
+                m_failed.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        m_events.fetch_add(m_batch.size() / 2, std::memory_order_relaxed);
+    }
+
+    uint64_t Events() const { return m_events.load(std::memory_order_relaxed); }
+    uint64_t Writes() const { return m_writes.load(std::memory_order_relaxed); }
+    uint64_t Skipped() const { return m_skipped.load(std::memory_order_relaxed); }
+    uint64_t Failed() const { return m_failed.load(std::memory_order_relaxed); }
+
+    static input_event MakeEvent(uint16_t type, uint16_t code, int32_t value)
+    {
+        input_event ev;
+        std::memset(&ev, 0, sizeof(ev)); // The kernel stamps the time
+        ev.type = type;
+        ev.code = code;
+        ev.value = value;
+        return ev;
+    }
+
+private:
+    static bool Fail(std::string* error, const std::string& what)
+    {
+        if (error) *error = what + ": " + std::strerror(errno);
+        return false;
+    }
+
+    int m_fd = -1;
+    bool m_created = false;
+    uint64_t m_readyNs = 0;
+    std::vector<input_event> m_batch; // Reused; replay runs on one thread
+    std::atomic<uint64_t> m_events{ 0 }, m_writes{ 0 }, m_skipped{ 0 }, m_failed{ 0 };
+};
+
+// -----------------------------------------------------------------------------
+// Capture + hotkey: every keyboard under /dev/input, read on one thread
+// -----------------------------------------------------------------------------
+class EvdevInput : public KeyboardHook, public HotkeyRegistrar
+{
+public:
+    typedef std::function<void()> HotkeyHandler;
+
+    EvdevInput() : m_wake(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+    ~EvdevInput()
+    {
+        Stop();
+        for (Device& d : m_devices) {
+            if (d.owned) close(d.fd);
+        }
+        if (m_wake >= 0) close(m_wake);
+    }
+    EvdevInput(const EvdevInput&) = delete;
+    EvdevInput& operator=(const EvdevInput&) = delete;
+
+    // Opens every keyboard (anything with letter keys) except our own virtual one.
+    // Returns how many; error says why there are none.
+    size_t OpenKeyboards(std::string* error = nullptr)
+    {
+        DIR* dir = opendir("/dev/input");
+        if (!dir) {
+            if (error) *error = std::string("cannot list /dev/input: ") + std::strerror(errno);
+            return 0;
+        }
+        size_t denied = 0;
+        while (dirent* de = readdir(dir)) {
+            if (std::strncmp(de->d_name, "event", 5) != 0) continue;
+            std::string path = std::string("/dev/input/") + de->d_name;
+            int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EACCES || errno == EPERM) ++denied;
+                continue;
+            }
+            char name[256] = {};
+            ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name);
+            unsigned long keys[KEY_CNT / (8 * sizeof(unsigned long)) + 1] = {};
+            ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys);
+            auto has = [&](int code) { return (keys[code / (8 * sizeof(unsigned long))] >> (code % (8 * sizeof(unsigned long)))) & 1; };
+            if (!has(KEY_A) || !has(KEY_Z) || !has(KEY_SPACE) || std::strcmp(name, UINPUT_DEVICE_NAME) == 0) {
+                close(fd);
+                continue;
+            }
+            int clock = CLOCK_MONOTONIC; // Event times on MonotonicNs()'s clock, for capture latency
+            bool monotonic = ioctl(fd, EVIOCSCLOCKID, &clock) == 0;
+            AddDevice(fd, name[0] ? name : path, monotonic, true);
+        }
+        closedir(dir);
+        if (m_devices.empty() && error)
+            *error = denied ? "no permission to read /dev/input (run as root or join the input group)" : "no keyboard found under /dev/input";
+        return m_devices.size();
+    }
+
+    // Reads input_event records from fd (a pipe in benchmarks). monotonicTimes: the
+    // event times are CLOCK_MONOTONIC. Before Start() only.
+    void AddDevice(int fd, const std::string& name, bool monotonicTimes, bool owned = false)
+    {
+        m_devices.emplace_back();
+        Device& d = m_devices.back();
+        d.fd = fd;
+        d.name = name;
+        d.monotonic = monotonicTimes;
+        d.owned = owned;
+    }
+    size_t DeviceCount() const { return m_devices.size(); }
+    std::vector<std::string> DeviceNames() const
+    {
+        std::vector<std::string> names;
+        for (const Device& d : m_devices) names.push_back(d.name);
+        return names;
+    }
+
+    // The reader only classifies and queues: OnKey() takes no lock, and onHotkey runs on the
+    // reader thread, so it should hand the pause/resume to a worker (CommandQueue) and return
+    void Start(PauseController* controller, const HotkeyHandler& onHotkey)
+    {
+        Stop();
+        m_controller = controller;
+        m_onHotkey = onHotkey;
+        m_running = true;
+        m_reader = std::thread([this] { ReadLoop(); });
+    }
+    void Stop()
+    {
+        if (!m_running.exchange(false)) return;
+        Wake();
+        if (m_reader.joinable()) m_reader.join();
+        Remove();
+    }
+
+    // ---- KeyboardHook: capture on, keyboards grabbed as soon as their keys are up ----
+    bool Install() override
+    {
+        m_capture = true;
+        Wake();
+        return !m_devices.empty();
+    }
+    // From another thread this is handed to the reader, which ungrabs and then captures what
+    // the kernel queued before the ungrab; it returns once those keys are in the ring
+    void Remove() override
+    {
+        if (!m_running || std::this_thread::get_id() == m_reader.get_id()) {
+            Release();
+            return;
+        }
+        std::unique_lock<std::mutex> lock(m_removeMutex);
+        uint64_t ticket = ++m_removeAsked;
+        Wake();
+        m_removeDone.wait(lock, [&] { return m_removeServed >= ticket || !m_running; });
+    }
+    bool Grabbed() const
+    {
+        std::lock_guard<std::mutex> lock(m_grabMutex);
+        for (const Device& d : m_devices) {
+            if (d.grabbed) return true;
+        }
+        return false;
+    }
+
+    // ---- HotkeyRegistrar: matched on the reader thread, exact modifiers like RegisterHotKey ----
+    bool Register(uint16_t vk, uint32_t mods) override
+    {
+        m_hotkey = static_cast<uint32_t>(vk) << 16 | (mods & HOTKEY_MOD_MASK);
+        return !m_devices.empty();
+    }
+    void Unregister() override { m_hotkey = 0; }
+
+    // Kernel timestamp -> OnKey() returned, per event seen during capture
+    LatencyHistogram captureNs;
+
+private:
+    struct Device
+    {
+        int fd = -1;
+        std::string name;
+        bool monotonic = false;
+        bool owned = false;
+        bool grabbed = false; // Under m_grabMutex
+        bool open = true; // Reader thread only
+        std::bitset<KEY_CNT> down; // Reader thread only
+    };
+
+    void Wake()
+    {
+        uint64_t one = 1;
+        if (m_wake >= 0 && write(m_wake, &one, sizeof(one)) < 0) {}
+    }
+
+    void ReadLoop()
+    {
+        // Outrank the worker this thread feeds (a thread's own nice value on Linux); needs CAP_SYS_NICE, best effort
+        setpriority(PRIO_PROCESS, 0, -10);
+        TraceThreadName("evdev reader");
+        std::vector<pollfd> fds(m_devices.size() + 1);
+        input_event buf[64];
+        while (m_running) {
+            for (size_t i = 0; i < m_devices.size(); ++i) fds[i] = { m_devices[i].open ? m_devices[i].fd : -1, POLLIN, 0 };
+            fds.back() = { m_wake, POLLIN, 0 };
+            if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR) break;
+            if (fds.back().revents & POLLIN) {
+                uint64_t n;
+                if (read(m_wake, &n, sizeof(n)) < 0) {}
+            }
+            for (size_t i = 0; i < m_devices.size(); ++i) {
+                Device& d = m_devices[i];
+                if (!fds[i].revents) continue;
+                ssize_t n = read(d.fd, buf, sizeof(buf));
+                if (n <= 0) {
+                    if (n == 0 || (errno != EAGAIN && errno != EINTR)) d.open = false; // Unplugged (ENODEV) or closed
+                    continue;
+                }
+                for (size_t k = 0; k < static_cast<size_t>(n) / sizeof(input_event); ++k) Handle(d, buf[k], m_capture);
+            }
+            if (m_capture) GrabIdle();
+            ServeRemove();
+        }
+        ServeRemove(); // Stop() must not leave a Remove() waiting
+    }
+
+    void ServeRemove()
+    {
+        std::lock_guard<std::mutex> lock(m_removeMutex);
+        if (m_removeServed == m_removeAsked) return;
+        Release();
+        m_removeServed = m_removeAsked;
+        m_removeDone.notify_all();
+    }
+
+    // Reader thread (or no reader): ungrab, then flush what was queued while grabbed
+    void Release()
+    {
+        if (!m_capture.exchange(false)) return; // From here the reader passes keys on
+        uint64_t ungrabNs = MonotonicNs();
+        {
+            std::lock_guard<std::mutex> lock(m_grabMutex);
+            for (Device& d : m_devices) {
+                if (d.grabbed && d.owned) ioctl(d.fd, EVIOCGRAB, 0);
+                d.grabbed = false;
+            }
+        }
+        input_event buf[64];
+        for (Device& d : m_devices) {
+            ssize_t n;
+            while (d.open && (n = read(d.fd, buf, sizeof(buf))) > 0) {
+                for (size_t k = 0; k < static_cast<size_t>(n) / sizeof(input_event); ++k)
+                    Handle(d, buf[k], !d.monotonic || EventNs(d, buf[k]) < ungrabNs); // Later keys reached the game too
+            }
+        }
+    }
+
+    static uint64_t EventNs(const Device& d, const input_event& ie)
+    {
+        return d.monotonic ? static_cast<uint64_t>(ie.input_event_sec) * 1000000000ULL + static_cast<uint64_t>(ie.input_event_usec) * 1000ULL : MonotonicNs();
+    }
+
+    void Handle(Device& d, const input_event& ie, bool capture)
+    {
+        if (ie.type != EV_KEY || ie.code >= KEY_CNT) return;
+        bool down = ie.value != 0;
+        d.down[ie.code] = down;
+        uint16_t flags = down ? 0 : KEY_UP;
+        uint16_t vk = EvdevKeyMap::Get().ToVK(ie.code, flags);
+        if (!vk) return;
+        uint32_t bit = EvdevModifierBit(vk);
+        if (bit) {
+            // Either side holds the modifier
+            uint16_t other = static_cast<uint16_t>(vk ^ 1);
+            if (vk == 0x5B || vk == 0x5C) other = vk == 0x5B ? 0x5C : 0x5B;
+            if (down) m_mods |= bit;
+            else if (!m_sideDown[other]) m_mods &= ~bit;
+            m_sideDown[vk] = down;
+        }
+        KeyEvent ev;
+        ev.timeNs = EventNs(d, ie);
+        ev.vk = vk;
+        ev.scan = ie.code;
+        ev.flags = flags;
+        ev.extra = 0;
+        uint32_t hotkey = m_hotkey;
+        bool fire = ie.value == 1 && hotkey && vk == (hotkey >> 16) && m_mods == (hotkey & HOTKEY_MOD_MASK);
+        if (capture) {
+            // Passed events are the hotkey chords, which are ours to act on: nothing to re-inject
+            m_controller->OnKey(ev, m_mods);
+            if (d.monotonic) captureNs.Record(MonotonicNs() - ev.timeNs);
+        }
+        else {
+            m_controller->PhysicalKeys().Apply(ev);
+        }
+        if (fire && m_onHotkey) m_onHotkey();
+    }
+
+    void GrabIdle()
+    {
+        std::lock_guard<std::mutex> lock(m_grabMutex);
+        for (Device& d : m_devices) {
+            if (!m_capture || d.grabbed || !d.open || d.down.any()) continue;
+            d.grabbed = ioctl(d.fd, EVIOCGRAB, 1) == 0 || !d.owned; // Pipes can't be grabbed; count them as held
+        }
+    }
+
+    std::vector<Device> m_devices;
+    int m_wake;
+    mutable std::mutex m_grabMutex;
+    std::thread m_reader;
+    std::atomic<bool> m_running{ false };
+    std::atomic<bool> m_capture{ false };
+    std::atomic<uint32_t> m_hotkey{ 0 }; // vk << 16 | mods, 0 = none
+    PauseController* m_controller = nullptr;
+    HotkeyHandler m_onHotkey;
+    std::mutex m_removeMutex;
+    std::condition_variable m_removeDone;
+    uint64_t m_removeAsked = 0; // Under m_removeMutex
+    uint64_t m_removeServed = 0;
+    uint32_t m_mods = 0; // Reader thread only
+    bool m_sideDown[256] = {};
+};
+#endif
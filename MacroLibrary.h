@@ -0,0 +1,545 @@
+// =============================================================================
+// MacroLibrary.h - Saved pause sessions, memory-mapped and replayed in place
+//
+// The keys typed during a pause can be kept as a named macro and played back
+// later by hotkey. Every macro lives in one binary file:
+//   MacroFileHeader        64 bytes: magic, version, section offsets, size
+//   MacroIndexEntry[n]     32 bytes each, sorted by name
+//   name table             names back to back, no terminators
+//   KeyEvent[total]        16-byte aligned; the struct the hook captures,
+//                          with times rebased to 0 at each macro's first key
+// MacroLibrary maps the file read-only and checks only the header, so opening
+// costs the same for ten macros or ten thousand; the OS pages in whatever a
+// lookup or replay touches. Find() is a binary search over the index and a
+// macro's events go to the ReplayScheduler straight from the mapping.
+// Files are in host byte order (little-endian everywhere GamePauser runs).
+//
+// MacroLibraryWriter builds a whole new file, optionally seeded from an open
+// library, and renames it over the old one: readers never see half a file.
+// =============================================================================
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "KeyRing.h"
+
+const uint32_t MACRO_FILE_VERSION = 1;
+const size_t MACRO_NAME_MAX = 255;
+static const char MACRO_FILE_MAGIC[8] = { 'G', 'P', 'M', 'A', 'C', 'R', 'O', 'S' };
+
+struct MacroFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t count; // Entries in the index
+    uint64_t indexOffset;
+    uint64_t namesOffset;
+    uint64_t namesBytes;
+    uint64_t eventsOffset;
+    uint64_t eventCount; // KeyEvents in the whole file
+    uint64_t fileSize; // Catches truncated copies
+};
+static_assert(sizeof(MacroFileHeader) == 64, "MacroFileHeader is part of the file format");
+
+struct MacroIndexEntry
+{
+    uint64_t firstEvent; // Into the event array
+    uint64_t durationNs; // Time of the last event (the first is 0)
+    uint32_t eventCount;
+    uint32_t nameOffset; // Into the name table
+    uint16_t nameLength;
+    uint16_t flags; // Reserved, 0
+    uint32_t reserved;
+};
+static_assert(sizeof(MacroIndexEntry) == 32, "MacroIndexEntry is part of the file format");
+
+// One macro inside a mapped library. Points into the mapping: valid until the
+// library is closed or reopened.
+struct MacroView
+{
+    const char* name = nullptr;
+    size_t nameLength = 0;
+    const KeyEvent* events = nullptr;
+    size_t count = 0;
+    uint64_t durationNs = 0;
+
+    bool Valid() const { return name != nullptr; }
+    std::string Name() const { return std::string(name, nameLength); }
+};
+
+// Same order as std::string's operator< - the writer sorts with a std::map
+static inline int CompareMacroName(const char* a, size_t na, const char* b, size_t nb)
+{
+    int c = std::memcmp(a, b, std::min(na, nb));
+    if (c) return c;
+    return na < nb ? -1 : (na > nb ? 1 : 0);
+}
+
+static inline bool ValidMacroName(const std::string& name)
+{
+    if (name.empty() || name.size() > MACRO_NAME_MAX) return false;
+    for (char c : name)
+        if (c == '\n' || c == '\r' || c == ',') return false; // Would break the text form or an INI binding
+    return true;
+}
+
+class MacroLibrary
+{
+public:
+    MacroLibrary() {}
+    ~MacroLibrary() { Close(); }
+    MacroLibrary(const MacroLibrary&) = delete;
+    MacroLibrary& operator=(const MacroLibrary&) = delete;
+
+    // Maps the file and validates the header. Nothing else is read.
+    bool Open(const std::string& path)
+    {
+        Close();
+        m_error.clear();
+        m_missing = false;
+        m_path = path;
+#ifdef _WIN32
+        // FILE_SHARE_DELETE so a writer can still rename a new library into place
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            m_missing = GetLastError() == ERROR_FILE_NOT_FOUND;
+            return Fail(m_missing ? "no such file" : "cannot open file");
+        }
+        LARGE_INTEGER size = {};
+        if (GetFileSizeEx(file, &size) && size.QuadPart >= static_cast<LONGLONG>(sizeof(MacroFileHeader))) {
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping) {
+                m_base = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                CloseHandle(mapping); // The view keeps the section alive
+            }
+            if (m_base) m_size = static_cast<uint64_t>(size.QuadPart);
+        }
+        CloseHandle(file);
+#else
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            m_missing = errno == ENOENT;
+            return Fail(m_missing ? "no such file" : std::strerror(errno));
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(MacroFileHeader))) {
+            void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED) {
+                m_base = static_cast<const uint8_t*>(p);
+                m_size = static_cast<uint64_t>(st.st_size);
+            }
+        }
+        close(fd);
+#endif
+        if (!m_base) return Fail("too small or cannot be mapped");
+        const MacroFileHeader* h = reinterpret_cast<const MacroFileHeader*>(m_base);
+        if (std::memcmp(h->magic, MACRO_FILE_MAGIC, sizeof(h->magic)) != 0) return Fail("not a macro library");
+        if (h->version != MACRO_FILE_VERSION) return Fail("unsupported version");
+        if (h->fileSize != m_size) return Fail("truncated or padded");
+        if (h->indexOffset % 8 || h->eventsOffset % 16 || !Fits(h->indexOffset, h->count, sizeof(MacroIndexEntry))
+            || !Fits(h->namesOffset, h->namesBytes, 1) || !Fits(h->eventsOffset, h->eventCount, sizeof(KeyEvent)))
+            return Fail("corrupt header");
+        m_count = h->count;
+        m_index = reinterpret_cast<const MacroIndexEntry*>(m_base + h->indexOffset);
+        m_names = reinterpret_cast<const char*>(m_base + h->namesOffset);
+        m_namesBytes = h->namesBytes;
+        m_events = reinterpret_cast<const KeyEvent*>(m_base + h->eventsOffset);
+        m_eventCount = h->eventCount;
+        return true;
+    }
+
+    void Close()
+    {
+        if (m_base) {
+#ifdef _WIN32
+            UnmapViewOfFile(m_base);
+#else
+            munmap(const_cast<uint8_t*>(m_base), static_cast<size_t>(m_size));
+#endif
+        }
+        m_base = nullptr;
+        m_size = 0;
+        m_count = 0;
+        m_index = nullptr;
+        m_names = nullptr;
+        m_namesBytes = 0;
+        m_events = nullptr;
+        m_eventCount = 0;
+    }
+
+    bool IsOpen() const { return m_base != nullptr; }
+    size_t Count() const { return m_count; }
+    uint64_t FileBytes() const { return m_size; }
+    const std::string& Path() const { return m_path; }
+    const std::string& Error() const { return m_error; } // Why the last Open() failed
+    // The last Open() failed only because there is no file yet. Any other failure
+    // means a library may be there: never write a new one over it.
+    bool Missing() const { return m_missing; }
+
+    // Entries are in name order. An entry pointing outside the file comes back invalid.
+    MacroView At(size_t i) const
+    {
+        MacroView v;
+        if (i >= m_count) return v;
+        const MacroIndexEntry& e = m_index[i];
+        if (!EntryInBounds(e)) return v;
+        v.name = m_names + e.nameOffset;
+        v.nameLength = e.nameLength;
+        v.events = m_events + e.firstEvent;
+        v.count = e.eventCount;
+        v.durationNs = e.durationNs;
+        return v;
+    }
+
+    MacroView Find(const std::string& name) const
+    {
+        size_t lo = 0, hi = m_count;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            const MacroIndexEntry& e = m_index[mid];
+            if (!EntryInBounds(e)) return MacroView();
+            int c = CompareMacroName(m_names + e.nameOffset, e.nameLength, name.data(), name.size());
+            if (c == 0) return At(mid);
+            if (c < 0) lo = mid + 1;
+            else hi = mid;
+        }
+        return MacroView();
+    }
+
+private:
+    bool Fail(const char* why)
+    {
+        Close();
+        m_error = why;
+        return false;
+    }
+
+    // [offset, offset + n * size) lies inside the mapping, without overflowing
+    bool Fits(uint64_t offset, uint64_t n, uint64_t size) const
+    {
+        return offset <= m_size && n <= (m_size - offset) / size;
+    }
+
+    bool EntryInBounds(const MacroIndexEntry& e) const
+    {
+        return static_cast<uint64_t>(e.nameOffset) + e.nameLength <= m_namesBytes
+            && e.firstEvent <= m_eventCount && e.eventCount <= m_eventCount - e.firstEvent;
+    }
+
+    std::string m_path;
+    std::string m_error;
+    bool m_missing = false;
+    const uint8_t* m_base = nullptr;
+    uint64_t m_size = 0;
+    size_t m_count = 0;
+    const MacroIndexEntry* m_index = nullptr;
+    const char* m_names = nullptr;
+    uint64_t m_namesBytes = 0;
+    const KeyEvent* m_events = nullptr;
+    uint64_t m_eventCount = 0;
+};
+
+class MacroLibraryWriter
+{
+public:
+    // Copies every macro of an open library (e.g. before adding one more)
+    void AddLibrary(const MacroLibrary& library)
+    {
+        for (size_t i = 0; i < library.Count(); ++i) {
+            MacroView m = library.At(i);
+            if (m.Valid()) m_macros[m.Name()].assign(m.events, m.events + m.count);
+        }
+    }
+
+    // Replaces any macro of the same name. False if the name can't be stored.
+    bool Add(const std::string& name, const KeyEvent* events, size_t count)
+    {
+        if (!ValidMacroName(name)) return false;
+        std::vector<KeyEvent>& out = m_macros[name];
+        out.assign(events, events + count);
+        uint64_t t0 = out.empty() ? 0 : out.front().timeNs;
+        for (KeyEvent& ev : out) {
+            ev.timeNs = ev.timeNs >= t0 ? ev.timeNs - t0 : 0;
+            ev.flags &= ~KEY_INJECTED;
+        }
+        return true;
+    }
+
+    bool Remove(const std::string& name) { return m_macros.erase(name) != 0; }
+
+    bool Rename(const std::string& from, const std::string& to)
+    {
+        auto it = m_macros.find(from);
+        if (it == m_macros.end() || !ValidMacroName(to) || m_macros.count(to)) return false;
+        std::vector<KeyEvent> events;
+        events.swap(it->second);
+        m_macros.erase(it);
+        m_macros[to].swap(events);
+        return true;
+    }
+
+    bool Contains(const std::string& name) const { return m_macros.count(name) != 0; }
+    size_t Count() const { return m_macros.size(); }
+
+    // Writes <path>.tmp and renames it over path. If reopen is the library
+    // currently mapping path it is closed for the swap (Windows won't replace
+    // a mapped file) and reopened on whichever file is in place afterwards.
+    bool Write(const std::string& path, MacroLibrary* reopen = nullptr, std::string* error = nullptr)
+    {
+        std::string tmp = path + ".tmp";
+        if (!WriteFile(tmp)) {
+            std::remove(tmp.c_str());
+            if (error) *error = "cannot write " + tmp;
+            return false;
+        }
+#ifdef _WIN32
+        if (reopen) reopen->Close();
+        bool ok = MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+#else
+        bool ok = std::rename(tmp.c_str(), path.c_str()) == 0; // An old mapping stays valid on the unlinked inode
+        if (reopen) reopen->Close();
+#endif
+        if (!ok) {
+            std::remove(tmp.c_str());
+            if (error) *error = "cannot replace " + path;
+        }
+        if (reopen && !reopen->Open(path) && ok) {
+            if (error) *error = "wrote " + path + " but cannot map it: " + reopen->Error();
+            return false;
+        }
+        return ok;
+    }
+
+private:
+    bool WriteFile(const std::string& path) const
+    {
+        MacroFileHeader h = {};
+        std::memcpy(h.magic, MACRO_FILE_MAGIC, sizeof(h.magic));
+        h.version = MACRO_FILE_VERSION;
+        h.count = static_cast<uint32_t>(m_macros.size());
+        h.indexOffset = sizeof(MacroFileHeader);
+        h.namesOffset = h.indexOffset + m_macros.size() * sizeof(MacroIndexEntry);
+        std::vector<MacroIndexEntry> index;
+        index.reserve(m_macros.size());
+        for (const auto& m : m_macros) {
+            MacroIndexEntry e = {};
+            e.firstEvent = h.eventCount;
+            e.eventCount = static_cast<uint32_t>(m.second.size());
+            e.durationNs = m.second.empty() ? 0 : m.second.back().timeNs;
+            e.nameOffset = static_cast<uint32_t>(h.namesBytes);
+            e.nameLength = static_cast<uint16_t>(m.first.size());
+            index.push_back(e);
+            h.namesBytes += m.first.size();
+            h.eventCount += m.second.size();
+        }
+        h.eventsOffset = (h.namesOffset + h.namesBytes + 15) & ~static_cast<uint64_t>(15);
+        h.fileSize = h.eventsOffset + h.eventCount * sizeof(KeyEvent);
+        FILE* f = std::fopen(path.c_str(), "wb");
+        if (!f) return false;
+        bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+        if (ok && !index.empty()) ok = std::fwrite(index.data(), sizeof(MacroIndexEntry), index.size(), f) == index.size();
+        for (const auto& m : m_macros)
+            if (ok) ok = std::fwrite(m.first.data(), 1, m.first.size(), f) == m.first.size();
+        static const char zeros[16] = {};
+        size_t pad = static_cast<size_t>(h.eventsOffset - h.namesOffset - h.namesBytes);
+        if (ok && pad) ok = std::fwrite(zeros, 1, pad, f) == pad;
+        for (const auto& m : m_macros)
+            if (ok && !m.second.empty()) ok = std::fwrite(m.second.data(), sizeof(KeyEvent), m.second.size(), f) == m.second.size();
+        ok = std::fclose(f) == 0 && ok;
+        return ok;
+    }
+
+    std::map<std::string, std::vector<KeyEvent>> m_macros; // Sorted by name, as the index must be
+};
+
+// -----------------------------------------------------------------------------
+// Text form, for export / import / hand editing:
+//   macro <name>
+//   <ms> <down|up> <vk> <scan> [ext] [unicode]     (vk and scan in hex)
+//   end
+// -----------------------------------------------------------------------------
+static inline void ExportMacro(std::ostream& out, const MacroView& m)
+{
+    out << "macro " << m.Name() << "\n";
+    char line[96];
+    for (size_t i = 0; i < m.count; ++i) {
+        const KeyEvent& ev = m.events[i];
+        std::snprintf(line, sizeof(line), "%.3f %s 0x%02X 0x%02X%s%s\n", ev.timeNs / 1e6, (ev.flags & KEY_UP) ? "up" : "down",
+            ev.vk, ev.scan, (ev.flags & KEY_EXTENDED) ? " ext" : "", (ev.flags & KEY_UNICODE) ? " unicode" : "");
+        out << line;
+    }
+    out << "end\n";
+}
+
+// Adds every macro in the text to the writer. On a malformed line, error gets
+// the line number and nothing more is read.
+static inline bool ImportMacros(std::istream& in, MacroLibraryWriter& writer, size_t& imported, std::string& error)
+{
+    std::string line, name;
+    std::vector<KeyEvent> events;
+    bool inMacro = false;
+    imported = 0;
+    for (size_t lineNo = 1; std::getline(in, line); ++lineNo) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == '#' || line[first] == ';') continue;
+        line = line.substr(first);
+        if (!inMacro) {
+            if (line.compare(0, 6, "macro ") != 0 || !ValidMacroName(line.substr(6))) {
+                error = "line " + std::to_string(lineNo) + ": expected 'macro <name>'";
+                return false;
+            }
+            name = line.substr(6);
+            events.clear();
+            inMacro = true;
+            continue;
+        }
+        if (line == "end") {
+            writer.Add(name, events.data(), events.size());
+            ++imported;
+            inMacro = false;
+            continue;
+        }
+        std::istringstream fields(line);
+        double ms = 0;
+        std::string dir, vk, scan, flag;
+        KeyEvent ev = {};
+        bool ok = static_cast<bool>(fields >> ms >> dir >> vk >> scan) && ms >= 0 && (dir == "down" || dir == "up");
+        try {
+            if (ok) {
+                ev.vk = static_cast<uint16_t>(std::stoul(vk, nullptr, 16));
+                ev.scan = static_cast<uint16_t>(std::stoul(scan, nullptr, 16));
+            }
+        }
+        catch (...) {
+            ok = false;
+        }
+        while (ok && fields >> flag) {
+            if (flag == "ext") ev.flags |= KEY_EXTENDED;
+            else if (flag == "unicode") ev.flags |= KEY_UNICODE;
+            else ok = false;
+        }
+        if (!ok) {
+            error = "line " + std::to_string(lineNo) + ": expected '<ms> <down|up> <vk> <scan> [ext] [unicode]'";
+            return false;
+        }
+        ev.timeNs = static_cast<uint64_t>(ms * 1e6 + 0.5);
+        if (dir == "up") ev.flags |= KEY_UP;
+        events.push_back(ev);
+    }
+    if (inMacro) {
+        error = "macro '" + name + "' has no 'end'";
+        return false;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// Tool mode: GamePauser --macros <library> <command>
+// -----------------------------------------------------------------------------
+static inline int MacroToolUsage()
+{
+    std::printf("Usage: --macros <library> <command>\n"
+                "  list                  name, key events and length of every macro\n"
+                "  export [name]         print macros (all, or one) in text form\n"
+                "  import <text file>    add or replace macros from text form\n"
+                "  delete <name>\n"
+                "  rename <old> <new>\n");
+    return 2;
+}
+
+// args[0] is the library path, args[1] the command
+static inline int RunMacroTool(int argc, char** args)
+{
+    if (argc < 2) return MacroToolUsage();
+    std::string path = args[0], cmd = args[1];
+    MacroLibrary library;
+    bool exists = library.Open(path);
+    if (!exists && (cmd != "import" || !library.Missing())) { // Import may start a library, not replace a broken one
+        std::fprintf(stderr, "%s: %s\n", path.c_str(), library.Error().c_str());
+        return 1;
+    }
+    if (cmd == "list") {
+        uint64_t events = 0;
+        for (size_t i = 0; i < library.Count(); ++i) {
+            MacroView m = library.At(i);
+            if (!m.Valid()) continue;
+            std::printf("  %-32s %6zu key events  %8.2f s\n", m.Name().c_str(), m.count, m.durationNs / 1e9);
+            events += m.count;
+        }
+        std::printf("%zu macros, %llu key events, %llu bytes\n", library.Count(),
+            static_cast<unsigned long long>(events), static_cast<unsigned long long>(library.FileBytes()));
+        return 0;
+    }
+    if (cmd == "export") {
+        if (argc > 2) {
+            MacroView m = library.Find(args[2]);
+            if (!m.Valid()) {
+                std::fprintf(stderr, "No macro named '%s'\n", args[2]);
+                return 1;
+            }
+            ExportMacro(std::cout, m);
+            return 0;
+        }
+        for (size_t i = 0; i < library.Count(); ++i) {
+            MacroView m = library.At(i);
+            if (m.Valid()) ExportMacro(std::cout, m);
+        }
+        return 0;
+    }
+    MacroLibraryWriter writer;
+    writer.AddLibrary(library);
+    if (cmd == "import" && argc > 2) {
+        std::ifstream in(args[2]);
+        if (!in) {
+            std::fprintf(stderr, "Cannot read %s\n", args[2]);
+            return 1;
+        }
+        size_t imported = 0;
+        std::string error;
+        if (!ImportMacros(in, writer, imported, error)) {
+            std::fprintf(stderr, "%s: %s\n", args[2], error.c_str());
+            return 1;
+        }
+        std::printf("Imported %zu macros\n", imported);
+    }
+    else if (cmd == "delete" && argc > 2) {
+        if (!writer.Remove(args[2])) {
+            std::fprintf(stderr, "No macro named '%s'\n", args[2]);
+            return 1;
+        }
+    }
+    else if (cmd == "rename" && argc > 3) {
+        if (!writer.Rename(args[2], args[3])) {
+            std::fprintf(stderr, "Cannot rename '%s' to '%s' (missing, taken or invalid name)\n", args[2], args[3]);
+            return 1;
+        }
+    }
+    else {
+        return MacroToolUsage();
+    }
+    std::string error;
+    if (!writer.Write(path, &library, &error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    std::printf("%s: %zu macros\n", path.c_str(), library.Count());
+    return 0;
+}
@@ -0,0 +1,359 @@
+// =============================================================================
+// MemoryTrim.h - Give a frozen target's memory back, fetch it again on resume
+//
+// While a game is suspended its working set only costs the rest of the
+// machine. Trim() records which pages are resident (the "hot" set, as runs of
+// contiguous pages), then asks the OS to page the process out:
+//   Windows - EmptyWorkingSet (pages go to the standby list; the hot set is
+//             the QueryWorkingSet page list)
+//   Linux   - process_madvise(MADV_PAGEOUT) over the hot set, read from
+//             /proc/<pid>/pagemap (whole VMAs with Rss > 0 if pagemap can't be
+//             read). Anonymous pages need swap to go anywhere; clean
+//             file-backed pages are always dropped.
+// Prefetch() reads the hot set back into memory in the background:
+// PrefetchVirtualMemory on Windows, process_madvise(MADV_WILLNEED) on Linux.
+// It only saves the disk reads. Neither call maps the pages back into the
+// target, so its first touch of each one still faults (a minor fault instead
+// of a major one), and a target that touches everything at once outruns it.
+// =============================================================================
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef SYS_process_madvise
+#define SYS_process_madvise 440
+#endif
+#ifndef MADV_PAGEOUT
+#define MADV_PAGEOUT 21
+#endif
+#endif
+
+struct MemoryOptions
+{
+    bool trimWhilePaused = false; // Page the frozen target out
+    bool prefetchOnResume = true; // Bring its hot set back in the background on resume
+    uint64_t prefetchLimit = 0; // Bytes per process, 0 = whole hot set
+};
+
+struct MemoryRegion
+{
+    uint64_t base;
+    uint64_t size;
+    uint64_t resident; // Bytes resident when recorded (== size for a run of resident pages)
+};
+
+struct TrimResult
+{
+    bool ok = false;
+    uint64_t rssBefore = 0;
+    uint64_t rssAfter = 0;
+    size_t regions = 0; // Hot runs recorded for prefetch
+    uint64_t hotBytes = 0;
+    int64_t elapsedNs = 0;
+};
+
+struct PrefetchResult
+{
+    bool ok = false;
+    uint64_t bytes = 0;
+    size_t calls = 0;
+    int64_t elapsedNs = 0;
+};
+
+static inline int64_t TrimNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Resident set size in bytes; 0 if unreadable
+static inline uint64_t ProcessResidentBytes(uint32_t pid)
+{
+#ifdef _WIN32
+    HANDLE h = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (!h) return 0;
+    PROCESS_MEMORY_COUNTERS pmc = {};
+    pmc.cb = sizeof(pmc);
+    uint64_t rss = GetProcessMemoryInfo(h, &pmc, sizeof(pmc)) ? pmc.WorkingSetSize : 0;
+    CloseHandle(h);
+    return rss;
+#else
+    char path[64];
+    std::snprintf(path, sizeof(path), "/proc/%u/statm", pid);
+    FILE* f = std::fopen(path, "r");
+    if (!f) return 0;
+    unsigned long long size = 0, resident = 0;
+    int n = std::fscanf(f, "%llu %llu", &size, &resident);
+    std::fclose(f);
+    return n == 2 ? resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE)) : 0;
+#endif
+}
+
+struct PageFaults
+{
+    uint64_t total = 0;
+    uint64_t major = 0; // Had to wait for I/O (Linux only; Windows doesn't split them)
+};
+
+static inline PageFaults ProcessPageFaults(uint32_t pid)
+{
+    PageFaults pf;
+#ifdef _WIN32
+    HANDLE h = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (!h) return pf;
+    PROCESS_MEMORY_COUNTERS pmc = {};
+    pmc.cb = sizeof(pmc);
+    if (GetProcessMemoryInfo(h, &pmc, sizeof(pmc))) pf.total = pmc.PageFaultCount;
+    CloseHandle(h);
+#else
+    char path[64];
+    std::snprintf(path, sizeof(path), "/proc/%u/stat", pid);
+    FILE* f = std::fopen(path, "r");
+    if (!f) return pf;
+    char buf[1024];
+    size_t n = std::fread(buf, 1, sizeof(buf) - 1, f);
+    std::fclose(f);
+    buf[n] = 0;
+    const char* p = std::strrchr(buf, ')');
+    if (!p) return pf;
+    // Fields 10 (minflt) and 12 (majflt); we're positioned before field 3
+    unsigned long long minflt = 0, majflt = 0;
+    if (std::sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %llu %*u %llu", &minflt, &majflt) == 2) {
+        pf.total = minflt + majflt;
+        pf.major = majflt;
+    }
+#endif
+    return pf;
+}
+
+class WorkingSetTrimmer
+{
+public:
+    // prefetchBudget caps how much of the hot set is brought back (0 = all)
+    explicit WorkingSetTrimmer(uint64_t prefetchBudget = 0) : m_budget(prefetchBudget) {}
+    ~WorkingSetTrimmer() { Close(); }
+    WorkingSetTrimmer(const WorkingSetTrimmer&) = delete;
+    WorkingSetTrimmer& operator=(const WorkingSetTrimmer&) = delete;
+
+    uint32_t Pid() const { return m_pid; }
+    const std::vector<MemoryRegion>& HotRegions() const { return m_hot; }
+
+    // Record the hot set, then page the (already frozen) process out
+    TrimResult Trim(uint32_t pid)
+    {
+        TrimResult r;
+        int64_t t0 = TrimNowNs();
+        Close();
+        m_pid = pid;
+        r.rssBefore = ProcessResidentBytes(pid);
+#ifdef _WIN32
+        m_process = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_SET_QUOTA | PROCESS_VM_READ | PROCESS_VM_OPERATION, FALSE, pid);
+        if (m_process) {
+            RecordHotRegions(r.rssBefore);
+            r.ok = EmptyWorkingSet(m_process) != FALSE;
+        }
+#else
+        m_pidfd = static_cast<int>(syscall(SYS_pidfd_open, static_cast<pid_t>(pid), 0));
+        if (m_pidfd >= 0) {
+            RecordHotRegions(r.rssBefore);
+            size_t calls = 0;
+            r.ok = Advise(m_hot, MADV_PAGEOUT, calls);
+        }
+#endif
+        r.rssAfter = ProcessResidentBytes(pid);
+        r.regions = m_hot.size();
+        for (const MemoryRegion& m : m_hot) r.hotBytes += m.resident;
+        r.elapsedNs = TrimNowNs() - t0;
+        return r;
+    }
+
+    // Bring the hot set back in, most resident first, up to the budget: the run
+    // that crosses it is cut at the budget, so bytes never exceeds it.
+    // Safe to run on a background thread while the target resumes.
+    PrefetchResult Prefetch()
+    {
+        PrefetchResult r;
+        int64_t t0 = TrimNowNs();
+        std::vector<MemoryRegion> regions = m_hot;
+        std::sort(regions.begin(), regions.end(), [](const MemoryRegion& a, const MemoryRegion& b) { return a.resident > b.resident; });
+        uint64_t total = 0;
+        size_t keep = 0;
+        for (; keep < regions.size() && (m_budget == 0 || total < m_budget); ++keep) {
+            MemoryRegion& m = regions[keep];
+            if (m_budget && m.size > m_budget - total) m.size = (m_budget - total) & ~static_cast<uint64_t>(4095); // Whole pages
+            if (!m.size) break;
+            total += m.size;
+        }
+        regions.resize(keep);
+        // Back to address order: sequential readahead works best ascending
+        std::sort(regions.begin(), regions.end(), [](const MemoryRegion& a, const MemoryRegion& b) { return a.base < b.base; });
+#ifdef _WIN32
+        if (m_process && !regions.empty()) {
+            std::vector<WIN32_MEMORY_RANGE_ENTRY> entries;
+            for (const MemoryRegion& m : regions)
+                entries.push_back({ reinterpret_cast<void*>(static_cast<uintptr_t>(m.base)), static_cast<SIZE_T>(m.size) });
+            r.ok = true;
+            for (size_t i = 0; i < entries.size(); i += 256) {
+                ULONG n = static_cast<ULONG>(std::min<size_t>(256, entries.size() - i));
+                r.ok = PrefetchVirtualMemory(m_process, n, &entries[i], 0) != FALSE && r.ok;
+                ++r.calls;
+            }
+        }
+#else
+        if (m_pidfd >= 0 && !regions.empty()) r.ok = Advise(regions, MADV_WILLNEED, r.calls);
+#endif
+        for (const MemoryRegion& m : regions) r.bytes += m.size;
+        r.elapsedNs = TrimNowNs() - t0;
+        return r;
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (m_process) CloseHandle(m_process);
+        m_process = nullptr;
+#else
+        if (m_pidfd >= 0) close(m_pidfd);
+        m_pidfd = -1;
+#endif
+        m_hot.clear();
+        m_pid = 0;
+    }
+
+private:
+#ifdef _WIN32
+    // The working-set page list, collapsed into contiguous runs
+    void RecordHotRegions(uint64_t)
+    {
+        std::vector<ULONG_PTR> buf(4096);
+        for (int attempt = 0; attempt < 4; ++attempt) {
+            if (QueryWorkingSet(m_process, buf.data(), static_cast<DWORD>(buf.size() * sizeof(ULONG_PTR)))) break;
+            if (GetLastError() != ERROR_BAD_LENGTH) return;
+            buf.resize(buf[0] + buf[0] / 8 + 1024); // First word holds the entry count; leave room for growth
+        }
+        size_t count = std::min<size_t>(buf[0], buf.size() - 1);
+        std::vector<uint64_t> pages(count);
+        for (size_t i = 0; i < count; ++i) pages[i] = buf[i + 1] >> 12; // Bits 12+ are the virtual page
+        std::sort(pages.begin(), pages.end());
+        for (size_t i = 0; i < pages.size();) {
+            size_t j = i + 1;
+            while (j < pages.size() && pages[j] == pages[j - 1] + 1) ++j;
+            uint64_t bytes = static_cast<uint64_t>(j - i) << 12;
+            m_hot.push_back({ pages[i] << 12, bytes, bytes });
+            i = j;
+        }
+    }
+
+    HANDLE m_process = nullptr;
+#else
+    // Runs of resident pages: the VMAs with Rss > 0 from /proc/<pid>/smaps, narrowed
+    // to their present or swapped pages by /proc/<pid>/pagemap when it can be read
+    void RecordHotRegions(uint64_t)
+    {
+        char path[64];
+        std::snprintf(path, sizeof(path), "/proc/%u/smaps", m_pid);
+        FILE* f = std::fopen(path, "r");
+        if (!f) return;
+        std::vector<MemoryRegion> vmas;
+        char line[512];
+        MemoryRegion cur = { 0, 0, 0 };
+        bool skip = true;
+        while (std::fgets(line, sizeof(line), f)) {
+            unsigned long long lo, hi, kb;
+            if (std::sscanf(line, "%llx-%llx ", &lo, &hi) == 2) {
+                cur = { lo, hi - lo, 0 };
+                skip = std::strstr(line, "[vsyscall]") || std::strstr(line, "[vvar]") || std::strstr(line, "[vdso]");
+            }
+            else if (!skip && std::sscanf(line, "Rss: %llu kB", &kb) == 1 && kb > 0) {
+                cur.resident = kb * 1024;
+                vmas.push_back(cur);
+            }
+        }
+        std::fclose(f);
+        std::snprintf(path, sizeof(path), "/proc/%u/pagemap", m_pid);
+        int pagemap = open(path, O_RDONLY | O_CLOEXEC);
+        for (const MemoryRegion& vma : vmas) {
+            if (pagemap < 0 || !RecordResidentRuns(pagemap, vma)) m_hot.push_back(vma); // Whole VMA as before
+        }
+        if (pagemap >= 0) close(pagemap);
+    }
+
+    // One 64-bit pagemap entry per page: bit 63 present, bit 62 swapped
+    bool RecordResidentRuns(int pagemap, const MemoryRegion& vma)
+    {
+        const uint64_t PAGE = 4096, PRESENT = 1ULL << 63, SWAPPED = 1ULL << 62;
+        const size_t CHUNK = 4096; // Entries per read: 16 MB of address space
+        uint64_t entries[CHUNK];
+        uint64_t first = vma.base / PAGE, pages = vma.size / PAGE, runStart = 0;
+        bool inRun = false;
+        size_t before = m_hot.size();
+        for (uint64_t done = 0; done < pages;) {
+            size_t want = static_cast<size_t>(std::min<uint64_t>(CHUNK, pages - done));
+            ssize_t got = pread(pagemap, entries, want * sizeof(uint64_t), static_cast<off_t>((first + done) * sizeof(uint64_t)));
+            if (got <= 0) {
+                m_hot.resize(before);
+                return false;
+            }
+            size_t n = static_cast<size_t>(got) / sizeof(uint64_t);
+            for (size_t i = 0; i < n; ++i) {
+                bool hot = (entries[i] & (PRESENT | SWAPPED)) != 0;
+                uint64_t page = first + done + i;
+                if (hot && !inRun) runStart = page;
+                if (!hot && inRun) m_hot.push_back({ runStart * PAGE, (page - runStart) * PAGE, (page - runStart) * PAGE });
+                inRun = hot;
+            }
+            done += n;
+        }
+        if (inRun) m_hot.push_back({ runStart * PAGE, (first + pages - runStart) * PAGE, (first + pages - runStart) * PAGE });
+        return true;
+    }
+
+    // process_madvise in iovec batches; a failing VMA doesn't stop the rest.
+    // True if any of it was accepted.
+    bool Advise(const std::vector<MemoryRegion>& regions, int advice, size_t& calls)
+    {
+        const size_t BATCH = 512; // Under UIO_MAXIOV
+        std::vector<iovec> iov;
+        bool ok = false;
+        for (size_t i = 0; i < regions.size(); i += BATCH) {
+            iov.clear();
+            for (size_t j = i; j < std::min(regions.size(), i + BATCH); ++j)
+                iov.push_back({ reinterpret_cast<void*>(static_cast<uintptr_t>(regions[j].base)), static_cast<size_t>(regions[j].size) });
+            ++calls;
+            if (syscall(SYS_process_madvise, m_pidfd, iov.data(), iov.size(), advice, 0) >= 0) {
+                ok = true;
+                continue;
+            }
+            // One bad VMA (locked, special mapping) fails the batch: retry it region by region
+            for (const iovec& v : iov) {
+                ++calls;
+                if (syscall(SYS_process_madvise, m_pidfd, &v, 1, advice, 0) >= 0) ok = true;
+            }
+        }
+        return ok;
+    }
+
+    int m_pidfd = -1;
+#endif
+    uint32_t m_pid = 0;
+    uint64_t m_budget;
+    std::vector<MemoryRegion> m_hot;
+};
@@ -0,0 +1,394 @@
+// =============================================================================
+// Metrics.h - Counters, HDR-style histograms and a Prometheus text endpoint
+//
+// Recording is a handful of relaxed atomic adds: no locks, no allocation, so
+// the keyboard hook can record its own duration. Histograms are log-linear
+// (8 sub-buckets per power of two, ~12% resolution) over the full uint64
+// range. Per-title pause histograms are created on the main thread, never on
+// the hook path.
+//
+// MetricsServer answers any HTTP request on 127.0.0.1:<port> with the
+// Prometheus text exposition format (version 0.0.4).
+// =============================================================================
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static inline int HighestSetBit(uint64_t w)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, w);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(w);
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// Log-linear histogram. Values are whatever the caller records (ns, counts).
+// -----------------------------------------------------------------------------
+class LatencyHistogram
+{
+public:
+    static const int SUB_BITS = 3;
+    static const int SUB = 1 << SUB_BITS;
+    static const size_t BUCKETS = (64 - SUB_BITS) * SUB + SUB;
+
+    LatencyHistogram() { Reset(); }
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void Record(uint64_t v)
+    {
+        m_buckets[Index(v)].fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(v, std::memory_order_relaxed);
+        uint64_t max = m_max.load(std::memory_order_relaxed);
+        while (v > max && !m_max.compare_exchange_weak(max, v, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Summed at read time so Record() stays at two atomic adds
+    uint64_t Count() const
+    {
+        uint64_t n = 0;
+        for (const auto& b : m_buckets) n += b.load(std::memory_order_relaxed);
+        return n;
+    }
+    uint64_t Sum() const { return m_sum.load(std::memory_order_relaxed); }
+    uint64_t Max() const { return m_max.load(std::memory_order_relaxed); }
+
+    // Number of recorded values <= limit (bucket granularity)
+    uint64_t CountAtOrBelow(uint64_t limit) const
+    {
+        uint64_t n = 0;
+        for (size_t i = 0; i < BUCKETS && UpperBound(i) <= limit + 1; ++i)
+            n += m_buckets[i].load(std::memory_order_relaxed);
+        return n;
+    }
+
+    // Upper edge of the bucket holding the p-th value (0 < p <= 1)
+    uint64_t Percentile(double p) const
+    {
+        uint64_t total = Count();
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(p * total + 0.5);
+        if (rank == 0) rank = 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += m_buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank) return std::min(UpperBound(i) - 1, Max());
+        }
+        return Max();
+    }
+
+    void Reset()
+    {
+        for (auto& b : m_buckets) b.store(0, std::memory_order_relaxed);
+        m_sum.store(0, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+    static size_t Index(uint64_t v)
+    {
+        if (v < SUB) return static_cast<size_t>(v);
+        int shift = HighestSetBit(v) - SUB_BITS;
+        return static_cast<size_t>((shift + 1) * SUB + ((v >> shift) - SUB));
+    }
+    // Exclusive upper edge of bucket i (saturates at UINT64_MAX)
+    static uint64_t UpperBound(size_t i)
+    {
+        if (i < SUB) return i + 1;
+        int shift = static_cast<int>(i / SUB) - 1;
+        uint64_t top = static_cast<uint64_t>(SUB + i % SUB + 1);
+        return shift >= 60 && top >= 16 ? UINT64_MAX : top << shift;
+    }
+
+private:
+    std::atomic<uint64_t> m_buckets[BUCKETS];
+    std::atomic<uint64_t> m_sum, m_max;
+};
+
+// -----------------------------------------------------------------------------
+// Everything GamePauser measures
+// -----------------------------------------------------------------------------
+class PauseMetrics
+{
+public:
+    struct Title
+    {
+        LatencyHistogram freezeNs; // Hotkey -> every thread frozen
+        LatencyHistogram resumeToKeyNs; // Resume -> first replayed key out
+        LatencyHistogram threads; // Threads frozen per pause
+        std::atomic<uint64_t> pauses{ 0 };
+    };
+
+    LatencyHistogram hookNs; // Keyboard hook callback duration
+    std::atomic<uint64_t> captured{ 0 }; // Events queued for replay
+    std::atomic<uint64_t> dropped{ 0 }; // Lost to the ring's DropOldest policy
+    std::atomic<uint64_t> spilled{ 0 }; // Went through the overflow arena
+    std::atomic<uint64_t> discarded{ 0 }; // Thrown away by an Esc cancel
+    std::atomic<uint64_t> replayed{ 0 }; // Injected on resume
+    std::atomic<uint64_t> optimized{ 0 }; // Removed by the capture optimizer before replay
+    std::atomic<uint64_t> freezeFailures{ 0 };
+    std::atomic<uint32_t> paused{ 0 }; // Gauge: 1 while a target is frozen
+
+    // Main-thread only (pause/resume path)
+    Title& ForTitle(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(m_titlesMutex);
+        std::unique_ptr<Title>& t = m_titles[name.empty() ? "unknown" : name];
+        if (!t) t.reset(new Title());
+        return *t;
+    }
+
+    std::string RenderPrometheus()
+    {
+        std::string out;
+        out.reserve(8192);
+        Counter(out, "gamepauser_events_captured_total", "Key events captured while paused.", captured);
+        Counter(out, "gamepauser_events_dropped_total", "Key events lost because the capture ring overflowed.", dropped);
+        Counter(out, "gamepauser_events_spilled_total", "Key events that went through the overflow arena.", spilled);
+        Counter(out, "gamepauser_events_discarded_total", "Captured key events discarded by an Esc cancel.", discarded);
+        Counter(out, "gamepauser_events_replayed_total", "Key events injected on resume.", replayed);
+        Counter(out, "gamepauser_events_optimized_total", "Captured key events removed by the capture optimizer.", optimized);
+        Counter(out, "gamepauser_freeze_failures_total", "Pauses where no thread could be suspended.", freezeFailures);
+        Header(out, "gamepauser_paused", "1 while a target is frozen.", "gauge");
+        Line(out, "gamepauser_paused", "", paused.load(std::memory_order_relaxed));
+        Header(out, "gamepauser_hook_callback_seconds", "Keyboard hook callback duration.", "histogram");
+        HistogramSeries(out, "gamepauser_hook_callback_seconds", "", hookNs, LatencyEdges(), 1e-9);
+        std::lock_guard<std::mutex> lock(m_titlesMutex);
+        Header(out, "gamepauser_pause_seconds", "Time from hotkey to every thread of the target frozen.", "histogram");
+        for (auto& kv : m_titles)
+            HistogramSeries(out, "gamepauser_pause_seconds", TitleLabel(kv.first), kv.second->freezeNs, LatencyEdges(), 1e-9);
+        Header(out, "gamepauser_resume_to_first_key_seconds", "Time from resume to the first replayed key.", "histogram");
+        for (auto& kv : m_titles)
+            HistogramSeries(out, "gamepauser_resume_to_first_key_seconds", TitleLabel(kv.first), kv.second->resumeToKeyNs, LatencyEdges(), 1e-9);
+        Header(out, "gamepauser_pause_threads", "Threads frozen per pause.", "histogram");
+        for (auto& kv : m_titles)
+            HistogramSeries(out, "gamepauser_pause_threads", TitleLabel(kv.first), kv.second->threads, CountEdges(), 1.0);
+        Header(out, "gamepauser_pauses_total", "Pauses per target image.", "counter");
+        for (auto& kv : m_titles)
+            Line(out, "gamepauser_pauses_total", TitleLabel(kv.first), kv.second->pauses.load(std::memory_order_relaxed));
+        return out;
+    }
+
+private:
+    static const std::vector<uint64_t>& LatencyEdges()
+    {
+        // 100 ns .. 10 s, 1-2.5-5 steps (in ns)
+        static const std::vector<uint64_t> edges = [] {
+            std::vector<uint64_t> e;
+            for (uint64_t decade = 100; decade <= 1000000000ULL; decade *= 10) {
+                e.push_back(decade);
+                e.push_back(decade * 5 / 2);
+                e.push_back(decade * 5);
+            }
+            e.push_back(10000000000ULL);
+            return e;
+        }();
+        return edges;
+    }
+    static const std::vector<uint64_t>& CountEdges()
+    {
+        static const std::vector<uint64_t> edges = { 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+        return edges;
+    }
+
+    static std::string TitleLabel(const std::string& title)
+    {
+        std::string v = "title=\"";
+        for (char c : title) {
+            if (c == '"' || c == '\\') v += '\\';
+            if (c == '\n') { v += "\\n"; continue; }
+            v += c;
+        }
+        return v + "\"";
+    }
+
+    static void Header(std::string& out, const char* name, const char* help, const char* type)
+    {
+        out += "# HELP "; out += name; out += ' '; out += help; out += '\n';
+        out += "# TYPE "; out += name; out += ' '; out += type; out += '\n';
+    }
+    static void Line(std::string& out, const char* name, const std::string& labels, double value)
+    {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), " %.9g\n", value);
+        out += name;
+        if (!labels.empty()) { out += '{'; out += labels; out += '}'; }
+        out += buf;
+    }
+    static void Counter(std::string& out, const char* name, const char* help, const std::atomic<uint64_t>& v)
+    {
+        Header(out, name, help, "counter");
+        Line(out, name, "", static_cast<double>(v.load(std::memory_order_relaxed)));
+    }
+    static void HistogramSeries(std::string& out, const char* name, const std::string& labels, const LatencyHistogram& h,
+        const std::vector<uint64_t>& edges, double scale)
+    {
+        std::string bucket = std::string(name) + "_bucket";
+        std::string sep = labels.empty() ? "" : labels + ",";
+        char le[48];
+        for (uint64_t edge : edges) {
+            std::snprintf(le, sizeof(le), "le=\"%.9g\"", edge * scale);
+            Line(out, bucket.c_str(), sep + le, static_cast<double>(h.CountAtOrBelow(edge)));
+        }
+        Line(out, bucket.c_str(), sep + "le=\"+Inf\"", static_cast<double>(h.Count()));
+        Line(out, (std::string(name) + "_sum").c_str(), labels, h.Sum() * scale);
+        Line(out, (std::string(name) + "_count").c_str(), labels, static_cast<double>(h.Count()));
+    }
+
+    std::mutex m_titlesMutex;
+    std::map<std::string, std::unique_ptr<Title>> m_titles;
+};
+
+// -----------------------------------------------------------------------------
+// Minimal HTTP endpoint: one thread, one connection at a time, localhost only.
+// A client gets IO_TIMEOUT_MS per receive and per send, so one that connects
+// and says nothing can't hold up the next scrape or Stop().
+// -----------------------------------------------------------------------------
+class MetricsServer
+{
+public:
+    static const int IO_TIMEOUT_MS = 500;
+
+    ~MetricsServer() { Stop(); }
+
+    bool Start(uint16_t port, std::function<std::string()> render)
+    {
+        if (m_running) return true;
+#ifdef _WIN32
+        WSADATA wsa;
+        if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return false;
+        m_wsa = true;
+#endif
+        m_listen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (m_listen == INVALID_SOCK) return false;
+        int yes = 1;
+#ifdef _WIN32
+        // Windows' SO_REUSEADDR would let another program bind the same port over us
+        setsockopt(m_listen, SOL_SOCKET, SO_EXCLUSIVEADDRUSE, reinterpret_cast<const char*>(&yes), sizeof(yes));
+#else
+        setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)); // Restart while the old socket is in TIME_WAIT
+#endif
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // Never reachable from the network
+        if (bind(m_listen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(m_listen, 4) != 0) {
+            CloseSock(m_listen);
+            return false;
+        }
+        m_render = render;
+        m_running = true;
+        m_thread = std::thread([this] { Serve(); });
+        return true;
+    }
+
+    void Stop()
+    {
+        if (m_running.exchange(false)) {
+#ifdef _WIN32
+            CloseSock(m_listen); // Unblocks accept()
+#else
+            shutdown(m_listen, SHUT_RDWR);
+            CloseSock(m_listen);
+#endif
+            if (m_thread.joinable()) m_thread.join();
+        }
+#ifdef _WIN32
+        if (m_wsa) WSACleanup();
+        m_wsa = false;
+#endif
+    }
+
+    uint64_t Scrapes() const { return m_scrapes.load(std::memory_order_relaxed); }
+
+private:
+#ifdef _WIN32
+    typedef SOCKET Sock;
+    static const Sock INVALID_SOCK = INVALID_SOCKET;
+    static const int SEND_FLAGS = 0;
+    static void CloseSock(Sock& s) { if (s != INVALID_SOCK) closesocket(s); s = INVALID_SOCK; }
+#else
+    typedef int Sock;
+    static const Sock INVALID_SOCK = -1;
+    static const int SEND_FLAGS = MSG_NOSIGNAL; // A scraper that hung up is an error, not SIGPIPE
+    static void CloseSock(Sock& s) { if (s != INVALID_SOCK) close(s); s = INVALID_SOCK; }
+#endif
+
+    static void SetTimeouts(Sock c)
+    {
+#ifdef _WIN32
+        DWORD ms = IO_TIMEOUT_MS;
+        setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&ms), sizeof(ms));
+        setsockopt(c, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&ms), sizeof(ms));
+#else
+        timeval tv = { IO_TIMEOUT_MS / 1000, (IO_TIMEOUT_MS % 1000) * 1000 };
+        setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(c, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+#endif
+    }
+
+    void Serve()
+    {
+        while (m_running) {
+            Sock c = accept(m_listen, nullptr, nullptr);
+            if (c == INVALID_SOCK) continue;
+            SetTimeouts(c);
+            char req[1024];
+            if (recv(c, req, sizeof(req), 0) <= 0) { // Path and headers don't matter: there is one page
+                CloseSock(c); // Timed out or hung up without asking
+                continue;
+            }
+            std::string body = m_render();
+            char head[160];
+            int n = std::snprintf(head, sizeof(head),
+                "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                body.size());
+            std::string resp = std::string(head, static_cast<size_t>(n)) + body;
+            for (size_t sent = 0; sent < resp.size();) {
+                int k = send(c, resp.data() + sent, static_cast<int>(resp.size() - sent), SEND_FLAGS);
+                if (k <= 0) break;
+                sent += static_cast<size_t>(k);
+            }
+            m_scrapes.fetch_add(1, std::memory_order_relaxed);
+            CloseSock(c);
+        }
+    }
+
+    Sock m_listen = INVALID_SOCK;
+    std::atomic<bool> m_running{ false };
+    std::atomic<uint64_t> m_scrapes{ 0 };
+    std::function<std::string()> m_render;
+    std::thread m_thread;
+#ifdef _WIN32
+    bool m_wsa = false;
+#endif
+};
@@ -0,0 +1,977 @@
+// =============================================================================
+// PauseController.h - The pause / capture / replay state machine
+//
+// Everything GamePauser decides lives here; everything it *does* to the OS
+// goes through a backend:
+//   KeyboardHook     - install/remove the capture hook
+//   PauseFreezer     - freeze/thaw the pause target
+//   InputSink        - inject keys (pre-pause release, replay)
+//   ReplayClock      - time for replay pacing
+//   HotkeyRegistrar  - register the pause hotkey
+// Text compiled by TextCompiler.h can be queued into a pause alongside the
+// typed keys; it replays at its own rate instead of the replay policy's.
+// CaptureOptimizer.h can shrink a session before it is replayed. Replay pacing
+// comes from the target's profile (ReplayProfiles.h) when it has one.
+// With a wakeWorker backend, Esc/Enter only mark the ring on the hook thread
+// and the worker it wakes does the unhook/thaw/replay (RunPendingAction).
+// GamePauser.cpp wires in the Win32 backends, LinuxInput.h has evdev/uinput
+// ones for the Linux daemon, and the headless harness in Simulation.h wires
+// in fakes and drives synthetic keystroke traces. With [Trace] on, each step
+// of a pause is a span in the Tracing.h timeline.
+// =============================================================================
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "RetroLog.h"
+#include "KeyRing.h"
+#include "KeyboardState.h"
+#include "ReplayScheduler.h"
+#include "ProcessTree.h"
+#include "Metrics.h"
+#include "Tracing.h"
+#include "MemoryTrim.h"
+#include "ResumeStrategy.h"
+#include "TextCompiler.h"
+#include "CaptureOptimizer.h"
+#include "ReplayProfiles.h"
+
+// Modifier bits (same values as Win32 MOD_* so the INI parser can share them)
+const uint32_t HOTKEY_ALT = 0x0001;
+const uint32_t HOTKEY_CONTROL = 0x0002;
+const uint32_t HOTKEY_SHIFT = 0x0004;
+const uint32_t HOTKEY_WIN = 0x0008;
+const uint32_t HOTKEY_MOD_MASK = HOTKEY_ALT | HOTKEY_CONTROL | HOTKEY_SHIFT | HOTKEY_WIN;
+
+// Key codes the state machine cares about (Windows virtual-key values)
+const uint16_t KEYCODE_RETURN = 0x0D;
+const uint16_t KEYCODE_ESCAPE = 0x1B;
+
+// KeyEvent::extra kind of the ring marker a deferred Esc/Enter leaves behind: keys
+// before it belong to the session, keys after it were typed while the hook came down
+const uint16_t KEY_EXTRA_CUT = 0x0003;
+static inline bool IsCutMarker(const KeyEvent& ev) { return ev.vk == 0 && ev.extra == KEY_EXTRA_CUT; }
+
+class KeyboardHook
+{
+public:
+    virtual ~KeyboardHook() {}
+    virtual bool Install() = 0;
+    virtual void Remove() = 0;
+};
+
+class PauseFreezer
+{
+public:
+    virtual ~PauseFreezer() {}
+    virtual std::vector<MemberResult> Freeze(uint32_t pid) = 0;
+    virtual std::vector<MemberResult> Thaw() = 0;
+    // Blocks until the thawed target runs again, at most maxNs after the thaw.
+    // Returns ns since the thaw, or -1 if this freezer can't tell.
+    virtual int64_t AwaitRunning(int64_t maxNs) { (void)maxNs; return -1; }
+};
+
+class HotkeyRegistrar
+{
+public:
+    virtual ~HotkeyRegistrar() {}
+    virtual bool Register(uint16_t vk, uint32_t mods) = 0;
+    virtual void Unregister() = 0;
+};
+
+// One worker thread running posted jobs in order. Hooks and input readers hand
+// their slow work (freeze, thaw, replay) to it so they only ever queue and return.
+class CommandQueue
+{
+public:
+    CommandQueue() : m_thread([this] { Run(); }) {}
+    ~CommandQueue()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_wake.notify_all();
+        m_thread.join(); // Runs whatever is still queued first
+    }
+
+    void Post(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push_back(std::move(job));
+        }
+        m_wake.notify_one();
+    }
+
+    // Posts and waits for the job (and everything queued before it) to finish.
+    // Not from a job: the worker would wait on itself.
+    void RunSync(const std::function<void()>& job)
+    {
+        std::mutex doneMutex;
+        std::condition_variable doneWake;
+        bool done = false;
+        Post([&] {
+            job();
+            std::lock_guard<std::mutex> lock(doneMutex);
+            done = true;
+            doneWake.notify_one();
+        });
+        std::unique_lock<std::mutex> lock(doneMutex);
+        doneWake.wait(lock, [&] { return done; });
+    }
+
+    bool OnWorker() const { return std::this_thread::get_id() == m_thread.get_id(); }
+
+private:
+    void Run()
+    {
+        TraceThreadName("worker");
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_wake.wait(lock, [this] { return m_quit || !m_jobs.empty(); });
+            if (m_jobs.empty()) return;
+            std::function<void()> job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            lock.unlock();
+            job();
+            lock.lock();
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<std::function<void()>> m_jobs;
+    bool m_quit = false;
+    std::thread m_thread;
+};
+
+// The real freezer: resolve the process group, freeze it level by level,
+// optionally trim the frozen members' memory until they are thawed, and wake
+// them with the configured resume strategy
+class GroupPauseFreezer : public PauseFreezer
+{
+public:
+    GroupPauseFreezer(const PauseTargetOptions& targets, GroupOrder order, uint32_t selfPid,
+        const MemoryOptions& memory = MemoryOptions(), const ResumeOptions& resume = ResumeOptions(), AsyncLogger* log = nullptr)
+        : m_targets(targets), m_order(order), m_selfPid(selfPid), m_memory(memory), m_resume(resume), m_log(log)
+    {
+    }
+    ~GroupPauseFreezer() override
+    {
+        m_group.Thaw();
+        EndWarmup();
+        if (m_prefetch.joinable()) m_prefetch.join();
+    }
+
+    std::vector<MemberResult> Freeze(uint32_t pid) override
+    {
+        EndWarmup(); // Never freeze with a boost still applied
+        std::vector<MemberResult> results = m_group.Freeze(ResolvePauseTargets(pid, m_targets, m_selfPid), m_order);
+        if (m_memory.trimWhilePaused) Trim(results);
+        return results;
+    }
+
+    std::vector<MemberResult> Thaw() override
+    {
+        // Prefetch runs alongside the thaw and the replay lead-in, not before them
+        if (!m_trimmed.empty() && m_memory.prefetchOnResume) {
+            if (m_prefetch.joinable()) m_prefetch.join();
+            std::shared_ptr<std::vector<std::unique_ptr<WorkingSetTrimmer>>> batch(
+                new std::vector<std::unique_ptr<WorkingSetTrimmer>>(std::move(m_trimmed)));
+            m_prefetch = std::thread([this, batch] { Prefetch(*batch); });
+        }
+        m_trimmed.clear();
+        EndWarmup();
+        m_resumed = m_group.Pids();
+        m_thawCpuNs = m_resume.leadOnRunning || m_resume.warmupMs > 0 ? GroupCpuNs(m_resumed) : 0;
+        std::vector<MemberResult> results = m_resume.Staged() || m_resume.warmupMs > 0
+            ? m_group.Thaw([this](uint32_t pid, const std::vector<uint32_t>& tids) { return PlanMember(pid, tids); })
+            : m_group.Thaw();
+        m_thawNs = FreezerNowNs();
+        if (!m_warming.empty()) StartWarmup();
+        return results;
+    }
+
+    // Between pauses only: waits out any warm-up or prefetch still working with the old options
+    void SetOptions(const PauseTargetOptions& targets, GroupOrder order, const MemoryOptions& memory, const ResumeOptions& resume)
+    {
+        EndWarmup();
+        if (m_prefetch.joinable()) m_prefetch.join();
+        m_targets = targets;
+        m_order = order;
+        m_memory = memory;
+        m_resume = resume;
+    }
+
+    int64_t AwaitRunning(int64_t maxNs) override
+    {
+        if (!m_resume.leadOnRunning || m_resumed.empty()) return -1;
+        for (;;) {
+            int64_t since = FreezerNowNs() - m_thawNs;
+            if (GroupCpuNs(m_resumed) - m_thawCpuNs >= static_cast<uint64_t>(RESUME_RUNNING_CPU_NS) || since >= maxNs) return since;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+private:
+    template <typename... Args>
+    void Log(const char* fmt, Args... args)
+    {
+        if (m_log) m_log->PushF(fmt, args...);
+    }
+
+    void Trim(const std::vector<MemberResult>& results)
+    {
+        if (m_prefetch.joinable()) m_prefetch.join(); // Don't page out what is still being paged in
+        for (const MemberResult& r : results) {
+            if (!r.result.ok) continue;
+            std::unique_ptr<WorkingSetTrimmer> trimmer(new WorkingSetTrimmer(m_memory.prefetchLimit));
+            TrimResult t = trimmer->Trim(r.pid);
+            if (!t.ok) {
+                Log("WARNING: Could not trim memory of %s PID %u - needs admin (Windows) or CAP_SYS_NICE (Linux)", r.name.c_str(), r.pid);
+                continue;
+            }
+            Log("*** MEMORY TRIMMED *** %s PID %u: %.1f MB -> %.1f MB resident (%zu hot regions, %.2f ms)", r.name.c_str(), r.pid,
+                t.rssBefore / 1048576.0, t.rssAfter / 1048576.0, t.regions, t.elapsedNs / 1e6);
+            m_trimmed.push_back(std::move(trimmer));
+        }
+    }
+
+    static uint64_t GroupCpuNs(const std::vector<uint32_t>& pids)
+    {
+        uint64_t ns = 0;
+        for (uint32_t pid : pids) ns += ProcessCpuNs(pid);
+        return ns;
+    }
+
+    // Called per member while it is still frozen: pick its lead threads and boost them
+    ResumePlan PlanMember(uint32_t pid, const std::vector<uint32_t>& tids)
+    {
+        ResumeOptions opt = m_resume;
+        if (!opt.Staged()) {
+            // Warm-up only: boost the main thread, but wake everything together
+            opt.order = ResumeOrder::MainFirst;
+            opt.leadThreads = std::max<size_t>(1, opt.leadThreads);
+            opt.staggerMs = 0;
+        }
+        ResumePlan plan = PlanResume(pid, tids, opt);
+        if (m_resume.warmupMs <= 0) return plan;
+        Warming w;
+        w.pid = pid;
+        w.lead = plan.first;
+        w.processCpuNs = ProcessCpuNs(pid);
+        for (uint32_t tid : w.lead) w.leadCpuNs += ThreadCpuNs(pid, tid);
+        w.boost.reset(new WarmupBoost());
+        w.boosted = w.boost->Apply(pid, w.lead, m_resume.warmupPin);
+        std::lock_guard<std::mutex> lock(m_warmupMutex); // Members of a level are planned in parallel
+        m_warming.push_back(std::move(w));
+        return plan;
+    }
+
+    void StartWarmup()
+    {
+        m_warmupCancel = false;
+        m_warmup = std::thread([this] {
+            std::unique_lock<std::mutex> lock(m_warmupMutex);
+            m_warmupWake.wait_for(lock, std::chrono::milliseconds(m_resume.warmupMs), [this] { return m_warmupCancel; });
+            double ms = (FreezerNowNs() - m_thawNs) / 1e6;
+            for (Warming& w : m_warming) {
+                uint64_t lead = 0;
+                for (uint32_t tid : w.lead) lead += ThreadCpuNs(w.pid, tid);
+                w.boost->Restore();
+                Log("*** RESUME WARM-UP DONE *** PID %u: %.1f ms CPU in the first %.0f ms, %.1f ms of it on %zu lead threads (%zu boosted)",
+                    w.pid, (ProcessCpuNs(w.pid) - w.processCpuNs) / 1e6, ms, (lead - w.leadCpuNs) / 1e6, w.lead.size(), w.boosted);
+            }
+            m_warming.clear();
+        });
+    }
+
+    // Restores any boost still applied; returns at once if the window is already over
+    void EndWarmup()
+    {
+        if (!m_warmup.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(m_warmupMutex);
+            m_warmupCancel = true;
+        }
+        m_warmupWake.notify_all();
+        m_warmup.join();
+    }
+
+    void Prefetch(std::vector<std::unique_ptr<WorkingSetTrimmer>>& batch)
+    {
+        for (auto& trimmer : batch) {
+            uint32_t pid = trimmer->Pid();
+            PrefetchResult p = trimmer->Prefetch();
+            Log("*** MEMORY PREFETCH *** PID %u: %.1f MB hot set requested back in %.2f ms (%zu calls)%s", pid,
+                p.bytes / 1048576.0, p.elapsedNs / 1e6, p.calls, p.ok ? "" : "  (FAILED)");
+        }
+    }
+
+    PauseTargetOptions m_targets;
+    GroupOrder m_order;
+    uint32_t m_selfPid;
+    MemoryOptions m_memory;
+    ResumeOptions m_resume;
+    AsyncLogger* m_log;
+    ProcessGroupFreezer m_group;
+    std::vector<std::unique_ptr<WorkingSetTrimmer>> m_trimmed; // Members paged out during this pause
+    std::thread m_prefetch;
+
+    // Warm-up: members boosted on the last resume, restored when the window ends
+    struct Warming
+    {
+        uint32_t pid = 0;
+        std::vector<uint32_t> lead;
+        uint64_t processCpuNs = 0; // At the thaw, for the CPU-delta report
+        uint64_t leadCpuNs = 0;
+        size_t boosted = 0;
+        std::unique_ptr<WarmupBoost> boost;
+    };
+    std::vector<Warming> m_warming;
+    std::mutex m_warmupMutex;
+    std::condition_variable m_warmupWake;
+    bool m_warmupCancel = false;
+    std::thread m_warmup;
+    std::vector<uint32_t> m_resumed; // Members of the last thaw
+    uint64_t m_thawCpuNs = 0;
+    int64_t m_thawNs = 0;
+};
+
+struct PauseConfig
+{
+    uint16_t pauseVK = 'P';
+    uint32_t pauseMods = HOTKEY_CONTROL | HOTKEY_ALT;
+    uint16_t pasteVK = 0; // Paste hotkey, passed through while paused like the pause key (0 = none)
+    uint32_t pasteMods = HOTKEY_CONTROL | HOTKEY_ALT;
+    size_t ringCapacity = 4096;
+    OverflowPolicy overflow = OverflowPolicy::Spill;
+    ReplayOptions replay;
+    CaptureOptimizeOptions optimize; // Off: sessions replay exactly as captured
+    ReplayProfiles profiles; // Per-game replay overrides, picked by image name when a pause starts
+};
+
+struct PauseBackends
+{
+    KeyboardHook* hook = nullptr;
+    PauseFreezer* freezer = nullptr;
+    InputSink* sink = nullptr;
+    ReplayClock* clock = nullptr; // Null = real time (PreciseWaiter)
+    HotkeyRegistrar* hotkeys = nullptr; // Optional
+    AsyncLogger* log = nullptr; // Optional
+    PauseMetrics* metrics = nullptr; // Optional
+    uint32_t selfPid = 0;
+    // Optional: Esc/Enter on the hook path only mark the action and call this; the
+    // worker it wakes runs RunPendingAction(). Unset, they run inside OnKey().
+    std::function<void()> wakeWorker;
+};
+
+enum class PendingAction { None, Cancel, Accept };
+
+enum class HookVerdict { Pass, Block };
+
+class PauseController
+{
+public:
+    PauseController(const PauseBackends& backends, const PauseConfig& config)
+        : m_b(backends), m_config(config), m_ring(config.ringCapacity, config.overflow),
+          m_scheduler(config.replay, backends.clock), m_pasteScheduler(PasteReplayOptions(), backends.clock)
+    {
+    }
+    ~PauseController()
+    {
+        m_consumerRunning = false;
+        if (m_consumer.joinable()) m_consumer.join();
+    }
+    PauseController(const PauseController&) = delete;
+    PauseController& operator=(const PauseController&) = delete;
+
+    // Registers the hotkey (if a registrar is wired) and starts the capture consumer
+    bool Start()
+    {
+        bool ok = true;
+        if (m_b.hotkeys) ok = m_b.hotkeys->Register(m_config.pauseVK, m_config.pauseMods);
+        m_consumerRunning = true;
+        m_consumer = std::thread([this] { ConsumerLoop(); });
+        return ok;
+    }
+
+    // Final safety: unhook, force-resume, unregister. Safe to call more than once.
+    void Stop()
+    {
+        RemoveHook();
+        if (m_targetPid) {
+            Log("Force-resuming lingering process PID %u", m_targetPid.load());
+            Thaw();
+            m_targetPid = 0;
+        }
+        if (m_b.hotkeys) m_b.hotkeys->Unregister();
+    }
+
+    // ---- Hook path: classify one key event. Must stay cheap. ----
+    // heldMods is only consulted when ev.vk is the pause or paste key. capture=false is for
+    // events that are blocked while paused but never queued (system-key messages).
+    HookVerdict OnKey(const KeyEvent& ev, uint32_t heldMods, bool capture = true)
+    {
+        TraceSpan span("hook key", "vk", ev.vk);
+        if (!m_b.metrics) return Classify(ev, heldMods, capture);
+        uint64_t t0 = MonotonicNs();
+        HookVerdict verdict = Classify(ev, heldMods, capture);
+        m_b.metrics->hookNs.Record(MonotonicNs() - t0); // Relaxed atomic adds only
+        return verdict;
+    }
+
+    // ---- Hotkey: pause the foreground process, or resume it if it's ours ----
+    void OnHotkey(uint32_t foregroundPid)
+    {
+        if (foregroundPid == 0 || foregroundPid == m_b.selfPid) return;
+        uint64_t hotkeyNs = MonotonicNs();
+        TraceSpan span("hotkey", "pid", foregroundPid);
+        if (m_targetPid && m_targetPid == foregroundPid) {
+            // Resume via normal hotkey
+            m_armEsc = m_armEnter = false;
+            RemoveHook();
+            Thaw();
+            Replay();
+            m_targetPid = 0;
+            return;
+        }
+        if (m_targetPid) {
+            RemoveHook();
+            Thaw();
+        }
+        m_targetPid = foregroundPid;
+        DiscardCaptured(); // Reset for during-pause tracking only
+        // Clear any held keys before suspending - O(1) snapshot of the tracked state
+        std::vector<KeyEvent> releases;
+        m_physical.Snapshot().HeldEvents(releases, true);
+        if (!releases.empty()) {
+            TraceSpan release("release held keys", "keys", releases.size());
+            m_b.sink->Begin();
+            m_b.sink->Send(releases.data(), releases.size()); // One injection for the whole chord
+            m_b.sink->End();
+        }
+        Log("*** PRE-PAUSE CLEANUP *** - Released %zu held keys to prevent stuck input", releases.size());
+        m_pending = PendingAction::None;
+        m_swallowVk = 0;
+        m_armEsc = true;
+        m_armEnter = true;
+        Freeze(hotkeyNs);
+        InstallHook();
+        Log("*** PAUSE MODE ENGAGED *** - Type freely; replay on resume or special keys");
+    }
+
+    // ---- Worker side of a deferred Esc/Enter. Same thread as OnHotkey(). ----
+    // The hook is removed before anything else, so every key it blocked is in the ring:
+    // keys typed after the Esc/Enter replay after the session (Enter) or alone (Esc).
+    void RunPendingAction()
+    {
+        PendingAction action = m_pending.exchange(PendingAction::None);
+        if (action == PendingAction::None || !Paused()) return; // The hotkey got there first
+        if (action == PendingAction::Cancel) Cancel();
+        else Accept();
+    }
+    PendingAction Pending() const { return m_pending; }
+
+    // Adds or replaces a game's profile (e.g. after calibration). Same thread as OnHotkey().
+    void SetProfile(const ReplayProfile& profile) { m_config.profiles.Set(profile); }
+
+    // New settings between pauses (a reloaded INI), same thread as OnHotkey(). The ring
+    // keeps its size and overflow policy until restart. False while paused, or if the
+    // new pause hotkey could not be registered.
+    bool Reconfigure(const PauseConfig& config)
+    {
+        if (Paused()) return false;
+        bool ok = true;
+        if (m_b.hotkeys && (config.pauseVK != m_config.pauseVK || config.pauseMods != m_config.pauseMods)) {
+            m_b.hotkeys->Unregister();
+            ok = m_b.hotkeys->Register(config.pauseVK, config.pauseMods);
+        }
+        size_t ring = m_config.ringCapacity;
+        OverflowPolicy overflow = m_config.overflow;
+        m_config = config;
+        m_config.ringCapacity = ring;
+        m_config.overflow = overflow;
+        UseProfile(std::string());
+        return ok;
+    }
+    const ReplayProfiles& Profiles() const { return m_config.profiles; }
+    const ReplayOptions& CurrentReplay() const { return m_scheduler.Options(); }
+
+    // Live physical keyboard model - fed by the platform's input tracker
+    KeyboardState& PhysicalKeys() { return m_physical; }
+    KeyRing& Ring() { return m_ring; }
+    uint32_t TargetPid() const { return m_targetPid; }
+    bool Paused() const { return m_targetPid != 0; }
+    bool Replaying() const { return m_replaying; } // Any thread
+    const ReplayStats& LastReplay() const { return m_lastReplay; }
+    const ReplayStats& LastPaste() const { return m_lastPaste; }
+    const PauseConfig& Config() const { return m_config; }
+    size_t CapturedCount()
+    {
+        std::lock_guard<std::mutex> lock(m_captureMutex);
+        return m_captured.size();
+    }
+
+    // Consumer side, also callable directly (headless runs, replay, cancel)
+    void DrainCaptured()
+    {
+        std::lock_guard<std::mutex> lock(m_captureMutex); // Also makes us the ring's single consumer
+        size_t first = m_captured.size();
+        m_ring.Drain(m_captured);
+        size_t markers = 0;
+        for (size_t i = first; i < m_captured.size(); ++i) {
+            if (IsCutMarker(m_captured[i])) ++markers;
+            else {
+                m_held.Apply(m_captured[i]);
+                m_physical.Apply(m_captured[i]); // The OS tracker doesn't see keys the hook eats
+            }
+        }
+        if (m_b.metrics) {
+            m_b.metrics->captured.fetch_add(m_captured.size() - first - markers, std::memory_order_relaxed);
+            m_b.metrics->dropped.store(m_ring.Dropped(), std::memory_order_relaxed);
+            m_b.metrics->spilled.store(m_ring.Spilled(), std::memory_order_relaxed);
+        }
+    }
+
+    // ---- Paste: queue a compiled text program behind what has been typed so far ----
+    // Returns the events queued (0 when not paused).
+    size_t QueuePaste(const TextProgram& program)
+    {
+        if (!Paused() || program.events.empty()) return 0;
+        DrainCaptured(); // Keys typed before the paste stay before it
+        std::lock_guard<std::mutex> lock(m_captureMutex);
+        m_captured.insert(m_captured.end(), program.events.begin(), program.events.end());
+        m_pasteChars += program.chars;
+        return program.events.size();
+    }
+
+    // The keys of the last pause session, replayed or cancelled - what gets saved as a macro
+    std::vector<KeyEvent> LastSession()
+    {
+        std::lock_guard<std::mutex> lock(m_captureMutex);
+        return m_lastSession;
+    }
+
+    // ---- Macro: replay stored events through the same scheduler and sink ----
+    // events may point straight into a mapped MacroLibrary; they are read in place.
+    ReplayStats PlayMacro(const char* name, const KeyEvent* events, size_t count)
+    {
+        if (Paused() || count == 0) return ReplayStats();
+        TraceSpan span("macro", "events", count);
+        UseProfile(std::string()); // Played into whatever has focus: [Replay] pacing
+        // The macro hotkey's own modifiers are still down - release them or every key comes out as a chord
+        std::vector<KeyEvent> releases;
+        m_physical.Snapshot().HeldEvents(releases, true);
+        ProbeSink sink(m_b.sink, Clock());
+        sink.Begin();
+        if (!releases.empty()) {
+            m_b.sink->Send(releases.data(), releases.size());
+            Clock()->SleepFor(1000000);
+        }
+        m_replaying = true;
+        ReplayStats stats = RunQueued(events, count, sink);
+        m_replaying = false;
+        sink.End();
+        if (m_b.metrics) m_b.metrics->replayed.fetch_add(sink.sent, std::memory_order_relaxed);
+        Log("*** MACRO REPLAY COMPLETE *** - '%s' (%zu events, %s, %.1f ms)", name, stats.events,
+            ReplayPolicyName(m_scheduler.Options().policy), stats.durationNs / 1e6);
+        return stats;
+    }
+
+private:
+    HookVerdict Classify(const KeyEvent& ev, uint32_t heldMods, bool capture)
+    {
+        if (m_targetPid == 0 || (ev.flags & KEY_INJECTED))
+            return HookVerdict::Pass;
+        // Let the configured pause hotkey pass through untouched
+        uint32_t required = m_config.pauseMods & HOTKEY_MOD_MASK;
+        if (ev.vk == m_config.pauseVK && (heldMods & required) == required)
+            return HookVerdict::Pass;
+        uint32_t pasteRequired = m_config.pasteMods & HOTKEY_MOD_MASK;
+        if (m_config.pasteVK && ev.vk == m_config.pasteVK && (heldMods & pasteRequired) == pasteRequired)
+            return HookVerdict::Pass;
+        if (!capture)
+            return HookVerdict::Block;
+        bool up = (ev.flags & KEY_UP) != 0;
+        if (up && ev.vk == m_swallowVk) {
+            m_swallowVk = 0; // The deferred Esc/Enter's own keyup
+            return HookVerdict::Block;
+        }
+        // === SPECIAL: Escape - cancel on first Esc down, suppress its keyup ===
+        if (m_armEsc && ev.vk == KEYCODE_ESCAPE) {
+            m_armEsc = false;
+            if (!up) Special(PendingAction::Cancel, ev);
+            return HookVerdict::Block;
+        }
+        // === SPECIAL: Enter - accept on first Enter down, suppress its keyup ===
+        if (m_armEnter && ev.vk == KEYCODE_RETURN) {
+            m_armEnter = false;
+            if (!up) Special(PendingAction::Accept, ev);
+            return HookVerdict::Block;
+        }
+        // Normal capture: one 16-byte write into the ring, no allocation, no locks
+        KeyEvent stored = ev;
+        stored.flags &= ~KEY_INJECTED;
+        m_ring.Push(stored);
+        return HookVerdict::Block; // Block all other keys while paused
+    }
+
+    // Inline without a worker; otherwise leave a marker in the ring and hand the action over
+    void Special(PendingAction action, const KeyEvent& ev)
+    {
+        TraceInstant(action == PendingAction::Cancel ? "esc" : "enter", "vk", ev.vk);
+        if (!m_b.wakeWorker) {
+            if (action == PendingAction::Cancel) Cancel();
+            else Accept();
+            return;
+        }
+        m_armEsc = m_armEnter = false; // One action per pause; from here Esc and Enter are typed keys
+        m_swallowVk = ev.vk;
+        KeyEvent marker = { ev.timeNs, 0, 0, 0, KEY_EXTRA_CUT };
+        m_ring.Push(marker);
+        m_pending = action;
+        m_b.wakeWorker();
+    }
+
+    void InstallHook()
+    {
+        TraceSpan span("hook install");
+        m_b.hook->Install();
+    }
+
+    void RemoveHook()
+    {
+        TraceSpan span("hook remove");
+        m_b.hook->Remove();
+    }
+
+    template <typename... Args>
+    void Log(const char* fmt, Args... args)
+    {
+        if (m_b.log) m_b.log->PushF(fmt, args...);
+    }
+
+    void Cancel()
+    {
+        TraceSpan span("cancel");
+        // Order is CRITICAL: unhook FIRST, then resume the process
+        RemoveHook(); // <- hook is now gone - no more events will be captured
+        Thaw(); // <- game threads resume
+        m_targetPid = 0;
+        std::vector<KeyEvent> typedAfter = TakeAfterCut();
+        size_t discarded = DiscardCaptured(true);
+        if (m_b.metrics) m_b.metrics->discarded.fetch_add(discarded, std::memory_order_relaxed);
+        Log("*** ESCAPE DETECTED: PAUSE CANCELLED *** - Discarding all captured input");
+        if (!typedAfter.empty()) {
+            // Typed after the Esc, meant for the game: they go out as typed
+            ProbeSink sink(m_b.sink, Clock());
+            sink.Begin();
+            m_replaying = true;
+            RunQueued(typedAfter.data(), typedAfter.size(), sink);
+            m_replaying = false;
+            sink.End();
+            Log("*** KEYS AFTER ESCAPE REPLAYED *** - %zu events typed while capture was ending", typedAfter.size());
+        }
+    }
+
+    // Everything captured after a cut marker; the marker itself goes too
+    std::vector<KeyEvent> TakeAfterCut()
+    {
+        DrainCaptured();
+        std::lock_guard<std::mutex> lock(m_captureMutex);
+        std::vector<KeyEvent> after;
+        auto cut = std::find_if(m_captured.begin(), m_captured.end(), IsCutMarker);
+        if (cut == m_captured.end()) return after;
+        after.assign(cut + 1, m_captured.end());
+        m_captured.erase(cut, m_captured.end());
+        after.erase(std::remove_if(after.begin(), after.end(), IsCutMarker), after.end());
+        return after;
+    }
+
+    void Accept()
+    {
+        TraceSpan span("accept");
+        RemoveHook();
+        Thaw();
+        Replay(); // only sends keys typed BEFORE this Enter
+        m_targetPid = 0;
+        Log("*** ENTER DETECTED: PAUSE ACCEPTED *** - Replaying input (Enter suppressed)");
+    }
+
+    // Returns how many events were thrown away. keep = still remember them as the last session.
+    size_t DiscardCaptured(bool keep = false)
+    {
+        DrainCaptured(); // Pull anything still in flight so it can't leak into the next pause
+        std::lock_guard<std::mutex> lock(m_captureMutex);
+        size_t n = m_captured.size();
+        if (keep) m_lastSession = m_captured;
+        m_captured.clear();
+        m_pasteChars = 0;
+        m_held.Clear();
+        return n;
+    }
+
+    void ConsumerLoop()
+    {
+        while (m_consumerRunning) {
+            DrainCaptured();
+            // Poll briskly only while something can be captured
+            std::this_thread::sleep_for(std::chrono::milliseconds(m_targetPid ? 1 : 20));
+        }
+    }
+
+    // hotkeyNs: when the pause was requested - the latency metric starts there
+    void Freeze(uint64_t hotkeyNs)
+    {
+        TraceSpan span("freeze", "pid", m_targetPid.load());
+        int64_t t0 = FreezerNowNs();
+        std::vector<MemberResult> results = m_b.freezer->Freeze(m_targetPid);
+        ReportFreeze(true, results, FreezerNowNs() - t0);
+        uint64_t frozenNs = MonotonicNs() - hotkeyNs;
+        std::string title;
+        size_t threads = 0;
+        bool any = false;
+        for (const MemberResult& r : results) {
+            if (r.pid == m_targetPid) title = r.name;
+            threads += r.result.threads;
+            any = any || r.result.ok;
+        }
+        UseProfile(title);
+        if (!m_b.metrics) return;
+        m_title = &m_b.metrics->ForTitle(title);
+        m_title->pauses.fetch_add(1, std::memory_order_relaxed);
+        if (!any) {
+            m_b.metrics->freezeFailures.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        m_title->freezeNs.Record(frozenNs);
+        m_title->threads.Record(threads);
+        m_b.metrics->paused.store(1, std::memory_order_relaxed);
+    }
+
+    // The image's profile, or [Replay] when it has none (or image is empty)
+    void UseProfile(const std::string& image)
+    {
+        const ReplayProfile* profile = m_config.profiles.Find(image);
+        const ReplayOptions& replay = profile ? profile->replay : m_config.replay;
+        m_scheduler.SetOptions(replay);
+        ReplayOptions paste = PasteReplayOptions();
+        paste.minGapMs = replay.minGapMs; // A game that drops fast keys drops fast pasted ones too
+        m_pasteScheduler.SetOptions(paste);
+        if (profile)
+            Log("*** PROFILE LOADED *** - %s: %s replay, %d ms lead, %d ms min gap", profile->image.c_str(),
+                ReplayPolicyName(replay.policy), replay.leadDelayMs, replay.minGapMs);
+    }
+
+    void Thaw()
+    {
+        TraceSpan span("thaw", "pid", m_targetPid.load());
+        m_resumeNs = Clock()->NowNs(); // Resume-to-first-key starts here
+        if (m_b.metrics) m_b.metrics->paused.store(0, std::memory_order_relaxed);
+        int64_t t0 = FreezerNowNs();
+        std::vector<MemberResult> results = m_b.freezer->Thaw();
+        ReportFreeze(false, results, FreezerNowNs() - t0);
+    }
+
+    void ReportFreeze(bool suspend, const std::vector<MemberResult>& results, int64_t elapsedNs)
+    {
+        size_t threads = 0, failed = 0, partial = 0;
+        for (const MemberResult& r : results) {
+            threads += r.result.threads;
+            if (!r.result.ok) ++failed;
+            if (r.result.partial) ++partial;
+        }
+        if (suspend && failed == results.size()) {
+            Log("ERROR: Could not suspend any threads of PID %u", m_targetPid.load());
+            return;
+        }
+        Log("%s PID: %u (%zu processes, %zu threads affected, %.2f ms)",
+            suspend ? "*** PROCESS PAUSED ***" : "*** PROCESS RESUMED ***", m_targetPid.load(),
+            results.size(), threads, elapsedNs / 1e6);
+        if (results.size() > 1 || failed || partial) {
+            for (const MemberResult& r : results) {
+                Log("    %-7s %-24s PID %-6u %4zu threads %8.2f ms%s", suspend ? "paused" : "resumed",
+                    r.name.c_str(), r.pid, r.result.threads, r.result.elapsedNs / 1e6,
+                    !r.result.ok ? "  (FAILED)" : r.result.partial ? "  (PARTIAL)" : "");
+                if (r.result.partial) {
+                    std::string tids;
+                    for (uint32_t tid : r.result.laggards) tids += " " + std::to_string(tid);
+                    Log("WARNING: PID %u: %zu threads still running when the freeze gave up:%s",
+                        r.pid, r.result.laggards.size(), tids.empty() ? " (thread set still changing)" : tids.c_str());
+                }
+            }
+        }
+    }
+
+    ReplayClock* Clock() { return m_b.clock ? m_b.clock : &m_waiter; }
+
+    // Forwards to the real sink, noting when the first key went out
+    class ProbeSink : public InputSink
+    {
+    public:
+        ProbeSink(InputSink* sink, ReplayClock* clock) : m_sink(sink), m_clock(clock) {}
+        void Begin() override { m_sink->Begin(); }
+        void Send(const KeyEvent* events, size_t count) override
+        {
+            if (!firstNs) firstNs = m_clock->NowNs();
+            sent += count;
+            m_sink->Send(events, count);
+        }
+        void End() override { m_sink->End(); }
+        uint64_t firstNs = 0;
+        size_t sent = 0;
+
+    private:
+        InputSink* m_sink;
+        ReplayClock* m_clock;
+    };
+
+    // Paste runs carry their own spacing: play it as is, however long the gaps
+    static ReplayOptions PasteReplayOptions()
+    {
+        ReplayOptions opt;
+        opt.policy = ReplayPolicy::Faithful;
+        opt.leadDelayMs = 0;
+        opt.maxGapMs = 0;
+        return opt;
+    }
+
+    // Typed keys go at the replay policy's pace, pasted runs at the pace baked into
+    // their times. Lateness is the worst of the runs.
+    ReplayStats RunQueued(const KeyEvent* events, size_t count, InputSink& sink)
+    {
+        ReplayStats total;
+        m_lastPaste = ReplayStats();
+        for (size_t i = 0; i < count;) {
+            bool paste = events[i].extra == KEY_EXTRA_PASTE;
+            size_t j = i + 1;
+            while (j < count && (events[j].extra == KEY_EXTRA_PASTE) == paste) ++j;
+            ReplayStats st = (paste ? m_pasteScheduler : m_scheduler).Run(events + i, j - i, sink);
+            if (paste) {
+                m_lastPaste.events += st.events;
+                m_lastPaste.durationNs += st.durationNs;
+            }
+            total.events += st.events;
+            total.sinkCalls += st.sinkCalls;
+            total.durationNs += st.durationNs;
+            total.lateP50Ns = std::max(total.lateP50Ns, st.lateP50Ns);
+            total.lateP99Ns = std::max(total.lateP99Ns, st.lateP99Ns);
+            total.lateMaxNs = std::max(total.lateMaxNs, st.lateMaxNs);
+            i = j;
+        }
+        return total;
+    }
+
+    // [Capture] Optimize - m_lastSession keeps the raw keys, only this replay is shortened
+    void Optimize(std::vector<KeyEvent>& captured, const std::vector<KeyEvent>& presses)
+    {
+        uint64_t beforeNs = EstimateReplayNs(captured, m_scheduler.Options());
+        CaptureOptimizeStats stats = CaptureOptimizer(m_config.optimize).Run(captured, &presses);
+        if (stats.eventsOut == stats.eventsIn) return;
+        uint64_t afterNs = EstimateReplayNs(captured, m_scheduler.Options());
+        if (m_b.metrics) m_b.metrics->optimized.fetch_add(stats.eventsIn - stats.eventsOut, std::memory_order_relaxed);
+        Log("*** CAPTURE OPTIMISED *** - %zu -> %zu events (%zu repeats folded, %zu keystrokes erased, %zu tap events dropped), ~%.0f ms less replay",
+            stats.eventsIn, stats.eventsOut, stats.repeatsFolded, stats.keystrokesErased, stats.tapsDropped,
+            beforeNs > afterNs ? (beforeNs - afterNs) / 1e6 : 0.0);
+    }
+
+    // Replay captured keystrokes
+    void Replay()
+    {
+        TraceSpan span("replay");
+        DrainCaptured(); // Hook is already removed - collect the last events in flight
+        std::vector<KeyEvent> captured;
+        KeySnapshot held;
+        size_t pasteChars = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_captureMutex);
+            captured.swap(m_captured);
+            captured.erase(std::remove_if(captured.begin(), captured.end(), IsCutMarker), captured.end()); // Keys after Enter follow the session
+            pasteChars = m_pasteChars;
+            m_pasteChars = 0;
+            m_lastSession = captured;
+            held = m_held.Snapshot();
+            m_held.Clear();
+        }
+        size_t heldCount = held.Count();
+        if (captured.empty() && heldCount == 0) {
+            Log("*** INPUT REPLAY: Nothing queued - proceeding empty-handed ***");
+            m_lastReplay = ReplayStats();
+            return;
+        }
+        std::ostringstream oss;
+        oss << "*** INPUT REPLAY INITIATED ***";
+        if (heldCount) oss << " (Releasing chord of " << heldCount << " held keys)";
+        if (!captured.empty()) oss << " (" << captured.size() / 2 << " key events)";
+        Log("%s", oss.str().c_str());
+        // LeadDelayMs - let the resumed target settle, or less if the freezer sees it running
+        int64_t leadNs = static_cast<int64_t>(std::max(0, m_scheduler.Options().leadDelayMs)) * 1000000LL;
+        int64_t runningNs;
+        {
+            TraceSpan lead("lead delay");
+            runningNs = m_b.freezer->AwaitRunning(leadNs);
+            if (runningNs < 0) m_scheduler.Lead();
+        }
+        if (runningNs >= 0)
+            Log("*** TARGET RUNNING *** - %.1f ms after resume%s", runningNs / 1e6, runningNs >= leadNs ? " (not seen, waited LeadDelayMs)" : "");
+        std::vector<KeyEvent> presses;
+        held.HeldEvents(presses, false);
+        if (m_config.optimize.Any() && !captured.empty()) Optimize(captured, presses);
+        ProbeSink sink(m_b.sink, Clock());
+        sink.Begin();
+        // Press all currently held keys first - one batched injection, extended flags from the table
+        if (!presses.empty()) {
+            TraceSpan press("press held keys", "keys", presses.size());
+            sink.Send(presses.data(), presses.size());
+        }
+        Clock()->SleepFor(1000000);
+        // Replay recorded events, paced by the configured policy
+        m_replaying = true;
+        m_lastReplay = RunQueued(captured.data(), captured.size(), sink);
+        m_replaying = false;
+        sink.End();
+        if (m_b.metrics) {
+            m_b.metrics->replayed.fetch_add(sink.sent, std::memory_order_relaxed);
+            if (m_title && sink.firstNs) m_title->resumeToKeyNs.Record(sink.firstNs - m_resumeNs);
+        }
+        Log("*** INPUT REPLAY COMPLETE *** - Target process fully updated (%zu events, %s, %.1f ms)",
+            m_lastReplay.events, ReplayPolicyName(m_scheduler.Options().policy), m_lastReplay.durationNs / 1e6);
+        if (pasteChars && m_lastPaste.durationNs)
+            Log("*** PASTE REPLAYED *** - %zu characters in %.1f ms (%.0f chars/s)", pasteChars,
+                m_lastPaste.durationNs / 1e6, pasteChars / (m_lastPaste.durationNs / 1e9));
+    }
+
+    PauseBackends m_b;
+    PauseConfig m_config;
+    std::atomic<uint32_t> m_targetPid{ 0 }; // PID of the currently paused process
+    std::atomic<bool> m_armEsc{ false }; // True only while paused - Esc cancels
+    std::atomic<bool> m_armEnter{ false }; // True only while paused - Enter accepts without sending Enter
+    std::atomic<PendingAction> m_pending{ PendingAction::None }; // Deferred Esc/Enter, for the worker
+    std::atomic<uint16_t> m_swallowVk{ 0 }; // Hook path only: keyup still to block after a deferred Esc/Enter
+    std::atomic<bool> m_replaying{ false }; // Keys are going out (resume or macro)
+    KeyRing m_ring;
+    std::mutex m_captureMutex; // Guards m_captured and m_lastSession (consumer vs replay)
+    std::vector<KeyEvent> m_captured; // Keystrokes queued for replay
+    std::vector<KeyEvent> m_lastSession; // Copy of the last session's keystrokes, for saving as a macro
+    KeyboardState m_held; // Keys physically held when resuming (during-pause only, post-clear)
+    KeyboardState m_physical;
+    PreciseWaiter m_waiter;
+    ReplayScheduler m_scheduler;
+    ReplayScheduler m_pasteScheduler; // Faithful, no clamp: pasted text carries its own spacing
+    ReplayStats m_lastReplay;
+    ReplayStats m_lastPaste; // Pasted runs of the last replay
+    size_t m_pasteChars = 0; // Characters pasted into the current pause (guarded by m_captureMutex)
+    PauseMetrics::Title* m_title = nullptr; // Metrics of the current/last target
+    uint64_t m_resumeNs = 0;
+    std::atomic<bool> m_consumerRunning{ false };
+    std::thread m_consumer;
+};
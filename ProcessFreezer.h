@@ -0,0 +1,596 @@
+// =============================================================================
+// ProcessFreezer.h - Pluggable process-freezer engine
+//
+// A freezer owns one paused process. Freeze() loops until an enumeration pass
+// turns up no thread it has not already suspended, so threads the game spawns
+// mid-freeze are caught too. The handles it opened are kept for the whole
+// pause, which makes Thaw() O(target threads) with no enumeration at all, and
+// on Windows past it: the next Freeze() of the same process suspends those
+// threads straight away and only opens threads it has not seen before.
+//
+// Backends:
+//   Windows - NtGetNextThread walks only the target's threads (Toolhelp
+//             system-wide snapshot as fallback); large suspend batches are
+//             spread across a small worker pool.
+//   Linux   - SIGSTOP/SIGCONT on the thread group, converging on every task in
+//             /proc/<pid>/task reporting the stopped state.
+// ThawStaged() lets a few threads run alone for a moment before the rest wake
+// (see ResumeStrategy.h for how they are picked).
+//
+// If a FreezeRecorder is installed, every freezer tells it what it is about
+// to suspend before suspending it, so a crash can be undone (FreezeJournal.h).
+// With tracing on, every enumeration pass and per-thread suspend/resume is a
+// span (Tracing.h), so a slow freeze shows which thread or call held it up.
+// =============================================================================
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "Tracing.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <tlhelp32.h>
+#else
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+struct FreezeResult
+{
+    bool ok = false;
+    size_t threads = 0; // Threads affected by this call
+    int passes = 0; // Enumeration passes until the thread set converged
+    int64_t elapsedNs = 0;
+    // Freeze() gave up waiting: laggards had not stopped yet (Linux only; their
+    // stop is still pending, and Thaw() is still owed)
+    bool partial = false;
+    std::vector<uint32_t> laggards;
+};
+
+// Head start on resume: `first` wake in this order and run alone for staggerNs
+struct ResumePlan
+{
+    std::vector<uint32_t> first;
+    int64_t staggerNs = 0;
+};
+
+class FreezeWorkers;
+
+class ProcessFreezer
+{
+public:
+    virtual ~ProcessFreezer() {}
+    // Pool for the next Freeze()'s suspend batches, null = the calling thread only.
+    // It must not be busy running the caller (the pool does not nest).
+    virtual void SetWorkers(FreezeWorkers* workers) { (void)workers; }
+    // Suspend every thread of pid, repeating until no new threads appear
+    virtual FreezeResult Freeze(uint32_t pid) = 0;
+    // Resume exactly the threads Freeze() suspended, then forget them
+    FreezeResult Thaw() { return ThawStaged(ResumePlan()); }
+    virtual FreezeResult ThawStaged(const ResumePlan& plan) = 0;
+    virtual uint32_t Pid() const = 0;
+    virtual size_t ThreadCount() const = 0;
+    virtual std::vector<uint32_t> ThreadIds() const = 0;
+};
+
+// -----------------------------------------------------------------------------
+// Write-ahead hook for the crash journal. Calls come from the freezing thread;
+// different freezers may call at the same time with different slots.
+// -----------------------------------------------------------------------------
+class FreezeRecorder
+{
+public:
+    virtual ~FreezeRecorder() {}
+    // pid is about to be frozen. Returns its slot, -1 = not journaled.
+    virtual int Begin(uint32_t pid) = 0;
+    // tids are about to be suspended once each. Returns the journal index of the
+    // first (the others follow in order), -1 = not journaled.
+    virtual int Threads(int slot, const std::vector<uint32_t>& tids) = 0;
+    // The thread at index was resumed (indices past what was journaled are ignored)
+    virtual void Resumed(int slot, int index) = 0;
+    // Freeze() is done: the target is stopped, so slow bookkeeping won't stall behind it
+    virtual void Frozen(int slot) { (void)slot; }
+    // Everything in the slot has been resumed
+    virtual void End(int slot) = 0;
+};
+
+// Picked up by each Freeze(); null = no journal
+static inline std::atomic<FreezeRecorder*>& ActiveFreezeRecorder()
+{
+    static std::atomic<FreezeRecorder*> recorder(nullptr);
+    return recorder;
+}
+
+static inline int64_t FreezerNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// -----------------------------------------------------------------------------
+// Tiny persistent worker pool: splits [0, n) into contiguous chunks.
+// Persistent so a pause doesn't pay thread creation; idle workers sleep on a
+// condition variable.
+// -----------------------------------------------------------------------------
+class FreezeWorkers
+{
+public:
+    explicit FreezeWorkers(unsigned count)
+    {
+        for (unsigned i = 0; i < count; ++i)
+            m_threads.emplace_back([this, i] { Run(i); });
+    }
+    ~FreezeWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_wake.notify_all();
+        for (auto& t : m_threads) t.join();
+    }
+    unsigned Size() const { return static_cast<unsigned>(m_threads.size()); }
+
+    // Caller thread takes the first chunk; returns once all chunks are done.
+    void ParallelFor(size_t n, const std::function<void(size_t, size_t)>& fn)
+    {
+        size_t parts = m_threads.size() + 1;
+        size_t chunk = (n + parts - 1) / parts;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_fn = &fn;
+            m_n = n;
+            m_chunk = chunk;
+            m_pending = m_threads.size();
+            ++m_generation;
+        }
+        m_wake.notify_all();
+        fn(0, std::min(chunk, n));
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_pending == 0; });
+        m_fn = nullptr;
+    }
+
+private:
+    void Run(unsigned index)
+    {
+        TraceThreadName("freeze worker");
+        uint64_t seen = 0;
+        for (;;) {
+            const std::function<void(size_t, size_t)>* fn;
+            size_t begin, end;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [&] { return m_quit || m_generation != seen; });
+                if (m_quit) return;
+                seen = m_generation;
+                fn = m_fn;
+                begin = std::min(m_n, (index + 1) * m_chunk);
+                end = std::min(m_n, begin + m_chunk);
+            }
+            if (begin < end) (*fn)(begin, end);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_pending == 0) m_done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_wake, m_done;
+    const std::function<void(size_t, size_t)>* m_fn = nullptr;
+    size_t m_n = 0, m_chunk = 0, m_pending = 0;
+    uint64_t m_generation = 0;
+    bool m_quit = false;
+};
+
+#ifdef _WIN32
+// -----------------------------------------------------------------------------
+// Windows backend
+// -----------------------------------------------------------------------------
+typedef LONG(NTAPI* NtGetNextThreadFn)(HANDLE, HANDLE, ACCESS_MASK, ULONG, ULONG, PHANDLE);
+
+class Win32Freezer : public ProcessFreezer
+{
+public:
+    static const DWORD THREAD_ACCESS = THREAD_SUSPEND_RESUME | THREAD_QUERY_LIMITED_INFORMATION | SYNCHRONIZE;
+    static const size_t PARALLEL_THRESHOLD = 64; // Below this, one thread is faster than a handoff
+
+    explicit Win32Freezer(unsigned workers)
+    {
+        if (workers > 1) m_ownWorkers.reset(new FreezeWorkers(workers - 1));
+        m_workers = m_ownWorkers.get();
+        static NtGetNextThreadFn fn = reinterpret_cast<NtGetNextThreadFn>(
+            GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtGetNextThread"));
+        m_getNextThread = fn;
+    }
+    ~Win32Freezer() override
+    {
+        Thaw();
+        DropCache();
+    }
+
+    void SetWorkers(FreezeWorkers* workers) override { m_workers = workers; }
+
+    FreezeResult Freeze(uint32_t pid) override
+    {
+        FreezeResult r;
+        int64_t t0 = FreezerNowNs();
+        if (m_pid) Thaw();
+        if (pid != m_cachedPid) DropCache();
+        TraceSpan span("freeze process", "pid", pid);
+        m_pid = pid;
+        m_recorder = ActiveFreezeRecorder().load();
+        m_slot = m_recorder ? m_recorder->Begin(pid) : -1;
+        if (!m_process) m_process = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, pid);
+        std::vector<Entry> fresh;
+        if (!m_cached.empty()) {
+            // Threads from the last pause of this process. The process handle keeps the PID
+            // from being reused; a thread that has exited is forgotten, since its id may be
+            // handed to a new thread the walk below must then pick up.
+            TraceSpan cached("cached threads", "count", static_cast<uint64_t>(m_cached.size()));
+            for (Entry& e : m_cached) {
+                if (WaitForSingleObject(e.handle, 0) == WAIT_TIMEOUT) fresh.push_back({ e.tid, e.handle });
+                else Forget(e);
+            }
+            m_cached.clear();
+            SuspendBatch(fresh);
+            for (const Entry& e : fresh) {
+                if (e.handle) m_threads.push_back(e);
+            }
+        }
+        for (r.passes = 1; r.passes <= MAX_PASSES; ++r.passes) {
+            fresh.clear();
+            TraceSpan pass("freeze pass", "pass", static_cast<uint64_t>(r.passes));
+            if (!EnumerateNew(fresh)) break;
+            if (fresh.empty()) break; // Converged: nothing new since the last pass
+            SuspendBatch(fresh);
+            for (const Entry& e : fresh) {
+                if (e.handle) m_threads.push_back(e);
+            }
+        }
+        if (m_slot >= 0) m_recorder->Frozen(m_slot);
+        r.ok = !m_threads.empty();
+        r.threads = m_threads.size();
+        r.elapsedNs = FreezerNowNs() - t0;
+        return r;
+    }
+
+    FreezeResult ThawStaged(const ResumePlan& plan) override
+    {
+        FreezeResult r;
+        int64_t t0 = FreezerNowNs();
+        TraceSpan span("thaw process", "pid", m_pid);
+        auto resume = [this, &r](Entry& e) {
+            if (!e.handle) return;
+            TraceSpan resumeSpan("ResumeThread", "tid", e.tid);
+            if (ResumeThread(e.handle) != static_cast<DWORD>(-1)) {
+                ++r.threads;
+                m_cached.push_back({ e.tid, e.handle }); // Kept for the next pause of this process
+            }
+            else {
+                Forget(e);
+            }
+            if (m_slot >= 0) m_recorder->Resumed(m_slot, e.journal);
+            e.handle = nullptr;
+        };
+        for (uint32_t tid : plan.first) {
+            for (Entry& e : m_threads) {
+                if (e.tid == tid) resume(e);
+            }
+        }
+        if (r.threads && plan.staggerNs > 0) std::this_thread::sleep_for(std::chrono::nanoseconds(plan.staggerNs));
+        // The rest in reverse order: last frozen, first released
+        for (auto it = m_threads.rbegin(); it != m_threads.rend(); ++it) resume(*it);
+        if (m_slot >= 0) m_recorder->End(m_slot);
+        m_slot = -1;
+        m_threads.clear();
+        if (m_pid) m_cachedPid = m_pid;
+        r.ok = m_pid != 0;
+        r.passes = 0;
+        m_pid = 0;
+        r.elapsedNs = FreezerNowNs() - t0;
+        return r;
+    }
+
+    uint32_t Pid() const override { return m_pid; }
+    size_t ThreadCount() const override { return m_threads.size(); }
+    std::vector<uint32_t> ThreadIds() const override
+    {
+        std::vector<uint32_t> ids;
+        for (const Entry& e : m_threads) ids.push_back(e.tid);
+        return ids;
+    }
+
+private:
+    static const int MAX_PASSES = 16;
+    struct Entry { DWORD tid; HANDLE handle; int journal = -1; };
+
+    void Forget(Entry& e)
+    {
+        m_known.erase(e.tid);
+        CloseHandle(e.handle);
+        e.handle = nullptr;
+    }
+
+    // Closes what Thaw() kept for the next pause of the same process
+    void DropCache()
+    {
+        for (Entry& e : m_cached) CloseHandle(e.handle);
+        m_cached.clear();
+        m_known.clear();
+        if (m_process) CloseHandle(m_process);
+        m_process = nullptr;
+        m_cachedPid = 0;
+    }
+
+    // Collect handles for threads not seen before. Returns false on failure.
+    bool EnumerateNew(std::vector<Entry>& fresh)
+    {
+        if (m_getNextThread && m_process) {
+            TraceSpan walk("NtGetNextThread walk");
+            HANDLE cur = nullptr;
+            for (;;) {
+                HANDLE next = nullptr;
+                LONG status = m_getNextThread(m_process, cur, THREAD_ACCESS, 0, 0, &next);
+                if (cur && !KeepIfNew(cur, fresh)) CloseHandle(cur);
+                if (status < 0) break; // STATUS_NO_MORE_ENTRIES
+                cur = next;
+            }
+            walk.SetArg("new", fresh.size());
+            return true;
+        }
+        // Fallback: whole-system Toolhelp snapshot
+        HANDLE snap;
+        {
+            TraceSpan snapshot("Toolhelp snapshot");
+            snap = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+        }
+        if (snap == INVALID_HANDLE_VALUE) return false;
+        THREADENTRY32 te = { sizeof(te) };
+        if (Thread32First(snap, &te)) {
+            do {
+                if (te.th32OwnerProcessID != m_pid || m_known.count(te.th32ThreadID)) continue;
+                TraceSpan open("OpenThread", "tid", te.th32ThreadID);
+                HANDLE h = OpenThread(THREAD_ACCESS, FALSE, te.th32ThreadID);
+                if (h) {
+                    m_known.insert(te.th32ThreadID);
+                    fresh.push_back({ te.th32ThreadID, h });
+                }
+            } while (Thread32Next(snap, &te));
+        }
+        CloseHandle(snap);
+        return true;
+    }
+
+    bool KeepIfNew(HANDLE h, std::vector<Entry>& fresh)
+    {
+        DWORD tid = GetThreadId(h);
+        if (!tid || m_known.count(tid)) return false;
+        m_known.insert(tid);
+        fresh.push_back({ tid, h });
+        return true;
+    }
+
+    void SuspendBatch(std::vector<Entry>& batch)
+    {
+        if (m_slot >= 0) {
+            std::vector<uint32_t> tids;
+            tids.reserve(batch.size());
+            for (const Entry& e : batch) tids.push_back(e.tid);
+            int first = m_recorder->Threads(m_slot, tids);
+            for (size_t i = 0; first >= 0 && i < batch.size(); ++i) batch[i].journal = first + static_cast<int>(i);
+        }
+        auto suspendRange = [&batch](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                TraceSpan span("SuspendThread", "tid", batch[i].tid);
+                if (SuspendThread(batch[i].handle) == static_cast<DWORD>(-1)) {
+                    CloseHandle(batch[i].handle); // Thread already gone
+                    batch[i].handle = nullptr;
+                }
+            }
+        };
+        if (m_workers && m_workers->Size() && batch.size() >= PARALLEL_THRESHOLD)
+            m_workers->ParallelFor(batch.size(), suspendRange);
+        else
+            suspendRange(0, batch.size());
+        for (const Entry& e : batch) {
+            if (!e.handle) m_known.erase(e.tid); // Gone: its id may come back on a new thread
+        }
+    }
+
+    NtGetNextThreadFn m_getNextThread = nullptr;
+    std::unique_ptr<FreezeWorkers> m_ownWorkers;
+    FreezeWorkers* m_workers = nullptr; // m_ownWorkers unless SetWorkers() lent a pool
+    HANDLE m_process = nullptr; // Open from the first Freeze() of m_cachedPid until DropCache()
+    uint32_t m_pid = 0;
+    uint32_t m_cachedPid = 0; // Process m_cached, m_known and m_process belong to
+    FreezeRecorder* m_recorder = nullptr;
+    int m_slot = -1; // In m_recorder, -1 = not journaled
+    std::vector<Entry> m_threads; // Suspended, handle held until Thaw()
+    std::vector<Entry> m_cached; // Resumed, handle held for the next Freeze() of m_cachedPid
+    std::unordered_set<DWORD> m_known;
+};
+#else
+// -----------------------------------------------------------------------------
+// Linux backend
+// -----------------------------------------------------------------------------
+// Enumerate task ids of a process from /proc/<pid>/task
+static inline std::vector<uint32_t> ListProcTasks(uint32_t pid)
+{
+    std::vector<uint32_t> tids;
+    std::string path = "/proc/" + std::to_string(pid) + "/task";
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return tids;
+    while (dirent* de = readdir(dir)) {
+        if (de->d_name[0] < '0' || de->d_name[0] > '9') continue;
+        tids.push_back(static_cast<uint32_t>(std::strtoul(de->d_name, nullptr, 10)));
+    }
+    closedir(dir);
+    return tids;
+}
+
+// Single-letter scheduler state from /proc/<pid>/task/<tid>/stat ('?' if gone)
+static inline char ReadTaskState(uint32_t pid, uint32_t tid)
+{
+    char path[64];
+    std::snprintf(path, sizeof(path), "/proc/%u/task/%u/stat", pid, tid);
+    FILE* f = std::fopen(path, "r");
+    if (!f) return '?';
+    char buf[512];
+    size_t n = std::fread(buf, 1, sizeof(buf) - 1, f);
+    std::fclose(f);
+    buf[n] = 0;
+    const char* close = std::strrchr(buf, ')'); // comm may contain spaces or ')'
+    return (close && close[1] == ' ') ? close[2] : '?';
+}
+
+class LinuxFreezer : public ProcessFreezer
+{
+public:
+    LinuxFreezer() {}
+    ~LinuxFreezer() override { Thaw(); }
+
+    FreezeResult Freeze(uint32_t pid) override
+    {
+        FreezeResult r;
+        int64_t t0 = FreezerNowNs();
+        if (m_pid) Thaw();
+        m_recorder = ActiveFreezeRecorder().load();
+        m_slot = m_recorder ? m_recorder->Begin(pid) : -1;
+        TraceSpan span("freeze process", "pid", pid);
+        int stopped;
+        {
+            TraceSpan stop("SIGSTOP", "pid", pid);
+            stopped = kill(static_cast<pid_t>(pid), SIGSTOP);
+        }
+        if (stopped != 0) {
+            if (m_slot >= 0) m_recorder->End(m_slot);
+            m_slot = -1;
+            r.elapsedNs = FreezerNowNs() - t0;
+            return r;
+        }
+        m_pid = pid;
+        // Group stop is asynchronous: converge until the task set is stable
+        // and every task reports stopped (or is already dead).
+        int64_t deadline = t0 + 500000000LL;
+        std::vector<uint32_t> prev;
+        for (r.passes = 1;; ++r.passes) {
+            TraceSpan pass("converge pass", "pass", static_cast<uint64_t>(r.passes));
+            std::vector<uint32_t> tids = ListProcTasks(pid);
+            bool allStopped = true;
+            for (uint32_t tid : tids) {
+                if (!TaskStopped(pid, tid)) {
+                    allStopped = false;
+                    break;
+                }
+            }
+            bool stable = tids == prev;
+            prev.swap(tids);
+            if (allStopped && stable) break;
+            if (FreezerNowNs() > deadline) {
+                for (uint32_t tid : prev) {
+                    if (!TaskStopped(pid, tid)) r.laggards.push_back(tid);
+                }
+                r.partial = !r.laggards.empty() || !stable;
+                break;
+            }
+            // Yield so the target can take its SIGSTOP; back off to a real sleep if that isn't
+            // enough (a real-time caller's yield never hands the CPU to a normal thread)
+            if (!allStopped) {
+                if (r.passes < 8) std::this_thread::yield();
+                else std::this_thread::sleep_for(std::chrono::microseconds(20));
+            }
+        }
+        m_tids = prev;
+        if (m_slot >= 0) {
+            m_recorder->Threads(m_slot, m_tids); // For the record: SIGCONT resumes them all
+            m_recorder->Frozen(m_slot);
+        }
+        r.ok = true; // Partial or not, the stop is in effect or pending and Thaw() must undo it
+        r.threads = m_tids.size();
+        r.elapsedNs = FreezerNowNs() - t0;
+        return r;
+    }
+
+    // SIGCONT wakes the whole group at once, so the head start is given by parking
+    // every other thread at SCHED_IDLE until the stagger is over
+    FreezeResult ThawStaged(const ResumePlan& plan) override
+    {
+        FreezeResult r;
+        int64_t t0 = FreezerNowNs();
+        if (m_pid) {
+            TraceSpan span("thaw process", "pid", m_pid);
+            struct Parked { pid_t tid; int policy; sched_param param; };
+            std::vector<Parked> parked;
+            if (!plan.first.empty() && plan.staggerNs > 0) {
+                for (uint32_t tid : m_tids) {
+                    if (std::find(plan.first.begin(), plan.first.end(), tid) != plan.first.end()) continue;
+                    Parked p = { static_cast<pid_t>(tid), sched_getscheduler(static_cast<pid_t>(tid)), {} };
+                    sched_param idle = {};
+                    if (p.policy < 0 || (p.policy & ~SCHED_RESET_ON_FORK) == SCHED_IDLE || sched_getparam(p.tid, &p.param) != 0) continue;
+                    if (sched_setscheduler(p.tid, SCHED_IDLE, &idle) == 0) parked.push_back(p);
+                }
+            }
+            {
+                TraceSpan cont("SIGCONT", "pid", m_pid);
+                r.ok = kill(static_cast<pid_t>(m_pid), SIGCONT) == 0;
+            }
+            r.threads = m_tids.size();
+            if (!parked.empty()) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(plan.staggerNs));
+                for (const Parked& p : parked) sched_setscheduler(p.tid, p.policy, &p.param);
+            }
+        }
+        if (m_slot >= 0) m_recorder->End(m_slot);
+        m_slot = -1;
+        m_pid = 0;
+        m_tids.clear();
+        r.elapsedNs = FreezerNowNs() - t0;
+        return r;
+    }
+
+    uint32_t Pid() const override { return m_pid; }
+    size_t ThreadCount() const override { return m_tids.size(); }
+    std::vector<uint32_t> ThreadIds() const override { return m_tids; }
+
+private:
+    static bool TaskStopped(uint32_t pid, uint32_t tid)
+    {
+        char st = ReadTaskState(pid, tid);
+        return st == 'T' || st == 't' || st == 'Z' || st == 'X' || st == '?';
+    }
+
+    uint32_t m_pid = 0;
+    std::vector<uint32_t> m_tids;
+    FreezeRecorder* m_recorder = nullptr;
+    int m_slot = -1; // In m_recorder, -1 = not journaled
+};
+#endif
+
+// Worker count 0 = pick from hardware concurrency (capped; suspend is cheap).
+// Windows only: on Linux one SIGSTOP stops the whole thread group.
+static inline std::unique_ptr<ProcessFreezer> CreateProcessFreezer(unsigned workers = 0)
+{
+#ifdef _WIN32
+    if (workers == 0) workers = std::min(4u, std::max(1u, std::thread::hardware_concurrency() / 2));
+    return std::unique_ptr<ProcessFreezer>(new Win32Freezer(workers));
+#else
+    (void)workers;
+    return std::unique_ptr<ProcessFreezer>(new LinuxFreezer());
+#endif
+}
@@ -0,0 +1,355 @@
+// =============================================================================
+// ProcessTree.h - Pause targets that span several processes
+//
+// A pause target is a set of processes: the foreground process, optionally
+// its descendants, plus anything matching configured image names. The set is
+// frozen level by level (each level in parallel) in a consistent order, and
+// thawed in exactly the reverse order.
+//
+// Discovery: Toolhelp process snapshot on Windows, /proc on Linux. Parent
+// links are only trusted if the child started after the parent, so a reused
+// PID can't pull an unrelated process into the tree.
+// =============================================================================
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ProcessFreezer.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <tlhelp32.h>
+#else
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+struct ProcessInfo
+{
+    uint32_t pid = 0;
+    uint32_t ppid = 0;
+    std::string name; // Lowercase image name, e.g. "game.exe" / "retroarch"
+};
+
+static inline std::string ToLowerAscii(std::string s)
+{
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return s;
+}
+
+// Opaque, monotonic-per-boot start time; 0 if the process is gone/unreadable
+static inline uint64_t ProcessStartTime(uint32_t pid)
+{
+#ifdef _WIN32
+    HANDLE h = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (!h) return 0;
+    FILETIME created, exited, kernel, user;
+    uint64_t t = 0;
+    if (GetProcessTimes(h, &created, &exited, &kernel, &user))
+        t = (static_cast<uint64_t>(created.dwHighDateTime) << 32) | created.dwLowDateTime;
+    CloseHandle(h);
+    return t;
+#else
+    char path[64];
+    std::snprintf(path, sizeof(path), "/proc/%u/stat", pid);
+    FILE* f = std::fopen(path, "r");
+    if (!f) return 0;
+    char buf[1024];
+    size_t n = std::fread(buf, 1, sizeof(buf) - 1, f);
+    std::fclose(f);
+    buf[n] = 0;
+    const char* p = std::strrchr(buf, ')');
+    if (!p) return 0;
+    // Field 22 (starttime); we're positioned before field 3
+    int field = 2;
+    for (; *p && field < 22; ++p) {
+        if (*p == ' ') ++field;
+    }
+    return std::strtoull(p, nullptr, 10);
+#endif
+}
+
+#ifdef _WIN32
+static inline std::string WideToUtf8(const wchar_t* w)
+{
+    int len = WideCharToMultiByte(CP_UTF8, 0, w, -1, nullptr, 0, nullptr, nullptr);
+    if (len <= 1) return std::string();
+    std::string out(static_cast<size_t>(len - 1), '\0');
+    WideCharToMultiByte(CP_UTF8, 0, w, -1, &out[0], len, nullptr, nullptr);
+    return out;
+}
+#endif
+
+static inline std::vector<ProcessInfo> ListProcesses()
+{
+    std::vector<ProcessInfo> list;
+    TraceSpan span("process snapshot");
+#ifdef _WIN32
+    HANDLE snap = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (snap == INVALID_HANDLE_VALUE) return list;
+    PROCESSENTRY32W pe = { sizeof(pe) };
+    if (Process32FirstW(snap, &pe)) {
+        do {
+            ProcessInfo info;
+            info.pid = pe.th32ProcessID;
+            info.ppid = pe.th32ParentProcessID;
+            info.name = ToLowerAscii(WideToUtf8(pe.szExeFile));
+            list.push_back(info);
+        } while (Process32NextW(snap, &pe));
+    }
+    CloseHandle(snap);
+#else
+    DIR* dir = opendir("/proc");
+    if (!dir) return list;
+    while (dirent* de = readdir(dir)) {
+        if (de->d_name[0] < '0' || de->d_name[0] > '9') continue;
+        ProcessInfo info;
+        info.pid = static_cast<uint32_t>(std::strtoul(de->d_name, nullptr, 10));
+        char path[64];
+        std::snprintf(path, sizeof(path), "/proc/%u/stat", info.pid);
+        FILE* f = std::fopen(path, "r");
+        if (!f) continue;
+        char buf[512];
+        size_t n = std::fread(buf, 1, sizeof(buf) - 1, f);
+        std::fclose(f);
+        buf[n] = 0;
+        const char* open = std::strchr(buf, '(');
+        const char* close = std::strrchr(buf, ')');
+        if (!open || !close || close < open) continue;
+        info.name = ToLowerAscii(std::string(open + 1, close)); // comm (15 chars max)
+        unsigned ppid = 0;
+        if (std::sscanf(close + 2, "%*c %u", &ppid) == 1) info.ppid = ppid;
+        // Prefer the full executable name over the truncated comm when we can read it
+        std::snprintf(path, sizeof(path), "/proc/%u/exe", info.pid);
+        char exe[4096];
+        ssize_t len = readlink(path, exe, sizeof(exe) - 1);
+        if (len > 0) {
+            exe[len] = 0;
+            const char* base = std::strrchr(exe, '/');
+            info.name = ToLowerAscii(base ? base + 1 : exe);
+        }
+        list.push_back(info);
+    }
+    closedir(dir);
+#endif
+    span.SetArg("processes", list.size());
+    return list;
+}
+
+// Descendants of root in breadth-first order (children, grandchildren, ...),
+// with the depth of each. Parent links from before the child existed are ignored.
+static inline std::vector<std::pair<uint32_t, int>> FindDescendants(const std::vector<ProcessInfo>& procs, uint32_t root)
+{
+    std::unordered_multimap<uint32_t, uint32_t> children;
+    for (const ProcessInfo& p : procs) {
+        if (p.pid != p.ppid && p.pid != 0) children.emplace(p.ppid, p.pid);
+    }
+    std::vector<std::pair<uint32_t, int>> out;
+    std::vector<std::pair<uint32_t, int>> queue = { { root, 0 } };
+    for (size_t i = 0; i < queue.size(); ++i) {
+        uint32_t parent = queue[i].first;
+        uint64_t parentStart = ProcessStartTime(parent);
+        auto range = children.equal_range(parent);
+        for (auto it = range.first; it != range.second; ++it) {
+            uint64_t childStart = ProcessStartTime(it->second);
+            if (parentStart && childStart && childStart < parentStart) continue; // Reused parent PID
+            if (std::find_if(queue.begin(), queue.end(), [&](const std::pair<uint32_t, int>& q) { return q.first == it->second; }) != queue.end())
+                continue; // Cycle guard (PID reuse can create one)
+            queue.push_back({ it->second, queue[i].second + 1 });
+            out.push_back(queue.back());
+        }
+    }
+    return out;
+}
+
+enum class GroupOrder { ChildrenFirst, ParentFirst };
+
+static inline GroupOrder GroupOrderFromString(const std::string& s)
+{
+    return ToLowerAscii(s) == "parent-first" ? GroupOrder::ParentFirst : GroupOrder::ChildrenFirst;
+}
+
+struct PauseMember
+{
+    uint32_t pid = 0;
+    std::string name;
+    int depth = 0; // 0 = the foreground process; named matches outside the tree get depth 0 too
+};
+
+struct PauseTargetOptions
+{
+    bool includeChildren = true;
+    std::vector<std::string> imageNames; // Lowercase, matched exactly
+};
+
+// Foreground process + descendants + named processes, without duplicates or ourselves
+static inline std::vector<PauseMember> ResolvePauseTargets(uint32_t rootPid, const PauseTargetOptions& opt, uint32_t selfPid)
+{
+    std::vector<ProcessInfo> procs = ListProcesses();
+    std::unordered_map<uint32_t, const ProcessInfo*> byPid;
+    for (const ProcessInfo& p : procs) byPid[p.pid] = &p;
+    std::vector<PauseMember> members;
+    auto add = [&](uint32_t pid, int depth) {
+        if (pid == 0 || pid == selfPid) return;
+        for (const PauseMember& m : members) {
+            if (m.pid == pid) return;
+        }
+        PauseMember m;
+        m.pid = pid;
+        m.depth = depth;
+        auto it = byPid.find(pid);
+        if (it != byPid.end()) m.name = it->second->name;
+        members.push_back(m);
+    };
+    add(rootPid, 0);
+    if (opt.includeChildren) {
+        for (const auto& d : FindDescendants(procs, rootPid)) add(d.first, d.second);
+    }
+    for (const ProcessInfo& p : procs) {
+        if (std::find(opt.imageNames.begin(), opt.imageNames.end(), p.name) != opt.imageNames.end())
+            add(p.pid, 0);
+    }
+    return members;
+}
+
+// -----------------------------------------------------------------------------
+// Freezes a whole member set: one ProcessFreezer per process, levels in order,
+// members of a level in parallel. Freezers are kept per PID across pauses (so
+// their handles are too) until the PID leaves the member set. The group's
+// workers are one budget: a level of one process (the usual game) gets them
+// all for its suspend batches, a wider level spreads its members over them.
+// -----------------------------------------------------------------------------
+struct MemberResult
+{
+    uint32_t pid;
+    std::string name;
+    FreezeResult result;
+};
+
+class ProcessGroupFreezer
+{
+public:
+    // workers counts the calling thread, so 1 means strictly sequential
+    explicit ProcessGroupFreezer(unsigned workers = 0)
+        : m_workers((workers ? workers : std::min(4u, std::max(1u, std::thread::hardware_concurrency() / 2))) - 1)
+    {
+    }
+    ~ProcessGroupFreezer() { Thaw(); }
+
+    std::vector<MemberResult> Freeze(const std::vector<PauseMember>& members, GroupOrder order)
+    {
+        Thaw();
+        for (auto it = m_freezers.begin(); it != m_freezers.end();) {
+            bool member = std::any_of(members.begin(), members.end(), [&](const PauseMember& m) { return m.pid == it->first; });
+            if (member) ++it;
+            else it = m_freezers.erase(it); // Closes what it kept of a process we no longer freeze
+        }
+        // Level order: deepest first for ChildrenFirst (a child never runs against a frozen parent's IPC
+        // for long), shallowest first for ParentFirst.
+        std::map<int, std::vector<PauseMember>> levels;
+        for (const PauseMember& m : members) levels[m.depth].push_back(m);
+        m_plan.clear();
+        for (auto& kv : levels) m_plan.push_back(kv.second);
+        if (order == GroupOrder::ChildrenFirst) std::reverse(m_plan.begin(), m_plan.end());
+        return Freeze();
+    }
+
+    // The member set and order of the last Freeze(members, order) again, less any
+    // member that could not be frozen since: no planning, no allocation per member
+    std::vector<MemberResult> Freeze()
+    {
+        Thaw();
+        std::vector<MemberResult> results;
+        for (auto& level : m_plan) {
+            std::vector<Slot> slots(level.size());
+            for (size_t i = 0; i < level.size(); ++i) {
+                std::unique_ptr<ProcessFreezer>& freezer = m_freezers[level[i].pid];
+                if (!freezer) freezer = CreateProcessFreezer(1);
+                slots[i].freezer = freezer.get();
+                slots[i].member = level[i];
+            }
+            FreezeWorkers* pool = level.size() == 1 ? &m_workers : nullptr; // Otherwise busy running the level
+            RunParallel(level.size(), [&](size_t i) {
+                slots[i].freezer->SetWorkers(pool);
+                slots[i].result = slots[i].freezer->Freeze(slots[i].member.pid);
+            });
+            std::vector<Slot> frozen;
+            for (Slot& s : slots) {
+                results.push_back({ s.member.pid, s.member.name, s.result });
+                if (s.result.ok) {
+                    frozen.push_back(s);
+                }
+                else {
+                    s.freezer->Thaw(); // Nothing to resume, but it releases the journal slot
+                    m_freezers.erase(s.member.pid);
+                    level.erase(std::find_if(level.begin(), level.end(), [&](const PauseMember& m) { return m.pid == s.member.pid; }));
+                }
+            }
+            m_levels.push_back(std::move(frozen));
+        }
+        return results;
+    }
+
+    // Picks each member's head-start threads while it is still frozen
+    typedef std::function<ResumePlan(uint32_t pid, const std::vector<uint32_t>& tids)> ResumePlanner;
+
+    // Reverse of the freeze order, each level in parallel
+    std::vector<MemberResult> Thaw(const ResumePlanner& planner = ResumePlanner())
+    {
+        std::vector<MemberResult> results;
+        for (auto level = m_levels.rbegin(); level != m_levels.rend(); ++level) {
+            std::vector<MemberResult> part(level->size());
+            RunParallel(level->size(), [&](size_t i) {
+                Slot& s = (*level)[i];
+                FreezeResult r = planner ? s.freezer->ThawStaged(planner(s.member.pid, s.freezer->ThreadIds())) : s.freezer->Thaw();
+                part[i] = { s.member.pid, s.member.name, r };
+            });
+            results.insert(results.end(), part.begin(), part.end());
+        }
+        m_levels.clear();
+        return results;
+    }
+
+    bool Active() const { return !m_levels.empty(); }
+    std::vector<uint32_t> Pids() const
+    {
+        std::vector<uint32_t> pids;
+        for (const auto& level : m_levels) {
+            for (const Slot& s : level) pids.push_back(s.member.pid);
+        }
+        return pids;
+    }
+
+private:
+    struct Slot
+    {
+        ProcessFreezer* freezer = nullptr; // Owned by m_freezers
+        PauseMember member;
+        FreezeResult result;
+    };
+
+    template <typename Fn> void RunParallel(size_t n, Fn fn)
+    {
+        if (n <= 1) {
+            if (n == 1) fn(0);
+            return;
+        }
+        std::function<void(size_t, size_t)> range = [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; ++i) fn(i);
+        };
+        m_workers.ParallelFor(n, range);
+    }
+
+    FreezeWorkers m_workers;
+    std::map<uint32_t, std::unique_ptr<ProcessFreezer>> m_freezers; // By PID, kept across pauses
+    std::vector<std::vector<PauseMember>> m_plan; // Members by level, in freeze order
+    std::vector<std::vector<Slot>> m_levels; // In freeze order
+};
@@ -0,0 +1,160 @@
+// =============================================================================
+// ReplayCalibrator.h - Learn the fastest key rate a game reliably accepts
+//
+// Games that poll the keyboard once per frame miss a key that goes down and
+// up between two polls. The calibrator types a test sequence of distinct
+// letters, reads back what the target registered, and repeats with shorter
+// and shorter gaps between events until keys go missing; then it narrows the
+// last passing and first failing gap down to the millisecond. The result,
+// with a safety margin, becomes the profile's MinGapMs.
+//
+// The target is anything that can take keys and report what it saw: a game's
+// chat box read back through the clipboard on Windows, or the SlowPoller
+// stand-in in Simulation.h on Linux.
+// =============================================================================
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "KeyRing.h"
+#include "ReplayScheduler.h"
+
+class CalibrationTarget : public InputSink
+{
+public:
+    virtual void Reset() {} // Before each sequence: forget what arrived so far
+    virtual std::string Received() = 0; // Letters registered since Reset(), any case
+};
+
+struct CalibrationOptions
+{
+    int startGapMs = 50; // First gap tried; should be safe for anything
+    int floorGapMs = 1; // Stop looking below this
+    double step = 0.75; // Each round tries gap * step
+    int trials = 3; // Sequences that must all arrive intact at a gap
+    size_t sequenceKeys = 16; // Letters per sequence
+    int settleMs = 200; // Wait after a sequence before reading back
+    double margin = 1.25; // Recommended = fastest reliable gap * margin
+};
+
+struct CalibrationStep
+{
+    int gapMs = 0;
+    int passed = 0;
+    int trials = 0;
+    std::string expected, received; // Of the first failing trial
+};
+
+struct CalibrationResult
+{
+    bool ok = false;
+    int fastestGapMs = 0; // Smallest gap where every trial arrived intact
+    int recommendedGapMs = 0; // With the margin - what goes into MinGapMs
+    std::vector<CalibrationStep> steps;
+    uint64_t elapsedNs = 0;
+    std::string error;
+};
+
+class ReplayCalibrator
+{
+public:
+    // clock may be null: real time
+    explicit ReplayCalibrator(const CalibrationOptions& options, ReplayClock* clock = nullptr)
+        : m_options(options), m_clock(clock ? clock : &m_waiter)
+    {
+    }
+
+    // progress (optional) is called after every gap tried
+    CalibrationResult Run(CalibrationTarget& target, const std::function<void(const CalibrationStep&)>& progress = nullptr)
+    {
+        CalibrationResult result;
+        uint64_t start = m_clock->NowNs();
+        m_round = 0;
+        target.Begin();
+        int gap = std::max(m_options.startGapMs, m_options.floorGapMs), good = 0, bad = 0;
+        // Decreasing gaps until one fails
+        while (gap >= m_options.floorGapMs) {
+            if (!Try(target, gap, result, progress)) {
+                bad = gap;
+                break;
+            }
+            good = gap;
+            int next = static_cast<int>(gap * m_options.step);
+            gap = std::min(next, gap - 1);
+        }
+        // Then bisect between the last gap that passed and the first that failed
+        while (good && bad && good - bad > 1) {
+            int mid = (good + bad) / 2;
+            if (Try(target, mid, result, progress)) good = mid;
+            else bad = mid;
+        }
+        target.End();
+        result.elapsedNs = m_clock->NowNs() - start;
+        if (!good) {
+            result.error = "keys went missing even " + std::to_string(m_options.startGapMs) + " ms apart";
+            return result;
+        }
+        result.ok = true;
+        result.fastestGapMs = good;
+        result.recommendedGapMs = std::max(good, static_cast<int>(std::ceil(good * m_options.margin)));
+        return result;
+    }
+
+    // Taps of distinct letters, each held for gapMs with gapMs between them. The
+    // letter order shifts every round so a target can't pass by pattern.
+    static std::vector<KeyEvent> Sequence(size_t keys, int gapMs, size_t round, std::string& expected)
+    {
+        static const char letters[] = "QWERTYUIOPASDFGHJKLZXCVBNM";
+        std::vector<KeyEvent> events;
+        expected.clear();
+        uint64_t gap = static_cast<uint64_t>(gapMs) * 1000000ULL, t = 0;
+        for (size_t i = 0; i < keys; ++i) {
+            char c = letters[(i * 7 + round * 3) % 26]; // 7 is coprime with 26: no repeats within 26 keys
+            events.push_back({ t, static_cast<uint16_t>(c), 0, 0, 0 });
+            events.push_back({ t + gap, static_cast<uint16_t>(c), 0, KEY_UP, 0 });
+            t += 2 * gap;
+            expected.push_back(static_cast<char>(std::tolower(c)));
+        }
+        return events;
+    }
+
+private:
+    bool Try(CalibrationTarget& target, int gapMs, CalibrationResult& result, const std::function<void(const CalibrationStep&)>& progress)
+    {
+        ReplayOptions faithful;
+        faithful.policy = ReplayPolicy::Faithful;
+        faithful.leadDelayMs = 0;
+        faithful.maxGapMs = 0;
+        ReplayScheduler scheduler(faithful, m_clock);
+        CalibrationStep step;
+        step.gapMs = gapMs;
+        for (int t = 0; t < m_options.trials; ++t) {
+            std::string expected;
+            std::vector<KeyEvent> events = Sequence(m_options.sequenceKeys, gapMs, m_round++, expected);
+            target.Reset();
+            scheduler.Run(events.data(), events.size(), target);
+            m_clock->SleepFor(static_cast<uint64_t>(std::max(0, m_options.settleMs)) * 1000000ULL);
+            std::string received = target.Received();
+            std::transform(received.begin(), received.end(), received.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            ++step.trials;
+            if (received != expected) {
+                step.expected = expected;
+                step.received = received;
+                break; // One miss is enough to rule this gap out
+            }
+            ++step.passed;
+        }
+        result.steps.push_back(step);
+        if (progress) progress(step);
+        return step.passed == step.trials;
+    }
+
+    CalibrationOptions m_options;
+    PreciseWaiter m_waiter;
+    ReplayClock* m_clock;
+    size_t m_round = 0;
+};
@@ -0,0 +1,156 @@
+// =============================================================================
+// ReplayProfiles.h - Per-game replay settings, keyed by image name
+//
+// [Profiles] in GamePauser.ini holds one line per game:
+//   Profile1 = eldenring.exe, Policy=faithful, LeadDelayMs=120, MinGapMs=17
+// Whatever a profile leaves out comes from [Replay]. The table is a hash map
+// on the lowercase image name, looked up once when a pause starts. MinGapMs
+// is what calibration (ReplayCalibrator.h) learns; UpdateProfileIni() writes
+// a profile back into the INI text without touching any other line.
+// =============================================================================
+#pragma once
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ProcessTree.h"
+#include "ReplayScheduler.h"
+
+struct ReplayProfile
+{
+    std::string image; // As written in the INI
+    ReplayOptions replay;
+};
+
+// "C:\Games\EldenRing.exe" -> "eldenring.exe"
+static inline std::string ProfileKey(const std::string& image)
+{
+    size_t slash = image.find_last_of("\\/");
+    return ToLowerAscii(slash == std::string::npos ? image : image.substr(slash + 1));
+}
+
+// "<image>, Policy=..., LeadDelayMs=..., MinGapMs=..., Speed=..., MaxGapMs=..." over defaults.
+// Returns false (and why) if there is no image name; unknown fields are reported but skipped.
+static inline bool ParseReplayProfile(const std::string& value, const ReplayOptions& defaults, ReplayProfile& out, std::string* error = nullptr)
+{
+    std::stringstream list(value);
+    std::string item;
+    out.image.clear();
+    out.replay = defaults;
+    std::string unknown;
+    while (std::getline(list, item, ',')) {
+        item.erase(0, item.find_first_not_of(" \t"));
+        item.erase(item.find_last_not_of(" \t") + 1);
+        if (item.empty()) continue;
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) {
+            if (out.image.empty()) out.image = item;
+            else unknown += " '" + item + "'";
+            continue;
+        }
+        std::string key = item.substr(0, eq), val = item.substr(eq + 1);
+        key.erase(key.find_last_not_of(" \t") + 1);
+        val.erase(0, val.find_first_not_of(" \t"));
+        int n = std::atoi(val.c_str());
+        if (key == "Policy") out.replay.policy = ReplayPolicyFromString(val);
+        else if (key == "LeadDelayMs") out.replay.leadDelayMs = std::max(0, n);
+        else if (key == "MinGapMs") out.replay.minGapMs = std::max(0, n);
+        else if (key == "MaxGapMs") out.replay.maxGapMs = std::max(0, n);
+        else if (key == "Speed") out.replay.speed = std::max(0.1, std::atof(val.c_str()));
+        else unknown += " '" + key + "'";
+    }
+    if (error) *error = out.image.empty() ? "no image name" : unknown.empty() ? "" : "unknown field" + unknown;
+    return !out.image.empty();
+}
+
+static inline std::string FormatReplayProfile(const ReplayProfile& p)
+{
+    std::ostringstream oss;
+    oss << p.image << ", Policy=" << ReplayPolicyName(p.replay.policy) << ", LeadDelayMs=" << p.replay.leadDelayMs
+        << ", MinGapMs=" << p.replay.minGapMs;
+    if (p.replay.policy == ReplayPolicy::Speed) oss << ", Speed=" << p.replay.speed;
+    return oss.str();
+}
+
+class ReplayProfiles
+{
+public:
+    void Set(const ReplayProfile& profile) { m_byImage[ProfileKey(profile.image)] = profile; }
+    // image: as reported by the process list (any case, with or without a path)
+    const ReplayProfile* Find(const std::string& image) const
+    {
+        if (m_byImage.empty() || image.empty()) return nullptr;
+        auto it = m_byImage.find(ProfileKey(image));
+        return it == m_byImage.end() ? nullptr : &it->second;
+    }
+    size_t Count() const { return m_byImage.size(); }
+
+private:
+    std::unordered_map<std::string, ReplayProfile> m_byImage;
+};
+
+// Rewrites the ProfileN line for profile.image, reuses an empty ProfileN placeholder,
+// or adds a new ProfileN under [Profiles] (creating the section at the end if needed).
+// Line endings and every other line are kept as they are.
+static inline std::string UpdateProfileIni(const std::string& text, const ReplayProfile& profile)
+{
+    std::vector<std::string> lines;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t nl = text.find('\n', start);
+        if (nl == std::string::npos) nl = text.size() - 1;
+        lines.push_back(text.substr(start, nl - start + 1));
+        start = nl + 1;
+    }
+    std::string eol = !lines.empty() && lines[0].size() >= 2 && lines[0].compare(lines[0].size() - 2, 2, "\r\n") == 0 ? "\r\n" : "\n";
+    const size_t NONE = static_cast<size_t>(-1);
+    size_t match = NONE, empty = NONE, last = NONE, section = NONE;
+    int highest = 0;
+    std::string key = ProfileKey(profile.image);
+    for (size_t i = 0; i < lines.size(); ++i) {
+        std::string line = lines[i];
+        line.erase(line.find_last_not_of("\r\n") + 1);
+        size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == ';') continue;
+        if (line.compare(first, 10, "[Profiles]") == 0) section = i;
+        if (line.compare(first, 7, "Profile") != 0) continue;
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) continue;
+        std::string name = line.substr(first, eq - first);
+        name.erase(name.find_last_not_of(" \t") + 1);
+        if (name.size() <= 7 || name.find_first_not_of("0123456789", 7) != std::string::npos) continue;
+        highest = std::max(highest, std::atoi(name.c_str() + 7));
+        last = i;
+        std::string value = line.substr(eq + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        ReplayProfile existing;
+        if (value.empty() && empty == NONE) empty = i;
+        else if (match == NONE && ParseReplayProfile(value, ReplayOptions(), existing) && ProfileKey(existing.image) == key) match = i;
+    }
+    size_t at = match != NONE ? match : empty;
+    if (at != NONE) {
+        std::string& line = lines[at];
+        line = line.substr(0, line.find('=') + 1) + " " + FormatReplayProfile(profile) + eol;
+    }
+    else {
+        std::string added = "Profile" + std::to_string(highest + 1) + " = " + FormatReplayProfile(profile) + eol;
+        if (!lines.empty() && lines.back().back() != '\n') lines.back() += eol;
+        if (last != NONE) {
+            lines.insert(lines.begin() + static_cast<std::ptrdiff_t>(last + 1), added);
+        }
+        else if (section != NONE) {
+            lines.insert(lines.begin() + static_cast<std::ptrdiff_t>(section + 1), added);
+        }
+        else {
+            lines.push_back(eol);
+            lines.push_back("[Profiles]" + eol);
+            lines.push_back(added);
+        }
+    }
+    std::string out;
+    out.reserve(text.size() + 128);
+    for (const std::string& line : lines) out += line;
+    return out;
+}
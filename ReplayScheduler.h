@@ -0,0 +1,321 @@
+// =============================================================================
+// ReplayScheduler.h - High-resolution replay pacing, independent of injection
+//
+// The scheduler decides *when* each captured KeyEvent goes out; an InputSink
+// decides *how* (SendInput on Windows, uinput or a recording mock elsewhere).
+// Policies:
+//   Jitter   - the classic 18-45 ms random gap between events
+//   Faithful - reproduce the captured inter-key timing
+//   Speed    - captured timing divided by a multiplier
+//   Batched  - runs of events handed to the sink in one call
+// Waits use a spin-then-sleep hybrid; on Windows the sleep part is a
+// high-resolution waitable timer, so pacing is sub-millisecond. Each wait and
+// each hand-off to the sink is a span when tracing is on (Tracing.h).
+// =============================================================================
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "KeyRing.h"
+#include "Tracing.h"
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+enum class ReplayPolicy { Jitter, Faithful, Speed, Batched };
+
+static inline ReplayPolicy ReplayPolicyFromString(const std::string& s)
+{
+    if (s == "faithful") return ReplayPolicy::Faithful;
+    if (s == "speed") return ReplayPolicy::Speed;
+    if (s == "batched") return ReplayPolicy::Batched;
+    return ReplayPolicy::Jitter;
+}
+
+static inline const char* ReplayPolicyName(ReplayPolicy p)
+{
+    switch (p) {
+    case ReplayPolicy::Faithful: return "faithful";
+    case ReplayPolicy::Speed: return "speed";
+    case ReplayPolicy::Batched: return "batched";
+    default: return "jitter";
+    }
+}
+
+struct ReplayOptions
+{
+    ReplayPolicy policy = ReplayPolicy::Jitter;
+    int leadDelayMs = 380; // Pause before the first event so the resumed target can settle
+    double speed = 1.0; // Speed policy multiplier (Faithful always uses 1)
+    int jitterMinMs = 18;
+    int jitterMaxMs = 45;
+    size_t batchSize = 32; // Batched: events per sink call
+    int batchGapMs = 1; // Batched: pause between batches
+    int maxGapMs = 1000; // Faithful/Speed: clamp long think-pauses (0 = no clamp)
+    int minGapMs = 0; // Floor for every gap, for games that drop faster input (0 = none). Batched then sends one event per call.
+};
+
+// KeyEvent::extra - the low 4 bits say what a pass made of the event, the rest is payload.
+// KEY_EXTRA_REPEAT | count << 4 is a key-down standing for count identical key-downs
+// (a folded autorepeat run); Run() sends them as one burst.
+const uint16_t KEY_EXTRA_KIND = 0x000F;
+const uint16_t KEY_EXTRA_REPEAT = 0x0002;
+const size_t KEY_REPEAT_MAX = 0x0FFF;
+
+static inline size_t KeyDownCount(const KeyEvent& ev)
+{
+    return (ev.extra & KEY_EXTRA_KIND) == KEY_EXTRA_REPEAT ? static_cast<size_t>(ev.extra >> 4) : 1;
+}
+
+static inline void SetKeyRepeat(KeyEvent& ev, size_t count)
+{
+    ev.extra = static_cast<uint16_t>(KEY_EXTRA_REPEAT | (std::min(count, KEY_REPEAT_MAX) << 4));
+}
+
+// Where replayed events go. Send() receives a contiguous run in order.
+// Begin()/End() bracket one replay session (e.g. attach to the foreground thread).
+class InputSink
+{
+public:
+    virtual ~InputSink() {}
+    virtual void Begin() {}
+    virtual void Send(const KeyEvent* events, size_t count) = 0;
+    virtual void End() {}
+};
+
+// Time source for pacing. The real one waits; a virtual one just jumps ahead,
+// which lets headless runs measure schedules without spending the time.
+class ReplayClock
+{
+public:
+    virtual ~ReplayClock() {}
+    virtual uint64_t NowNs() = 0;
+    virtual void SleepUntil(uint64_t deadlineNs) = 0;
+    void SleepFor(uint64_t ns) { SleepUntil(NowNs() + ns); }
+};
+
+// -----------------------------------------------------------------------------
+// Precise waiting: sleep coarsely until close, then spin the last stretch
+// -----------------------------------------------------------------------------
+class PreciseWaiter : public ReplayClock
+{
+public:
+    PreciseWaiter()
+    {
+#ifdef _WIN32
+        // High-resolution timers (Win10 1803+) wake within ~0.5 ms instead of a 15.6 ms tick
+        m_timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        m_spinNs = m_timer ? 600000 : 2000000;
+#endif
+    }
+    ~PreciseWaiter() override
+    {
+#ifdef _WIN32
+        if (m_timer) CloseHandle(m_timer);
+#endif
+    }
+    PreciseWaiter(const PreciseWaiter&) = delete;
+    PreciseWaiter& operator=(const PreciseWaiter&) = delete;
+
+    uint64_t NowNs() override { return MonotonicNs(); }
+    // How much of each wait is spun instead of slept: accuracy for CPU
+    void SetSpinNs(uint64_t ns) { m_spinNs = ns; }
+    void SleepUntil(uint64_t deadlineNs) override
+    {
+        for (;;) {
+            uint64_t now = MonotonicNs();
+            if (now >= deadlineNs) return;
+            uint64_t remaining = deadlineNs - now;
+            if (remaining <= m_spinNs) break;
+            CoarseSleep(remaining - m_spinNs);
+        }
+        while (MonotonicNs() < deadlineNs)
+            std::this_thread::yield();
+    }
+
+private:
+    void CoarseSleep(uint64_t ns)
+    {
+#ifdef _WIN32
+        if (m_timer) {
+            LARGE_INTEGER due;
+            due.QuadPart = -static_cast<LONGLONG>(ns / 100); // Relative, 100 ns units
+            if (SetWaitableTimer(m_timer, &due, 0, nullptr, nullptr, FALSE)) {
+                WaitForSingleObject(m_timer, INFINITE);
+                return;
+            }
+        }
+#endif
+        std::this_thread::sleep_for(std::chrono::nanoseconds(ns));
+    }
+
+#ifdef _WIN32
+    HANDLE m_timer = nullptr;
+    uint64_t m_spinNs = 2000000;
+#else
+    uint64_t m_spinNs = 200000; // nanosleep is good to ~60 us here
+#endif
+};
+
+// Simulated time: SleepUntil() returns immediately after moving the clock
+class VirtualClock : public ReplayClock
+{
+public:
+    uint64_t NowNs() override { return m_now; }
+    void SleepUntil(uint64_t deadlineNs) override { m_now = std::max(m_now, deadlineNs); }
+    void Advance(uint64_t ns) { m_now += ns; }
+
+private:
+    uint64_t m_now = 0;
+};
+
+struct ReplayStats
+{
+    size_t events = 0;
+    size_t sinkCalls = 0;
+    uint64_t durationNs = 0; // First event out to last event out (lead delay excluded)
+    uint64_t lateP50Ns = 0; // How far behind schedule events went out
+    uint64_t lateP99Ns = 0;
+    uint64_t lateMaxNs = 0;
+};
+
+// -----------------------------------------------------------------------------
+// The scheduler itself - no OS calls beyond waiting
+// -----------------------------------------------------------------------------
+class ReplayScheduler
+{
+public:
+    // clock may be null: a PreciseWaiter is used
+    explicit ReplayScheduler(const ReplayOptions& options, ReplayClock* clock = nullptr)
+        : m_options(options), m_clock(clock ? clock : &m_waiter)
+    {
+    }
+    const ReplayOptions& Options() const { return m_options; }
+
+    // Between runs only (e.g. a per-game profile picked when a pause starts)
+    void SetOptions(const ReplayOptions& options) { m_options = options; }
+
+    void Lead() { m_clock->SleepFor(static_cast<uint64_t>(std::max(0, m_options.leadDelayMs)) * 1000000ULL); }
+
+    // Replays events[0..count) into sink. Events are read in place, never copied.
+    ReplayStats Run(const KeyEvent* events, size_t count, InputSink& sink)
+    {
+        ReplayStats stats;
+        if (count == 0) return stats;
+        TraceSpan span("replay run", "events", count);
+        std::vector<uint64_t> late;
+        late.reserve(count);
+        uint64_t start = m_clock->NowNs();
+        uint64_t due = start;
+        std::mt19937 gen(std::random_device{}());
+        std::uniform_int_distribution<> jitter(m_options.jitterMinMs, std::max(m_options.jitterMinMs, m_options.jitterMaxMs));
+        size_t step = m_options.policy == ReplayPolicy::Batched && m_options.minGapMs <= 0 ? std::max<size_t>(1, m_options.batchSize) : 1;
+        for (size_t i = 0; i < count; i += step) {
+            if (i > 0) due += GapNs(events, i, gen, jitter);
+            {
+                TraceSpan wait("replay sleep");
+                m_clock->SleepUntil(due);
+            }
+            uint64_t sent = m_clock->NowNs();
+            size_t n = std::min(step, count - i);
+            Send(events + i, n, sink);
+            ++stats.sinkCalls;
+            late.push_back(sent - due);
+        }
+        stats.events = count;
+        stats.durationNs = m_clock->NowNs() - start;
+        std::sort(late.begin(), late.end());
+        stats.lateP50Ns = late[late.size() / 2];
+        stats.lateP99Ns = late[std::min(late.size() - 1, late.size() * 99 / 100)];
+        stats.lateMaxNs = late.back();
+        return stats;
+    }
+
+private:
+    // Folded autorepeat goes out as the key-downs it stands for, in one call - or
+    // MinGapMs apart when the target can't take a burst
+    void Send(const KeyEvent* events, size_t n, InputSink& sink)
+    {
+        TraceSpan span("inject", "events", n);
+        bool folded = false;
+        for (size_t k = 0; k < n && !folded; ++k) folded = (events[k].extra & KEY_EXTRA_KIND) == KEY_EXTRA_REPEAT;
+        if (!folded) {
+            sink.Send(events, n);
+            return;
+        }
+        if (m_options.minGapMs > 0) {
+            for (size_t k = 0; k < n; ++k) {
+                KeyEvent ev = events[k];
+                size_t downs = KeyDownCount(ev);
+                if ((ev.extra & KEY_EXTRA_KIND) == KEY_EXTRA_REPEAT) ev.extra = 0;
+                for (size_t d = 0; d < downs; ++d) {
+                    if (k || d) m_clock->SleepFor(static_cast<uint64_t>(m_options.minGapMs) * 1000000ULL);
+                    sink.Send(&ev, 1);
+                }
+            }
+            return;
+        }
+        m_expanded.clear();
+        for (size_t k = 0; k < n; ++k) {
+            KeyEvent ev = events[k];
+            size_t downs = KeyDownCount(ev);
+            if ((ev.extra & KEY_EXTRA_KIND) == KEY_EXTRA_REPEAT) ev.extra = 0;
+            m_expanded.insert(m_expanded.end(), downs, ev);
+        }
+        sink.Send(m_expanded.data(), m_expanded.size());
+    }
+
+    // Scheduled gap before events[i]
+    uint64_t GapNs(const KeyEvent* events, size_t i, std::mt19937& gen, std::uniform_int_distribution<>& jitter) const
+    {
+        return std::max<uint64_t>(PolicyGapNs(events, i, gen, jitter), static_cast<uint64_t>(std::max(0, m_options.minGapMs)) * 1000000ULL);
+    }
+
+    uint64_t PolicyGapNs(const KeyEvent* events, size_t i, std::mt19937& gen, std::uniform_int_distribution<>& jitter) const
+    {
+        switch (m_options.policy) {
+        case ReplayPolicy::Faithful:
+        case ReplayPolicy::Speed: {
+            uint64_t captured = events[i].timeNs > events[i - 1].timeNs ? events[i].timeNs - events[i - 1].timeNs : 0;
+            if (m_options.maxGapMs > 0)
+                captured = std::min<uint64_t>(captured, static_cast<uint64_t>(m_options.maxGapMs) * 1000000ULL);
+            double speed = m_options.policy == ReplayPolicy::Speed && m_options.speed > 0 ? m_options.speed : 1.0;
+            return static_cast<uint64_t>(captured / speed);
+        }
+        case ReplayPolicy::Batched:
+            return static_cast<uint64_t>(std::max(0, m_options.batchGapMs)) * 1000000ULL;
+        default:
+            return static_cast<uint64_t>(jitter(gen)) * 1000000ULL;
+        }
+    }
+
+    ReplayOptions m_options;
+    PreciseWaiter m_waiter;
+    ReplayClock* m_clock;
+    std::vector<KeyEvent> m_expanded; // Scratch for folded autorepeat
+};
+
+// -----------------------------------------------------------------------------
+// Mock sink: records what arrived and when (benchmarks, headless runs)
+// -----------------------------------------------------------------------------
+class RecordingSink : public InputSink
+{
+public:
+    struct Arrival { uint64_t timeNs; KeyEvent event; };
+    explicit RecordingSink(ReplayClock* clock = nullptr) : m_clock(clock) {}
+    void Send(const KeyEvent* events, size_t count) override
+    {
+        uint64_t now = m_clock ? m_clock->NowNs() : MonotonicNs();
+        for (size_t i = 0; i < count; ++i) m_arrivals.push_back({ now, events[i] });
+    }
+    const std::vector<Arrival>& Arrivals() const { return m_arrivals; }
+    void Clear() { m_arrivals.clear(); }
+
+private:
+    ReplayClock* m_clock;
+    std::vector<Arrival> m_arrivals;
+};
@@ -0,0 +1,296 @@
+// =============================================================================
+// ResumeStrategy.h - How a paused target is woken back up
+//
+// Resuming every thread at once makes audio, streaming and worker threads all
+// catch up at the same moment, and the first second after resume stutters.
+// Per process, a resume can:
+//   - give a few lead threads (main thread, or busiest by CPU time at pause)
+//     a head start before the rest wake (ResumePlan)
+//   - warm up: raise priority of the process and its lead threads, optionally
+//     pin them to the core they last ran on, and restore it all afterwards
+//   - report when the target is running again (it has burned CPU since the
+//     thaw), so replay needn't guess with a fixed sleep
+// Windows suspends per thread, so the head start is exact. Linux stops the
+// thread group as a whole; the other threads are parked at SCHED_IDLE instead.
+// Undoing a Linux priority change on another user's process needs CAP_SYS_NICE.
+// =============================================================================
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "ProcessTree.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+enum class ResumeOrder { Reverse, MainFirst, Busiest };
+
+static inline ResumeOrder ResumeOrderFromString(const std::string& str)
+{
+    std::string s = ToLowerAscii(str);
+    if (s == "main-first") return ResumeOrder::MainFirst;
+    if (s == "busiest") return ResumeOrder::Busiest;
+    return ResumeOrder::Reverse;
+}
+
+static inline const char* ResumeOrderName(ResumeOrder o)
+{
+    switch (o) {
+    case ResumeOrder::MainFirst: return "main-first";
+    case ResumeOrder::Busiest: return "busiest";
+    default: return "reverse";
+    }
+}
+
+struct ResumeOptions
+{
+    ResumeOrder order = ResumeOrder::Reverse; // Reverse = everything at once, last frozen first
+    size_t leadThreads = 1; // How many threads get the head start
+    int staggerMs = 0; // How long they run alone
+    int warmupMs = 0; // Priority boost window after resume, 0 = off
+    bool warmupPin = false; // Also pin lead threads to the core they last ran on
+    bool leadOnRunning = false; // Start replay once the target runs, LeadDelayMs at most
+
+    bool Staged() const { return order != ResumeOrder::Reverse && leadThreads > 0; }
+};
+
+// Threshold for "running again": CPU the target burns after the thaw
+const int64_t RESUME_RUNNING_CPU_NS = 2000000;
+
+struct ThreadCpu
+{
+    uint32_t tid;
+    uint64_t cpuNs;
+    bool main; // The process's first thread
+};
+
+#ifndef _WIN32
+// Field `index` (1-based, as in proc(5)) of /proc/<pid>/task/<tid>/stat
+static inline bool ReadTaskStatField(uint32_t pid, uint32_t tid, int index, unsigned long long& value)
+{
+    char path[64];
+    std::snprintf(path, sizeof(path), "/proc/%u/task/%u/stat", pid, tid);
+    FILE* f = std::fopen(path, "r");
+    if (!f) return false;
+    char buf[1024];
+    size_t n = std::fread(buf, 1, sizeof(buf) - 1, f);
+    std::fclose(f);
+    buf[n] = 0;
+    const char* p = std::strrchr(buf, ')');
+    if (!p) return false;
+    for (int field = 2; *p && field < index; ++p) {
+        if (*p == ' ') ++field;
+    }
+    return std::sscanf(p, "%llu", &value) == 1;
+}
+#endif
+
+// CPU time (user + kernel) a thread has used; 0 if it's gone
+static inline uint64_t ThreadCpuNs(uint32_t pid, uint32_t tid)
+{
+#ifdef _WIN32
+    (void)pid;
+    HANDLE h = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, tid);
+    if (!h) return 0;
+    FILETIME created, exited, kernel, user;
+    uint64_t ns = 0;
+    if (GetThreadTimes(h, &created, &exited, &kernel, &user)) {
+        ns = ((static_cast<uint64_t>(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime)
+            + ((static_cast<uint64_t>(user.dwHighDateTime) << 32) | user.dwLowDateTime);
+        ns *= 100;
+    }
+    CloseHandle(h);
+    return ns;
+#else
+    // schedstat is in nanoseconds; stat's utime/stime only in clock ticks
+    char path[64];
+    std::snprintf(path, sizeof(path), "/proc/%u/task/%u/schedstat", pid, tid);
+    FILE* f = std::fopen(path, "r");
+    unsigned long long ns = 0;
+    if (f) {
+        int n = std::fscanf(f, "%llu", &ns);
+        std::fclose(f);
+        if (n == 1) return ns;
+    }
+    unsigned long long utime = 0, stime = 0;
+    if (!ReadTaskStatField(pid, tid, 14, utime) || !ReadTaskStatField(pid, tid, 15, stime)) return 0;
+    return (utime + stime) * 1000000000ULL / static_cast<uint64_t>(sysconf(_SC_CLK_TCK));
+#endif
+}
+
+// CPU time of the whole process
+static inline uint64_t ProcessCpuNs(uint32_t pid)
+{
+#ifdef _WIN32
+    HANDLE h = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (!h) return 0;
+    FILETIME created, exited, kernel, user;
+    uint64_t ns = 0;
+    if (GetProcessTimes(h, &created, &exited, &kernel, &user)) {
+        ns = ((static_cast<uint64_t>(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime)
+            + ((static_cast<uint64_t>(user.dwHighDateTime) << 32) | user.dwLowDateTime);
+        ns *= 100;
+    }
+    CloseHandle(h);
+    return ns;
+#else
+    uint64_t ns = 0;
+    for (uint32_t tid : ListProcTasks(pid)) ns += ThreadCpuNs(pid, tid);
+    return ns;
+#endif
+}
+
+static inline std::vector<ThreadCpu> SampleThreadCpu(uint32_t pid, const std::vector<uint32_t>& tids)
+{
+    std::vector<ThreadCpu> out;
+#ifdef _WIN32
+    (void)pid; // Thread ids are system-wide
+    // Main thread = the earliest created
+    uint64_t earliest = UINT64_MAX;
+    size_t mainIndex = 0;
+    for (uint32_t tid : tids) {
+        HANDLE h = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, tid);
+        if (!h) continue;
+        FILETIME created, exited, kernel, user;
+        if (GetThreadTimes(h, &created, &exited, &kernel, &user)) {
+            uint64_t c = (static_cast<uint64_t>(created.dwHighDateTime) << 32) | created.dwLowDateTime;
+            uint64_t ns = (((static_cast<uint64_t>(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime)
+                + ((static_cast<uint64_t>(user.dwHighDateTime) << 32) | user.dwLowDateTime)) * 100;
+            if (c < earliest) {
+                earliest = c;
+                mainIndex = out.size();
+            }
+            out.push_back({ tid, ns, false });
+        }
+        CloseHandle(h);
+    }
+    if (!out.empty()) out[mainIndex].main = true;
+#else
+    for (uint32_t tid : tids) out.push_back({ tid, ThreadCpuNs(pid, tid), tid == pid });
+#endif
+    return out;
+}
+
+// Which threads of a (frozen) process get the head start, in wake order
+static inline ResumePlan PlanResume(uint32_t pid, const std::vector<uint32_t>& tids, const ResumeOptions& opt)
+{
+    ResumePlan plan;
+    if (!opt.Staged()) return plan;
+    std::vector<ThreadCpu> threads = SampleThreadCpu(pid, tids);
+    // Busiest = most CPU time used up to the pause; the main thread jumps the queue for MainFirst
+    bool mainFirst = opt.order == ResumeOrder::MainFirst;
+    std::stable_sort(threads.begin(), threads.end(), [mainFirst](const ThreadCpu& a, const ThreadCpu& b) {
+        if (mainFirst && a.main != b.main) return a.main;
+        return a.cpuNs > b.cpuNs;
+    });
+    for (size_t i = 0; i < threads.size() && i < opt.leadThreads; ++i) plan.first.push_back(threads[i].tid);
+    plan.staggerNs = static_cast<int64_t>(std::max(0, opt.staggerMs)) * 1000000LL;
+    return plan;
+}
+
+// -----------------------------------------------------------------------------
+// Temporary priority / affinity boost; Restore() puts back what Apply() found
+// -----------------------------------------------------------------------------
+class WarmupBoost
+{
+public:
+    WarmupBoost() {}
+    ~WarmupBoost() { Restore(); }
+    WarmupBoost(const WarmupBoost&) = delete;
+    WarmupBoost& operator=(const WarmupBoost&) = delete;
+
+    // Returns how many of the lead threads were boosted
+    size_t Apply(uint32_t pid, const std::vector<uint32_t>& leadTids, bool pin)
+    {
+        Restore();
+        m_pid = pid;
+#ifdef _WIN32
+        m_process = OpenProcess(PROCESS_SET_INFORMATION | PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+        if (m_process) {
+            m_class = GetPriorityClass(m_process);
+            if (m_class == NORMAL_PRIORITY_CLASS || m_class == BELOW_NORMAL_PRIORITY_CLASS || m_class == IDLE_PRIORITY_CLASS)
+                SetPriorityClass(m_process, ABOVE_NORMAL_PRIORITY_CLASS);
+            else
+                m_class = 0; // Already high enough - leave it alone
+        }
+        for (uint32_t tid : leadTids) {
+            Saved s = {};
+            s.tid = tid;
+            s.handle = OpenThread(THREAD_SET_INFORMATION | THREAD_QUERY_INFORMATION, FALSE, tid);
+            if (!s.handle) continue;
+            s.priority = GetThreadPriority(s.handle);
+            if (s.priority == THREAD_PRIORITY_ERROR_RETURN || !SetThreadPriority(s.handle, THREAD_PRIORITY_HIGHEST)) {
+                CloseHandle(s.handle);
+                continue;
+            }
+            PROCESSOR_NUMBER pn = {};
+            if (pin && GetThreadIdealProcessorEx(s.handle, &pn) && pn.Group == 0 && pn.Number < 64)
+                s.affinity = SetThreadAffinityMask(s.handle, static_cast<DWORD_PTR>(1) << pn.Number);
+            m_threads.push_back(s);
+        }
+#else
+        for (uint32_t tid : leadTids) {
+            Saved s = {};
+            s.tid = tid;
+            errno = 0;
+            s.nice = getpriority(PRIO_PROCESS, static_cast<id_t>(tid)); // Per thread on Linux
+            if (errno || setpriority(PRIO_PROCESS, static_cast<id_t>(tid), std::max(-20, s.nice - 5)) != 0) continue;
+            unsigned long long cpu = 0;
+            if (pin && sched_getaffinity(static_cast<pid_t>(tid), sizeof(s.affinity), &s.affinity) == 0
+                && ReadTaskStatField(pid, tid, 39, cpu) && cpu < CPU_SETSIZE) {
+                cpu_set_t one;
+                CPU_ZERO(&one);
+                CPU_SET(static_cast<int>(cpu), &one);
+                s.pinned = sched_setaffinity(static_cast<pid_t>(tid), sizeof(one), &one) == 0;
+            }
+            m_threads.push_back(s);
+        }
+#endif
+        return m_threads.size();
+    }
+
+    void Restore()
+    {
+#ifdef _WIN32
+        for (Saved& s : m_threads) {
+            if (s.affinity) SetThreadAffinityMask(s.handle, s.affinity);
+            SetThreadPriority(s.handle, s.priority);
+            CloseHandle(s.handle);
+        }
+        if (m_process) {
+            if (m_class) SetPriorityClass(m_process, m_class);
+            CloseHandle(m_process);
+        }
+        m_process = nullptr;
+        m_class = 0;
+#else
+        for (Saved& s : m_threads) {
+            if (s.pinned) sched_setaffinity(static_cast<pid_t>(s.tid), sizeof(s.affinity), &s.affinity);
+            setpriority(PRIO_PROCESS, static_cast<id_t>(s.tid), s.nice);
+        }
+#endif
+        m_threads.clear();
+        m_pid = 0;
+    }
+
+    uint32_t Pid() const { return m_pid; }
+
+private:
+#ifdef _WIN32
+    struct Saved { uint32_t tid; HANDLE handle; int priority; DWORD_PTR affinity; };
+    HANDLE m_process = nullptr;
+    DWORD m_class = 0;
+#else
+    struct Saved { uint32_t tid; int nice; cpu_set_t affinity; bool pinned; };
+#endif
+    uint32_t m_pid = 0;
+    std::vector<Saved> m_threads;
+};
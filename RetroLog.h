@@ -0,0 +1,261 @@
+// =============================================================================
+// RetroLog.h - Asynchronous retro logger for GamePauser
+//
+// Hot paths (the keyboard hook, suspend/resume) must never block on console
+// I/O. Callers push fixed-size records into a preallocated lock-free ring;
+// a background drain thread does the timestamp formatting, amber colouring,
+// teletype borders and the old-CRT "flicker" pause.
+//
+// Portable: Win32 console attributes on Windows, ANSI colour elsewhere.
+// =============================================================================
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// -----------------------------------------------------------------------------
+// One log line as it sits in the ring. Fixed size, no heap, no pointers.
+// -----------------------------------------------------------------------------
+struct LogRecord
+{
+    std::atomic<uint64_t> seq; // Vyukov cell sequence number
+    int64_t wallNs; // system_clock time at push, nanoseconds since epoch
+    uint16_t len;
+    bool retro; // Style captured at push time (config may change before drain)
+    char text[237];
+};
+
+// -----------------------------------------------------------------------------
+// Bounded multi-producer / single-consumer ring (Vyukov-style sequence cells).
+// Push never blocks and never allocates: when the ring is full the record is
+// dropped and counted, which is the right trade for a hook callback.
+// -----------------------------------------------------------------------------
+class AsyncLogger
+{
+public:
+    static const size_t CAPACITY = 1024; // Must be a power of two
+    static const size_t MAX_TEXT = sizeof(LogRecord::text);
+
+    AsyncLogger()
+    {
+        for (size_t i = 0; i < CAPACITY; ++i)
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+    ~AsyncLogger() { Stop(); }
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    // Start the drain thread. Records pushed before Start() are kept.
+    void Start()
+    {
+        std::lock_guard<std::mutex> lock(m_consumerMutex);
+        if (m_drainerAlive) return;
+        m_drainerAlive = true;
+        m_running.store(true);
+        m_drainer = std::thread([this] { DrainLoop(); });
+    }
+
+    // Drain what is queued, then stop the drain thread.
+    void Stop()
+    {
+        std::lock_guard<std::mutex> lock(m_consumerMutex);
+        if (!m_drainerAlive) return;
+        m_running.store(false);
+        if (m_drainer.joinable()) m_drainer.join();
+        m_drainerAlive = false;
+        DrainAvailable(); // Anything pushed while we were shutting down; the drain thread is gone
+    }
+
+    // Block until everything pushed so far has been written (or timeout).
+    void Flush(std::chrono::milliseconds timeout = std::chrono::milliseconds(2000))
+    {
+        uint64_t target = m_enqueuePos.load(std::memory_order_acquire);
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (m_written.load(std::memory_order_acquire) < target) {
+            if (!m_running.load()) {
+                // Either never started (drain here, as the only consumer) or mid-Stop
+                // (the lock waits for the join and the final drain)
+                std::lock_guard<std::mutex> lock(m_consumerMutex);
+                if (!m_drainerAlive) { DrainAvailable(); return; }
+            }
+            if (std::chrono::steady_clock::now() > deadline) return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    void SetRetro(bool retro) { m_retro.store(retro, std::memory_order_relaxed); }
+    bool Retro() const { return m_retro.load(std::memory_order_relaxed); }
+    // Retro "flicker" between lines - cosmetic, paid by the drain thread only
+    void SetFlicker(std::chrono::milliseconds ms) { m_flickerMs.store(static_cast<int>(ms.count())); }
+    // Benchmarks swap stdout for a no-op so only the producer side is measured
+    void SetSilent(bool silent) { m_silent.store(silent); }
+
+    uint64_t Dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+    uint64_t Written() const { return m_written.load(std::memory_order_relaxed); }
+
+    // Producer side: copy the text into a free cell. Lock-free, O(len).
+    bool Push(const char* msg, size_t len)
+    {
+        LogRecord* cell = Claim();
+        if (!cell) return false;
+        if (len > MAX_TEXT) len = MAX_TEXT;
+        std::memcpy(cell->text, msg, len);
+        cell->len = static_cast<uint16_t>(len);
+        Publish(cell);
+        return true;
+    }
+    bool Push(const std::string& msg) { return Push(msg.data(), msg.size()); }
+
+    // Producer side: printf-style formatting straight into the cell
+    bool PushV(const char* fmt, va_list args)
+    {
+        LogRecord* cell = Claim();
+        if (!cell) return false;
+        int n = std::vsnprintf(cell->text, MAX_TEXT, fmt, args);
+        if (n < 0) n = 0;
+        cell->len = static_cast<uint16_t>(n < static_cast<int>(MAX_TEXT) ? n : MAX_TEXT - 1);
+        Publish(cell);
+        return true;
+    }
+    bool PushF(const char* fmt, ...)
+    {
+        va_list args;
+        va_start(args, fmt);
+        bool pushed = PushV(fmt, args);
+        va_end(args);
+        return pushed;
+    }
+
+private:
+    LogRecord* Claim()
+    {
+        uint64_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            LogRecord& cell = m_cells[pos & (CAPACITY - 1)];
+            uint64_t seq = cell.seq.load(std::memory_order_acquire);
+            int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+            if (diff == 0) {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.wallNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count();
+                    cell.retro = m_retro.load(std::memory_order_relaxed);
+                    return &cell;
+                }
+            }
+            else if (diff < 0) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed); // Ring full - never block
+                return nullptr;
+            }
+            else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void Publish(LogRecord* cell)
+    {
+        // A claimed cell still carries seq == its ring position; +1 hands it to the drainer
+        uint64_t pos = cell->seq.load(std::memory_order_relaxed);
+        cell->seq.store(pos + 1, std::memory_order_release);
+    }
+
+    // Consumer side. Returns number of records written.
+    size_t DrainAvailable()
+    {
+        size_t n = 0;
+        for (;;) {
+            LogRecord& cell = m_cells[m_dequeuePos & (CAPACITY - 1)];
+            uint64_t seq = cell.seq.load(std::memory_order_acquire);
+            if (seq != m_dequeuePos + 1) break;
+            Write(cell);
+            cell.seq.store(m_dequeuePos + CAPACITY, std::memory_order_release);
+            ++m_dequeuePos;
+            m_written.fetch_add(1, std::memory_order_release);
+            ++n;
+        }
+        return n;
+    }
+
+    void DrainLoop()
+    {
+        while (m_running.load(std::memory_order_acquire)) {
+            if (DrainAvailable() == 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+
+    void Write(const LogRecord& rec)
+    {
+        if (m_silent.load(std::memory_order_relaxed)) return;
+        if (!rec.retro) {
+            std::cout.write(rec.text, rec.len);
+            std::cout << "\n" << std::flush;
+            return;
+        }
+        char stamp[32];
+        FormatStamp(rec.wallNs, stamp, sizeof(stamp));
+        size_t width = std::strlen(stamp) + rec.len + 4;
+        std::string border(width, '-'); // Simple underline for that teletype feel
+        SetAmber(true);
+        std::cout << border << "\n| " << stamp;
+        std::cout.write(rec.text, rec.len);
+        std::cout << " |\n" << border << "\n";
+        SetAmber(false);
+        std::cout << std::flush; // Ensure it draws immediately, like a slow terminal
+        int flicker = m_flickerMs.load(std::memory_order_relaxed);
+        if (flicker > 0) // Subtle "flicker" pause - old CRTs weren't instant
+            std::this_thread::sleep_for(std::chrono::milliseconds(flicker));
+    }
+
+    static void FormatStamp(int64_t wallNs, char* out, size_t cap)
+    {
+        std::time_t secs = static_cast<std::time_t>(wallNs / 1000000000);
+        int ms = static_cast<int>((wallNs / 1000000) % 1000);
+        std::tm timeinfo;
+#ifdef _WIN32
+        bool ok = localtime_s(&timeinfo, &secs) == 0;
+#else
+        bool ok = localtime_r(&secs, &timeinfo) != nullptr;
+#endif
+        if (ok)
+            std::snprintf(out, cap, "[%02d:%02d:%02d.%03d] ", timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec, ms);
+        else // Fallback: basic time without local formatting (rare, but safe)
+            std::snprintf(out, cap, "[%lld.%d] ", static_cast<long long>(secs), ms);
+    }
+
+    static void SetAmber(bool on)
+    {
+#ifdef _WIN32
+        static HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+        SetConsoleTextAttribute(console, on ? 14 : 7); // Bright yellow/orange phosphor glow
+#else
+        std::cout << (on ? "\x1b[93m" : "\x1b[0m");
+#endif
+    }
+
+    LogRecord m_cells[CAPACITY];
+    alignas(64) std::atomic<uint64_t> m_enqueuePos{ 0 };
+    alignas(64) uint64_t m_dequeuePos = 0;
+    std::atomic<uint64_t> m_written{ 0 };
+    std::atomic<uint64_t> m_dropped{ 0 };
+    std::atomic<bool> m_running{ false }; // Tells the drain thread to keep going
+    std::atomic<bool> m_retro{ true };
+    std::atomic<bool> m_silent{ false };
+    std::atomic<int> m_flickerMs{ 50 };
+    std::thread m_drainer;
+    // The ring has one consumer: the drain thread while it is alive, otherwise
+    // whoever holds this (Stop's final drain, Flush before Start)
+    std::mutex m_consumerMutex;
+    bool m_drainerAlive = false;
+};
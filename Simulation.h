@@ -0,0 +1,253 @@
+// =============================================================================
+// Simulation.h - Headless harness for the pause / capture / replay pipeline
+//
+// Drives synthetic keystroke traces through the real PauseController with
+// fake backends: a hook that only counts, a freezer that freezes nothing, a
+// recording sink and a virtual clock (so a 30 s faithful replay takes
+// microseconds). No desktop, no game, no Win32 - runs on plain Linux.
+// SlowPoller stands in for a game that polls the keyboard once per frame,
+// for replay-rate calibration.
+//
+// Reports per session:
+//   hook latency   - OnKey() cost per event, p50/p99/max (the hook callback)
+//   capture        - events/s from the first OnKey() until the consumer has
+//                    drained everything into the replay queue
+//   replay         - simulated duration under the configured policy, plus
+//                    the real CPU time the replay took
+// =============================================================================
+#pragma once
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "PauseController.h"
+#include "ReplayCalibrator.h"
+
+static inline int64_t SimNowNs() { return static_cast<int64_t>(MonotonicNs()); }
+
+// -----------------------------------------------------------------------------
+// Fake backends
+// -----------------------------------------------------------------------------
+class SimKeyboardHook : public KeyboardHook
+{
+public:
+    bool Install() override { ++installs; installed = true; return true; }
+    void Remove() override { installed = false; }
+    int installs = 0;
+    bool installed = false;
+};
+
+class SimFreezer : public PauseFreezer
+{
+public:
+    std::vector<MemberResult> Freeze(uint32_t pid) override
+    {
+        ++freezes;
+        m_pid = pid;
+        return { { pid, "sim-target", { true, 8, 1, 0, false, {} } } };
+    }
+    std::vector<MemberResult> Thaw() override
+    {
+        if (!m_pid) return {};
+        ++thaws;
+        std::vector<MemberResult> r = { { m_pid, "sim-target", { true, 8, 1, 0, false, {} } } };
+        m_pid = 0;
+        return r;
+    }
+    int freezes = 0, thaws = 0;
+
+private:
+    uint32_t m_pid = 0;
+};
+
+// A game that reads the keyboard once per frame instead of taking events: a
+// key counts as pressed when a poll finds it down and the previous poll didn't,
+// so a tap that fits between two polls is lost. Polls are evaluated lazily
+// against the clock, which makes it exact on a VirtualClock and good to the
+// clock's precision in real time.
+class SlowPoller : public CalibrationTarget
+{
+public:
+    // frameMs: poll interval; jitterMs: each poll lands up to this much late
+    SlowPoller(ReplayClock* clock, double frameMs, double jitterMs = 0, uint32_t seed = 1)
+        : m_clock(clock), m_frameNs(static_cast<uint64_t>(frameMs * 1e6)),
+          m_jitterNs(static_cast<uint64_t>(std::min(jitterMs, frameMs * 0.9) * 1e6)), m_gen(seed)
+    {
+        m_frame = m_clock->NowNs() / m_frameNs;
+        m_nextPoll = NextPoll();
+    }
+    void Send(const KeyEvent* events, size_t count) override
+    {
+        PollUntil(m_clock->NowNs());
+        for (size_t i = 0; i < count; ++i)
+            if (!(events[i].flags & KEY_UNICODE) && events[i].vk < 256) m_down[events[i].vk] = !(events[i].flags & KEY_UP);
+    }
+    void Reset() override
+    {
+        PollUntil(m_clock->NowNs());
+        m_seen.clear();
+    }
+    std::string Received() override
+    {
+        PollUntil(m_clock->NowNs());
+        return m_seen;
+    }
+    uint64_t Polls() const { return m_polls; }
+
+private:
+    uint64_t NextPoll()
+    {
+        ++m_frame;
+        return m_frame * m_frameNs + (m_jitterNs ? m_gen() % m_jitterNs : 0);
+    }
+    void PollUntil(uint64_t now)
+    {
+        while (m_nextPoll <= now) {
+            for (int vk = 0; vk < 256; ++vk) {
+                if (m_down[vk] && !m_polled[vk] && vk >= 'A' && vk <= 'Z') m_seen.push_back(static_cast<char>(vk));
+                m_polled[vk] = m_down[vk];
+            }
+            ++m_polls;
+            m_nextPoll = NextPoll();
+        }
+    }
+
+    ReplayClock* m_clock;
+    uint64_t m_frameNs, m_jitterNs;
+    std::mt19937 m_gen;
+    uint64_t m_frame = 0, m_nextPoll = 0, m_polls = 0;
+    bool m_down[256] = {}; // What the keyboard says now
+    bool m_polled[256] = {}; // What the last poll saw
+    std::string m_seen;
+};
+
+// -----------------------------------------------------------------------------
+// Synthetic traces (timestamps are capture times; the harness feeds them
+// back-to-back, which is the worst case for the hook and the ring)
+// -----------------------------------------------------------------------------
+// Words of 3-8 letters, 60-140 ms between keys, ~350 ms between words
+static inline std::vector<KeyEvent> SimTypingBursts(size_t events, uint32_t seed = 1)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<> letter(0, 25), wordLen(3, 8), keyGap(60, 140), wordGap(250, 450);
+    std::vector<KeyEvent> trace;
+    uint64_t t = 0;
+    while (trace.size() + 1 < events) {
+        int len = wordLen(gen);
+        for (int i = 0; i < len && trace.size() + 1 < events; ++i) {
+            uint16_t vk = static_cast<uint16_t>('A' + letter(gen));
+            trace.push_back({ t, vk, static_cast<uint16_t>(vk - 'A' + 0x10), 0, 0 });
+            t += 30000000;
+            trace.push_back({ t, vk, static_cast<uint16_t>(vk - 'A' + 0x10), KEY_UP, 0 });
+            t += static_cast<uint64_t>(keyGap(gen)) * 1000000ULL;
+        }
+        t += static_cast<uint64_t>(wordGap(gen)) * 1000000ULL;
+    }
+    return trace;
+}
+
+// Keys held down long enough to autorepeat: 500 ms delay, then a down every 33 ms
+static inline std::vector<KeyEvent> SimAutorepeatStorm(size_t events)
+{
+    std::vector<KeyEvent> trace;
+    uint64_t t = 0;
+    const uint16_t keys[] = { 'W', 'A', 'S', 'D', 0x25, 0x26, 0x27, 0x28 }; // Arrows are extended
+    for (size_t k = 0; trace.size() < events; ++k) {
+        uint16_t vk = keys[k % 8];
+        uint16_t ext = vk >= 0x25 && vk <= 0x28 ? KEY_EXTENDED : 0;
+        trace.push_back({ t, vk, 0, ext, 0 });
+        t += 500000000;
+        for (int r = 0; r < 60 && trace.size() + 1 < events; ++r) {
+            trace.push_back({ t, vk, 0, ext, 0 });
+            t += 33000000;
+        }
+        trace.push_back({ t, vk, 0, static_cast<uint16_t>(ext | KEY_UP), 0 });
+        t += 100000000;
+    }
+    return trace;
+}
+
+// -----------------------------------------------------------------------------
+// One simulated session: pause, type the trace, accept with Enter
+// -----------------------------------------------------------------------------
+struct SimulationResult
+{
+    std::string name;
+    size_t events = 0;
+    size_t replayed = 0; // Events that reached the sink (trace + held-key presses)
+    std::vector<int64_t> idleNs; // OnKey while not paused (pass-through path)
+    std::vector<int64_t> captureNs; // OnKey while paused (ring push path)
+    int64_t captureWallNs = 0; // First OnKey to fully drained
+    int64_t acceptNs = 0; // Enter: unhook + thaw + replay, real time
+    ReplayStats replay; // Virtual-clock durations
+    uint64_t spilled = 0;
+    bool ok = false; // Every captured event came out, in order
+    std::vector<RecordingSink::Arrival> arrivals; // What the sink got, on the virtual clock
+};
+
+// profiles: per-game overrides; the simulated target's image is "sim-target"
+static inline SimulationResult RunSimulation(const char* name, const std::vector<KeyEvent>& trace, const ReplayOptions& replay,
+    size_t ringCapacity = 4096, PauseMetrics* metrics = nullptr, const ReplayProfiles* profiles = nullptr)
+{
+    SimulationResult res;
+    res.name = name;
+    res.events = trace.size();
+    VirtualClock clock;
+    RecordingSink sink(&clock);
+    SimKeyboardHook hook;
+    SimFreezer freezer;
+    PauseBackends b;
+    b.hook = &hook;
+    b.freezer = &freezer;
+    b.sink = &sink;
+    b.clock = &clock;
+    b.metrics = metrics;
+    b.selfPid = 1;
+    PauseConfig cfg;
+    cfg.ringCapacity = ringCapacity;
+    cfg.replay = replay;
+    if (profiles) cfg.profiles = *profiles;
+    PauseController controller(b, cfg);
+    controller.Start();
+
+    // Not paused: every key is passed straight on
+    res.idleNs.reserve(trace.size());
+    for (const KeyEvent& ev : trace) {
+        int64_t t0 = SimNowNs();
+        controller.OnKey(ev, 0);
+        res.idleNs.push_back(SimNowNs() - t0);
+    }
+
+    controller.OnHotkey(4242);
+    sink.Clear(); // Pre-pause releases aren't part of the replay
+    res.captureNs.reserve(trace.size());
+    int64_t start = SimNowNs();
+    for (const KeyEvent& ev : trace) {
+        int64_t t0 = SimNowNs();
+        controller.OnKey(ev, 0);
+        res.captureNs.push_back(SimNowNs() - t0);
+    }
+    controller.DrainCaptured(); // Don't wait out the consumer's poll interval
+    while (controller.CapturedCount() < trace.size() && SimNowNs() - start < 5000000000LL)
+        std::this_thread::yield();
+    res.captureWallNs = SimNowNs() - start;
+    res.spilled = controller.Ring().Spilled();
+
+    KeyEvent enter = { MonotonicNs(), KEYCODE_RETURN, 0x1C, 0, 0 };
+    int64_t t0 = SimNowNs();
+    controller.OnKey(enter, 0);
+    res.acceptNs = SimNowNs() - t0;
+    res.replay = controller.LastReplay();
+    controller.Stop();
+
+    // Held keys are pressed first, then the trace in capture order
+    const std::vector<RecordingSink::Arrival>& out = sink.Arrivals();
+    res.arrivals = out;
+    res.replayed = out.size();
+    size_t heldPresses = out.size() >= trace.size() ? out.size() - trace.size() : 0;
+    res.ok = !controller.Paused() && !hook.installed && freezer.thaws == 1 && out.size() >= trace.size();
+    for (size_t i = 0; res.ok && i < trace.size(); ++i)
+        res.ok = out[heldPresses + i].event.vk == trace[i].vk && out[heldPresses + i].event.flags == trace[i].flags;
+    return res;
+}
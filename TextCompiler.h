@@ -0,0 +1,322 @@
+// =============================================================================
+// TextCompiler.h - Text -> key-event program, for pasting into a paused game
+//
+// Typing a paragraph during a pause means capturing it key by key and then
+// replaying it at the replay policy's pace (~30 ms per event with jitter).
+// Instead, text from the clipboard or a file is compiled once into the same
+// KeyEvents the hook captures:
+//   - each character maps to a virtual key + modifiers on the target's
+//     layout (KeyLayout: the built-in US table, or the live one on Windows)
+//   - modifiers change only when the next character needs a different set,
+//     so a run of capitals or symbols shares one Shift press
+//   - characters the layout can't type directly (missing, dead keys) are
+//     injected as UTF-16 code units (KEY_UNICODE)
+//   - event times are spaced for a target rate in characters per second;
+//     the Faithful replay policy then plays the program at exactly that rate
+// Everything is pure except KeyLayoutFromSystem() at the bottom (Windows).
+// =============================================================================
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "KeyRing.h"
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// LayoutKey modifier bits (the same as VkKeyScanEx's shift state)
+const uint8_t LAYOUT_SHIFT = 0x01;
+const uint8_t LAYOUT_CTRL = 0x02;
+const uint8_t LAYOUT_ALT = 0x04; // Ctrl+Alt together is AltGr
+
+// KeyEvent::extra tag: compiled text, paced by its own event times
+const uint16_t KEY_EXTRA_PASTE = 0x0001;
+
+struct LayoutKey
+{
+    uint16_t vk = 0; // 0 = not typeable
+    uint16_t scan = 0;
+    uint8_t mods = 0;
+};
+
+class KeyLayout
+{
+public:
+    void Set(char32_t ch, uint16_t vk, uint16_t scan, uint8_t mods)
+    {
+        LayoutKey k;
+        k.vk = vk;
+        k.scan = scan;
+        k.mods = mods;
+        if (ch < 128) m_ascii[ch] = k;
+        else m_other[ch] = k;
+    }
+
+    // Null if the layout has no key for ch
+    const LayoutKey* Find(char32_t ch) const
+    {
+        if (ch < 128) return m_ascii[ch].vk ? &m_ascii[ch] : nullptr;
+        auto it = m_other.find(ch);
+        return it == m_other.end() ? nullptr : &it->second;
+    }
+
+private:
+    LayoutKey m_ascii[128];
+    std::unordered_map<char32_t, LayoutKey> m_other;
+};
+
+// US QWERTY: printable ASCII with set-1 scan codes
+static inline KeyLayout UsKeyLayout()
+{
+    struct Row { const char* plain; const char* shifted; uint16_t scan; };
+    // Keys with a letter VK get it from the plain character; the rest are OEM keys
+    static const Row rows[] = {
+        { "1234567890", "!@#$%^&*()", 0x02 },
+        { "qwertyuiop", "QWERTYUIOP", 0x10 },
+        { "asdfghjkl", "ASDFGHJKL", 0x1E },
+        { "zxcvbnm", "ZXCVBNM", 0x2C },
+    };
+    struct Oem { char plain, shifted; uint16_t vk, scan; };
+    static const Oem oem[] = {
+        { '`', '~', 0xC0, 0x29 }, { '-', '_', 0xBD, 0x0C }, { '=', '+', 0xBB, 0x0D }, { '[', '{', 0xDB, 0x1A },
+        { ']', '}', 0xDD, 0x1B }, { '\\', '|', 0xDC, 0x2B }, { ';', ':', 0xBA, 0x27 }, { '\'', '"', 0xDE, 0x28 },
+        { ',', '<', 0xBC, 0x33 }, { '.', '>', 0xBE, 0x34 }, { '/', '?', 0xBF, 0x35 },
+    };
+    KeyLayout layout;
+    for (const Row& r : rows) {
+        for (size_t i = 0; r.plain[i]; ++i) {
+            char c = r.plain[i];
+            uint16_t vk = static_cast<uint16_t>(c >= 'a' ? c - 'a' + 'A' : c);
+            layout.Set(static_cast<char32_t>(c), vk, static_cast<uint16_t>(r.scan + i), 0);
+            layout.Set(static_cast<char32_t>(r.shifted[i]), vk, static_cast<uint16_t>(r.scan + i), LAYOUT_SHIFT);
+        }
+    }
+    for (const Oem& o : oem) {
+        layout.Set(static_cast<char32_t>(o.plain), o.vk, o.scan, 0);
+        layout.Set(static_cast<char32_t>(o.shifted), o.vk, o.scan, LAYOUT_SHIFT);
+    }
+    layout.Set(U' ', 0x20, 0x39, 0);
+    return layout;
+}
+
+// -----------------------------------------------------------------------------
+// Text decoding (invalid input becomes U+FFFD rather than being dropped)
+// -----------------------------------------------------------------------------
+static inline std::u32string DecodeUtf8(const std::string& s)
+{
+    std::u32string out;
+    out.reserve(s.size());
+    size_t i = 0;
+    if (s.compare(0, 3, "\xEF\xBB\xBF") == 0) i = 3; // BOM
+    while (i < s.size()) {
+        unsigned char b = static_cast<unsigned char>(s[i]);
+        size_t len = b < 0x80 ? 1 : (b >> 5) == 6 ? 2 : (b >> 4) == 14 ? 3 : (b >> 3) == 30 ? 4 : 0;
+        char32_t cp = len == 1 ? b : len == 2 ? (b & 0x1F) : len == 3 ? (b & 0x0F) : (b & 0x07);
+        bool ok = len != 0 && i + len <= s.size();
+        for (size_t k = 1; ok && k < len; ++k) {
+            unsigned char c = static_cast<unsigned char>(s[i + k]);
+            ok = (c & 0xC0) == 0x80;
+            cp = (cp << 6) | (c & 0x3F);
+        }
+        if (ok) ok = cp <= 0x10FFFF && (cp < 0xD800 || cp > 0xDFFF);
+        out.push_back(ok ? cp : 0xFFFD);
+        i += ok ? len : 1;
+    }
+    return out;
+}
+
+static inline std::u32string DecodeUtf16(const char16_t* s, size_t n)
+{
+    std::u32string out;
+    out.reserve(n);
+    size_t i = 0;
+    if (n && s[0] == 0xFEFF) i = 1; // BOM
+    for (; i < n; ++i) {
+        char32_t c = s[i];
+        if (c >= 0xD800 && c <= 0xDBFF && i + 1 < n && s[i + 1] >= 0xDC00 && s[i + 1] <= 0xDFFF)
+            out.push_back(0x10000 + ((c - 0xD800) << 10) + (s[++i] - 0xDC00));
+        else
+            out.push_back(c >= 0xD800 && c <= 0xDFFF ? 0xFFFD : c);
+    }
+    return out;
+}
+
+// -----------------------------------------------------------------------------
+// The compiler
+// -----------------------------------------------------------------------------
+struct TextCompileOptions
+{
+    double charsPerSecond = 300; // Event spacing; 0 = all events at time 0
+    bool enterForNewline = true; // false = line breaks are skipped (single-line chat boxes)
+    bool capsLock = false; // Caps Lock is on at the target: letters need the opposite Shift
+    bool coalesceModifiers = true; // false = press/release modifiers around every character
+    size_t maxChars = 0; // 0 = no limit
+};
+
+struct TextProgram
+{
+    std::vector<KeyEvent> events; // Tagged KEY_EXTRA_PASTE
+    size_t chars = 0; // Characters in the program
+    size_t keyed = 0; // ...typed through the layout
+    size_t unicode = 0; // ...injected as code units
+    size_t skipped = 0; // Control characters, and anything past maxChars
+    size_t modifierEvents = 0; // Shift/Ctrl/Alt presses + releases emitted
+    size_t naiveModifierEvents = 0; // What press/release around every character would emit
+    uint64_t durationNs = 0; // Time of the last event
+};
+
+class TextCompiler
+{
+public:
+    TextCompiler(const KeyLayout& layout, const TextCompileOptions& options) : m_layout(layout), m_options(options) {}
+
+    TextProgram Compile(const std::u32string& text)
+    {
+        m_program = TextProgram();
+        m_program.events.reserve(text.size() * 2 + 16);
+        m_held = 0;
+        m_t = 0;
+        uint64_t interval = m_options.charsPerSecond > 0 ? static_cast<uint64_t>(1e9 / m_options.charsPerSecond) : 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            char32_t c = text[i];
+            if (c == U'\r') {
+                if (i + 1 < text.size() && text[i + 1] == U'\n') continue; // CRLF is one line break
+                c = U'\n';
+            }
+            if (m_options.maxChars && m_program.chars >= m_options.maxChars) {
+                m_program.skipped += text.size() - i;
+                break;
+            }
+            LayoutKey special;
+            const LayoutKey* key = nullptr;
+            if (c == U'\n' && m_options.enterForNewline) {
+                special.vk = 0x0D; // VK_RETURN
+                special.scan = 0x1C;
+                key = &special;
+            }
+            else if (c == U'\t') {
+                special.vk = 0x09; // VK_TAB
+                special.scan = 0x0F;
+                key = &special;
+            }
+            else if (c < 0x20 || c == 0x7F || (c >= 0x80 && c < 0xA0)) {
+                ++m_program.skipped;
+                continue;
+            }
+            else {
+                key = m_layout.Find(c);
+            }
+            if (key) {
+                uint8_t mods = key->mods;
+                bool letter = key->vk >= 'A' && key->vk <= 'Z';
+                if (m_options.capsLock && letter && !(mods & (LAYOUT_CTRL | LAYOUT_ALT))) mods ^= LAYOUT_SHIFT;
+                m_program.naiveModifierEvents += 2 * Popcount(mods);
+                SetModifiers(mods);
+                Emit(key->vk, key->scan, 0);
+                m_t += interval / 2;
+                Emit(key->vk, key->scan, KEY_UP);
+                ++m_program.keyed;
+            }
+            else {
+                // Shift doesn't change an injected character, but Ctrl/Alt would make it a shortcut
+                SetModifiers(m_held & LAYOUT_SHIFT);
+                if (c > 0xFFFF) {
+                    EmitUnit(static_cast<uint16_t>(0xD800 + ((c - 0x10000) >> 10)));
+                    EmitUnit(static_cast<uint16_t>(0xDC00 + ((c - 0x10000) & 0x3FF)));
+                }
+                else {
+                    EmitUnit(static_cast<uint16_t>(c));
+                }
+                m_t += interval / 2;
+                ++m_program.unicode;
+            }
+            if (!m_options.coalesceModifiers) SetModifiers(0);
+            m_t += interval - interval / 2;
+            ++m_program.chars;
+        }
+        SetModifiers(0);
+        m_program.durationNs = m_program.events.empty() ? 0 : m_program.events.back().timeNs;
+        return std::move(m_program);
+    }
+
+private:
+    static size_t Popcount(uint8_t m) { return (m & 1) + ((m >> 1) & 1) + ((m >> 2) & 1); }
+
+    void Emit(uint16_t vk, uint16_t scan, uint16_t flags)
+    {
+        KeyEvent ev = { m_t, vk, scan, flags, KEY_EXTRA_PASTE };
+        m_program.events.push_back(ev);
+    }
+
+    void EmitUnit(uint16_t unit)
+    {
+        Emit(0, unit, KEY_UNICODE);
+        Emit(0, unit, KEY_UNICODE | KEY_UP);
+    }
+
+    // Releases what isn't wanted, then presses what's missing. AltGr (Ctrl+Alt)
+    // uses right Alt, as the physical AltGr key does.
+    void SetModifiers(uint8_t want)
+    {
+        if (want == m_held) return;
+        struct Mod { uint8_t bit; uint16_t vk, scan; };
+        const Mod mods[] = { { LAYOUT_SHIFT, 0xA0, 0x2A }, { LAYOUT_CTRL, 0xA2, 0x1D }, { LAYOUT_ALT, 0xA4, 0x38 } };
+        for (const Mod& m : mods) {
+            if ((m_held & m.bit) && !(want & m.bit)) {
+                if (m.bit == LAYOUT_ALT) Emit(m_altVk, 0x38, static_cast<uint16_t>(KEY_UP | (m_altVk == 0xA5 ? KEY_EXTENDED : 0)));
+                else Emit(m.vk, m.scan, KEY_UP);
+                ++m_program.modifierEvents;
+            }
+        }
+        for (const Mod& m : mods) {
+            if (!(m_held & m.bit) && (want & m.bit)) {
+                if (m.bit == LAYOUT_ALT) {
+                    m_altVk = (want & LAYOUT_CTRL) ? 0xA5 : 0xA4;
+                    Emit(m_altVk, 0x38, m_altVk == 0xA5 ? KEY_EXTENDED : 0);
+                }
+                else {
+                    Emit(m.vk, m.scan, 0);
+                }
+                ++m_program.modifierEvents;
+            }
+        }
+        m_held = want;
+    }
+
+    const KeyLayout& m_layout;
+    TextCompileOptions m_options;
+    TextProgram m_program;
+    uint8_t m_held = 0; // Modifiers currently down in the program
+    uint16_t m_altVk = 0xA4; // Which Alt is down (right Alt for AltGr)
+    uint64_t m_t = 0;
+};
+
+#ifdef _WIN32
+// The keyboard layout hkl, for just the characters in text. Every mapping is
+// checked with ToUnicodeEx so dead keys and odd shift states fall back to
+// unicode injection instead of typing the wrong thing.
+static inline KeyLayout KeyLayoutFromSystem(HKL hkl, const std::u32string& text)
+{
+    KeyLayout layout;
+    std::unordered_set<char32_t> tried;
+    for (char32_t c : text) {
+        if (c < 0x20 || c > 0xFFFF || !tried.insert(c).second) continue;
+        SHORT r = VkKeyScanExW(static_cast<WCHAR>(c), hkl);
+        if (r == -1) continue;
+        BYTE vk = LOBYTE(r), state = HIBYTE(r);
+        if (state & ~7) continue; // Kana / OEM shift states
+        BYTE keys[256] = {};
+        if (state & LAYOUT_SHIFT) keys[VK_SHIFT] = 0x80;
+        if (state & LAYOUT_CTRL) keys[VK_CONTROL] = 0x80;
+        if (state & LAYOUT_ALT) keys[VK_MENU] = 0x80;
+        UINT scan = MapVirtualKeyExW(vk, MAPVK_VK_TO_VSC, hkl);
+        WCHAR out[4] = {};
+        // Flag 4: don't touch the kernel's dead-key state (Windows 10 1607+)
+        if (ToUnicodeEx(vk, scan, keys, out, 4, 4, hkl) != 1 || out[0] != static_cast<WCHAR>(c)) continue;
+        layout.Set(c, vk, static_cast<uint16_t>(scan), state);
+    }
+    return layout;
+}
+#endif
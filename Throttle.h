@@ -0,0 +1,416 @@
+// =============================================================================
+// Throttle.h - Duty-cycle throttling: let a background process run in slices
+//
+// A hard pause can cost an idle MMO client or emulator its connection. A
+// throttled target is instead thawed for `slice` out of every `period` (say
+// 2 ms of every 20 ms) with the same group freezer a pause uses, so it keeps
+// running at a fraction of the CPU. Every half second the slice is replanned
+// from the CPU time the group actually used, plus a share of whatever it is
+// owed (or has overdrawn) since the throttle started, so the achieved share
+// converges on the target whether the process is multi-threaded, I/O-bound
+// or idle, and a biased estimate can't leave a steady offset. The share
+// converges over a few seconds; a single window can still be off by half
+// when the freeze cost swings (a busy target on one core can keep running
+// for milliseconds after SIGSTOP).
+//
+// Shares are fractions of one core (1.0 = one core flat out, like `top`).
+// The longest freeze is period - slice plus timer lateness; both are tracked
+// and reported. The slicing thread runs at raised priority (time-critical on
+// Windows, SCHED_FIFO on Linux when allowed) so a busy machine can't leave the
+// target frozen for long.
+// =============================================================================
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "RetroLog.h"
+#include "ProcessTree.h"
+#include "ReplayScheduler.h"
+#include "ResumeStrategy.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+struct ThrottleOptions
+{
+    double share = 0.15; // Target CPU, fraction of one core
+    int periodMs = 20; // One run slice per period
+    bool adaptive = true; // Correct the slice from measured CPU time
+};
+
+struct ThrottleStats
+{
+    uint32_t pid = 0;
+    double targetShare = 0;
+    double achievedShare = 0; // Since the throttle started
+    double recentShare = 0; // Last adaptation window
+    int64_t sliceNs = 0;
+    int64_t periodNs = 0;
+    uint64_t periods = 0;
+    int64_t maxFrozenNs = 0; // Longest the target went without running
+    int64_t maxLateNs = 0; // Worst timer overshoot on a slice end
+    int64_t freezeCostNs = 0; // Mean time one group freeze took
+};
+
+class DutyCycleThrottler
+{
+public:
+    static const int64_t WINDOW_NS = 500000000; // Adaptation window
+    static const int64_t RESOLVE_NS = 2000000000; // How often the group is re-resolved (new children)
+    static const int64_t MIN_SLICE_NS = 200000;
+    static const int DEBT_WINDOWS = 2; // CPU owed since the start is paid back over this many windows
+
+    DutyCycleThrottler(const PauseTargetOptions& targets, GroupOrder order, uint32_t selfPid,
+        const ThrottleOptions& options, AsyncLogger* log = nullptr)
+        : m_targets(targets), m_order(order), m_selfPid(selfPid), m_options(options), m_log(log), m_group(1)
+    {
+    }
+    ~DutyCycleThrottler() { Stop(); }
+    DutyCycleThrottler(const DutyCycleThrottler&) = delete;
+    DutyCycleThrottler& operator=(const DutyCycleThrottler&) = delete;
+
+    bool Start(uint32_t pid)
+    {
+        Stop();
+        m_members = ResolvePauseTargets(pid, m_targets, m_selfPid);
+        if (m_members.empty()) return false;
+        m_pid = pid;
+        m_stats = ThrottleStats();
+        m_stats.pid = pid;
+        m_stats.targetShare = m_options.share;
+        m_running = true;
+        m_thread = std::thread([this] { Run(); });
+        return true;
+    }
+
+    // Thaws the target for good; safe to call more than once
+    void Stop()
+    {
+        m_running = false;
+        if (m_thread.joinable()) m_thread.join();
+        m_group.Thaw();
+    }
+
+    // False once stopped, or once the target has exited
+    bool Active() const { return m_running; }
+    uint32_t Pid() const { return m_pid; }
+    ThrottleStats Stats()
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        return m_stats;
+    }
+
+private:
+    template <typename... Args>
+    void Log(const char* fmt, Args... args)
+    {
+        if (m_log) m_log->PushF(fmt, args...);
+    }
+
+    uint64_t GroupCpuNs() const
+    {
+        uint64_t ns = 0;
+        for (const PauseMember& m : m_members) ns += ProcessCpuNs(m.pid);
+        return ns;
+    }
+
+    static bool SameMembers(const std::vector<PauseMember>& a, const std::vector<PauseMember>& b)
+    {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+            [](const PauseMember& x, const PauseMember& y) { return x.pid == y.pid && x.depth == y.depth; });
+    }
+
+    static void RaiseThreadPriority()
+    {
+#ifdef _WIN32
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#else
+        // Real-time if allowed: a woken target must not be able to hold the CPU past the
+        // thaw or the slice end. It sleeps almost all the time, so this is safe.
+        sched_param rt = {};
+        rt.sched_priority = 10;
+        if (sched_setscheduler(0, SCHED_FIFO, &rt) != 0)
+            setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), -10);
+#endif
+    }
+
+    void Run()
+    {
+        TraceThreadName("throttle");
+        RaiseThreadPriority();
+        PreciseWaiter waiter;
+        waiter.SetSpinNs(50000); // Lateness only costs share, and the adaptation corrects that
+        const int64_t period = std::max(1, m_options.periodMs) * 1000000LL;
+        const double share = std::min(1.0, std::max(0.01, m_options.share));
+        int64_t slice = std::max<int64_t>(MIN_SLICE_NS, static_cast<int64_t>(period * share));
+        int64_t start = static_cast<int64_t>(MonotonicNs());
+        uint64_t cpuStart = GroupCpuNs(), cpuWindow = cpuStart;
+        int64_t windowStart = start, lastResolve = start, lastReport = start;
+        int64_t periodStart = start, frozenAt = start, freezeCost = 0;
+        int64_t windowOverrun = 0; // Lateness + freeze time this window: the target runs through both
+        uint64_t periods = 0, windowPeriods = 0;
+        bool replan = true; // Hand the group a new member set; otherwise it refreezes the last one
+        {
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            m_stats.sliceNs = slice;
+            m_stats.periodNs = period;
+        }
+        Log("*** THROTTLE ENGAGED *** PID %u: %.0f%% of a core, %.2f ms slices every %d ms (%zu processes)", m_pid,
+            share * 100, slice / 1e6, m_options.periodMs, m_members.size());
+        while (m_running) {
+            m_group.Thaw();
+            int64_t runAt = static_cast<int64_t>(MonotonicNs());
+            int64_t frozen = runAt - frozenAt;
+            waiter.SleepUntil(static_cast<uint64_t>(periodStart + slice));
+            int64_t sliceEnd = static_cast<int64_t>(MonotonicNs());
+            int64_t late = sliceEnd - (periodStart + slice);
+            // Same freezers every period: only the re-resolve below changes the member set
+            std::vector<MemberResult> results = replan ? m_group.Freeze(m_members, m_order) : m_group.Freeze();
+            replan = false;
+            frozenAt = static_cast<int64_t>(MonotonicNs());
+            freezeCost += frozenAt - sliceEnd;
+            windowOverrun += frozenAt - (periodStart + slice);
+            ++periods;
+            ++windowPeriods;
+            bool alive = false;
+            for (const MemberResult& r : results) alive = alive || r.result.ok;
+            if (!alive) {
+                Log("*** THROTTLE ENDED *** PID %u is gone", m_pid);
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_statsMutex);
+                m_stats.maxFrozenNs = std::max(m_stats.maxFrozenNs, frozen);
+                m_stats.maxLateNs = std::max(m_stats.maxLateNs, late);
+            }
+            // Next period; if we fell badly behind, start over rather than run slices back to back
+            periodStart += period;
+            if (frozenAt > periodStart) periodStart = frozenAt;
+
+            if (frozenAt - windowStart >= WINDOW_NS) {
+                uint64_t cpu = GroupCpuNs();
+                double windowNs = static_cast<double>(frozenAt - windowStart);
+                double used = static_cast<double>(cpu - cpuWindow);
+                double recent = used / windowNs;
+                if (m_options.adaptive) {
+                    // Each period the target ran for slice + overrun (lateness and the freeze itself,
+                    // which a multi-threaded target keeps running through), at `cores` cores meanwhile.
+                    // Plan the next window for the target share plus a slice of the running debt.
+                    int64_t overrun = windowOverrun / static_cast<int64_t>(windowPeriods);
+                    double cores = used / (static_cast<double>(windowPeriods) * static_cast<double>(slice + overrun));
+                    double owed = share * static_cast<double>(frozenAt - start) - static_cast<double>(cpu - cpuStart);
+                    double due = share * WINDOW_NS;
+                    double want = due + std::min(due, std::max(-due, owed / DEBT_WINDOWS));
+                    double periodsAhead = static_cast<double>(windowPeriods) * WINDOW_NS / windowNs;
+                    // Go half way to the planned slice: the freeze cost swings from window to window,
+                    // and a full step on one noisy estimate oscillates
+                    if (cores > 0.01) slice = (slice + static_cast<int64_t>(want / periodsAhead / cores) - overrun) / 2;
+                    else slice *= 2; // Idle or blocked: nothing to measure, just let it run longer
+                    slice = std::min(period - MIN_SLICE_NS, std::max(MIN_SLICE_NS, slice));
+                }
+                windowOverrun = 0;
+                windowPeriods = 0;
+                std::lock_guard<std::mutex> lock(m_statsMutex);
+                m_stats.recentShare = recent;
+                m_stats.achievedShare = static_cast<double>(cpu - cpuStart) / static_cast<double>(frozenAt - start);
+                m_stats.sliceNs = slice;
+                m_stats.periodNs = period;
+                m_stats.periods = periods;
+                m_stats.freezeCostNs = freezeCost / static_cast<int64_t>(periods);
+                cpuWindow = cpu;
+                windowStart = frozenAt;
+            }
+            if (frozenAt - lastResolve >= RESOLVE_NS) {
+                std::vector<PauseMember> members = ResolvePauseTargets(m_pid, m_targets, m_selfPid);
+                if (!members.empty() && !SameMembers(members, m_members)) {
+                    m_members.swap(members);
+                    replan = true;
+                }
+                lastResolve = frozenAt;
+            }
+            if (frozenAt - lastReport >= 10 * 1000000000LL) {
+                Report("*** THROTTLE ***");
+                lastReport = frozenAt;
+            }
+            waiter.SleepUntil(static_cast<uint64_t>(periodStart));
+        }
+        m_group.Thaw();
+        Report("*** THROTTLE RELEASED ***");
+        m_running = false;
+    }
+
+    void Report(const char* banner)
+    {
+        ThrottleStats s = Stats();
+        Log("%s PID %u: %.1f%% of a core (target %.0f%%), slice %.2f ms of %.0f ms, longest freeze %.1f ms, worst timer lateness %.2f ms",
+            banner, s.pid, s.achievedShare * 100, s.targetShare * 100, s.sliceNs / 1e6, s.periodNs / 1e6, s.maxFrozenNs / 1e6, s.maxLateNs / 1e6);
+    }
+
+    PauseTargetOptions m_targets;
+    GroupOrder m_order;
+    uint32_t m_selfPid;
+    ThrottleOptions m_options;
+    AsyncLogger* m_log;
+    // One worker: the slicing thread runs at real-time priority, a pool at normal
+    // priority would queue behind the very target it is trying to stop
+    ProcessGroupFreezer m_group;
+    std::vector<PauseMember> m_members;
+    uint32_t m_pid = 0;
+    std::atomic<bool> m_running{ false };
+    std::thread m_thread;
+    std::mutex m_statsMutex;
+    ThrottleStats m_stats;
+};
+
+// -----------------------------------------------------------------------------
+// All throttled processes: toggled by hotkey, or matched by image name rules
+// -----------------------------------------------------------------------------
+class ThrottleManager
+{
+public:
+    ThrottleManager(const PauseTargetOptions& targets, GroupOrder order, uint32_t selfPid,
+        const ThrottleOptions& options, AsyncLogger* log = nullptr)
+        : m_targets(targets), m_order(order), m_selfPid(selfPid), m_options(options), m_log(log)
+    {
+    }
+    ~ThrottleManager() { StopAll(); }
+
+    // Throttle pid, or release it if it already is. Returns true if now throttled.
+    bool Toggle(uint32_t pid)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_active.find(pid);
+        if (it != m_active.end() && it->second->Active()) {
+            m_active.erase(it); // Destructor thaws
+            m_exempt.insert(pid); // Rules don't take it back
+            return false;
+        }
+        m_exempt.erase(pid);
+        return StartLocked(pid);
+    }
+
+    // Stop throttling pid (e.g. it's about to be hard-paused). Returns true if it was.
+    bool Release(uint32_t pid)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_active.find(pid);
+        if (it == m_active.end()) return false;
+        bool was = it->second->Active();
+        m_active.erase(it);
+        m_exempt.insert(pid);
+        return was;
+    }
+
+    bool Throttled(uint32_t pid)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_active.find(pid);
+        return it != m_active.end() && it->second->Active();
+    }
+
+    // Throttle every process whose image name matches, now and as they start
+    void Watch(const std::vector<std::string>& imageNames)
+    {
+        if (imageNames.empty() || m_watcher.joinable()) return;
+        m_rules = imageNames;
+        m_watching = true;
+        m_watcher = std::thread([this] { WatchLoop(); });
+    }
+
+    // Reloaded settings: options apply to throttles started from now on, the rules replace the old ones
+    void Reconfigure(const ThrottleOptions& options, const std::vector<std::string>& imageNames)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_options = options;
+            if (m_watcher.joinable()) m_rules = imageNames;
+        }
+        Watch(imageNames); // Starts the watcher if there were no rules before
+    }
+
+    void StopAll()
+    {
+        if (m_watcher.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_watching = false;
+            }
+            m_wake.notify_all();
+            m_watcher.join();
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_active.clear();
+    }
+
+    std::vector<ThrottleStats> Stats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<ThrottleStats> out;
+        for (auto& kv : m_active) out.push_back(kv.second->Stats());
+        return out;
+    }
+
+private:
+    bool StartLocked(uint32_t pid)
+    {
+        std::unique_ptr<DutyCycleThrottler> t(new DutyCycleThrottler(m_targets, m_order, m_selfPid, m_options, m_log));
+        if (!t->Start(pid)) return false;
+        m_active[pid] = std::move(t);
+        return true;
+    }
+
+    void WatchLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_watching) {
+            // Scan without the lock: Toggle/Release/Stats must not wait on a process list walk
+            lock.unlock();
+            std::vector<ProcessInfo> processes = ListProcesses();
+            lock.lock();
+            if (!m_watching) break;
+            // Reap throttles whose target exited
+            for (auto it = m_active.begin(); it != m_active.end();) {
+                if (it->second->Active()) ++it;
+                else it = m_active.erase(it);
+            }
+            // An exemption ends with the process: a new one that gets its PID is fair game
+            std::set<uint32_t> live;
+            for (const ProcessInfo& p : processes) live.insert(p.pid);
+            for (auto it = m_exempt.begin(); it != m_exempt.end();) {
+                if (live.count(*it)) ++it;
+                else it = m_exempt.erase(it);
+            }
+            for (const ProcessInfo& p : processes) {
+                if (p.pid == m_selfPid || m_active.count(p.pid) || m_exempt.count(p.pid)) continue;
+                if (std::find(m_rules.begin(), m_rules.end(), p.name) != m_rules.end()) StartLocked(p.pid);
+            }
+            m_wake.wait_for(lock, std::chrono::seconds(2), [this] { return !m_watching; });
+        }
+    }
+
+    PauseTargetOptions m_targets;
+    GroupOrder m_order;
+    uint32_t m_selfPid;
+    ThrottleOptions m_options;
+    AsyncLogger* m_log;
+    std::mutex m_mutex;
+    std::map<uint32_t, std::unique_ptr<DutyCycleThrottler>> m_active;
+    std::set<uint32_t> m_exempt; // Released by hand - rules leave them alone
+    std::vector<std::string> m_rules;
+    bool m_watching = false;
+    std::condition_variable m_wake;
+    std::thread m_watcher;
+};
@@ -0,0 +1,426 @@
+// =============================================================================
+// Tracing.h - Opt-in nanosecond spans, dumped as a Chrome / Perfetto timeline
+//
+// The log says how long a pause took; a trace says where the time went. With
+// [Trace] on, the steps of a pause - hotkey, held-key release, each thread's
+// suspend and resume, hook install/remove, every replay injection and sleep,
+// Esc/Enter - record spans with steady-clock nanosecond timestamps.
+//
+// Each thread records into its own ring, taken the first time it records
+// anything, so recording takes no lock and shares no cache line with another
+// thread. The ring keeps the newest events. When the thread exits its ring is
+// kept for the next dump, then handed to the next new thread.
+// Tracer::Dump() copies every ring into Chrome's trace-event JSON, which both
+// chrome://tracing and ui.perfetto.dev open; a slot the writer laps while it
+// is being copied is dropped rather than read half-written.
+//
+// Off, a span is one relaxed load and a branch. Names must be string literals:
+// only the pointer is stored.
+// =============================================================================
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const size_t TRACE_DEFAULT_EVENTS = 32768; // Per thread
+static const size_t TRACE_MAX_THREADS = 64; // Rings at once; threads beyond this record nothing and are counted
+
+static inline std::atomic<bool>& TraceSwitch()
+{
+    static std::atomic<bool> on(false);
+    return on;
+}
+
+static inline bool TraceEnabled() { return TraceSwitch().load(std::memory_order_relaxed); }
+
+static inline int64_t TraceNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static inline uint32_t TraceThreadId()
+{
+#ifdef _WIN32
+    return GetCurrentThreadId();
+#else
+    return static_cast<uint32_t>(syscall(SYS_gettid));
+#endif
+}
+
+struct TraceEvent
+{
+    int64_t ts = 0; // Steady-clock ns
+    int64_t dur = -1; // -1 = instant
+    const char* name = nullptr;
+    const char* argName = nullptr; // Null = no argument
+    uint64_t arg = 0;
+};
+
+// One thread's ring. Only the owning thread writes. It bumps claim before it
+// overwrites a slot and publishes head after, so a dumper on another thread can
+// tell which of the slots it copied may have changed under it. Slots are relaxed
+// 64-bit atomics, so a copy torn by the writer is discarded with no data race in
+// the C++ sense (as in KeyRing.h).
+class TraceBuffer
+{
+public:
+    TraceBuffer(size_t capacity, uint32_t tid) : m_tid(tid)
+    {
+        size_t n = 1;
+        while (n < capacity) n <<= 1;
+        m_slots.reset(new Slot[n]);
+        m_mask = n - 1;
+    }
+
+    void Add(const TraceEvent& ev)
+    {
+        uint64_t h = m_head.load(std::memory_order_relaxed);
+        m_claim.store(h + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release); // Claim before the slot changes
+        Store(m_slots[h & m_mask], ev);
+        m_head.store(h + 1, std::memory_order_release);
+    }
+
+    // Appends the events still intact; lost counts the ones already overwritten
+    void CopyTo(std::vector<TraceEvent>& out, uint64_t& lost) const
+    {
+        uint64_t size = m_mask + 1;
+        uint64_t end = m_head.load(std::memory_order_acquire);
+        uint64_t begin = end > size ? end - size : 0;
+        std::vector<TraceEvent> copy;
+        copy.reserve(static_cast<size_t>(end - begin));
+        for (uint64_t i = begin; i < end; ++i) copy.push_back(Load(m_slots[i & m_mask]));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // Write n (0-based) lands on index n - size: every index below claim - size may have changed
+        uint64_t claim = m_claim.load(std::memory_order_relaxed);
+        uint64_t safe = std::max(begin, claim > size ? claim - size : 0);
+        if (safe > end) safe = end;
+        lost += safe;
+        out.insert(out.end(), copy.begin() + static_cast<std::ptrdiff_t>(safe - begin), copy.end());
+    }
+
+    // Hands the ring to another thread; nothing may be reading it
+    void Reset(uint32_t tid)
+    {
+        m_head.store(0, std::memory_order_relaxed);
+        m_claim.store(0, std::memory_order_relaxed);
+        m_name.store(nullptr, std::memory_order_relaxed);
+        m_tid = tid;
+    }
+
+    size_t Capacity() const { return static_cast<size_t>(m_mask + 1); }
+    uint32_t Tid() const { return m_tid; }
+    void SetName(const char* name) { m_name.store(name, std::memory_order_release); }
+    const char* Name() const { return m_name.load(std::memory_order_acquire); }
+
+private:
+    static const size_t WORDS = sizeof(TraceEvent) / sizeof(uint64_t);
+    static_assert(sizeof(TraceEvent) % sizeof(uint64_t) == 0, "TraceEvent is copied as whole 64-bit words");
+    struct Slot { std::atomic<uint64_t> w[WORDS]; };
+
+    static void Store(Slot& s, const TraceEvent& ev)
+    {
+        uint64_t w[WORDS];
+        std::memcpy(w, &ev, sizeof(w));
+        for (size_t i = 0; i < WORDS; ++i) s.w[i].store(w[i], std::memory_order_relaxed);
+    }
+    static TraceEvent Load(const Slot& s)
+    {
+        uint64_t w[WORDS];
+        for (size_t i = 0; i < WORDS; ++i) w[i] = s.w[i].load(std::memory_order_relaxed);
+        TraceEvent ev;
+        std::memcpy(&ev, w, sizeof(ev));
+        return ev;
+    }
+
+    std::unique_ptr<Slot[]> m_slots;
+    uint64_t m_mask = 0;
+    std::atomic<uint64_t> m_head{ 0 }; // Events written
+    std::atomic<uint64_t> m_claim{ 0 }; // Events started: head, or head + 1 mid-write
+    std::atomic<const char*> m_name{ nullptr };
+    uint32_t m_tid;
+};
+
+struct TraceDumpStats
+{
+    size_t events = 0;
+    size_t threads = 0;
+    uint64_t lost = 0; // Overwritten by newer events before the dump
+    uint64_t bytes = 0;
+    uint64_t untraced = 0; // Threads that found all TRACE_MAX_THREADS rings taken, since startup
+};
+
+class Tracer
+{
+public:
+    static Tracer& Instance()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    // eventsPerThread applies to threads that have not recorded yet
+    void Enable(size_t eventsPerThread = TRACE_DEFAULT_EVENTS)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_capacity = std::max<size_t>(16, eventsPerThread);
+        }
+        TraceSwitch().store(true, std::memory_order_relaxed);
+    }
+    void Disable() { TraceSwitch().store(false, std::memory_order_relaxed); }
+
+    void Record(const TraceEvent& ev)
+    {
+        if (TraceBuffer* buf = ThisThread()) buf->Add(ev);
+    }
+
+    // name: string literal; shown instead of the thread id. Kept for when the thread
+    // first records, so a thread started while tracing is off still gets its name.
+    void NameThread(const char* name)
+    {
+        ThreadLabel() = name;
+        if (TraceBuffer* buf = Existing()) buf->SetName(name);
+    }
+
+    // Writes everything recorded so far; recording goes on meanwhile. The rings of
+    // threads that had exited by then are freed for reuse afterwards.
+    bool Dump(const std::string& path, TraceDumpStats* stats = nullptr, std::string* error = nullptr)
+    {
+        std::lock_guard<std::mutex> dumping(m_dumpMutex); // One reader at a time, so a freed ring has none
+        std::vector<TraceBuffer*> buffers, exited;
+        TraceDumpStats s;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const auto& b : m_buffers) buffers.push_back(b.get());
+            exited.swap(m_exited);
+            s.untraced = m_untraced;
+        }
+        FILE* f = std::fopen(path.c_str(), "wb");
+        if (!f) {
+            Free(exited);
+            if (error) *error = "cannot write " + path;
+            return false;
+        }
+        s.threads = buffers.size();
+        unsigned long pid = CurrentPid();
+        uint64_t bytes = 0;
+        auto put = [&](int n) {
+            if (n > 0) bytes += static_cast<uint64_t>(n);
+        };
+        put(std::fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"));
+        put(std::fprintf(f, "{\"ph\":\"M\",\"pid\":%lu,\"tid\":0,\"name\":\"process_name\",\"args\":{\"name\":\"GamePauser\"}}", pid));
+        std::vector<TraceEvent> events;
+        for (TraceBuffer* b : buffers) {
+            if (const char* name = b->Name())
+                put(std::fprintf(f, ",\n{\"ph\":\"M\",\"pid\":%lu,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}", pid, b->Tid(), name));
+            events.clear();
+            b->CopyTo(events, s.lost);
+            for (const TraceEvent& ev : events) {
+                // Microseconds with the nanoseconds kept as three decimals
+                int64_t ts = ev.ts - m_epochNs;
+                if (ts < 0) ts = 0;
+                put(std::fprintf(f, ",\n{\"ph\":\"%s\",\"pid\":%lu,\"tid\":%u,\"name\":\"%s\",\"ts\":%lld.%03d", ev.dur < 0 ? "i\",\"s\":\"t" : "X", pid,
+                    b->Tid(), ev.name, static_cast<long long>(ts / 1000), static_cast<int>(ts % 1000)));
+                if (ev.dur >= 0) put(std::fprintf(f, ",\"dur\":%lld.%03d", static_cast<long long>(ev.dur / 1000), static_cast<int>(ev.dur % 1000)));
+                if (ev.argName) put(std::fprintf(f, ",\"args\":{\"%s\":%llu}", ev.argName, static_cast<unsigned long long>(ev.arg)));
+                put(std::fprintf(f, "}"));
+            }
+            s.events += events.size();
+        }
+        put(std::fprintf(f, "\n]}\n"));
+        bool ok = std::fflush(f) == 0;
+        ok = std::fclose(f) == 0 && ok;
+        Free(exited);
+        s.bytes = bytes;
+        if (stats) *stats = s;
+        if (!ok && error) *error = "write to " + path + " failed";
+        return ok;
+    }
+
+private:
+    Tracer() : m_epochNs(TraceNowNs()) {}
+
+    static TraceBuffer*& Existing()
+    {
+        thread_local TraceBuffer* buffer = nullptr;
+        return buffer;
+    }
+    static const char*& ThreadLabel()
+    {
+        thread_local const char* label = nullptr;
+        return label;
+    }
+
+    // Gives the ring back when its thread exits
+    struct ThreadRing
+    {
+        TraceBuffer* buffer = nullptr;
+        ~ThreadRing()
+        {
+            Existing() = nullptr;
+            Tracer::Instance().Exited(buffer);
+        }
+    };
+
+    TraceBuffer* ThisThread()
+    {
+        thread_local bool registered = false;
+        TraceBuffer*& buffer = Existing();
+        if (!registered) {
+            registered = true;
+            buffer = Take();
+            if (buffer) {
+                thread_local ThreadRing ring; // Constructed only by threads that record
+                ring.buffer = buffer;
+            }
+        }
+        return buffer;
+    }
+
+    TraceBuffer* Take()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_buffers.size() >= TRACE_MAX_THREADS) {
+            ++m_untraced;
+            return nullptr;
+        }
+        std::unique_ptr<TraceBuffer> b;
+        while (!m_free.empty() && !b) {
+            b = std::move(m_free.back());
+            m_free.pop_back();
+            if (b->Capacity() < m_capacity) b.reset(); // Sized for an older Enable()
+        }
+        if (b) b->Reset(TraceThreadId());
+        else b.reset(new TraceBuffer(m_capacity, TraceThreadId()));
+        b->SetName(ThreadLabel());
+        m_buffers.push_back(std::move(b));
+        return m_buffers.back().get();
+    }
+
+    void Exited(TraceBuffer* buffer)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exited.push_back(buffer);
+    }
+
+    // After a dump: the rings in `exited` are written out and have no writer
+    void Free(const std::vector<TraceBuffer*>& exited)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (TraceBuffer* b : exited) {
+            auto it = std::find_if(m_buffers.begin(), m_buffers.end(), [b](const std::unique_ptr<TraceBuffer>& p) { return p.get() == b; });
+            if (it == m_buffers.end()) continue;
+            m_free.push_back(std::move(*it));
+            m_buffers.erase(it);
+        }
+    }
+
+    static unsigned long CurrentPid()
+    {
+#ifdef _WIN32
+        return GetCurrentProcessId();
+#else
+        return static_cast<unsigned long>(getpid());
+#endif
+    }
+
+    std::mutex m_mutex, m_dumpMutex;
+    std::vector<std::unique_ptr<TraceBuffer>> m_buffers; // Rings a dump reads: live threads', and exited ones' until dumped
+    std::vector<TraceBuffer*> m_exited; // In m_buffers, thread gone, not dumped yet
+    std::vector<std::unique_ptr<TraceBuffer>> m_free; // Dumped after their thread exited, ready for a new one
+    uint64_t m_untraced = 0;
+    size_t m_capacity = TRACE_DEFAULT_EVENTS;
+    int64_t m_epochNs; // Timestamps in the dump count from here
+};
+
+// -----------------------------------------------------------------------------
+// Recording. Each call checks the switch first and does nothing more when off.
+// -----------------------------------------------------------------------------
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char* name, const char* argName = nullptr, uint64_t arg = 0)
+        : m_name(TraceEnabled() ? name : nullptr), m_argName(argName), m_arg(arg)
+    {
+        if (m_name) m_start = TraceNowNs();
+    }
+    ~TraceSpan()
+    {
+        if (!m_name) return;
+        TraceEvent ev;
+        ev.ts = m_start;
+        ev.dur = TraceNowNs() - m_start;
+        ev.name = m_name;
+        ev.argName = m_argName;
+        ev.arg = m_arg;
+        Tracer::Instance().Record(ev);
+    }
+    // For an argument only known once the work is done
+    void SetArg(const char* argName, uint64_t arg)
+    {
+        m_argName = argName;
+        m_arg = arg;
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* m_name;
+    const char* m_argName;
+    uint64_t m_arg;
+    int64_t m_start = 0;
+};
+
+static inline void TraceInstant(const char* name, const char* argName = nullptr, uint64_t arg = 0)
+{
+    if (!TraceEnabled()) return;
+    TraceEvent ev;
+    ev.ts = TraceNowNs();
+    ev.name = name;
+    ev.argName = argName;
+    ev.arg = arg;
+    Tracer::Instance().Record(ev);
+}
+
+// Call at the top of a long-lived thread
+static inline void TraceThreadName(const char* name) { Tracer::Instance().NameThread(name); }
+
+// [Trace] TraceFile default: next to the executable on Windows, the runtime dir on Linux
+static inline std::string DefaultTracePath(const std::string& exeDir)
+{
+#ifdef _WIN32
+    return exeDir + "GamePauser.trace.json";
+#else
+    (void)exeDir;
+    const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime && *runtime) return std::string(runtime) + "/gamepauser.trace.json";
+    return "/tmp/gamepauser-" + std::to_string(getuid()) + ".trace.json";
+#endif
+}
+
+static inline std::string FormatTraceDump(const std::string& path, const TraceDumpStats& s)
+{
+    char buf[192];
+    int n = std::snprintf(buf, sizeof(buf), "%zu events from %zu threads (%llu overwritten), %.1f KB", s.events, s.threads,
+        static_cast<unsigned long long>(s.lost), s.bytes / 1024.0);
+    if (s.untraced && n > 0 && static_cast<size_t>(n) < sizeof(buf))
+        std::snprintf(buf + n, sizeof(buf) - static_cast<size_t>(n), ", %llu threads untraced (all %zu rings in use)",
+            static_cast<unsigned long long>(s.untraced), TRACE_MAX_THREADS);
+    return std::string(buf) + " -> " + path;
+}